@@ -0,0 +1,29 @@
+# - Find LZ4
+# This module finds an installed LZ4 library.
+#
+# It sets the following variables:
+#  LZ4_FOUND        - Set to false, or undefined, if LZ4 isn't found.
+#  LZ4_INCLUDE_DIRS - The LZ4 include directory.
+#  LZ4_LIBRARIES    - The LZ4 library to link against.
+
+FIND_PATH(LZ4_INCLUDE_DIR lz4.h PATHS $ENV{LZ4_ROOT_DIR}/include $ENV{LZ4_ROOT_DIR})
+
+FIND_LIBRARY(LZ4_LIBRARY NAMES lz4 PATHS $ENV{LZ4_ROOT_DIR}/lib $ENV{LZ4_ROOT_DIR})
+
+IF (LZ4_INCLUDE_DIR AND LZ4_LIBRARY)
+   SET(LZ4_FOUND TRUE)
+   SET(LZ4_INCLUDE_DIRS ${LZ4_INCLUDE_DIR})
+   SET(LZ4_LIBRARIES ${LZ4_LIBRARY})
+ENDIF (LZ4_INCLUDE_DIR AND LZ4_LIBRARY)
+
+IF (LZ4_FOUND)
+   # show which LZ4 was found only if not quiet
+   IF (NOT LZ4_FIND_QUIETLY)
+      MESSAGE(STATUS "Found LZ4: ${LZ4_INCLUDE_DIRS} ${LZ4_LIBRARIES}")
+   ENDIF (NOT LZ4_FIND_QUIETLY)
+ELSE (LZ4_FOUND)
+   # fatal error if LZ4 is required but not found
+   IF (LZ4_FIND_REQUIRED)
+      MESSAGE(FATAL_ERROR "Could not find LZ4")
+   ENDIF (LZ4_FIND_REQUIRED)
+ENDIF (LZ4_FOUND)
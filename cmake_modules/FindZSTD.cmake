@@ -0,0 +1,29 @@
+# - Find Zstandard
+# This module finds an installed Zstandard library.
+#
+# It sets the following variables:
+#  ZSTD_FOUND        - Set to false, or undefined, if Zstandard isn't found.
+#  ZSTD_INCLUDE_DIRS - The Zstandard include directory.
+#  ZSTD_LIBRARIES    - The Zstandard library to link against.
+
+FIND_PATH(ZSTD_INCLUDE_DIR zstd.h PATHS $ENV{ZSTD_ROOT_DIR}/include $ENV{ZSTD_ROOT_DIR})
+
+FIND_LIBRARY(ZSTD_LIBRARY NAMES zstd PATHS $ENV{ZSTD_ROOT_DIR}/lib $ENV{ZSTD_ROOT_DIR})
+
+IF (ZSTD_INCLUDE_DIR AND ZSTD_LIBRARY)
+   SET(ZSTD_FOUND TRUE)
+   SET(ZSTD_INCLUDE_DIRS ${ZSTD_INCLUDE_DIR})
+   SET(ZSTD_LIBRARIES ${ZSTD_LIBRARY})
+ENDIF (ZSTD_INCLUDE_DIR AND ZSTD_LIBRARY)
+
+IF (ZSTD_FOUND)
+   # show which Zstandard was found only if not quiet
+   IF (NOT ZSTD_FIND_QUIETLY)
+      MESSAGE(STATUS "Found Zstandard: ${ZSTD_INCLUDE_DIRS} ${ZSTD_LIBRARIES}")
+   ENDIF (NOT ZSTD_FIND_QUIETLY)
+ELSE (ZSTD_FOUND)
+   # fatal error if Zstandard is required but not found
+   IF (ZSTD_FIND_REQUIRED)
+      MESSAGE(FATAL_ERROR "Could not find Zstandard")
+   ENDIF (ZSTD_FIND_REQUIRED)
+ENDIF (ZSTD_FOUND)
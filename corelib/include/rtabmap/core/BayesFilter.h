@@ -32,7 +32,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <opencv2/core/core.hpp>
 #include <list>
+#include <map>
 #include <set>
+#include <vector>
 #include "rtabmap/utilite/UEventsHandler.h"
 #include "rtabmap/core/Parameters.h"
 
@@ -58,25 +60,56 @@ public:
 	float getVirtualPlacePrior() const {return _virtualPlacePrior;}
 	const std::vector<double> & getPredictionLC() const; // {Vp, Lc, l1, l2, l3, l4...}
 	std::string getPredictionLCStr() const; // for convenience {Vp, Lc, l1, l2, l3, l4...}
+	long getMemoryUsed() const; // In bytes (approximation, std::map nodes are counted as 4 pointers)
 
+	/**
+	 * Dense prediction matrix of the ids (for debugging, the
+	 * filter uses a sparse representation).
+	 */
 	cv::Mat generatePrediction(const Memory * memory, const std::vector<int> & ids);
 
 private:
-	cv::Mat updatePrediction(const cv::Mat & oldPrediction,
+	/**
+	 * Column of the prediction matrix (the prior of a place), only the
+	 * probabilities of its loop closure neighbors are set. The other rows
+	 * have the "fill" value if they were already in the prediction when the
+	 * column was normalized (rowGeneration <= columnGeneration), otherwise 0.
+	 * The virtual place row is implicit: _predictionLC[0] for all places.
+	 */
+	class PredictionColumn
+	{
+	public:
+		PredictionColumn() : fill(0.0f), rowGeneration(0), columnGeneration(0) {}
+		std::vector<std::pair<int, float> > neighbors; // <id, probability>, sorted by id
+		float fill;
+		int rowGeneration;
+		int columnGeneration;
+	};
+	typedef std::map<int, PredictionColumn> Prediction;
+
+	void predict(Prediction & prediction,
+			const Memory * memory,
+			const std::vector<int> & oldIds,
+			const std::vector<int> & ids);
+	void generatePrediction(Prediction & prediction,
+			const Memory * memory,
+			const std::vector<int> & ids);
+	void updatePrediction(Prediction & prediction,
 			const Memory * memory,
 			const std::vector<int> & oldIds,
 			const std::vector<int> & newIds);
 	void updatePosterior(const Memory * memory, const std::vector<int> & likelihoodIds);
-	void normalize(cv::Mat & prediction, unsigned int index, float addedProbabilitiesSum, bool virtualPlaceUsed) const;
+	void normalize(PredictionColumn & column, int id, float addedProbabilitiesSum, bool virtualPlaceUsed, int cols) const;
 
 private:
 	std::map<int, float> _posterior;
-	cv::Mat _prediction;
+	Prediction _prediction;
 	float _virtualPlacePrior;
 	std::vector<double> _predictionLC; // {Vp, Lc, l1, l2, l3, l4...}
 	bool _fullPredictionUpdate;
 	float _totalPredictionLCValues;
 	float _predictionEpsilon;
+	int _predictionGeneration; // incremented on each prediction update
 	std::map<int, std::map<int, int> > _neighborsIndex;
 };
 
@@ -48,6 +48,8 @@ public:
 		timeScanFromDepth(0.0f),
 		timeUndistortDepth(0.0f),
 		timeBilateralFiltering(0.0f),
+		timeScanFiltering(0.0f),
+		timeImuFiltering(0.0f),
 		timeTotal(0.0f),
 		odomCovariance(cv::Mat::eye(6,6,CV_64FC1))
 	{
@@ -65,6 +67,8 @@ public:
 	float timeScanFromDepth;
 	float timeUndistortDepth;
 	float timeBilateralFiltering;
+	float timeScanFiltering;
+	float timeImuFiltering;
 	float timeTotal;
 	Transform odomPose;
 	cv::Mat odomCovariance;
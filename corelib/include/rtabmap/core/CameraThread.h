@@ -33,6 +33,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UThread.h>
 #include <rtabmap/utilite/UEventsSender.h>
 
+class UThreadPool;
+
 namespace clams
 {
 class DiscreteDepthDistortionModel;
@@ -60,6 +62,12 @@ public:
 	CameraThread(Camera * camera, const ParametersMap & parameters = ParametersMap());
 	virtual ~CameraThread();
 
+	/**
+	 * Parse RGBD/CameraPostProcessingAsync and RGBD/CameraPostProcessingThreads,
+	 * called by the constructor. Should be called before the thread is started.
+	 */
+	void parseParameters(const ParametersMap & parameters);
+
 	void setMirroringEnabled(bool enabled) {_mirroring = enabled;}
 	void setStereoExposureCompensation(bool enabled) {_stereoExposureCompensation = enabled;}
 	void setColorOnly(bool colorOnly) {_colorOnly = colorOnly;}
@@ -92,6 +100,19 @@ public:
 		_scanForceGroundNormalsUp = forceGroundNormalsUp;
 	}
 
+	/**
+	 * Post-process the data in a second thread, so that the next data is
+	 * captured while the previous one is post-processed. Should be set
+	 * before the thread is started.
+	 */
+	void setPostProcessingAsync(bool enabled);
+	/**
+	 * Threads used to post-process independent parts of the data
+	 * at the same time (1=sequential, 0=as many as cores). Should be
+	 * set before the thread is started.
+	 */
+	void setPostProcessingThreads(int threads);
+
 	void postUpdate(SensorData * data, CameraInfo * info = 0) const;
 
 	//getters
@@ -104,8 +125,16 @@ private:
 	virtual void mainLoopBegin();
 	virtual void mainLoop();
 	virtual void mainLoopKill();
+	virtual void mainLoopEnd();
+
+	void postUpdateImages(SensorData & data, CameraInfo * info) const;
+	void postUpdateScan(SensorData & data, CameraInfo * info) const;
+	void postUpdateIMU(SensorData & data, CameraInfo * info) const;
 
 private:
+	class PostProcessingThread;
+	class PostUpdateTask;
+	friend class PostUpdateTask;
 	Camera * _camera;
 	bool _mirroring;
 	bool _stereoExposureCompensation;
@@ -126,6 +155,8 @@ private:
 	float _bilateralSigmaS;
 	float _bilateralSigmaR;
 	IMUFilter * _imuFilter;
+	PostProcessingThread * _postProcessingThread;
+	UThreadPool * _postProcessingPool;
 };
 
 } // namespace rtabmap
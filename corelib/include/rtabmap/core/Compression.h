@@ -31,12 +31,82 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
 
 #include <rtabmap/utilite/UThread.h>
+#include <rtabmap/utilite/UThreadPool.h>
 #include <opencv2/opencv.hpp>
 
 namespace rtabmap {
 
 /**
- * Compress image or data
+ * Codecs of compressData()/compressData2(). zlib data has no header
+ * (compatible with data saved by previous versions), the other
+ * codecs start with a byte identifying the codec. uncompressData()
+ * detects the codec. LZ4 is the fastest (real-time saves), zstd
+ * gives the smallest data (archives).
+ */
+enum CompressionCodec
+{
+	kCompressionZlib = 0,
+	kCompressionLZ4 = 1,
+	kCompressionZstd = 2
+};
+/**
+ * @return true if RTAB-Map is built with this codec. Compressing
+ *         with an unavailable codec falls back to zlib.
+ */
+bool RTABMAP_EXP isCompressionCodecAvailable(CompressionCodec codec);
+
+/**
+ * Compress or uncompress image or data in a thread of the
+ * process-wide compression pool.
+ *
+ * Example:
+ *   cv::Mat image;// an image
+ *   cv::Mat userData;// some data
+ *   CompressionTask ctImage(image, ".jpg");
+ *   CompressionTask ctUserData(userData);
+ *   std::vector<CompressionTask*> tasks;
+ *   tasks.push_back(&ctImage);
+ *   tasks.push_back(&ctUserData);
+ *   runCompressionTasks(tasks); // blocking
+ *   cv::Mat imageBytes = ctImage.getCompressedData();
+ *   cv::Mat userDataBytes = ctUserData.getCompressedData();
+ */
+class RTABMAP_EXP CompressionTask : public UThreadPoolTask
+{
+public:
+	// format : ".png" ".jpg" ".rvl" "" (empty is general, compressed with codec)
+	CompressionTask(const cv::Mat & mat, const std::string & format = "", CompressionCodec codec = kCompressionZlib);
+	CompressionTask(const cv::Mat & bytes, bool isImage);
+	const cv::Mat & getCompressedData() const {return compressedData_;}
+	cv::Mat & getUncompressedData() {return uncompressedData_;}
+	virtual void run();
+private:
+	cv::Mat compressedData_;
+	cv::Mat uncompressedData_;
+	std::string format_;
+	CompressionCodec codec_;
+	bool image_;
+	bool compressMode_;
+};
+
+/**
+ * Process-wide thread pool used for compression/uncompression (created on
+ * first use with as many threads as cores). Other tasks can be submitted to it,
+ * like batches of nodes to uncompress (see SensorData::uncompressData(const std::vector<SensorData*>&)).
+ */
+UThreadPool RTABMAP_EXP & compressionThreadPool();
+
+/**
+ * Execute the tasks in the compression pool, the calling thread
+ * participates. Returns when all tasks are done. cv::Exception are
+ * caught by each task (its result is then empty), other exceptions
+ * (e.g., UException) are rethrown here once no task is running anymore.
+ */
+void RTABMAP_EXP runCompressionTasks(const std::vector<CompressionTask*> & tasks);
+
+/**
+ * Compress image or data in its own thread. Prefer CompressionTask with
+ * runCompressionTasks() to avoid creating a thread for each blob.
  *
  * Example compression:
  *   cv::Mat image;// an image
@@ -55,29 +125,27 @@ namespace rtabmap {
 class RTABMAP_EXP CompressionThread : public UThread
 {
 public:
-	// format : ".png" ".jpg" "" (empty is general)
+	// format : ".png" ".jpg" ".rvl" "" (empty is general)
 	CompressionThread(const cv::Mat & mat, const std::string & format = "");
 	CompressionThread(const cv::Mat & bytes, bool isImage);
-	const cv::Mat & getCompressedData() const {return compressedData_;}
-	cv::Mat & getUncompressedData() {return uncompressedData_;}
+	const cv::Mat & getCompressedData() const {return task_.getCompressedData();}
+	cv::Mat & getUncompressedData() {return task_.getUncompressedData();}
 protected:
 	virtual void mainLoop();
 private:
-	cv::Mat compressedData_;
-	cv::Mat uncompressedData_;
-	std::string format_;
-	bool image_;
-	bool compressMode_;
+	CompressionTask task_;
 };
 
+// format : ".png", ".jpg" or ".rvl" (lossless and fast for 16UC1 depth images, ".png" is used
+//          for other types). uncompressImage() detects the format from the bytes.
 std::vector<unsigned char> RTABMAP_EXP compressImage(const cv::Mat & image, const std::string & format = ".png");
 cv::Mat RTABMAP_EXP compressImage2(const cv::Mat & image, const std::string & format = ".png");
 
 cv::Mat RTABMAP_EXP uncompressImage(const cv::Mat & bytes);
 cv::Mat RTABMAP_EXP uncompressImage(const std::vector<unsigned char> & bytes);
 
-std::vector<unsigned char> RTABMAP_EXP compressData(const cv::Mat & data);
-cv::Mat RTABMAP_EXP compressData2(const cv::Mat & data);
+std::vector<unsigned char> RTABMAP_EXP compressData(const cv::Mat & data, CompressionCodec codec = kCompressionZlib);
+cv::Mat RTABMAP_EXP compressData2(const cv::Mat & data, CompressionCodec codec = kCompressionZlib);
 
 cv::Mat RTABMAP_EXP uncompressData(const cv::Mat & bytes);
 cv::Mat RTABMAP_EXP uncompressData(const std::vector<unsigned char> & bytes);
@@ -79,6 +79,12 @@ public:
 	void emptyTrashes(bool async = false);
 	double getEmptyTrashesTime() const {return _emptyTrashesTime;}
 	void setTimestampUpdateEnabled(bool enabled) {_timestampUpdate = enabled;} // used on Update Signature and Word queries
+	/**
+	 * Codec used to write blobs (see CompressionCodec). Only zlib is used with databases
+	 * created before 0.20.0, so that they can still be read by older versions.
+	 */
+	int getCompressionCodec() const {return getCompressionCodec(_compressionCodec);}
+	int getCompressionCodec(int codec) const;
 
 	// Warning: the following functions don't look in the trash, direct database modifications
 	void generateGraph(
@@ -298,6 +304,8 @@ private:
 	double _emptyTrashesTime;
 	std::string _url;
 	bool _timestampUpdate;
+	int _compressionCodec;
+	bool _compressionCodecsSupported; // database version >= 0.20.0
 };
 
 }
@@ -180,6 +180,8 @@ private:
 
 private:
 	void loadLinksQuery(std::list<Signature *> & signatures) const;
+	void loadStatisticsNamesQuery() const;
+	std::map<std::string, float> statisticsFromBinary(const cv::Mat & data) const;
 	int loadOrSaveDb(sqlite3 *pInMemory, const std::string & fileName, int isSave) const;
 
 protected:
@@ -193,6 +195,12 @@ private:
 	int _journalMode;
 	int _synchronous;
 	int _tempStore;
+
+	// StatisticsName table (databases >= 0.20.0), loaded on first use
+	mutable bool _statisticsNamesLoaded;
+	mutable std::map<int, std::string> _statisticsNames; // <database id, name>
+	mutable std::map<std::string, int> _statisticsNameIds; // <name, database id>
+	mutable std::vector<int> _statisticsDbIds; // Statistics::statisticId() -> database id, 0 if not resolved yet
 };
 
 }
@@ -71,12 +71,34 @@ public:
 	virtual std::string getSerial() const;
 	virtual bool odomProvided() const {return !_odometryIgnored;}
 
+	/**
+	 * Load and decompress the next nodes in a background thread, so that
+	 * takeImage() returns data already ready. Nodes are loaded in batches of
+	 * half the window. Applied on next init().
+	 * @param frames maximum number of nodes loaded ahead (0 = disabled,
+	 *        nodes are loaded on request)
+	 */
+	void setReadAhead(int frames) {_readAhead = frames;}
+	int getReadAhead() const {return _readAhead;}
+	/**
+	 * @return the number of nodes loaded and ready in the read-ahead queue
+	 */
+	int getReadAheadQueueSize() const;
+	/**
+	 * @return the nodes loaded per second by the read-ahead thread,
+	 *         including decompression (0 if read-ahead is disabled)
+	 */
+	float getReadAheadFrameRate() const;
+
 protected:
 	virtual SensorData captureImage(CameraInfo * info = 0);
 
 private:
 	SensorData getNextData(CameraInfo * info = 0);
 
+private:
+	class ReadAheadThread;
+
 private:
 	std::list<std::string> _paths;
 	bool _odometryIgnored;
@@ -85,8 +107,10 @@ private:
 	int _startIndex;
 	int _maxFrames;
 	int _cameraIndex;
+	int _readAhead;
 
 	DBDriver * _dbDriver;
+	ReadAheadThread * _readAheadThread;
 	UTimer _timer;
 	std::set<int> _ids;
 	std::set<int>::iterator _currentId;
@@ -38,6 +38,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace rtabmap {
 class Memory;
+class PosesIndex;
 
 namespace graph {
 
@@ -264,6 +265,20 @@ std::vector<int> RTABMAP_EXP findNearestNodes(
 		const rtabmap::Transform & targetPose,
 		int k);
 
+/**
+ * Same as above but using a spatial index of the nodes.
+ * @param ignoreLandmarks ignore nodes with id <= 0
+ */
+int RTABMAP_EXP findNearestNode(
+		const PosesIndex & nodes,
+		const rtabmap::Transform & targetPose,
+		bool ignoreLandmarks = false);
+std::vector<int> RTABMAP_EXP findNearestNodes(
+		const PosesIndex & nodes,
+		const rtabmap::Transform & targetPose,
+		int k,
+		bool ignoreLandmarks = false);
+
 /**
  * Get nodes near the query
  * @param nodeId the query id
@@ -281,6 +296,19 @@ std::map<int, Transform> RTABMAP_EXP getPosesInRadius(
 		float radius,
 		float angle = 0.0f);
 
+/**
+ * Same as above but using a spatial index of the nodes.
+ */
+std::map<int, float> RTABMAP_EXP getNodesInRadius(
+		int nodeId,
+		const PosesIndex & nodes,
+		float radius);
+std::map<int, Transform> RTABMAP_EXP getPosesInRadius(
+		int nodeId,
+		const PosesIndex & nodes,
+		float radius,
+		float angle = 0.0f);
+
 float RTABMAP_EXP computePathLength(
 		const std::vector<std::pair<int, Transform> > & path,
 		unsigned int fromIndex = 0,
@@ -289,6 +289,10 @@ private:
 	bool _notLinkedNodesKeptInDb;
 	bool _saveIntermediateNodeData;
 	std::string _rgbCompressionFormat;
+	std::string _depthCompressionFormat;
+	int _laserScanCompressionCodec;
+	int _userDataCompressionCodec;
+	int _occupancyGridCompressionCodec;
 	bool _incrementalMemory;
 	bool _reduceGraph;
 	int _maxStMemSize;
@@ -60,6 +60,7 @@ public:
 	float getMinMapSize() const {return minMapSize_;}
 	bool isGridFromDepth() const {return occupancyFromDepth_;}
 	bool isFullUpdate() const {return fullUpdate_;}
+	bool isEroded() const {return erode_;}
 	float getUpdateError() const {return updateError_;}
 	bool isMapFrameProjection() const {return projMapFrame_;}
 	const std::map<int, Transform> & addedNodes() const {return addedNodes_;}
@@ -104,6 +105,29 @@ public:
 	const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & getMapObstacles() const {return assembledObstacles_;}
 	const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & getMapEmptyCells() const {return assembledEmptyCells_;}
 
+	/**
+	 * Map version, incremented each time the tiles of the map have changed.
+	 * Only updated if GridGlobal/TileSize > 0.
+	 */
+	int getMapVersion() const {return mapVersion_;}
+	int getTileSize() const {return tileSize_;}
+	/**
+	 * Get the tiles of the map modified after "sinceVersion" (set 0 to get all tiles). Each tile
+	 * is a tileSize x tileSize CV_8SC1 image with the same values than getMap() (-1=unknown, 0=empty, 100=occupied),
+	 * erosion is not applied. The key of a tile is its <column, row> in tiles from
+	 * the origin (xMin, yMin), which stays the same while the map is growing. Tiles removed
+	 * since "sinceVersion" are returned in "removedTiles". If the tiles have been regenerated
+	 * since "sinceVersion" (e.g., the origin changed after the graph has been optimized, or the map
+	 * has been cleared), "reset" is true: all previous tiles should be discarded and all
+	 * current tiles are returned. Returned tiles are shared, they should not be modified.
+	 */
+	std::map<std::pair<int, int>, cv::Mat> getMapTiles(
+			int sinceVersion,
+			float & xMin,
+			float & yMin,
+			std::list<std::pair<int, int> > * removedTiles = 0,
+			bool * reset = 0) const;
+
 private:
 	ParametersMap parameters_;
 	int cloudDecimation_;
@@ -152,10 +176,21 @@ private:
 	float yMin_;
 	std::map<int, Transform> addedNodes_;
 
+	void updateTiles(const cv::Rect & region);
+	void removeTiles(int version);
+
 	bool cloudAssembling_;
 	pcl::PointCloud<pcl::PointXYZRGB>::Ptr assembledGround_;
 	pcl::PointCloud<pcl::PointXYZRGB>::Ptr assembledObstacles_;
 	pcl::PointCloud<pcl::PointXYZRGB>::Ptr assembledEmptyCells_;
+
+	int tileSize_;
+	int mapVersion_;
+	int tilesResetVersion_; // version at which all tiles have been regenerated
+	float tilesXMin_;
+	float tilesYMin_;
+	std::map<std::pair<int, int>, std::pair<cv::Mat, int> > tiles_; //<<col, row>, <tile, version> >
+	std::map<std::pair<int, int>, int> removedTiles_; //<<col, row>, version>, since last reset
 };
 
 }
@@ -52,6 +52,7 @@ public:
 		keyFrameAdded(false),
 		timeEstimation(0.0f),
 		timeParticleFiltering(0.0f),
+		timeQueued(0.0f),
 		stamp(0),
 		interval(0),
 		distanceTravelled(0.0f),
@@ -76,6 +77,7 @@ public:
 		output.keyFrameAdded = keyFrameAdded;
 		output.timeEstimation = timeEstimation;
 		output.timeParticleFiltering = timeParticleFiltering;
+		output.timeQueued = timeQueued;
 		output.stamp = stamp;
 		output.interval = interval;
 		output.transform = transform;
@@ -101,6 +103,7 @@ public:
 	bool keyFrameAdded;
 	float timeEstimation;
 	float timeParticleFiltering;
+	float timeQueued;   // time (s) the data waited in OdometryThread's buffer
 	double stamp;
 	double interval;
 	Transform transform;
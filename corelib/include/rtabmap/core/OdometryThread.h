@@ -32,7 +32,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/SensorData.h>
 #include <rtabmap/utilite/UThread.h>
 #include <rtabmap/utilite/UEventsHandler.h>
-#include <list>
+#include <rtabmap/utilite/URingBuffer.h>
 
 namespace rtabmap {
 
@@ -44,6 +44,11 @@ public:
 	OdometryThread(Odometry * odometry, unsigned int dataBufferMaxSize = 1);
 	virtual ~OdometryThread();
 
+	/**
+	 * Data dropped when the buffer is full: 0=oldest (default), 1=all except the latest.
+	 */
+	void setDataBufferPolicy(int policy);
+
 protected:
 	virtual bool handleEvent(UEvent * event);
 
@@ -56,15 +61,14 @@ private:
 	//============================================================
 	virtual void mainLoop();
 	void addData(const SensorData & data);
-	bool getData(SensorData & data);
+	SensorData * getData(double & queuedTime);
 
 private:
 	USemaphore _dataAdded;
 	UMutex _dataMutex;
-	std::list<SensorData> _dataBuffer;
-	std::list<SensorData> _imuBuffer;
+	URingBuffer<SensorData> _dataBuffer;
+	URingBuffer<SensorData> _imuBuffer;
 	Odometry * _odometry;
-	unsigned int _dataBufferMaxSize;
 	bool _resetOdometry;
 	Transform _resetPose;
 	double _lastImuStamp;
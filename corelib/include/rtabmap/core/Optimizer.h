@@ -32,6 +32,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <map>
 #include <list>
+#include <vector>
 #include <rtabmap/core/Link.h>
 #include <rtabmap/core/Parameters.h>
 #include <rtabmap/core/Signature.h>
@@ -129,6 +130,32 @@ public:
 				std::list<std::map<int, Transform> > * intermediateGraphes = 0,
 				double * finalError = 0,
 				int * iterationsDone = 0);
+
+	// "What-if" evaluation of a candidate link without re-optimizing the graph.
+	// The graph is linearized at the current solution (poses), the
+	// covariance of the relative pose between link.from() and link.to() is
+	// propagated along the most certain path of links, then the chi2 increase
+	// that adding the link would bring is returned (its Mahalanobis distance
+	// with link and marginal covariances combined). Returns a negative value
+	// if the link cannot be evaluated (unknown poses or not connected).
+	double computeLinkChi2(
+			const std::map<int, Transform> & poses,
+			const std::multimap<int, Link> & links,
+			const Link & link,
+			cv::Mat * relativeCovariance = 0) const;
+	// Same as above for several candidate links, each evaluated independently
+	// of the others (candidates are not part of the graph). The graph is made of
+	// "links" and optional "extraLinks" (e.g., links of a new pose not yet in
+	// "links"), its adjacency is built once for all candidates and one search is
+	// done for each different "from" pose. Chi2 values are returned in the
+	// candidates order.
+	// Backends can override this with exact marginals from their solver.
+	virtual std::vector<double> computeLinksChi2(
+			const std::map<int, Transform> & poses,
+			const std::multimap<int, Link> & links,
+			const std::vector<Link> & candidates,
+			const std::multimap<int, Link> * extraLinks = 0,
+			std::vector<cv::Mat> * relativeCovariances = 0) const;
 	virtual std::map<int, Transform> optimizeBA(
 			int rootId, // if negative, all other poses are fixed
 			const std::map<int, Transform> & poses,
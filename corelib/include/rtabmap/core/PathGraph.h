@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CORELIB_INCLUDE_RTABMAP_CORE_PATHGRAPH_H_
+#define CORELIB_INCLUDE_RTABMAP_CORE_PATHGRAPH_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/Transform.h>
+#include <rtabmap/core/Link.h>
+#include <opencv2/core/core.hpp>
+#include <map>
+#include <list>
+#include <vector>
+
+namespace rtabmap {
+
+/**
+ * Compact undirected graph used for path planning. Adjacency is kept
+ * in compressed sparse rows (CSR) indexed by contiguous node indices. Links
+ * and nodes added afterwards are kept in a small overlay until the next
+ * compaction, so that the graph can be kept in sync with the map
+ * without rebuilding it on each planning request.
+ */
+class RTABMAP_EXP PathGraph
+{
+public:
+	PathGraph();
+
+	void clear();
+
+	/**
+	 * Add a node or update its pose if it already exists.
+	 */
+	void addNode(int id, const Transform & pose);
+	bool removeNode(int id);
+	/**
+	 * Add an undirected link. Return false if one of the nodes doesn't exist.
+	 */
+	bool addLink(int from, int to);
+	bool removeLink(int from, int to);
+
+	bool hasNode(int id) const {return idToIndex_.find(id) != idToIndex_.end();}
+	bool hasLink(int from, int to) const;
+	int nodes() const {return (int)idToIndex_.size();}
+	int links() const {return links_;}
+
+	/**
+	 * Synchronize the graph with the poses and the links. Only the
+	 * differences are applied: poses are updated, new nodes and links are
+	 * added, and nodes and links not found anymore are removed. Links with
+	 * a node not in poses are ignored.
+	 */
+	void update(const std::map<int, Transform> & poses, const std::multimap<int, Link> & links);
+	/**
+	 * Same as above with links given as from id -> to id.
+	 */
+	void update(const std::map<int, Transform> & poses, const std::multimap<int, int> & links);
+
+	/**
+	 * Merge the links added or removed since the last compaction in
+	 * the compressed rows. This is done automatically before planning
+	 * when the overlay becomes too large.
+	 */
+	void compact();
+
+	/**
+	 * Perform A* path planning in the graph. The cost of a link is the
+	 * distance between its nodes.
+	 * @return the path ids and poses from id "from" to id "to" including initial and final nodes.
+	 */
+	std::list<std::pair<int, Transform> > computePath(int from, int to);
+
+private:
+	void updateNodes(const std::map<int, Transform> & poses);
+	int removeUnmarkedLinks(); // links not marked by the last update(), return the number removed
+	int addNodeIndex(int id, const Transform & pose);
+	void removeNodeIndex(int index);
+	bool addLinkIndex(int i, int j);
+	bool removeLinkIndex(int i, int j);
+	unsigned int * findLinkIndex(int i, int j);
+	const unsigned int * findLinkIndex(int i, int j) const;
+	void getNeighbors(int i, std::vector<int> & neighbors) const;
+	int lookup(int id) const;
+
+private:
+	std::map<int, int> idToIndex_;
+	std::vector<int> ids_; // index -> id, 0 if removed
+	std::vector<Transform> poses_;
+	std::vector<cv::Point3f> positions_;
+
+	// compressed rows of the last compaction, each link is stored in both directions
+	std::vector<int> rowOffsets_;
+	std::vector<int> columns_;
+	std::vector<unsigned int> columnMarks_; // last update() at which the link was seen, 0 if removed
+	// links added since the last compaction
+	std::vector<std::vector<std::pair<int, unsigned int> > > addedLinks_;
+
+	int links_;
+	int changes_; // links and nodes added/removed since the last compaction
+	unsigned int mark_;
+
+	// search buffers reused between requests
+	std::vector<float> costs_;
+	std::vector<int> parents_;
+	std::vector<unsigned char> closed_;
+	std::vector<int> neighbors_;
+};
+
+} /* namespace rtabmap */
+
+#endif /* CORELIB_INCLUDE_RTABMAP_CORE_PATHGRAPH_H_ */
@@ -0,0 +1,111 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CORELIB_INCLUDE_RTABMAP_CORE_POSESINDEX_H_
+#define CORELIB_INCLUDE_RTABMAP_CORE_POSESINDEX_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/Transform.h>
+#include <opencv2/core/core.hpp>
+#include <map>
+#include <vector>
+
+namespace rtabmap {
+
+/**
+ * Spatial index of poses (3D grid hash). The index can be kept in sync
+ * with a map of poses by calling update(), only new, removed and moved poses
+ * are re-indexed. Use a cell size close to the usual search radius.
+ */
+class RTABMAP_EXP PosesIndex
+{
+public:
+	PosesIndex(float cellSize = 1.0f);
+
+	void setCellSize(float cellSize);
+	float getCellSize() const {return cellSize_;}
+	void clear();
+	bool empty() const {return poses_.empty();}
+	int size() const {return (int)poses_.size();}
+
+	/**
+	 * Add a pose or move it if it already exists.
+	 */
+	void add(int id, const Transform & pose);
+	bool remove(int id);
+	/**
+	 * Synchronize the index with the poses.
+	 */
+	void update(const std::map<int, Transform> & poses);
+
+	const Transform & pose(int id) const;
+	bool contains(int id) const {return poses_.find(id) != poses_.end();}
+
+	/**
+	 * Get poses in the radius.
+	 * @return the ids with their squared distance to center.
+	 */
+	std::map<int, float> radiusSearch(const cv::Point3f & center, float radius) const;
+	/**
+	 * Get the k nearest poses, sorted by distance. If ignoreLandmarks is true, poses with id<=0 are ignored.
+	 */
+	std::vector<int> nearestKSearch(
+			const cv::Point3f & center,
+			int k,
+			bool ignoreLandmarks = false,
+			std::vector<float> * sqrdDistances = 0) const;
+
+private:
+	struct Entry
+	{
+		Transform pose;
+		cv::Point3f position;
+		long long cell;
+	};
+	cv::Point3i cellCoordinates(const cv::Point3f & position) const;
+	static long long cellKey(const cv::Point3i & cell);
+	void move(std::map<int, Entry>::iterator & iter, const Transform & pose);
+	void insertInCell(int id, const cv::Point3f & position, const cv::Point3i & cell);
+	void removeFromCell(int id, long long cell);
+	void searchCell(
+			const cv::Point3i & cell,
+			const cv::Point3f & center,
+			bool ignoreLandmarks,
+			std::vector<std::pair<float, int> > & candidates) const;
+
+private:
+	float cellSize_;
+	std::map<int, Entry> poses_;
+	std::map<long long, std::vector<std::pair<int, cv::Point3f> > > cells_;
+	cv::Point3i minCell_;
+	cv::Point3i maxCell_;
+};
+
+} /* namespace rtabmap */
+
+#endif /* CORELIB_INCLUDE_RTABMAP_CORE_POSESINDEX_H_ */
@@ -35,6 +35,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/Statistics.h"
 #include "rtabmap/core/Link.h"
 #include "rtabmap/core/ProgressState.h"
+#include "rtabmap/core/PathGraph.h"
+#include "rtabmap/core/PosesIndex.h"
 
 #include <opencv2/core/core.hpp>
 #include <list>
@@ -172,7 +174,8 @@ public:
 			int iterations = 1,
 			bool intraSession = true,
 			bool interSession = true,
-			const ProgressState * state = 0);
+			const ProgressState * state = 0,
+			int threads = 0); // 0 = as many threads as cores
 	int refineLinks();
 	bool addLink(const Link & link);
 	cv::Mat getInformation(const cv::Mat & covariance) const;
@@ -196,6 +199,11 @@ public:
 											const std::map<int, float> & likelihood) const;
 
 private:
+	// Spatial queries on _optimizedPoses
+	const PosesIndex & getPosesIndex() const;
+	std::map<int, float> getNodesInRadius(int nodeId, float radius) const;
+	int findNearestNode(const Transform & pose, bool ignoreLandmarks) const;
+
 	void optimizeCurrentMap(int id,
 			bool lookInDatabase,
 			std::map<int, Transform> & optimizedPoses,
@@ -212,6 +220,8 @@ private:
 			std::multimap<int, Link> * constraints = 0,
 			double * error = 0,
 			int * iterationsDone = 0) const;
+	void updateWMPathGraph();
+	void addWMPathGraphLinks(int id);
 	void updateGoalIndex();
 	bool computePath(int targetNode, std::map<int, Transform> nodes, const std::multimap<int, rtabmap::Link> & constraints);
 
@@ -260,6 +270,7 @@ private:
 	std::string _databasePath;
 	bool _optimizeFromGraphEnd;
 	float _optimizationMaxError;
+	float _optimizationMaxChi2;
 	bool _startNewMapOnLoopClosure;
 	bool _startNewMapOnGoodSignature;
 	float _goalReachedRadius; // meters
@@ -306,10 +317,16 @@ private:
 	bool _currentSessionHasGPS;
 	std::map<int, Transform> _odomCachePoses;       // used in localization mode to reject loop closures
 	std::multimap<int, Link> _odomCacheConstraints; // used in localization mode to reject loop closures
+	PosesIndex _posesIndex; // updated with _optimizedPoses
+	mutable double _posesIndexTime; // accumulated time of spatial queries, reset on each process()
 
 	// Planning stuff
 	int _pathStatus;
 	std::vector<std::pair<int,Transform> > _path;
+	PathGraph _pathGraph; // kept in sync with _optimizedPoses and _constraints
+	bool _pathGraphOutdated; // _pathGraph should be fully synchronized before next planning
+	PathGraph _wmPathGraph; // _optimizedPoses linked by their links in WM, used by computePath()
+	bool _wmPathGraphOutdated; // _wmPathGraph should be fully synchronized before next planning
 	std::set<unsigned int> _pathUnreachableNodes;
 	unsigned int _pathCurrentIndex;
 	unsigned int _pathGoalIndex;
@@ -34,6 +34,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UEventsHandler.h>
 #include <rtabmap/utilite/USemaphore.h>
 #include <rtabmap/utilite/UMutex.h>
+#include <rtabmap/utilite/URingBuffer.h>
 
 #include "rtabmap/core/RtabmapEvent.h"
 #include "rtabmap/core/SensorData.h"
@@ -79,10 +80,12 @@ public:
 	void clearBufferedData();
 	void setDetectorRate(float rate);
 	void setDataBufferSize(unsigned int bufferSize);
+	void setDataBufferPolicy(int policy);
 	void createIntermediateNodes(bool enabled);
 
 	float getDetectorRate() const {return _rate;}
 	unsigned int getDataBufferSize() const {return _dataBufferMaxSize;}
+	int getDataBufferPolicy() const {return _dataBufferPolicy;}
 	bool getCreateIntermediateNodes() const {return _createIntermediateNodes;}
 
 	/**
@@ -103,7 +106,7 @@ private:
 	virtual void mainLoopKill();
 	void process();
 	void addData(const OdometryEvent & odomEvent);
-	bool getData(OdometryEvent & data);
+	OdometryEvent * getData(double & queuedTime);
 	void pushNewState(State newState, const ParametersMap & parameters = ParametersMap());
 	void publishMap(bool optimized, bool full, bool graphOnly) const;
 
@@ -112,11 +115,12 @@ private:
 	std::queue<State> _state;
 	std::queue<ParametersMap> _stateParam;
 
-	std::list<OdometryEvent> _dataBuffer;
+	URingBuffer<OdometryEvent> _dataBuffer;
 	std::list<double> _newMapEvents;
 	UMutex _dataMutex;
 	USemaphore _dataAdded;
 	unsigned int _dataBufferMaxSize;
+	int _dataBufferPolicy;
 	float _rate;
 	bool _createIntermediateNodes;
 	UTimer * _frameRateTimer;
@@ -155,6 +155,12 @@ public:
 	void setId(int id) {_id = id;}
 	double stamp() const {return _stamp;}
 	void setStamp(double stamp) {_stamp = stamp;}
+	/**
+	 * Wall time (UTimer::now()) at which the data has been grabbed (see CameraThread), 0 if unknown.
+	 * It is not saved in the database, it is only used to measure latency in the pipeline.
+	 */
+	double captureTime() const {return _captureTime;}
+	void setCaptureTime(double captureTime) {_captureTime = captureTime;}
 
 	const cv::Mat & imageCompressed() const {return _imageCompressed;}
 	const cv::Mat & depthOrRightCompressed() const {return _depthOrRightCompressed;}
@@ -210,6 +216,11 @@ public:
 			cv::Mat * groundCellsRaw = 0,
 			cv::Mat * obstacleCellsRaw = 0,
 			cv::Mat * emptyCellsRaw = 0) const;
+	/**
+	 * Uncompress all data of many nodes at the same time, each node is a task
+	 * of the compression thread pool (see compressionThreadPool()).
+	 */
+	static void uncompressData(const std::vector<SensorData*> & data);
 
 	const std::vector<CameraModel> & cameraModels() const {return _cameraModels;}
 	const StereoCameraModel & stereoCameraModel() const {return _stereoCameraModel;}
@@ -227,12 +238,14 @@ public:
 	const cv::Mat & userDataCompressed() const {return _userDataCompressed;}
 
 	// detect automatically if raw or compressed. If raw, the data will be compressed.
+	// compressionCodec: see CompressionCodec, used to compress raw grids
 	void setOccupancyGrid(
 			const cv::Mat & ground,
 			const cv::Mat & obstacles,
 			const cv::Mat & empty,
 			float cellSize,
-			const cv::Point3f & viewPoint);
+			const cv::Point3f & viewPoint,
+			int compressionCodec = 0);
 	// remove raw occupancy grids
 	void clearOccupancyGridRaw() {_groundCellsRaw = cv::Mat(); _obstacleCellsRaw = cv::Mat();}
 	const cv::Mat & gridGroundCellsRaw() const {return _groundCellsRaw;}
@@ -286,6 +299,7 @@ public:
 private:
 	int _id;
 	double _stamp;
+	double _captureTime;
 
 	cv::Mat _imageCompressed;          // compressed image
 	cv::Mat _depthOrRightCompressed;   // compressed image
@@ -43,10 +43,11 @@ namespace rtabmap {
 #define RTABMAP_STATS(PREFIX, NAME, UNIT) \
 	public: \
 		static std::string k##PREFIX##NAME() {return #PREFIX "/" #NAME "/" #UNIT;} \
+		static int id##PREFIX##NAME() {static const int id = Statistics::statisticId(#PREFIX "/" #NAME "/" #UNIT); return id;} \
 	private: \
 		class Dummy##PREFIX##NAME { \
 		public: \
-			Dummy##PREFIX##NAME() {if(!_defaultDataInitialized)_defaultData.insert(std::pair<std::string, float>(#PREFIX "/" #NAME "/" #UNIT, 0.0f));} \
+			Dummy##PREFIX##NAME() {if(!_defaultDataInitialized){_defaultData.insert(std::pair<std::string, float>(#PREFIX "/" #NAME "/" #UNIT, 0.0f));id##PREFIX##NAME();}} \
 		}; \
 		Dummy##PREFIX##NAME dummy##PREFIX##NAME
 
@@ -67,6 +68,7 @@ class RTABMAP_EXP Statistics
 	RTABMAP_STATS(Loop, Optimization_max_error_ratio, );
 	RTABMAP_STATS(Loop, Optimization_error, );
 	RTABMAP_STATS(Loop, Optimization_iterations, );
+	RTABMAP_STATS(Loop, Optimization_max_chi2, );
 	RTABMAP_STATS(Loop, Linear_variance,);
 	RTABMAP_STATS(Loop, Angular_variance,);
 	RTABMAP_STATS(Loop, Landmark_detected,);
@@ -104,6 +106,7 @@ class RTABMAP_EXP Statistics
 	RTABMAP_STATS(Memory, Immunized_locally_max,);
 	RTABMAP_STATS(Memory, Signatures_retrieved,);
 	RTABMAP_STATS(Memory, Images_buffered,);
+	RTABMAP_STATS(Memory, Images_dropped,);
 	RTABMAP_STATS(Memory, Rehearsal_sim,);
 	RTABMAP_STATS(Memory, Rehearsal_id,);
 	RTABMAP_STATS(Memory, Rehearsal_merged,);
@@ -125,6 +128,8 @@ class RTABMAP_EXP Statistics
 	RTABMAP_STATS(Timing, Reactivation, ms);
 	RTABMAP_STATS(Timing, Add_loop_closure_link, ms);
 	RTABMAP_STATS(Timing, Map_optimization, ms);
+	RTABMAP_STATS(Timing, Loop_closure_gating, ms);
+	RTABMAP_STATS(Timing, Poses_index, ms);
 	RTABMAP_STATS(Timing, Likelihood_computation, ms);
 	RTABMAP_STATS(Timing, Posterior_computation, ms);
 	RTABMAP_STATS(Timing, Hypotheses_creation, ms);
@@ -136,6 +141,9 @@ class RTABMAP_EXP Statistics
 	RTABMAP_STATS(Timing, Joining_trash, ms);
 	RTABMAP_STATS(Timing, Emptying_trash, ms);
 	RTABMAP_STATS(Timing, Finalizing_statistics, ms);
+	RTABMAP_STATS(Timing, Odometry_queue, ms);
+	RTABMAP_STATS(Timing, Rtabmap_queue, ms);
+	RTABMAP_STATS(Timing, Pipeline_latency, ms);
 
 	RTABMAP_STATS(TimingMem, Pre_update, ms);
 	RTABMAP_STATS(TimingMem, Signature_creation, ms);
@@ -179,12 +187,27 @@ public:
 	static std::string serializeData(const std::map<std::string, float> & data);
 	static std::map<std::string, float> deserializeData(const std::string & data);
 
+	// Binary format: number of statistics, their ids (int32), then their values (float32).
+	// Used for the Statistics table of databases created by 0.20.0 and newer, the ids
+	// are those of the StatisticsName table of the database.
+	static cv::Mat serializeDataBinary(const std::vector<std::pair<int, float> > & data);
+	static std::vector<std::pair<int, float> > deserializeDataBinary(const cv::Mat & data);
+
+	// Process-wide registry of statistic names. The id of a name
+	// never changes, it can be resolved once and used with addStatistic(int, float).
+	// The ids are not saved, they may differ between processes.
+	static int statisticId(const std::string & name); // the name is registered if new
+	static std::string statisticName(int id);
+	static int statisticsCount();
+
 public:
 	Statistics();
 	virtual ~Statistics();
 
 	// name format = "Grp/Name/unit"
 	void addStatistic(const std::string & name, float value);
+	// id from statisticId() or id*() functions above (e.g., idTimingTotal())
+	void addStatistic(int id, float value);
 
 	// setters
 	void setExtended(bool extended) {_extended = extended;}
@@ -240,7 +263,12 @@ public:
 	const std::map<int, int> & reducedIds() const {return _reducedIds;}
 	const std::vector<int> & wmState() const {return _wmState;}
 
-	const std::map<std::string, float> & data() const {return _data;}
+	// Converted from the values on first call after a change (thread-safe), prefer value() to get a single statistic.
+	const std::map<std::string, float> & data() const;
+	float value(int id, float defaultValue = 0.0f) const {return hasValue(id)?_values[id]:defaultValue;}
+	bool hasValue(int id) const {return id>=0 && id < (int)_valuesSet.size() && _valuesSet[id];}
+	// ids (see statisticId()) and values of the statistics added, without creating the map
+	void getValues(std::vector<std::pair<int, float> > & values) const;
 
 private:
 	bool _extended; // 0 -> only loop closure and last signature ID fields are filled
@@ -274,10 +302,15 @@ private:
 
 	std::vector<int> _wmState;
 
+	// Plottable statistics, indexed by statistic id (see statisticId()).
+	std::vector<float> _values;
+	std::vector<unsigned char> _valuesSet;
+
 	// Format for statistics (Plottable statistics must go in that map) :
 	// {"Group/Name/Unit", value}
 	// Example : {"Timing/Total time/ms", 500.0f}
-	std::map<std::string, float> _data;
+	mutable std::map<std::string, float> _data;
+	mutable bool _dataUpdated;
 	static std::map<std::string, float> _defaultData;
 	static bool _defaultDataInitialized;
 	// end extended data
@@ -0,0 +1,135 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CORELIB_INCLUDE_RTABMAP_CORE_TILEDCLOUDWRITER_H_
+#define CORELIB_INCLUDE_RTABMAP_CORE_TILEDCLOUDWRITER_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <map>
+#include <string>
+#include <cstdio>
+
+namespace rtabmap {
+
+/**
+ * Out-of-core writer of large voxelized clouds. Clouds are added as they
+ * are created: their points are accumulated per voxel in spatial tiles, and
+ * the tiles are spilled to temporary files when too many voxels are in memory.
+ * On close(), the tiles are merged one at a time and written in binary PLY,
+ * either in a single file or in one file per tile listed in an index file.
+ * Memory usage depends on the tile and buffer sizes, not on the map size.
+ *
+ * Points in the same voxel are averaged (position, color, normal and curvature)
+ * like with pcl::VoxelGrid. Points are written tile by tile, ordered like
+ * pcl::VoxelGrid inside each tile: in a single file, the order differs from
+ * pcl::VoxelGrid applied on the whole cloud.
+ */
+class RTABMAP_EXP TiledCloudWriter
+{
+public:
+	/**
+	 * @param path output PLY file. With splitTiles, the tiles are written in
+	 *        "[path without extension]_[x]_[y]_[z].ply" and listed
+	 *        in "[path without extension]_index.txt" instead.
+	 * @param voxelSize voxel size (m)
+	 * @param tileSize tile size (m), rounded to a multiple of the voxel size
+	 * @param splitTiles write one file per tile
+	 * @param maxBufferedVoxels voxels kept in memory before spilling the tiles to disk
+	 */
+	TiledCloudWriter(
+			const std::string & path,
+			float voxelSize,
+			float tileSize = 10.0f,
+			bool splitTiles = false,
+			int maxBufferedVoxels = 1000000);
+	/**
+	 * Temporary files are removed. Nothing is written if close() was not called.
+	 */
+	virtual ~TiledCloudWriter();
+
+	void add(const pcl::PointCloud<pcl::PointXYZRGBNormal> & cloud);
+
+	/**
+	 * Merge the tiles and write the output file(s).
+	 * @return false if a file cannot be written
+	 */
+	bool close();
+
+	int tiles() const {return (int)tiles_.size();}
+	int bufferedVoxels() const {return bufferedVoxels_;}
+	/**
+	 * @return the number of points written by close()
+	 */
+	unsigned long points() const {return points_;}
+
+private:
+	struct Key
+	{
+		int i;
+		int j;
+		int k;
+		bool operator==(const Key & key) const
+		{
+			return i == key.i && j == key.j && k == key.k;
+		}
+		// z, then y, then x (same order than pcl::VoxelGrid)
+		bool operator<(const Key & key) const
+		{
+			return k < key.k || (k == key.k && (j < key.j || (j == key.j && i < key.i)));
+		}
+	};
+	struct Voxel;
+	struct Tile;
+
+	bool flush();
+	bool mergeTile(const Key & key, Tile & tile);
+	std::string tileName(const Key & key) const;
+	std::string basePath() const;
+	void clear();
+
+private:
+	std::string path_;
+	std::string tmpDir_;
+	float voxelSize_;
+	int tileVoxels_; // tile size in voxels
+	bool splitTiles_;
+	int maxBufferedVoxels_;
+	int bufferedVoxels_;
+	bool failed_;
+	bool closed_;
+	std::map<Key, Tile*> tiles_;
+	FILE * output_; // single file output, opened by close()
+	FILE * index_; // index of the tiles with splitTiles, opened by close()
+	unsigned long points_;
+};
+
+} // namespace rtabmap
+
+#endif /* CORELIB_INCLUDE_RTABMAP_CORE_TILEDCLOUDWRITER_H_ */
@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CORELIB_INCLUDE_RTABMAP_CORE_TRACE_H_
+#define CORELIB_INCLUDE_RTABMAP_CORE_TRACE_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/Version.h>
+#include <string>
+
+namespace rtabmap {
+
+/**
+ * Low-overhead tracing of scoped sections, saved in the Chrome trace
+ * JSON format (chrome://tracing or https://ui.perfetto.dev) to see how
+ * the threads overlap. Each thread records its events in its own
+ * pre-allocated buffer without locking. When tracing is not started, a
+ * scope costs a flag check. Sections are instrumented with
+ * RTABMAP_TRACE_SCOPE(), which is removed at compile time when built
+ * with WITH_TRACING=OFF.
+ *
+ * Example:
+ * @code
+ * Trace::start();
+ * ...
+ * {
+ *    RTABMAP_TRACE_SCOPE("Memory::update");
+ *    ...
+ * }
+ * ...
+ * Trace::stop();
+ * Trace::save("trace.json");
+ * @endcode
+ */
+class RTABMAP_EXP Trace
+{
+public:
+	/**
+	 * Start recording, previous events are kept (see clear()).
+	 * @param maxEventsPerThread events over this number are dropped,
+	 *        the buffer of a thread is allocated on its first event.
+	 */
+	static void start(int maxEventsPerThread = 1000000);
+	static void stop();
+	static bool isStarted();
+	/**
+	 * Remove the recorded events. Should be called when tracing is stopped.
+	 */
+	static void clear();
+	/**
+	 * Save the recorded events in Chrome trace JSON format. It
+	 * can be called while tracing.
+	 * @return false if the file cannot be written.
+	 */
+	static bool save(const std::string & path);
+	/**
+	 * @return the number of events recorded.
+	 */
+	static int events();
+	/**
+	 * @return the number of events dropped because a buffer was full.
+	 */
+	static int droppedEvents();
+
+	/**
+	 * Name of the current thread in the trace.
+	 */
+	static void setThreadName(const std::string & name);
+
+	/**
+	 * Record an event of the current thread. The name should be a
+	 * string literal, only its pointer is kept.
+	 * @param start time in microseconds (see now())
+	 */
+	static void add(const char * name, long long start, long long duration);
+	/**
+	 * @return microseconds since the trace origin.
+	 */
+	static long long now();
+};
+
+/**
+ * Records the section from its construction to its destruction.
+ * @see RTABMAP_TRACE_SCOPE()
+ */
+class RTABMAP_EXP TraceScope
+{
+public:
+	TraceScope(const char * name) :
+		name_(Trace::isStarted()?name:0),
+		start_(name_?Trace::now():0)
+	{}
+	~TraceScope()
+	{
+		if(name_)
+		{
+			Trace::add(name_, start_, Trace::now()-start_);
+		}
+	}
+private:
+	const char * name_;
+	long long start_;
+};
+
+} // namespace rtabmap
+
+#define RTABMAP_TRACE_CONCAT_(a, b) a##b
+#define RTABMAP_TRACE_CONCAT(a, b) RTABMAP_TRACE_CONCAT_(a, b)
+
+#ifdef RTABMAP_TRACING
+/**
+ * Trace the rest of the current scope, name should be a string literal.
+ */
+#define RTABMAP_TRACE_SCOPE(name) rtabmap::TraceScope RTABMAP_TRACE_CONCAT(rtabmapTraceScope, __LINE__)(name)
+#define RTABMAP_TRACE_THREAD_NAME(name) rtabmap::Trace::setThreadName(name)
+#else
+#define RTABMAP_TRACE_SCOPE(name)
+#define RTABMAP_TRACE_THREAD_NAME(name)
+#endif
+
+#endif /* CORELIB_INCLUDE_RTABMAP_CORE_TRACE_H_ */
@@ -173,6 +173,28 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr RTABMAP_EXP cloudRGBFromSensorData(
 		const ParametersMap & stereoParameters = ParametersMap(),
 		const std::vector<float> & roiRatios = std::vector<float>()); // ignored for stereo
 
+/**
+ * Back-project a depth image directly in a LaserScan, without intermediate PCL cloud. Invalid
+ * points are removed. The points are in the camera frame, the local transform of the
+ * camera model is set as the local transform of the scan.
+ *
+ * @param depth, the depth image (CV_16UC1 in mm or CV_32FC1 in m).
+ * @param model, the camera model, for the RGB image if set.
+ * @param decimation, should be a factor of the depth image width and height.
+ * @param maxDepth, maximum depth of the projected points (0 means infinity).
+ * @param minDepth, minimum depth of the projected points.
+ * @param rgb, optional BGR or mono image (same size or a multiple of the depth image size),
+ * the scan is then LaserScan::kXYZRGB, otherwise LaserScan::kXYZ.
+ * @return the scan.
+ */
+LaserScan RTABMAP_EXP laserScanFromDepth(
+		const cv::Mat & depth,
+		const CameraModel & model,
+		int decimation = 1,
+		float maxDepth = 0.0f,
+		float minDepth = 0.0f,
+		const cv::Mat & rgb = cv::Mat());
+
 /**
  * Simulate a laser scan rotating counterclockwise, using middle line of the depth image.
  */
@@ -115,6 +115,11 @@ void RTABMAP_EXP rayTrace(const cv::Point2i & start,
 		bool stopOnObstacle);
 
 cv::Mat RTABMAP_EXP convertMap2Image8U(const cv::Mat & map8S, bool pgmFormat = false);
+/**
+ * Same as above but written in map8U, which is allocated only if its size or type
+ * doesn't match (so it can be a region of a larger image).
+ */
+void RTABMAP_EXP convertMap2Image8U(const cv::Mat & map8S, cv::Mat & map8U, bool pgmFormat = false);
 cv::Mat RTABMAP_EXP convertImage8U2Map(const cv::Mat & map8U, bool pgmFormat = false);
 
 cv::Mat RTABMAP_EXP erodeMap(const cv::Mat & map);
@@ -270,60 +270,74 @@ cv::Mat RTABMAP_EXP computeNormals(
 		const cv::Mat & laserScan,
 		int searchK,
 		float searchRadius);
+/**
+ * Normals are estimated in parallel, "threads" is the maximum
+ * number of threads used (0 means all cores, 1 is sequential).
+ */
 pcl::PointCloud<pcl::Normal>::Ptr RTABMAP_EXP computeNormals(
 		const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud,
 		int searchK = 20,
 		float searchRadius = 0.0f,
-		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0));
+		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0),
+		int threads = 0);
 pcl::PointCloud<pcl::Normal>::Ptr RTABMAP_EXP computeNormals(
 		const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & cloud,
 		int searchK = 20,
 		float searchRadius = 0.0f,
-		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0));
+		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0),
+		int threads = 0);
 pcl::PointCloud<pcl::Normal>::Ptr RTABMAP_EXP computeNormals(
 		const pcl::PointCloud<pcl::PointXYZI>::Ptr & cloud,
 		int searchK = 20,
 		float searchRadius = 0.0f,
-		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0));
+		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0),
+		int threads = 0);
 pcl::PointCloud<pcl::Normal>::Ptr RTABMAP_EXP computeNormals(
 		const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud,
 		const pcl::IndicesPtr & indices,
 		int searchK = 20,
 		float searchRadius = 0.0f,
-		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0));
+		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0),
+		int threads = 0);
 pcl::PointCloud<pcl::Normal>::Ptr RTABMAP_EXP computeNormals(
 		const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & cloud,
 		const pcl::IndicesPtr & indices,
 		int searchK = 20,
 		float searchRadius = 0.0f,
-		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0));
+		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0),
+		int threads = 0);
 pcl::PointCloud<pcl::Normal>::Ptr RTABMAP_EXP computeNormals(
 		const pcl::PointCloud<pcl::PointXYZI>::Ptr & cloud,
 		const pcl::IndicesPtr & indices,
 		int searchK = 20,
 		float searchRadius = 0.0f,
-		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0));
+		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0),
+		int threads = 0);
 
 pcl::PointCloud<pcl::Normal>::Ptr RTABMAP_EXP computeNormals2D(
 		const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud,
 		int searchK = 5,
 		float searchRadius = 0.0f,
-		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0));
+		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0),
+		int threads = 0);
 pcl::PointCloud<pcl::Normal>::Ptr RTABMAP_EXP computeNormals2D(
 		const pcl::PointCloud<pcl::PointXYZI>::Ptr & cloud,
 		int searchK = 5,
 		float searchRadius = 0.0f,
-		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0));
+		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0),
+		int threads = 0);
 pcl::PointCloud<pcl::Normal>::Ptr RTABMAP_EXP computeFastOrganizedNormals2D(
 		const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud,
 		int searchK = 5,
 		float searchRadius = 0.0f,
-		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0));
+		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0),
+		int threads = 0);
 pcl::PointCloud<pcl::Normal>::Ptr RTABMAP_EXP computeFastOrganizedNormals2D(
 		const pcl::PointCloud<pcl::PointXYZI>::Ptr & cloud,
 		int searchK = 5,
 		float searchRadius = 0.0f,
-		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0));
+		const Eigen::Vector3f & viewPoint = Eigen::Vector3f(0,0,0),
+		int threads = 0);
 
 pcl::PointCloud<pcl::Normal>::Ptr RTABMAP_EXP computeFastOrganizedNormals(
 		const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & cloud,
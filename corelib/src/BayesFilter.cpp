@@ -29,8 +29,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/Memory.h"
 #include "rtabmap/core/Signature.h"
 #include "rtabmap/core/Parameters.h"
+#include "rtabmap/core/Trace.h"
 #include <iostream>
 #include <set>
+#include <algorithm>
 #if __cplusplus >= 201103L
 #include <unordered_map>
 #include <unordered_set>
@@ -44,7 +46,8 @@ BayesFilter::BayesFilter(const ParametersMap & parameters) :
 	_virtualPlacePrior(Parameters::defaultBayesVirtualPlacePriorThr()),
 	_fullPredictionUpdate(Parameters::defaultBayesFullPredictionUpdate()),
 	_totalPredictionLCValues(0.0f),
-	_predictionEpsilon(0.0f)
+	_predictionEpsilon(0.0f),
+	_predictionGeneration(0)
 {
 	this->setPredictionLC(Parameters::defaultBayesPredictionLC());
 	this->parseParameters(parameters);
@@ -135,15 +138,36 @@ std::string BayesFilter::getPredictionLCStr() const
 	return values;
 }
 
+long BayesFilter::getMemoryUsed() const
+{
+	long mapNode = 4*sizeof(void*); // left, right, parent, color
+	long memory = sizeof(BayesFilter);
+	memory += _posterior.size()*(sizeof(int)+sizeof(float)+mapNode);
+	memory += _predictionLC.capacity()*sizeof(double);
+	for(Prediction::const_iterator iter=_prediction.begin(); iter!=_prediction.end(); ++iter)
+	{
+		memory += sizeof(int)+sizeof(PredictionColumn)+mapNode;
+		memory += iter->second.neighbors.capacity()*sizeof(std::pair<int, float>);
+	}
+	for(std::map<int, std::map<int, int> >::const_iterator iter=_neighborsIndex.begin(); iter!=_neighborsIndex.end(); ++iter)
+	{
+		memory += sizeof(int)+sizeof(std::map<int, int>)+mapNode;
+		memory += iter->second.size()*(2*sizeof(int)+mapNode);
+	}
+	return memory;
+}
+
 void BayesFilter::reset()
 {
 	_posterior.clear();
-	_prediction = cv::Mat();
+	_prediction.clear();
+	_predictionGeneration = 0;
 	_neighborsIndex.clear();
 }
 
 const std::map<int, float> & BayesFilter::computePosterior(const Memory * memory, const std::map<int, float> & likelihood)
 {
+	RTABMAP_TRACE_SCOPE("BayesFilter::computePosterior");
 	ULOGGER_DEBUG("");
 
 	if(!memory)
@@ -167,39 +191,93 @@ const std::map<int, float> & BayesFilter::computePosterior(const Memory * memory
 	UTimer timer;
 	timer.start();
 
-	cv::Mat prior;
-	cv::Mat posterior;
-
 	float sum = 0;
 	int j=0;
 	// Recursive Bayes estimation...
 	// STEP 1 - Prediction : Prior*lastPosterior
-	_prediction = this->generatePrediction(memory, uKeys(likelihood));
+	std::vector<int> ids = uKeys(likelihood);
+	this->predict(_prediction, memory, uKeys(_posterior), ids);
 
-	UDEBUG("STEP1-generate prior=%fs, rows=%d, cols=%d", timer.ticks(), _prediction.rows, _prediction.cols);
-	//std::cout << "Prediction=" << _prediction << std::endl;
+	UDEBUG("STEP1-generate prior=%fs, columns=%d", timer.ticks(), (int)_prediction.size());
 
 	// Adjust the last posterior if some images were
 	// reactivated or removed from the working memory
-	posterior = cv::Mat(likelihood.size(), 1, CV_32FC1);
-	this->updatePosterior(memory, uKeys(likelihood));
+	std::vector<float> posterior(likelihood.size());
+	this->updatePosterior(memory, ids);
 	j=0;
 	for(std::map<int, float>::const_iterator i=_posterior.begin(); i!= _posterior.end(); ++i)
 	{
-		((float*)posterior.data)[j++] = (*i).second;
+		posterior[j++] = (*i).second;
 	}
-	ULOGGER_DEBUG("STEP1-update posterior=%fs, posterior=%d, _posterior size=%d", posterior.rows, _posterior.size());
-	//std::cout << "LastPosterior=" << posterior << std::endl;
+	ULOGGER_DEBUG("STEP1-update posterior=%fs, posterior=%d, _posterior size=%d", timer.ticks(), (int)posterior.size(), (int)_posterior.size());
 
 	// Multiply prediction matrix with the last posterior
-	// (m,m) X (m,1) = (m,1)
-	prior = _prediction * posterior;
-	ULOGGER_DEBUG("STEP1-matrix mult time=%fs", timer.ticks());
-	//std::cout << "ResultingPrior=" << prior << std::endl;
-
-	ULOGGER_DEBUG("STEP1-matrix mult time=%fs", timer.ticks());
-	std::vector<float> likelihoodValues = uValues(likelihood);
-	//std::cout << "Likelihood=" << cv::Mat(likelihoodValues) << std::endl;
+	// (m,m) X (m,1) = (m,1), only non-null values of the
+	// sparse columns are visited.
+	UASSERT(_prediction.size() == ids.size());
+#if __cplusplus >= 201103L
+	std::unordered_map<int,int> idToIndexMap;
+	idToIndexMap.reserve(ids.size());
+#else
+	std::map<int,int> idToIndexMap;
+#endif
+	for(unsigned int i=0; i<ids.size(); ++i)
+	{
+		idToIndexMap[ids[i]] = i;
+	}
+	bool virtualPlaceUsed = ids[0] < 0;
+	std::vector<float> prior(ids.size(), 0.0f);
+	std::map<int, float> fillPerGeneration;
+	int nonNull = 0;
+	j=0;
+	for(Prediction::const_iterator iter=_prediction.begin(); iter!=_prediction.end(); ++iter, ++j)
+	{
+		const PredictionColumn & column = iter->second;
+		float p = posterior[j];
+		for(unsigned int k=0; k<column.neighbors.size(); ++k)
+		{
+			int rowId = column.neighbors[k].first;
+			int row = idToIndexMap.at(rowId);
+			prior[row] += column.neighbors[k].second * p;
+			if(column.fill != 0.0f && rowId > 0 && _prediction.at(rowId).rowGeneration <= column.columnGeneration)
+			{
+				// the fill value is added below to all rows
+				prior[row] -= column.fill * p;
+			}
+		}
+		nonNull += (int)column.neighbors.size();
+		if(virtualPlaceUsed && iter->first > 0)
+		{
+			prior[0] += (float)_predictionLC[0] * p;
+		}
+		if(column.fill != 0.0f)
+		{
+			fillPerGeneration[column.columnGeneration] += column.fill * p;
+		}
+	}
+	if(fillPerGeneration.size())
+	{
+		// rows get the fill values of the columns normalized after they were added
+		float fill = 0.0f;
+		for(std::map<int, float>::reverse_iterator iter=fillPerGeneration.rbegin(); iter!=fillPerGeneration.rend(); ++iter)
+		{
+			fill += iter->second;
+			iter->second = fill;
+		}
+		j=0;
+		for(Prediction::const_iterator iter=_prediction.begin(); iter!=_prediction.end(); ++iter, ++j)
+		{
+			if(iter->first > 0)
+			{
+				std::map<int, float>::iterator jter = fillPerGeneration.lower_bound(iter->second.rowGeneration);
+				if(jter != fillPerGeneration.end())
+				{
+					prior[j] += jter->second;
+				}
+			}
+		}
+	}
+	ULOGGER_DEBUG("STEP1-matrix mult time=%fs (non-null=%d, filled generations=%d)", timer.ticks(), nonNull, (int)fillPerGeneration.size());
 
 	// STEP 2 - Update : Multiply with observations (likelihood)
 	j=0;
@@ -208,7 +286,7 @@ const std::map<int, float> & BayesFilter::computePosterior(const Memory * memory
 		std::map<int, float>::iterator p =_posterior.find((*i).first);
 		if(p!= _posterior.end())
 		{
-			(*p).second = (*i).second * ((float*)prior.data)[j++];
+			(*p).second = (*i).second * prior[j++];
 			sum+=(*p).second;
 		}
 		else
@@ -234,8 +312,7 @@ const std::map<int, float> & BayesFilter::computePosterior(const Memory * memory
 	return _posterior;
 }
 
-float addNeighborProb(cv::Mat & prediction,
-			unsigned int col,
+float addNeighborProb(std::vector<std::pair<int, float> > & column,
 			const std::map<int, int> & neighbors,
 			const std::vector<double> & predictionLC,
 #if __cplusplus >= 201103L
@@ -245,44 +322,88 @@ float addNeighborProb(cv::Mat & prediction,
 #endif
 			)
 {
-	UASSERT(col < (unsigned int)prediction.cols &&
-			col < (unsigned int)prediction.rows);
-
 	float sum=0.0f;
-	float * dataPtr = (float*)prediction.data;
+	column.clear();
 	for(std::map<int, int>::const_iterator iter=neighbors.begin(); iter!=neighbors.end(); ++iter)
 	{
 		if(iter->first>=0)
 		{
-#if __cplusplus >= 201103L
-			std::unordered_map<int, int>::const_iterator jter = idToIndex.find(iter->first);
-#else
-			std::map<int, int>::const_iterator jter = idToIndex.find(iter->first);
-#endif
-			if(jter != idToIndex.end())
+			if(idToIndex.find(iter->first) != idToIndex.end())
 			{
 				UASSERT((iter->second+1) < (int)predictionLC.size());
-				sum += dataPtr[col + jter->second*prediction.cols] = predictionLC[iter->second+1];
+				column.push_back(std::make_pair(iter->first, (float)predictionLC[iter->second+1]));
+				sum += column.back().second;
 			}
 		}
 	}
 	return sum;
 }
 
-
 cv::Mat BayesFilter::generatePrediction(const Memory * memory, const std::vector<int> & ids)
 {
-	std::vector<int> oldIds = uKeys(_posterior);
+	Prediction prediction = _prediction;
+	this->predict(prediction, memory, uKeys(_posterior), ids);
+
+	std::map<int, int> idToIndexMap;
+	for(unsigned int i=0; i<ids.size(); ++i)
+	{
+		idToIndexMap.insert(idToIndexMap.end(), std::make_pair(ids[i], i));
+	}
+
+	cv::Mat dense = cv::Mat::zeros(ids.size(), ids.size(), CV_32FC1);
+	int cols = dense.cols;
+	int j=0;
+	for(Prediction::const_iterator iter=prediction.begin(); iter!=prediction.end(); ++iter, ++j)
+	{
+		const PredictionColumn & column = iter->second;
+		if(column.fill != 0.0f)
+		{
+			int i=0;
+			for(Prediction::const_iterator jter=prediction.begin(); jter!=prediction.end(); ++jter, ++i)
+			{
+				if(jter->first > 0 && jter->second.rowGeneration <= column.columnGeneration)
+				{
+					((float*)dense.data)[j + i*cols] = column.fill;
+				}
+			}
+		}
+		for(unsigned int k=0; k<column.neighbors.size(); ++k)
+		{
+			int i = idToIndexMap.at(column.neighbors[k].first);
+			((float*)dense.data)[j + i*cols] = column.neighbors[k].second;
+		}
+		if(ids[0] < 0 && iter->first > 0)
+		{
+			((float*)dense.data)[j] = _predictionLC[0];
+		}
+	}
+	return dense;
+}
+
+void BayesFilter::predict(
+		Prediction & prediction,
+		const Memory * memory,
+		const std::vector<int> & oldIds,
+		const std::vector<int> & ids)
+{
 	if(oldIds.size() == ids.size() &&
 		memcmp(oldIds.data(), ids.data(), oldIds.size()*sizeof(int)) == 0)
 	{
-		return _prediction;
+		return;
 	}
 
-	if(!_fullPredictionUpdate && !_prediction.empty())
+	if(!_fullPredictionUpdate && !prediction.empty())
 	{
-		return updatePrediction(_prediction, memory, oldIds, ids);
+		updatePrediction(prediction, memory, oldIds, ids);
 	}
+	else
+	{
+		generatePrediction(prediction, memory, ids);
+	}
+}
+
+void BayesFilter::generatePrediction(Prediction & prediction, const Memory * memory, const std::vector<int> & ids)
+{
 	UDEBUG("");
 
 	UASSERT(memory &&
@@ -308,10 +429,15 @@ cv::Mat BayesFilter::generatePrediction(const Memory * memory, const std::vector
 		}
 	}
 
-
-	//int rows = prediction.rows;
-	cv::Mat prediction = cv::Mat::zeros(ids.size(), ids.size(), CV_32FC1);
-	int cols = prediction.cols;
+	++_predictionGeneration;
+	prediction.clear();
+	for(unsigned int i=0; i<ids.size(); ++i)
+	{
+		PredictionColumn & column = prediction.insert(prediction.end(), std::make_pair(ids[i], PredictionColumn()))->second;
+		column.rowGeneration = _predictionGeneration;
+		column.columnGeneration = _predictionGeneration;
+	}
+	int cols = (int)ids.size();
 
 	// Each prior is a column vector
 	UDEBUG("_predictionLC.size()=%d",_predictionLC.size());
@@ -365,30 +491,26 @@ cv::Mat BayesFilter::generatePrediction(const Memory * memory, const std::vector
 						uInsert(_neighborsIndex, std::make_pair(*iter, neighbors));
 					}
 
-					float sum = 0.0f; // sum values added
-					int index = idToIndexMap.at(*iter);
-					sum += addNeighborProb(prediction, index, neighbors, _predictionLC, idToIndexMap);
+					PredictionColumn & column = prediction.at(*iter);
+					float sum = addNeighborProb(column.neighbors, neighbors, _predictionLC, idToIndexMap);
 					idsDone.insert(*iter);
-					this->normalize(prediction, index, sum, ids[0]<0);
+					this->normalize(column, *iter, sum, ids[0]<0, cols);
 				}
 			}
 			else
 			{
 				// Set the virtual place prior
+				PredictionColumn & column = prediction.at(ids[i]);
 				if(_virtualPlacePrior > 0)
 				{
 					if(cols>1) // The first must be the virtual place
 					{
-						((float*)prediction.data)[i] = _virtualPlacePrior;
-						float val = (1.0-_virtualPlacePrior)/(cols-1);
-						for(int j=1; j<cols; j++)
-						{
-							((float*)prediction.data)[i + j*cols] = val;
-						}
+						column.neighbors.push_back(std::make_pair(ids[i], _virtualPlacePrior));
+						column.fill = (1.0-_virtualPlacePrior)/(cols-1);
 					}
 					else if(cols>0)
 					{
-						((float*)prediction.data)[i] = 1;
+						column.neighbors.push_back(std::make_pair(ids[i], 1.0f));
 					}
 				}
 				else
@@ -397,15 +519,12 @@ cv::Mat BayesFilter::generatePrediction(const Memory * memory, const std::vector
 					// when _virtualPlacePrior=0, set all priors to the same value
 					if(cols>1)
 					{
-						float val = 1.0/cols;
-						for(int j=0; j<cols; j++)
-						{
-							((float*)prediction.data)[i + j*cols] = val;
-						}
+						column.neighbors.push_back(std::make_pair(ids[i], 1.0f/cols));
+						column.fill = 1.0/cols;
 					}
 					else if(cols>0)
 					{
-						((float*)prediction.data)[i] = 1;
+						column.neighbors.push_back(std::make_pair(ids[i], 1.0f));
 					}
 				}
 			}
@@ -413,20 +532,26 @@ cv::Mat BayesFilter::generatePrediction(const Memory * memory, const std::vector
 	}
 
 	ULOGGER_DEBUG("time = %fs", timerGlobal.ticks());
-
-	return prediction;
 }
 
-void BayesFilter::normalize(cv::Mat & prediction, unsigned int index, float addedProbabilitiesSum, bool virtualPlaceUsed) const
+void BayesFilter::normalize(PredictionColumn & column, int id, float addedProbabilitiesSum, bool virtualPlaceUsed, int cols) const
 {
-	UASSERT(index < (unsigned int)prediction.rows && index < (unsigned int)prediction.cols);
+	std::vector<std::pair<int, float> > & neighbors = column.neighbors;
 
-	int cols = prediction.cols;
 	// ADD values of not found neighbors to loop closure
 	if(addedProbabilitiesSum < _totalPredictionLCValues-_predictionLC[0])
 	{
 		float delta = _totalPredictionLCValues-_predictionLC[0]-addedProbabilitiesSum;
-		((float*)prediction.data)[index + index*cols] += delta;
+		std::vector<std::pair<int, float> >::iterator iter = neighbors.begin();
+		while(iter != neighbors.end() && iter->first < id)
+		{
+			++iter;
+		}
+		if(iter == neighbors.end() || iter->first != id)
+		{
+			iter = neighbors.insert(iter, std::make_pair(id, 0.0f));
+		}
+		iter->second += delta;
 		addedProbabilitiesSum+=delta;
 	}
 
@@ -437,54 +562,61 @@ void BayesFilter::normalize(cv::Mat & prediction, unsigned int index, float adde
 	}
 
 	// Set all loop events to small values according to the model
+	column.fill = 0.0f;
 	if(allOtherPlacesValue > 0 && cols>1)
 	{
 		float value = allOtherPlacesValue / float(cols - 1);
-		for(int j=virtualPlaceUsed?1:0; j<cols; ++j)
+		column.fill = value;
+		int nulls = cols - (virtualPlaceUsed?1:0) - (int)neighbors.size();
+		for(unsigned int j=0; j<neighbors.size(); ++j)
 		{
-			if(((float*)prediction.data)[index + j*cols] == 0)
+			if(neighbors[j].second == 0)
 			{
-				((float*)prediction.data)[index + j*cols] = value;
-				addedProbabilitiesSum += ((float*)prediction.data)[index + j*cols];
+				neighbors[j].second = value;
+				++nulls;
 			}
 		}
+		// summed one by one like the filled values of a dense column
+		for(int j=0; j<nulls; ++j)
+		{
+			addedProbabilitiesSum += value;
+		}
 	}
 
-	//normalize this row
+	//normalize this column
 	float maxNorm = 1 - (virtualPlaceUsed?_predictionLC[0]:0); // 1 - virtual place probability
 	if(addedProbabilitiesSum<maxNorm-0.0001 || addedProbabilitiesSum>maxNorm+0.0001)
 	{
-		for(int j=virtualPlaceUsed?1:0; j<cols; ++j)
+		for(unsigned int j=0; j<neighbors.size(); ++j)
 		{
-			((float*)prediction.data)[index + j*cols] *= maxNorm / addedProbabilitiesSum;
-			if(((float*)prediction.data)[index + j*cols] < _predictionEpsilon)
+			neighbors[j].second *= maxNorm / addedProbabilitiesSum;
+			if(neighbors[j].second < _predictionEpsilon)
 			{
-				((float*)prediction.data)[index + j*cols] = 0.0f;
+				// kept to not be filled
+				neighbors[j].second = 0.0f;
 			}
 		}
+		column.fill *= maxNorm / addedProbabilitiesSum;
+		if(column.fill < _predictionEpsilon)
+		{
+			column.fill = 0.0f;
+		}
 		addedProbabilitiesSum = maxNorm;
 	}
 
-	// ADD virtual place prob
+	// ADD virtual place prob (implicit)
 	if(virtualPlaceUsed)
 	{
-		((float*)prediction.data)[index] = _predictionLC[0];
-		addedProbabilitiesSum += ((float*)prediction.data)[index];
+		addedProbabilitiesSum += (float)_predictionLC[0];
 	}
 
-	//debug
-	//for(int j=0; j<cols; ++j)
-	//{
-	//	ULOGGER_DEBUG("test col=%d = %f", i, prediction.data.fl[i + j*cols]);
-	//}
-
 	if(addedProbabilitiesSum<0.99 || addedProbabilitiesSum > 1.01)
 	{
 		UWARN("Prediction is not normalized sum=%f", addedProbabilitiesSum);
 	}
 }
 
-cv::Mat BayesFilter::updatePrediction(const cv::Mat & oldPrediction,
+void BayesFilter::updatePrediction(Prediction & prediction,
 		const Memory * memory,
 		const std::vector<int> & oldIds,
 		const std::vector<int> & newIds)
@@ -495,11 +627,9 @@ cv::Mat BayesFilter::updatePrediction(const cv::Mat & oldPrediction,
 	UASSERT(memory &&
 		oldIds.size() &&
 		newIds.size() &&
-		oldIds.size() == (unsigned int)oldPrediction.cols &&
-		oldIds.size() == (unsigned int)oldPrediction.rows);
+		oldIds.size() == prediction.size());
 
-	cv::Mat prediction = cv::Mat::zeros(newIds.size(), newIds.size(), CV_32FC1);
-	UDEBUG("time creating prediction = %fs", timer.restart());
+	++_predictionGeneration;
 
 	// Create id to index maps
 #if __cplusplus >= 201103L
@@ -533,45 +663,48 @@ cv::Mat BayesFilter::updatePrediction(const cv::Mat & oldPrediction,
 		{
 			removedIds.insert(removedIds.end(), oldIds[i]);
 			_neighborsIndex.erase(oldIds[i]);
+			prediction.erase(oldIds[i]);
 			UDEBUG("removed id=%d at oldIndex=%d", oldIds[i], i);
 		}
+		else if(oldIds[i] <= 0 && std::find(newIds.begin(), newIds.end(), oldIds[i]) == newIds.end())
+		{
+			// virtual place
+			prediction.erase(oldIds[i]);
+		}
 	}
 	UDEBUG("time getting removed ids = %fs", timer.restart());
 
-	bool oldAllCopied = false;
-	if(removedIds.empty() &&
-		newIds.size() > oldIds.size() &&
-		memcmp(oldIds.data(), newIds.data(), oldIds.size()*sizeof(int)) == 0)
+	// Rows and columns of added ids (the virtual place is always kept)
+	for(unsigned int i=0; i<newIds.size(); ++i)
 	{
-		oldPrediction.copyTo(cv::Mat(prediction, cv::Range(0, oldPrediction.rows), cv::Range(0, oldPrediction.cols)));
-		oldAllCopied = true;
-		UDEBUG("Copied all old prediction: = %fs", timer.ticks());
+		if(oldIdsSet.find(newIds[i]) == oldIdsSet.end())
+		{
+			PredictionColumn & column = prediction[newIds[i]];
+			column.rowGeneration = _predictionGeneration;
+			column.columnGeneration = _predictionGeneration;
+		}
 	}
+	int cols = (int)newIds.size();
+	UASSERT(prediction.size() == newIds.size());
 
 	int added = 0;
 	// get ids to update
 	std::set<int> idsToUpdate;
-	for(unsigned int i=0; i<oldIds.size() || i<newIds.size(); ++i)
+	if(!removedIds.empty())
 	{
-		if(i<oldIds.size())
+		// normalization of all other columns depends on the number of places
+		for(unsigned int i=0; i<oldIds.size(); ++i)
 		{
-			if(removedIds.find(oldIds[i]) != removedIds.end())
+			if(removedIds.find(oldIds[i]) == removedIds.end())
 			{
-				unsigned int cols = oldPrediction.cols;
-				int count = 0;
-				for(unsigned int j=0; j<cols; ++j)
-				{
-					if(j!=i && removedIds.find(oldIds[j]) == removedIds.end())
-					{
-						//UDEBUG("to update id=%d from id=%d removed (value=%f)", oldIds[j], oldIds[i], ((const float *)oldPrediction.data)[i + j*cols]);
-						idsToUpdate.insert(oldIds[j]);
-						++count;
-					}
-				}
-				UDEBUG("From removed id %d, %d neighbors to update.", oldIds[i], count);
+				idsToUpdate.insert(oldIds[i]);
 			}
 		}
-		if(i<newIds.size() && oldIdsSet.find(newIds[i]) == oldIdsSet.end())
+		UDEBUG("From %d removed ids, %d neighbors to update.", (int)removedIds.size(), (int)idsToUpdate.size());
+	}
+	for(unsigned int i=0; i<newIds.size(); ++i)
+	{
+		if(oldIdsSet.find(newIds[i]) == oldIdsSet.end())
 		{
 			if(_neighborsIndex.find(newIds[i]) == _neighborsIndex.end())
 			{
@@ -588,10 +721,10 @@ cv::Mat BayesFilter::updatePrediction(const cv::Mat & oldPrediction,
 				_neighborsIndex.insert(std::make_pair(newIds[i], neighbors));
 			}
 			const std::map<int, int> & neighbors = _neighborsIndex.at(newIds[i]);
-			//std::map<int, int> neighbors = memory->getNeighborsId(newIds[i], _predictionLC.size()-1, 0, false, false, true, true);
 
-			float sum = addNeighborProb(prediction, i, neighbors, _predictionLC, newIdToIndexMap);
-			this->normalize(prediction, i, sum, newIds[0]<0);
+			PredictionColumn & column = prediction.at(newIds[i]);
+			float sum = addNeighborProb(column.neighbors, neighbors, _predictionLC, newIdToIndexMap);
+			this->normalize(column, newIds[i], sum, newIds[0]<0, cols);
 
 			++added;
 			int count = 0;
@@ -609,8 +742,6 @@ cv::Mat BayesFilter::updatePrediction(const cv::Mat & oldPrediction,
 	}
 	UDEBUG("time getting %d ids to update = %fs", idsToUpdate.size(), timer.restart());
 
-	UTimer t1;
-	double e0=0,e1=0, e2=0, e3=0, e4=0;
 	// update modified/added ids
 	int modified = 0;
 	for(std::set<int>::iterator iter = idsToUpdate.begin(); iter!=idsToUpdate.end(); ++iter)
@@ -618,81 +749,39 @@ cv::Mat BayesFilter::updatePrediction(const cv::Mat & oldPrediction,
 		int id = *iter;
 		if(id > 0)
 		{
-			int index = newIdToIndexMap.at(id);
-
-			e0 = t1.ticks();
 			std::map<int, std::map<int, int> >::iterator kter = _neighborsIndex.find(id);
 			UASSERT_MSG(kter != _neighborsIndex.end(), uFormat("Did not find %d (current index size=%d)", id, (int)_neighborsIndex.size()).c_str());
 			const std::map<int, int> & neighbors = kter->second;
-			//std::map<int, int> neighbors = memory->getNeighborsId(id, _predictionLC.size()-1, 0, false, false, true, true);
-			e1+=t1.ticks();
 
-			float sum = addNeighborProb(prediction, index, neighbors, _predictionLC, newIdToIndexMap);
-			e3+=t1.ticks();
-
-			this->normalize(prediction, index, sum, newIds[0]<0);
+			PredictionColumn & column = prediction.at(id);
+			column.columnGeneration = _predictionGeneration;
+			float sum = addNeighborProb(column.neighbors, neighbors, _predictionLC, newIdToIndexMap);
+			this->normalize(column, id, sum, newIds[0]<0, cols);
 			++modified;
-			e4+=t1.ticks();
 		}
 	}
-	UDEBUG("time updating modified/added %d ids = %fs (e0=%f e1=%f e2=%f e3=%f e4=%f)", idsToUpdate.size(), timer.restart(), e0, e1, e2, e3, e4);
-
-	int copied = 0;
-	if(!oldAllCopied)
-	{
-		//UDEBUG("oldIds.size()=%d, oldPrediction.cols=%d, oldPrediction.rows=%d", oldIds.size(), oldPrediction.cols, oldPrediction.rows);
-		//UDEBUG("newIdToIndexMap.size()=%d, prediction.cols=%d, prediction.rows=%d", newIdToIndexMap.size(), prediction.cols, prediction.rows);
-		// copy not changed probabilities
-		for(unsigned int i=0; i<oldIds.size(); ++i)
-		{
-			if(oldIds[i]>0 && removedIds.find(oldIds[i]) == removedIds.end() && idsToUpdate.find(oldIds[i]) == idsToUpdate.end())
-			{
-				for(int j=0; j<oldPrediction.cols; ++j)
-				{
-					if(oldIds[j]>0 && removedIds.find(oldIds[j]) == removedIds.end())
-					{
-						//UDEBUG("i=%d, j=%d", i, j);
-						//UDEBUG("oldIds[i]=%d, oldIds[j]=%d", oldIds[i], oldIds[j]);
-						//UDEBUG("newIdToIndexMap.at(oldIds[i])=%d", newIdToIndexMap.at(oldIds[i]));
-						//UDEBUG("newIdToIndexMap.at(oldIds[j])=%d", newIdToIndexMap.at(oldIds[j]));
-						float v = ((const float *)oldPrediction.data)[i + j*oldPrediction.cols];
-						int ii = newIdToIndexMap.at(oldIds[i]);
-						int jj = newIdToIndexMap.at(oldIds[j]);
-						((float *)prediction.data)[ii + jj*prediction.cols] = v;
-						//if(ii != jj)
-						//{
-						//	((float *)prediction.data)[jj + ii*prediction.cols] = v;
-						//}
-					}
-				}
-				++copied;
-			}
-		}
-		UDEBUG("time copying = %fs", timer.restart());
-	}
+	UDEBUG("time updating modified/added %d ids = %fs", idsToUpdate.size(), timer.restart());
 
 	//update virtual place
 	if(newIds[0] < 0)
 	{
-		if(prediction.cols>1) // The first must be the virtual place
+		PredictionColumn & column = prediction.at(newIds[0]);
+		column.neighbors.clear();
+		column.fill = 0.0f;
+		column.columnGeneration = _predictionGeneration;
+		if(prediction.size()>1) // The first must be the virtual place
 		{
-			((float*)prediction.data)[0] = _virtualPlacePrior;
-			float val = (1.0-_virtualPlacePrior)/(prediction.cols-1);
-			for(int j=1; j<prediction.cols; j++)
-			{
-				((float*)prediction.data)[j*prediction.cols] = val;
-				((float*)prediction.data)[j] = _predictionLC[0];
-			}
+			column.neighbors.push_back(std::make_pair(newIds[0], _virtualPlacePrior));
+			column.fill = (1.0-_virtualPlacePrior)/(prediction.size()-1);
 		}
-		else if(prediction.cols>0)
+		else if(prediction.size()>0)
 		{
-			((float*)prediction.data)[0] = 1;
+			column.neighbors.push_back(std::make_pair(newIds[0], 1.0f));
 		}
 	}
 	UDEBUG("time updating virtual place = %fs", timer.restart());
 
-	UDEBUG("Modified=%d, Added=%d, Copied=%d", modified, added, copied);
-	return prediction;
+	UDEBUG("Modified=%d, Added=%d, Copied=%d", modified, added, (int)prediction.size()-modified-added);
 }
 
 void BayesFilter::updatePosterior(const Memory * memory, const std::vector<int> & likelihoodIds)
@@ -26,6 +26,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "rtabmap/core/Camera.h"
+#include "rtabmap/core/Trace.h"
 
 #include <rtabmap/utilite/UEventsManager.h>
 #include <rtabmap/utilite/UConversion.h>
@@ -94,7 +95,11 @@ SensorData Camera::takeImage(CameraInfo * info)
 	}
 
 	UTimer timer;
-	SensorData data  = this->captureImage(info);
+	SensorData data;
+	{
+		RTABMAP_TRACE_SCOPE("Camera::captureImage");
+		data = this->captureImage(info);
+	}
 	double captureTime = timer.ticks();
 	if(warnFrameRateTooHigh)
 	{
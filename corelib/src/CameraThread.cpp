@@ -26,6 +26,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "rtabmap/core/CameraThread.h"
+#include "rtabmap/core/Trace.h"
 #include "rtabmap/core/Camera.h"
 #include "rtabmap/core/CameraEvent.h"
 #include "rtabmap/core/CameraRGBD.h"
@@ -40,12 +41,173 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <opencv2/stitching/detail/exposure_compensate.hpp>
 #include <rtabmap/utilite/UTimer.h>
 #include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UThreadPool.h>
+#include <rtabmap/utilite/URingBuffer.h>
 
 #include <pcl/io/io.h>
 
 namespace rtabmap
 {
 
+// Post-process the captured data in its own thread, while the next data is captured
+class CameraThread::PostProcessingThread : public UThread
+{
+public:
+	PostProcessingThread(CameraThread * cameraThread) :
+		cameraThread_(cameraThread),
+		buffer_(1),
+		pending_(0)
+	{}
+	virtual ~PostProcessingThread()
+	{
+		join(true);
+	}
+
+	/**
+	 * Blocking until the previous data is post-processed (or the camera thread is killed).
+	 * @param start time when the capture of the data started
+	 */
+	void push(const SensorData & data, const CameraInfo & info, double start)
+	{
+		// only one data is post-processed at the same time
+		while(!cameraThread_->isKilled())
+		{
+			pendingMutex_.lock();
+			bool ready = pending_ == 0;
+			if(ready)
+			{
+				++pending_;
+			}
+			pendingMutex_.unlock();
+			if(ready)
+			{
+				buffer_.push(new Frame(data, info, start));
+				dataAdded_.release();
+				return;
+			}
+			dataProcessed_.acquire(1, 100);
+		}
+	}
+
+	/**
+	 * Wait until all pushed data are post-processed and posted.
+	 */
+	void waitProcessed()
+	{
+		while(this->isRunning())
+		{
+			pendingMutex_.lock();
+			bool done = pending_ == 0;
+			pendingMutex_.unlock();
+			if(done)
+			{
+				return;
+			}
+			dataProcessed_.acquire(1, 100);
+		}
+	}
+
+	/**
+	 * Stop the thread, data not yet post-processed are dropped.
+	 */
+	void stop()
+	{
+		join(true);
+		buffer_.clear();
+		UScopeMutex lock(pendingMutex_);
+		pending_ = 0;
+	}
+
+private:
+	struct Frame
+	{
+		Frame(const SensorData & data, const CameraInfo & info, double start) :
+			data(data),
+			info(info),
+			start(start)
+		{}
+		SensorData data;
+		CameraInfo info;
+		double start;
+	};
+
+	virtual void mainLoop()
+	{
+		dataAdded_.acquire();
+		Frame * frame = buffer_.pop();
+		if(frame)
+		{
+			cameraThread_->postUpdate(&frame->data, &frame->info);
+			frame->info.timeTotal = UTimer::now() - frame->start;
+			cameraThread_->post(new CameraEvent(frame->data, frame->info));
+			delete frame;
+
+			pendingMutex_.lock();
+			--pending_;
+			pendingMutex_.unlock();
+			dataProcessed_.release();
+		}
+	}
+	virtual void mainLoopKill()
+	{
+		dataAdded_.release();
+	}
+
+private:
+	CameraThread * cameraThread_;
+	URingBuffer<Frame> buffer_;
+	USemaphore dataAdded_;
+	USemaphore dataProcessed_;
+	UMutex pendingMutex_;
+	int pending_;
+};
+
+// Steps of CameraThread::postUpdate() run concurrently
+class CameraThread::PostUpdateTask : public UThreadPoolTask
+{
+public:
+	PostUpdateTask(const CameraThread * cameraThread, SensorData * data, CameraInfo * info, bool scan) :
+		cameraThread_(cameraThread),
+		data_(data),
+		info_(info),
+		scan_(scan)
+	{}
+	virtual void run()
+	{
+		if(scan_)
+		{
+			cameraThread_->postUpdateScan(*data_, info_);
+		}
+		else
+		{
+			cameraThread_->postUpdateImages(*data_, info_);
+		}
+	}
+private:
+	const CameraThread * cameraThread_;
+	SensorData * data_;
+	CameraInfo * info_;
+	bool scan_;
+};
+
+class DecimateTask : public UThreadPoolTask
+{
+public:
+	DecimateTask(const cv::Mat & image, int decimation) :
+		image_(image),
+		decimation_(decimation)
+	{}
+	virtual void run()
+	{
+		decimated_ = util2d::decimate(image_, decimation_);
+	}
+	const cv::Mat & decimated() const {return decimated_;}
+private:
+	cv::Mat image_;
+	int decimation_;
+	cv::Mat decimated_;
+};
+
 // ownership transferred
 CameraThread::CameraThread(Camera * camera, const ParametersMap & parameters) :
 		_camera(camera),
@@ -67,21 +229,40 @@ CameraThread::CameraThread(Camera * camera, const ParametersMap & parameters) :
 		_bilateralFiltering(false),
 		_bilateralSigmaS(10),
 		_bilateralSigmaR(0.1),
-		_imuFilter(0)
+		_imuFilter(0),
+		_postProcessingThread(0),
+		_postProcessingPool(0)
 {
 	UASSERT(_camera != 0);
+	this->parseParameters(parameters);
 }
 
 CameraThread::~CameraThread()
 {
 	UDEBUG("");
 	join(true);
+	delete _postProcessingThread;
+	delete _postProcessingPool;
 	delete _camera;
 	delete _distortionModel;
 	delete _stereoDense;
 	delete _imuFilter;
 }
 
+void CameraThread::parseParameters(const ParametersMap & parameters)
+{
+	bool postProcessingAsync = _postProcessingThread != 0;
+	if(Parameters::parse(parameters, Parameters::kRGBDCameraPostProcessingAsync(), postProcessingAsync))
+	{
+		setPostProcessingAsync(postProcessingAsync);
+	}
+	int postProcessingThreads = Parameters::defaultRGBDCameraPostProcessingThreads();
+	if(Parameters::parse(parameters, Parameters::kRGBDCameraPostProcessingThreads(), postProcessingThreads))
+	{
+		setPostProcessingThreads(postProcessingThreads);
+	}
+}
+
 void CameraThread::setImageRate(float imageRate)
 {
 	if(_camera)
@@ -130,30 +311,83 @@ void CameraThread::disableIMUFiltering()
 	_imuFilter = 0;
 }
 
+void CameraThread::setPostProcessingAsync(bool enabled)
+{
+	UASSERT_MSG(!this->isRunning(), "Post-processing mode should be set before the thread is started.");
+	if(enabled && _postProcessingThread == 0)
+	{
+		_postProcessingThread = new PostProcessingThread(this);
+	}
+	else if(!enabled && _postProcessingThread)
+	{
+		delete _postProcessingThread;
+		_postProcessingThread = 0;
+	}
+}
+
+void CameraThread::setPostProcessingThreads(int threads)
+{
+	UASSERT_MSG(!this->isRunning(), "Post-processing threads should be set before the thread is started.");
+	delete _postProcessingPool;
+	_postProcessingPool = 0;
+	if(threads != 1)
+	{
+		_postProcessingPool = new UThreadPool(threads);
+	}
+}
+
 void CameraThread::mainLoopBegin()
 {
 	ULogger::registerCurrentThread("Camera");
+	RTABMAP_TRACE_THREAD_NAME("Camera");
 	_camera->resetTimer();
+	if(_postProcessingThread)
+	{
+		_postProcessingThread->start();
+	}
+}
+
+void CameraThread::mainLoopEnd()
+{
+	if(_postProcessingThread)
+	{
+		_postProcessingThread->stop();
+	}
 }
 
 void CameraThread::mainLoop()
 {
 	UTimer totalTime;
+	double start = UTimer::now();
 	UDEBUG("");
 	CameraInfo info;
 	SensorData data = _camera->takeImage(&info);
+	data.setCaptureTime(UTimer::now());
 
 	if(!data.imageRaw().empty() || (dynamic_cast<DBReader*>(_camera) != 0 && data.id()>0)) // intermediate nodes could not have image set
 	{
-		postUpdate(&data, &info);
-
 		info.cameraName = _camera->getSerial();
-		info.timeTotal = totalTime.ticks();
-		this->post(new CameraEvent(data, info));
+		if(_postProcessingThread)
+		{
+			// post-processed while the next data is captured
+			_postProcessingThread->push(data, info, start);
+		}
+		else
+		{
+			postUpdate(&data, &info);
+
+			info.timeTotal = totalTime.ticks();
+			this->post(new CameraEvent(data, info));
+		}
 	}
 	else if(!this->isKilled())
 	{
 		UWARN("no more images...");
+		if(_postProcessingThread)
+		{
+			// make sure the last data are posted before the end
+			_postProcessingThread->waitProcessed();
+		}
 		this->kill();
 		this->post(new CameraEvent());
 	}
@@ -187,8 +421,32 @@ void CameraThread::mainLoopKill()
 
 void CameraThread::postUpdate(SensorData * dataPtr, CameraInfo * info) const
 {
+	RTABMAP_TRACE_SCOPE("CameraThread::postUpdate");
 	UASSERT(dataPtr!=0);
 	SensorData & data = *dataPtr;
+
+	if(_postProcessingPool && !_scanFromDepth && !data.laserScanRaw().isEmpty())
+	{
+		// The laser scan filtering doesn't depend on the images, so both are
+		// done at the same time (they modify different parts of the data)
+		PostUpdateTask imagesTask(this, &data, info, false);
+		PostUpdateTask scanTask(this, &data, info, true);
+		std::vector<UThreadPoolTask*> tasks;
+		tasks.push_back(&scanTask);
+		tasks.push_back(&imagesTask);
+		_postProcessingPool->run(tasks);
+	}
+	else
+	{
+		postUpdateImages(data, info);
+		postUpdateScan(data, info);
+	}
+
+	postUpdateIMU(data, info);
+}
+
+void CameraThread::postUpdateImages(SensorData & data, CameraInfo * info) const
+{
 	if(_colorOnly && !data.depthRaw().empty())
 	{
 		data.setRGBDImage(data.imageRaw(), cv::Mat(), data.cameraModels());
@@ -232,8 +490,24 @@ void CameraThread::postUpdate(SensorData * dataPtr, CameraInfo * info) const
 		}
 		else
 		{
-			cv::Mat image = util2d::decimate(data.imageRaw(), _imageDecimation);
-			cv::Mat depthOrRight = util2d::decimate(data.depthOrRightRaw(), _imageDecimation);
+			cv::Mat image;
+			cv::Mat depthOrRight;
+			if(_postProcessingPool)
+			{
+				DecimateTask imageTask(data.imageRaw(), _imageDecimation);
+				DecimateTask depthTask(data.depthOrRightRaw(), _imageDecimation);
+				std::vector<UThreadPoolTask*> tasks;
+				tasks.push_back(&imageTask);
+				tasks.push_back(&depthTask);
+				_postProcessingPool->run(tasks);
+				image = imageTask.decimated();
+				depthOrRight = depthTask.decimated();
+			}
+			else
+			{
+				image = util2d::decimate(data.imageRaw(), _imageDecimation);
+				depthOrRight = util2d::decimate(data.depthOrRightRaw(), _imageDecimation);
+			}
 			std::vector<CameraModel> models = data.cameraModels();
 			for(unsigned int i=0; i<models.size(); ++i)
 			{
@@ -332,6 +606,10 @@ void CameraThread::postUpdate(SensorData * dataPtr, CameraInfo * info) const
 		data.setRGBDImage(data.imageRaw(), depth, model);
 		if(info) info->timeDisparity = timer.ticks();
 	}
+}
+
+void CameraThread::postUpdateScan(SensorData & data, CameraInfo * info) const
+{
 	if(_scanFromDepth &&
 		data.cameraModels().size() &&
 		data.cameraModels().at(0).isValidForProjection() &&
@@ -342,50 +620,69 @@ void CameraThread::postUpdate(SensorData * dataPtr, CameraInfo * info) const
 		{
 			UASSERT(_scanDownsampleStep >= 1);
 			UTimer timer;
-			pcl::IndicesPtr validIndices(new std::vector<int>);
-			pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = util3d::cloudRGBFromSensorData(
-					data,
-					_scanDownsampleStep,
-					_scanRangeMax,
-					_scanRangeMin,
-					validIndices.get());
-			float maxPoints = (data.depthRaw().rows/_scanDownsampleStep)*(data.depthRaw().cols/_scanDownsampleStep);
-			cv::Mat scan;
-			const Transform & baseToScan = data.cameraModels()[0].localTransform();
-			LaserScan::Format format = LaserScan::kXYZRGB;
-			if(validIndices->size())
+			if(data.cameraModels().size() == 1 &&
+			   !data.imageRaw().empty() &&
+			   _scanVoxelSize <= 0.0f && _scanNormalsK <= 0 && _scanNormalsRadius <= 0.0f &&
+			   (data.imageRaw().channels() == 3 || data.imageRaw().channels() == 1) &&
+			   data.depthRaw().rows % _scanDownsampleStep == 0 &&
+			   data.depthRaw().cols % _scanDownsampleStep == 0)
 			{
-				if(_scanVoxelSize>0.0f)
-				{
-					cloud = util3d::voxelize(cloud, validIndices, _scanVoxelSize);
-					float ratio = float(cloud->size()) / float(validIndices->size());
-					maxPoints = ratio * maxPoints;
-				}
-				else if(!cloud->is_dense)
-				{
-					pcl::PointCloud<pcl::PointXYZRGB>::Ptr denseCloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-					pcl::copyPointCloud(*cloud, *validIndices, *denseCloud);
-					cloud = denseCloud;
-				}
-
-				if(cloud->size())
+				// no filtering, project directly in the scan
+				data.setLaserScan(util3d::laserScanFromDepth(
+						data.depthRaw(),
+						data.cameraModels()[0],
+						_scanDownsampleStep,
+						_scanRangeMax,
+						_scanRangeMin,
+						data.imageRaw()));
+			}
+			else
+			{
+				pcl::IndicesPtr validIndices(new std::vector<int>);
+				pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = util3d::cloudRGBFromSensorData(
+						data,
+						_scanDownsampleStep,
+						_scanRangeMax,
+						_scanRangeMin,
+						validIndices.get());
+				float maxPoints = (data.depthRaw().rows/_scanDownsampleStep)*(data.depthRaw().cols/_scanDownsampleStep);
+				cv::Mat scan;
+				const Transform & baseToScan = data.cameraModels()[0].localTransform();
+				LaserScan::Format format = LaserScan::kXYZRGB;
+				if(validIndices->size())
 				{
-					if(_scanNormalsK>0 || _scanNormalsRadius>0.0f)
+					if(_scanVoxelSize>0.0f)
 					{
-						Eigen::Vector3f viewPoint(baseToScan.x(), baseToScan.y(), baseToScan.z());
-						pcl::PointCloud<pcl::Normal>::Ptr normals = util3d::computeNormals(cloud, _scanNormalsK, _scanNormalsRadius, viewPoint);
-						pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloudNormals(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
-						pcl::concatenateFields(*cloud, *normals, *cloudNormals);
-						scan = util3d::laserScanFromPointCloud(*cloudNormals, baseToScan.inverse());
-						format = LaserScan::kXYZRGBNormal;
+						cloud = util3d::voxelize(cloud, validIndices, _scanVoxelSize);
+						float ratio = float(cloud->size()) / float(validIndices->size());
+						maxPoints = ratio * maxPoints;
 					}
-					else
+					else if(!cloud->is_dense)
 					{
-						scan = util3d::laserScanFromPointCloud(*cloud, baseToScan.inverse());
+						pcl::PointCloud<pcl::PointXYZRGB>::Ptr denseCloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+						pcl::copyPointCloud(*cloud, *validIndices, *denseCloud);
+						cloud = denseCloud;
+					}
+
+					if(cloud->size())
+					{
+						if(_scanNormalsK>0 || _scanNormalsRadius>0.0f)
+						{
+							Eigen::Vector3f viewPoint(baseToScan.x(), baseToScan.y(), baseToScan.z());
+							pcl::PointCloud<pcl::Normal>::Ptr normals = util3d::computeNormals(cloud, _scanNormalsK, _scanNormalsRadius, viewPoint);
+							pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloudNormals(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
+							pcl::concatenateFields(*cloud, *normals, *cloudNormals);
+							scan = util3d::laserScanFromPointCloud(*cloudNormals, baseToScan.inverse());
+							format = LaserScan::kXYZRGBNormal;
+						}
+						else
+						{
+							scan = util3d::laserScanFromPointCloud(*cloud, baseToScan.inverse());
+						}
 					}
 				}
+				data.setLaserScan(LaserScan(scan, (int)maxPoints, _scanRangeMax, format, baseToScan));
 			}
-			data.setLaserScan(LaserScan(scan, (int)maxPoints, _scanRangeMax, format, baseToScan));
 			if(info) info->timeScanFromDepth = timer.ticks();
 		}
 		else
@@ -398,10 +695,15 @@ void CameraThread::postUpdate(SensorData * dataPtr, CameraInfo * info) const
 	else if(!data.laserScanRaw().isEmpty())
 	{
 		UDEBUG("");
+		UTimer timer;
 		// filter the scan after registration
 		data.setLaserScan(util3d::commonFiltering(data.laserScanRaw(), _scanDownsampleStep, _scanRangeMin, _scanRangeMax, _scanVoxelSize, _scanNormalsK, _scanNormalsRadius, _scanForceGroundNormalsUp));
+		if(info) info->timeScanFiltering = timer.ticks();
 	}
+}
 
+void CameraThread::postUpdateIMU(SensorData & data, CameraInfo * info) const
+{
 	// IMU filtering
 	if(_imuFilter && !data.imu().empty())
 	{
@@ -416,6 +718,7 @@ void CameraThread::postUpdate(SensorData * dataPtr, CameraInfo * info) const
 		}
 		else
 		{
+			UTimer timer;
 			_imuFilter->update(
 					data.imu().angularVelocity()[0],
 					data.imu().angularVelocity()[1],
@@ -431,6 +734,7 @@ void CameraThread::postUpdate(SensorData * dataPtr, CameraInfo * info) const
 					data.imu().angularVelocity(), data.imu().angularVelocityCovariance(),
 					data.imu().linearAcceleration(), data.imu().linearAccelerationCovariance(),
 					data.imu().localTransform()));
+			if(info) info->timeImuFiltering = timer.ticks();
 			UDEBUG("%f %f %f %f (gyro=%f %f %f, acc=%f %f %f, %fs)",
 						data.imu().orientation()[0],
 						data.imu().orientation()[1],
@@ -26,30 +26,41 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "rtabmap/core/Compression.h"
+#include "rtabmap/core/Version.h"
 #include <rtabmap/utilite/ULogger.h>
 #include <rtabmap/utilite/UConversion.h>
+#include <rtabmap/utilite/UDestroyer.h>
+#include <rtabmap/utilite/UMutex.h>
 #include <opencv2/opencv.hpp>
 
 #include <zlib.h>
+#ifdef RTABMAP_LZ4
+#include <lz4.h>
+#endif
+#ifdef RTABMAP_ZSTD
+#include <zstd.h>
+#endif
 
 namespace rtabmap {
 
-// format : ".png" ".jpg" "" (empty is general)
-CompressionThread::CompressionThread(const cv::Mat & mat, const std::string & format) :
+// format : ".png" ".jpg" ".rvl" "" (empty is general)
+CompressionTask::CompressionTask(const cv::Mat & mat, const std::string & format, CompressionCodec codec) :
 	uncompressedData_(mat),
 	format_(format),
+	codec_(codec),
 	image_(!format.empty()),
 	compressMode_(true)
 {
-	UASSERT(format.empty() || format.compare(".png") == 0 || format.compare(".jpg") == 0);
+	UASSERT(format.empty() || format.compare(".png") == 0 || format.compare(".jpg") == 0 || format.compare(".rvl") == 0);
 }
 // assume image
-CompressionThread::CompressionThread(const cv::Mat & bytes, bool isImage) :
+CompressionTask::CompressionTask(const cv::Mat & bytes, bool isImage) :
 	compressedData_(bytes),
+	codec_(kCompressionZlib),
 	image_(isImage),
 	compressMode_(false)
 {}
-void CompressionThread::mainLoop()
+void CompressionTask::run()
 {
 	try
 	{
@@ -63,7 +74,7 @@ void CompressionThread::mainLoop()
 				}
 				else
 				{
-					compressedData_ = compressData2(uncompressedData_);
+					compressedData_ = compressData2(uncompressedData_, codec_);
 				}
 			}
 		}
@@ -93,16 +104,257 @@ void CompressionThread::mainLoop()
 			uncompressedData_ = cv::Mat();
 		}
 	}
+}
+
+static UThreadPool * g_compressionPool = 0;
+static UDestroyer<UThreadPool> g_compressionPoolDestroyer;
+static UMutex g_compressionPoolMutex;
+
+UThreadPool & compressionThreadPool()
+{
+	UScopeMutex lock(g_compressionPoolMutex);
+	if(g_compressionPool == 0)
+	{
+		g_compressionPool = new UThreadPool();
+		g_compressionPoolDestroyer.setDoomed(g_compressionPool);
+	}
+	return *g_compressionPool;
+}
+
+void runCompressionTasks(const std::vector<CompressionTask*> & tasks)
+{
+	if(tasks.size() == 1)
+	{
+		// no need to wake up the pool
+		tasks[0]->run();
+	}
+	else if(tasks.size())
+	{
+		compressionThreadPool().run(std::vector<UThreadPoolTask*>(tasks.begin(), tasks.end()));
+	}
+}
+
+// format : ".png" ".jpg" ".rvl" "" (empty is general)
+CompressionThread::CompressionThread(const cv::Mat & mat, const std::string & format) :
+	task_(mat, format)
+{}
+// assume image
+CompressionThread::CompressionThread(const cv::Mat & bytes, bool isImage) :
+	task_(bytes, isImage)
+{}
+void CompressionThread::mainLoop()
+{
+	task_.run();
 	this->kill();
 }
 
-// ".png" or ".jpg"
+// RVL: Run-length and Variable-Length coding of 16 bits depth images, see
+// A. D. Wilson, "Fast Lossless Depth Image Compression", ISS 2017. Zeros and
+// non-zeros runs are encoded, non-zeros as zigzag deltas with the previous
+// valid depth. Values are written 3 bits at the time in nibbles (the 4th bit
+// tells if more nibbles follow), 8 nibbles per 32 bits word.
+// Blob: "DEPTHRVL" + rows (int) + cols (int) + words.
+static const char kRVLTag[8] = {'D','E','P','T','H','R','V','L'};
+static const unsigned int kRVLHeaderSize = sizeof(kRVLTag) + 2*sizeof(int);
+
+class RVLWriter
+{
+public:
+	RVLWriter(unsigned char * output) : output_(output), word_(0), nibbles_(0) {}
+	void encode(unsigned int value)
+	{
+		do
+		{
+			unsigned int nibble = value & 0x7;
+			value >>= 3;
+			if(value)
+			{
+				nibble |= 0x8;
+			}
+			word_ = (word_ << 4) | nibble;
+			if(++nibbles_ == 8)
+			{
+				flush();
+			}
+		}
+		while(value);
+	}
+	// return the end of the output
+	unsigned char * finish()
+	{
+		if(nibbles_)
+		{
+			word_ <<= 4 * (8 - nibbles_);
+			flush();
+		}
+		return output_;
+	}
+private:
+	void flush()
+	{
+		memcpy(output_, &word_, sizeof(word_));
+		output_ += sizeof(word_);
+		word_ = 0;
+		nibbles_ = 0;
+	}
+private:
+	unsigned char * output_;
+	unsigned int word_;
+	int nibbles_;
+};
+
+class RVLReader
+{
+public:
+	RVLReader(const unsigned char * input, const unsigned char * end) : input_(input), end_(end), word_(0), nibbles_(0) {}
+	// return false if the end of the input is reached
+	bool decode(unsigned int & value)
+	{
+		value = 0;
+		int shift = 0;
+		unsigned int nibble;
+		do
+		{
+			if(nibbles_ == 0)
+			{
+				if(input_ + sizeof(word_) > end_)
+				{
+					return false;
+				}
+				memcpy(&word_, input_, sizeof(word_));
+				input_ += sizeof(word_);
+				nibbles_ = 8;
+			}
+			nibble = word_ >> 28;
+			value |= (nibble & 0x7) << shift;
+			word_ <<= 4;
+			--nibbles_;
+			shift += 3;
+		}
+		while((nibble & 0x8) && shift < 32);
+		return true;
+	}
+private:
+	const unsigned char * input_;
+	const unsigned char * end_;
+	unsigned int word_;
+	int nibbles_;
+};
+
+static std::vector<unsigned char> compressRVL(const cv::Mat & depth)
+{
+	UASSERT(depth.type() == CV_16UC1);
+	cv::Mat input = depth.isContinuous()?depth:depth.clone();
+	int numPixels = (int)input.total();
+
+	// Worst case: 6 nibbles per delta, runs lengths take less nibbles than their pixels.
+	std::vector<unsigned char> bytes(kRVLHeaderSize + ((7*(size_t)numPixels+2)/8+1)*4);
+	memcpy(bytes.data(), kRVLTag, sizeof(kRVLTag));
+	memcpy(bytes.data()+sizeof(kRVLTag), &input.rows, sizeof(int));
+	memcpy(bytes.data()+sizeof(kRVLTag)+sizeof(int), &input.cols, sizeof(int));
+
+	RVLWriter writer(bytes.data() + kRVLHeaderSize);
+	const unsigned short * p = input.ptr<unsigned short>();
+	const unsigned short * end = p + numPixels;
+	int previous = 0;
+	while(p != end)
+	{
+		unsigned int zeros = 0;
+		for(; p != end && *p == 0; ++p, ++zeros);
+		writer.encode(zeros);
+		unsigned int nonZeros = 0;
+		for(const unsigned short * q = p; q != end && *q != 0; ++q, ++nonZeros);
+		writer.encode(nonZeros);
+		for(unsigned int i=0; i<nonZeros; ++i, ++p)
+		{
+			int delta = (int)*p - previous;
+			writer.encode(((unsigned int)delta << 1) ^ (unsigned int)(delta >> 31));
+			previous = *p;
+		}
+	}
+	bytes.resize(writer.finish() - bytes.data());
+	return bytes;
+}
+
+static bool isRVL(const unsigned char * bytes, unsigned long size)
+{
+	return bytes && size >= kRVLHeaderSize && memcmp(bytes, kRVLTag, sizeof(kRVLTag)) == 0;
+}
+
+static cv::Mat uncompressRVL(const unsigned char * bytes, unsigned long size)
+{
+	UASSERT(isRVL(bytes, size));
+	int rows, cols;
+	memcpy(&rows, bytes+sizeof(kRVLTag), sizeof(int));
+	memcpy(&cols, bytes+sizeof(kRVLTag)+sizeof(int), sizeof(int));
+	if(rows <= 0 || cols <= 0)
+	{
+		UERROR("Invalid RVL depth image size (%dx%d).", cols, rows);
+		return cv::Mat();
+	}
+
+	cv::Mat depth(rows, cols, CV_16UC1);
+	RVLReader reader(bytes + kRVLHeaderSize, bytes + size);
+	unsigned short * p = depth.ptr<unsigned short>();
+	unsigned long remaining = depth.total();
+	int previous = 0;
+	while(remaining)
+	{
+		unsigned int zeros, nonZeros;
+		if(!reader.decode(zeros) || zeros > remaining)
+		{
+			break;
+		}
+		memset(p, 0, zeros*sizeof(unsigned short));
+		p += zeros;
+		remaining -= zeros;
+		if(!reader.decode(nonZeros) || nonZeros > remaining)
+		{
+			break;
+		}
+		unsigned int i=0;
+		for(; i<nonZeros; ++i)
+		{
+			unsigned int positive;
+			if(!reader.decode(positive))
+			{
+				break;
+			}
+			previous += (int)(positive >> 1) ^ -(int)(positive & 1);
+			*p++ = (unsigned short)previous;
+		}
+		if(i < nonZeros)
+		{
+			break;
+		}
+		remaining -= nonZeros;
+	}
+	if(remaining)
+	{
+		UERROR("The RVL compressed depth image (%dx%d) is corrupted.", cols, rows);
+		return cv::Mat();
+	}
+	return depth;
+}
+
+// ".png", ".jpg" or ".rvl" (16 bits depth only, ".png" is used for other types)
 std::vector<unsigned char> compressImage(const cv::Mat & image, const std::string & format)
 {
 	std::vector<unsigned char> bytes;
 	if(!image.empty())
 	{
-		if(image.type() == CV_32FC1)
+		if(format.compare(".rvl") == 0)
+		{
+			if(image.type() == CV_16UC1)
+			{
+				bytes = compressRVL(image);
+			}
+			else
+			{
+				bytes = compressImage(image, ".png");
+			}
+		}
+		else if(image.type() == CV_32FC1)
 		{
 			//save in 8bits-4channel
 			cv::Mat bgra(image.size(), CV_8UC4, image.data);
@@ -116,7 +368,7 @@ std::vector<unsigned char> compressImage(const cv::Mat & image, const std::strin
 	return bytes;
 }
 
-// ".png" or ".jpg"
+// ".png", ".jpg" or ".rvl"
 cv::Mat compressImage2(const cv::Mat & image, const std::string & format)
 {
 	std::vector<unsigned char> bytes = compressImage(image, format);
@@ -130,7 +382,12 @@ cv::Mat compressImage2(const cv::Mat & image, const std::string & format)
 cv::Mat uncompressImage(const cv::Mat & bytes)
 {
 	 cv::Mat image;
-	if(!bytes.empty())
+	if(!bytes.empty() && isRVL(bytes.data, bytes.total()*bytes.elemSize()))
+	{
+		UASSERT(bytes.isContinuous());
+		image = uncompressRVL(bytes.data, bytes.total()*bytes.elemSize());
+	}
+	else if(!bytes.empty())
 	{
 #if CV_MAJOR_VERSION>2 || (CV_MAJOR_VERSION >=2 && CV_MINOR_VERSION >=4)
 		image = cv::imdecode(bytes, cv::IMREAD_UNCHANGED);
@@ -152,7 +409,11 @@ cv::Mat uncompressImage(const cv::Mat & bytes)
 cv::Mat uncompressImage(const std::vector<unsigned char> & bytes)
 {
 	 cv::Mat image;
-	if(bytes.size())
+	if(isRVL(bytes.data(), (unsigned long)bytes.size()))
+	{
+		image = uncompressRVL(bytes.data(), (unsigned long)bytes.size());
+	}
+	else if(bytes.size())
 	{
 #if CV_MAJOR_VERSION>2 || (CV_MAJOR_VERSION >=2 && CV_MINOR_VERSION >=4)
 		image = cv::imdecode(bytes, cv::IMREAD_UNCHANGED);
@@ -167,24 +428,64 @@ cv::Mat uncompressImage(const std::vector<unsigned char> & bytes)
 	return image;
 }
 
-std::vector<unsigned char> compressData(const cv::Mat & data)
+bool isCompressionCodecAvailable(CompressionCodec codec)
 {
-	std::vector<unsigned char> bytes;
-	if(!data.empty())
+	return codec == kCompressionZlib
+#ifdef RTABMAP_LZ4
+		|| codec == kCompressionLZ4
+#endif
+#ifdef RTABMAP_ZSTD
+		|| codec == kCompressionZstd
+#endif
+		;
+}
+
+static CompressionCodec usableCodec(CompressionCodec codec)
+{
+	if(!isCompressionCodecAvailable(codec))
 	{
-		uLong sourceLen = uLong(data.total())*uLong(data.elemSize());
-		uLong destLen = compressBound(sourceLen);
-		bytes.resize(destLen);
+		UWARN("Compression codec %d is not available (RTAB-Map is not built with it), zlib is used instead.", (int)codec);
+		return kCompressionZlib;
+	}
+	return codec;
+}
+
+// Maximum size of the compressed data, including header and trailer
+static size_t compressedDataBound(size_t sourceLen, CompressionCodec codec)
+{
+	size_t bound = compressBound(uLong(sourceLen));
+#ifdef RTABMAP_LZ4
+	if(codec == kCompressionLZ4)
+	{
+		bound = 1 + LZ4_compressBound((int)sourceLen);
+	}
+#endif
+#ifdef RTABMAP_ZSTD
+	if(codec == kCompressionZstd)
+	{
+		bound = 1 + ZSTD_compressBound(sourceLen);
+	}
+#endif
+	return bound + 3*sizeof(int);
+}
+
+// Compressed data: [codec byte (not for zlib)][compressed data][rows][cols][type]
+// Returns the size written in bytes, 0 on error.
+static size_t compressDataTo(const cv::Mat & data, CompressionCodec codec, unsigned char * bytes, size_t size)
+{
+	UASSERT(data.isContinuous());
+	size_t sourceLen = data.total()*data.elemSize();
+	size_t destLen = 0;
+	size -= 3*sizeof(int);
+	if(codec == kCompressionZlib)
+	{
+		uLong zDestLen = uLong(size);
 		int errCode = compress(
-						(Bytef *)bytes.data(),
-						&destLen,
+						(Bytef *)bytes,
+						&zDestLen,
 						(const Bytef *)data.data,
-						sourceLen);
-
-		bytes.resize(destLen+3*sizeof(int));
-		*((int*)&bytes[destLen]) = data.rows;
-		*((int*)&bytes[destLen+sizeof(int)]) = data.cols;
-		*((int*)&bytes[destLen+2*sizeof(int)]) = data.type();
+						uLong(sourceLen));
+		destLen = zDestLen;
 
 		if(errCode == Z_MEM_ERROR)
 		{
@@ -195,35 +496,63 @@ std::vector<unsigned char> compressData(const cv::Mat & data)
 			UERROR("Z_BUF_ERROR : The buffer dest was not large enough to hold the uncompressed data.");
 		}
 	}
+#ifdef RTABMAP_LZ4
+	else if(codec == kCompressionLZ4)
+	{
+		bytes[0] = (unsigned char)kCompressionLZ4;
+		int compressedSize = LZ4_compress_default((const char *)data.data, (char *)bytes+1, (int)sourceLen, (int)size-1);
+		if(compressedSize <= 0)
+		{
+			UERROR("LZ4 : Compression failed (input size=%ld).", (long)sourceLen);
+			return 0;
+		}
+		destLen = 1 + compressedSize;
+	}
+#endif
+#ifdef RTABMAP_ZSTD
+	else if(codec == kCompressionZstd)
+	{
+		bytes[0] = (unsigned char)kCompressionZstd;
+		size_t compressedSize = ZSTD_compress(bytes+1, size-1, data.data, sourceLen, 3);
+		if(ZSTD_isError(compressedSize))
+		{
+			UERROR("ZSTD : %s", ZSTD_getErrorName(compressedSize));
+			return 0;
+		}
+		destLen = 1 + compressedSize;
+	}
+#endif
+	else
+	{
+		UFATAL("Compression codec %d not available.", (int)codec);
+	}
+
+	int trailer[3] = {data.rows, data.cols, data.type()};
+	memcpy(bytes+destLen, trailer, sizeof(trailer));
+	return destLen + sizeof(trailer);
+}
+
+std::vector<unsigned char> compressData(const cv::Mat & data, CompressionCodec codec)
+{
+	std::vector<unsigned char> bytes;
+	if(!data.empty())
+	{
+		codec = usableCodec(codec);
+		bytes.resize(compressedDataBound(data.total()*data.elemSize(), codec));
+		bytes.resize(compressDataTo(data, codec, bytes.data(), bytes.size()));
+	}
 	return bytes;
 }
 
-cv::Mat compressData2(const cv::Mat & data)
+cv::Mat compressData2(const cv::Mat & data, CompressionCodec codec)
 {
 	cv::Mat bytes;
 	if(!data.empty())
 	{
-		uLong sourceLen = uLong(data.total())*uLong(data.elemSize());
-		uLong destLen = compressBound(sourceLen);
-		bytes = cv::Mat(1, destLen+3*sizeof(int), CV_8UC1);
-		int errCode = compress(
-						(Bytef *)bytes.data,
-						&destLen,
-						(const Bytef *)data.data,
-						sourceLen);
-		bytes = cv::Mat(bytes, cv::Rect(0,0, destLen+3*sizeof(int), 1));
-		*((int*)&bytes.data[destLen]) = data.rows;
-		*((int*)&bytes.data[destLen+sizeof(int)]) = data.cols;
-		*((int*)&bytes.data[destLen+2*sizeof(int)]) = data.type();
-
-		if(errCode == Z_MEM_ERROR)
-		{
-			UERROR("Z_MEM_ERROR : Insufficient memory.");
-		}
-		else if(errCode == Z_BUF_ERROR)
-		{
-			UERROR("Z_BUF_ERROR : The buffer dest was not large enough to hold the uncompressed data.");
-		}
+		codec = usableCodec(codec);
+		bytes = cv::Mat(1, (int)compressedDataBound(data.total()*data.elemSize(), codec), CV_8UC1);
+		size_t size = compressDataTo(data, codec, bytes.data, bytes.cols);
+		bytes = size?cv::Mat(bytes, cv::Rect(0,0, (int)size, 1)):cv::Mat();
 	}
 	return bytes;
 }
@@ -245,13 +574,57 @@ cv::Mat uncompressData(const unsigned char * bytes, unsigned long size)
 	if(bytes && size>=3*sizeof(int))
 	{
 		//last 3 int elements are matrix size and type
-		int height = *((int*)&bytes[size-3*sizeof(int)]);
-		int width = *((int*)&bytes[size-2*sizeof(int)]);
-		int type = *((int*)&bytes[size-1*sizeof(int)]);
+		int height, width, type;
+		memcpy(&height, &bytes[size-3*sizeof(int)], sizeof(int));
+		memcpy(&width, &bytes[size-2*sizeof(int)], sizeof(int));
+		memcpy(&type, &bytes[size-1*sizeof(int)], sizeof(int));
 
 		data = cv::Mat(height, width, type);
-		uLongf totalUncompressed = uLongf(data.total())*uLongf(data.elemSize());
+		size_t dataSize = data.total()*data.elemSize();
+		unsigned long compressedSize = size - 3*sizeof(int);
+
+		// zlib streams start with 0x?8 (deflate method), other codecs start with their id
+		if(compressedSize && (bytes[0] & 0x0F) != 8)
+		{
+			bool success = false;
+			if(bytes[0] == kCompressionLZ4)
+			{
+#ifdef RTABMAP_LZ4
+				int uncompressedSize = LZ4_decompress_safe((const char *)bytes+1, (char *)data.data, (int)compressedSize-1, (int)dataSize);
+				success = uncompressedSize == (int)dataSize;
+				if(!success)
+				{
+					UERROR("LZ4 : The compressed data is corrupted.");
+				}
+#else
+				UERROR("Data is compressed with LZ4, but RTAB-Map is not built with LZ4 support.");
+#endif
+			}
+			else if(bytes[0] == kCompressionZstd)
+			{
+#ifdef RTABMAP_ZSTD
+				size_t uncompressedSize = ZSTD_decompress(data.data, dataSize, bytes+1, compressedSize-1);
+				success = !ZSTD_isError(uncompressedSize) && uncompressedSize == dataSize;
+				if(!success)
+				{
+					UERROR("ZSTD : %s", ZSTD_isError(uncompressedSize)?ZSTD_getErrorName(uncompressedSize):"The compressed data is corrupted.");
+				}
+#else
+				UERROR("Data is compressed with Zstandard, but RTAB-Map is not built with Zstandard support.");
+#endif
+			}
+			else
+			{
+				UERROR("Unknown compression codec (%d).", (int)bytes[0]);
+			}
+			if(!success)
+			{
+				data = cv::Mat();
+			}
+			return data;
+		}
 
+		uLongf totalUncompressed = uLongf(dataSize);
 		int errCode = uncompress(
 						(Bytef*)data.data,
 						&totalUncompressed,
@@ -26,10 +26,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "rtabmap/core/DBDriver.h"
+#include "rtabmap/core/Trace.h"
 
 #include "rtabmap/core/Signature.h"
 #include "rtabmap/core/VisualWord.h"
 #include "rtabmap/core/DBDriverSqlite3.h"
+#include "rtabmap/core/Compression.h"
 #include "rtabmap/utilite/UConversion.h"
 #include "rtabmap/utilite/UMath.h"
 #include "rtabmap/utilite/ULogger.h"
@@ -46,7 +48,9 @@ DBDriver * DBDriver::create(const ParametersMap & parameters)
 
 DBDriver::DBDriver(const ParametersMap & parameters) :
 	_emptyTrashesTime(0),
-	_timestampUpdate(true)
+	_timestampUpdate(true),
+	_compressionCodec(Parameters::defaultDbCompressionCodec()),
+	_compressionCodecsSupported(false)
 {
 	this->parseParameters(parameters);
 }
@@ -59,6 +63,12 @@ DBDriver::~DBDriver()
 
 void DBDriver::parseParameters(const ParametersMap & parameters)
 {
+	Parameters::parse(parameters, Parameters::kDbCompressionCodec(), _compressionCodec);
+	if(!isCompressionCodecAvailable((CompressionCodec)_compressionCodec))
+	{
+		UWARN("Compression codec %d is not available (RTAB-Map is not built with it), zlib is used instead.", _compressionCodec);
+		_compressionCodec = kCompressionZlib;
+	}
 }
 
 void DBDriver::closeConnection(bool save, const std::string & outputUrl)
@@ -79,10 +89,16 @@ void DBDriver::closeConnection(bool save, const std::string & outputUrl)
 	}
 	_dbSafeAccessMutex.lock();
 	this->disconnectDatabaseQuery(save, outputUrl);
+	_compressionCodecsSupported = false;
 	_dbSafeAccessMutex.unlock();
 	UDEBUG("");
 }
 
+int DBDriver::getCompressionCodec(int codec) const
+{
+	return _compressionCodecsSupported?codec:(int)kCompressionZlib;
+}
+
 bool DBDriver::openConnection(const std::string & url, bool overwritten)
 {
 	UDEBUG("");
@@ -90,6 +106,9 @@ bool DBDriver::openConnection(const std::string & url, bool overwritten)
 	_dbSafeAccessMutex.lock();
 	if(this->connectDatabaseQuery(url, overwritten))
 	{
+		std::string version;
+		getDatabaseVersionQuery(version);
+		_compressionCodecsSupported = uStrNumCmp(version, "0.20.0") >= 0;
 		_dbSafeAccessMutex.unlock();
 		return true;
 	}
@@ -283,6 +302,7 @@ std::string DBDriver::getDatabaseVersion() const
 
 void DBDriver::mainLoop()
 {
+	RTABMAP_TRACE_THREAD_NAME("DBDriver trash");
 	this->emptyTrashes();
 	this->kill(); // Do it only once
 }
@@ -317,6 +337,7 @@ void DBDriver::emptyTrashes(bool async)
 		return;
 	}
 
+	RTABMAP_TRACE_SCOPE("DBDriver::emptyTrashes");
 	UTimer totalTime;
 	totalTime.start();
 
@@ -406,6 +427,7 @@ void DBDriver::asyncSave(VisualWord * vw)
 
 void DBDriver::saveOrUpdate(const std::vector<Signature *> & signatures)
 {
+	RTABMAP_TRACE_SCOPE("DBDriver::saveOrUpdate");
 	ULOGGER_DEBUG("");
 	std::list<Signature *> toSave;
 	std::list<Signature *> toUpdate;
@@ -491,7 +513,7 @@ void DBDriver::updateOccupancyGrid(
 	_dbSafeAccessMutex.lock();
 	//just to make sure the occupancy grids are compressed for convenience
 	SensorData data;
-	data.setOccupancyGrid(ground, obstacles, empty, cellSize, viewpoint);
+	data.setOccupancyGrid(ground, obstacles, empty, cellSize, viewpoint, getCompressionCodec());
 	this->updateOccupancyGridQuery(
 			nodeId,
 			data.gridGroundCellsCompressed(),
@@ -538,6 +560,7 @@ void DBDriver::loadSignatures(const std::list<int> & signIds,
 		std::list<Signature *> & signatures,
 		std::set<int> * loadedFromTrash)
 {
+	RTABMAP_TRACE_SCOPE("DBDriver::loadSignatures");
 	UDEBUG("");
 	// look up in the trash before the database
 	std::list<int> ids = signIds;
@@ -630,6 +653,7 @@ void DBDriver::loadWords(const std::set<int> & wordIds, std::list<VisualWord *>
 
 void DBDriver::loadNodeData(std::list<Signature *> & signatures, bool images, bool scan, bool userData, bool occupancyGrid) const
 {
+	RTABMAP_TRACE_SCOPE("DBDriver::loadNodeData");
 	// Don't look in the trash, we assume that if we want to load
 	// data of a signature, it is not in thrash! Print an error if so.
 	_trashesMutex.lock();
@@ -49,7 +49,8 @@ DBDriverSqlite3::DBDriverSqlite3(const ParametersMap & parameters) :
 	_cacheSize(Parameters::defaultDbSqlite3CacheSize()),
 	_journalMode(Parameters::defaultDbSqlite3JournalMode()),
 	_synchronous(Parameters::defaultDbSqlite3Synchronous()),
-	_tempStore(Parameters::defaultDbSqlite3TempStore())
+	_tempStore(Parameters::defaultDbSqlite3TempStore()),
+	_statisticsNamesLoaded(false)
 {
 	ULOGGER_DEBUG("treadSafe=%d", sqlite3_threadsafe());
 	this->parseParameters(parameters);
@@ -453,6 +454,10 @@ void DBDriverSqlite3::disconnectDatabaseQuery(bool save, const std::string & out
 		UINFO("Disconnecting database %s...", this->getUrl().c_str());
 		sqlite3_close(_ppDb);
 		_ppDb = 0;
+		_statisticsNamesLoaded = false;
+		_statisticsNames.clear();
+		_statisticsNameIds.clear();
+		_statisticsDbIds.clear();
 
 		if(save && !_dbInMemory && !outputUrl.empty() && !this->getUrl().empty() && outputUrl.compare(this->getUrl()) != 0)
 		{
@@ -884,7 +889,12 @@ long DBDriverSqlite3::getStatisticsMemoryUsedQuery() const
 	if(_ppDb)
 	{
 		std::string query;
-		if(uStrNumCmp(_version, "0.16.2") >= 0)
+		if(uStrNumCmp(_version, "0.20.0") >= 0)
+		{
+			query = "SELECT sum(length(id) + length(stamp) + ifnull(length(data),0) + ifnull(length(wm_state),0)) + "
+					"(SELECT ifnull(sum(length(id) + length(name)),0) FROM StatisticsName) FROM Statistics;";
+		}
+		else if(uStrNumCmp(_version, "0.16.2") >= 0)
 		{
 			query = "SELECT sum(length(id) + length(stamp) + ifnull(length(data),0) + ifnull(length(wm_state),0)) FROM Statistics;";
 		}
@@ -1105,24 +1115,34 @@ std::map<std::string, float> DBDriverSqlite3::getStatisticsQuery(int nodeId, dou
 				int index = 0;
 				stamp = sqlite3_column_double(ppStmt, index++);
 
-				std::string text;
 				if(uStrNumCmp(this->getDatabaseVersion(), "0.15.0") >= 0)
 				{
 					const void * dataPtr = sqlite3_column_blob(ppStmt, index);
 					int dataSize = sqlite3_column_bytes(ppStmt, index++);
 					if(dataSize>0 && dataPtr)
 					{
-						text = uncompressString(cv::Mat(1, dataSize, CV_8UC1, (void *)dataPtr));
+						cv::Mat dataMat = uncompressData(cv::Mat(1, dataSize, CV_8UC1, (void *)dataPtr));
+						if(uStrNumCmp(this->getDatabaseVersion(), "0.20.0") >= 0)
+						{
+							// binary format
+							UASSERT(dataMat.type() == CV_8UC1 && dataMat.rows == 1);
+							data = statisticsFromBinary(dataMat);
+						}
+						else if(!dataMat.empty())
+						{
+							// text format
+							UASSERT(dataMat.type() == CV_8SC1 && dataMat.rows == 1);
+							data = Statistics::deserializeData((const char *)dataMat.data);
+						}
 					}
 				}
 				else
 				{
-					text = (const char *)sqlite3_column_text(ppStmt, index++);
-				}
-
-				if(text.size())
-				{
-					data = Statistics::deserializeData(text);
+					std::string text = (const char *)sqlite3_column_text(ppStmt, index++);
+					if(text.size())
+					{
+						data = Statistics::deserializeData(text);
+					}
 				}
 
 				if(uStrNumCmp(_version, "0.16.2") >= 0 && wmState)
@@ -1172,7 +1192,7 @@ std::map<int, std::pair<std::map<std::string, float>, double> > DBDriverSqlite3:
 				int id = sqlite3_column_int(ppStmt, index++);
 				double stamp = sqlite3_column_double(ppStmt, index++);
 
-				std::string text;
+				std::map<std::string, float> statistics;
 				if(uStrNumCmp(this->getDatabaseVersion(), "0.15.0") >= 0)
 				{
 					const void * dataPtr = 0;
@@ -1181,17 +1201,33 @@ std::map<int, std::pair<std::map<std::string, float>, double> > DBDriverSqlite3:
 					dataSize = sqlite3_column_bytes(ppStmt, index++);
 					if(dataSize>0 && dataPtr)
 					{
-						text = uncompressString(cv::Mat(1, dataSize, CV_8UC1, (void *)dataPtr));
+						cv::Mat dataMat = uncompressData(cv::Mat(1, dataSize, CV_8UC1, (void *)dataPtr));
+						if(uStrNumCmp(this->getDatabaseVersion(), "0.20.0") >= 0)
+						{
+							// binary format
+							UASSERT(dataMat.type() == CV_8UC1 && dataMat.rows == 1);
+							statistics = statisticsFromBinary(dataMat);
+						}
+						else if(!dataMat.empty())
+						{
+							// text format
+							UASSERT(dataMat.type() == CV_8SC1 && dataMat.rows == 1);
+							statistics = Statistics::deserializeData((const char *)dataMat.data);
+						}
 					}
 				}
 				else
 				{
-					text = (const char *)sqlite3_column_text(ppStmt, index++);
+					std::string text = (const char *)sqlite3_column_text(ppStmt, index++);
+					if(text.size())
+					{
+						statistics = Statistics::deserializeData(text);
+					}
 				}
 
-				if(text.size())
+				if(statistics.size())
 				{
-					data.insert(std::make_pair(id, std::make_pair(Statistics::deserializeData(text), stamp)));
+					data.insert(std::make_pair(id, std::make_pair(statistics, stamp)));
 				}
 
 				rc = sqlite3_step(ppStmt);
@@ -4522,8 +4558,65 @@ void DBDriverSqlite3::addStatisticsQuery(const Statistics & statistics) const
 		// Create query
 		if(uStrNumCmp(this->getDatabaseVersion(), "0.11.11") >= 0)
 		{
-			std::string param = Statistics::serializeData(statistics.data());
-			if(param.size() && statistics.refImageId()>0)
+			// Binary format (ids of StatisticsName table then float values) from 0.20.0, text format for older databases
+			std::string param;
+			cv::Mat binaryParam;
+			if(uStrNumCmp(this->getDatabaseVersion(), "0.20.0") >= 0)
+			{
+				loadStatisticsNamesQuery();
+				std::vector<std::pair<int, float> > values;
+				statistics.getValues(values);
+				std::list<std::pair<int, std::string> > newNames;
+				for(unsigned int i=0; i<values.size(); ++i)
+				{
+					int statisticId = values[i].first;
+					if(statisticId >= (int)_statisticsDbIds.size())
+					{
+						_statisticsDbIds.resize(statisticId+1, 0);
+					}
+					if(_statisticsDbIds[statisticId] == 0)
+					{
+						std::string name = Statistics::statisticName(statisticId);
+						std::map<std::string, int>::iterator iter = _statisticsNameIds.find(name);
+						if(iter == _statisticsNameIds.end())
+						{
+							int dbId = _statisticsNames.empty()?1:_statisticsNames.rbegin()->first+1;
+							iter = _statisticsNameIds.insert(std::make_pair(name, dbId)).first;
+							_statisticsNames.insert(std::make_pair(dbId, name));
+							newNames.push_back(std::make_pair(dbId, name));
+						}
+						_statisticsDbIds[statisticId] = iter->second;
+					}
+					values[i].first = _statisticsDbIds[statisticId];
+				}
+
+				if(newNames.size())
+				{
+					rc = sqlite3_prepare_v2(_ppDb, "INSERT INTO StatisticsName(id, name) values(?,?);", -1, &ppStmt, 0);
+					UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+					for(std::list<std::pair<int, std::string> >::iterator iter=newNames.begin(); iter!=newNames.end(); ++iter)
+					{
+						rc = sqlite3_bind_int(ppStmt, 1, iter->first);
+						UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+						rc = sqlite3_bind_text(ppStmt, 2, iter->second.c_str(), -1, SQLITE_STATIC);
+						UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+						rc=sqlite3_step(ppStmt);
+						UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+						rc = sqlite3_reset(ppStmt);
+						UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+					}
+					rc = sqlite3_finalize(ppStmt);
+					UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+					ppStmt = 0;
+					UDEBUG("Added %d statistic names", (int)newNames.size());
+				}
+				binaryParam = Statistics::serializeDataBinary(values);
+			}
+			else
+			{
+				param = Statistics::serializeData(statistics.data());
+			}
+			if((param.size() || binaryParam.cols > (int)sizeof(int)) && statistics.refImageId()>0)
 			{
 				std::string query;
 				if(uStrNumCmp(this->getDatabaseVersion(), "0.16.2") >= 0)
@@ -4544,8 +4637,15 @@ void DBDriverSqlite3::addStatisticsQuery(const Statistics & statistics) const
 				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
 
 				cv::Mat compressedParam;
-				if(uStrNumCmp(this->getDatabaseVersion(), "0.15.0") >= 0)
+				if(uStrNumCmp(this->getDatabaseVersion(), "0.20.0") >= 0)
+				{
+					compressedParam = compressData2(binaryParam, (CompressionCodec)getCompressionCodec());
+					rc = sqlite3_bind_blob(ppStmt, index++, compressedParam.data, compressedParam.cols, SQLITE_STATIC);
+					UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+				}
+				else if(uStrNumCmp(this->getDatabaseVersion(), "0.15.0") >= 0)
 				{
+					// keep zlib so that older rtabmap versions can read it back
 					compressedParam = compressString(param);
 					rc = sqlite3_bind_blob(ppStmt, index++, compressedParam.data, compressedParam.cols, SQLITE_STATIC);
 					UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
@@ -4561,7 +4661,7 @@ void DBDriverSqlite3::addStatisticsQuery(const Statistics & statistics) const
 				{
 					if(!statistics.wmState().empty())
 					{
-						compressedWmState = compressData2(cv::Mat(1, statistics.wmState().size(), CV_32SC1, (void *)statistics.wmState().data()));
+						compressedWmState = compressData2(cv::Mat(1, statistics.wmState().size(), CV_32SC1, (void *)statistics.wmState().data()), (CompressionCodec)getCompressionCodec());
 						rc = sqlite3_bind_blob(ppStmt, index++, compressedWmState.data, compressedWmState.cols, SQLITE_STATIC);
 						UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
 					}
@@ -4589,6 +4689,52 @@ void DBDriverSqlite3::addStatisticsQuery(const Statistics & statistics) const
 	}
 }
 
+void DBDriverSqlite3::loadStatisticsNamesQuery() const
+{
+	if(_ppDb && !_statisticsNamesLoaded && uStrNumCmp(_version, "0.20.0") >= 0)
+	{
+		UTimer timer;
+		int rc = SQLITE_OK;
+		sqlite3_stmt * ppStmt = 0;
+		rc = sqlite3_prepare_v2(_ppDb, "SELECT id, name FROM StatisticsName;", -1, &ppStmt, 0);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+		rc = sqlite3_step(ppStmt);
+		while(rc == SQLITE_ROW)
+		{
+			int id = sqlite3_column_int(ppStmt, 0);
+			std::string name = (const char *)sqlite3_column_text(ppStmt, 1);
+			_statisticsNames.insert(std::make_pair(id, name));
+			_statisticsNameIds.insert(std::make_pair(name, id));
+			rc = sqlite3_step(ppStmt);
+		}
+		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+		rc = sqlite3_finalize(ppStmt);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+		_statisticsNamesLoaded = true;
+		UDEBUG("Loaded %d statistic names (%fs)", (int)_statisticsNames.size(), timer.ticks());
+	}
+}
+
+std::map<std::string, float> DBDriverSqlite3::statisticsFromBinary(const cv::Mat & data) const
+{
+	loadStatisticsNamesQuery();
+	std::map<std::string, float> statistics;
+	std::vector<std::pair<int, float> > values = Statistics::deserializeDataBinary(data);
+	for(unsigned int i=0; i<values.size(); ++i)
+	{
+		std::map<int, std::string>::const_iterator iter = _statisticsNames.find(values[i].first);
+		if(iter != _statisticsNames.end())
+		{
+			statistics.insert(std::make_pair(iter->second, values[i].second));
+		}
+		else
+		{
+			UERROR("Statistic id %d not found in StatisticsName table", values[i].first);
+		}
+	}
+	return statistics;
+}
+
 void DBDriverSqlite3::savePreviewImageQuery(const cv::Mat & image) const
 {
 	UDEBUG("");
@@ -4730,8 +4876,8 @@ void DBDriverSqlite3::saveOptimizedPosesQuery(const std::map<int, Transform> & p
 				++i;
 			}
 
-			compressedIds = compressData2(cv::Mat(1,serializedIds.size(), CV_32SC1, serializedIds.data()));
-			compressedPoses = compressData2(cv::Mat(1,serializedPoses.size(), CV_32FC1, serializedPoses.data()));
+			compressedIds = compressData2(cv::Mat(1,serializedIds.size(), CV_32SC1, serializedIds.data()), (CompressionCodec)getCompressionCodec());
+			compressedPoses = compressData2(cv::Mat(1,serializedPoses.size(), CV_32FC1, serializedPoses.data()), (CompressionCodec)getCompressionCodec());
 
 			rc = sqlite3_bind_blob(ppStmt, index++, compressedIds.data, compressedIds.cols, SQLITE_STATIC);
 			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
@@ -4873,7 +5019,7 @@ void DBDriverSqlite3::save2DMapQuery(const cv::Mat & map, float xMin, float yMin
 		}
 		else
 		{
-			compressedMap = compressData2(map);
+			compressedMap = compressData2(map, (CompressionCodec)getCompressionCodec());
 
 			rc = sqlite3_bind_blob(ppStmt, index++, compressedMap.data, compressedMap.cols, SQLITE_STATIC);
 			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
@@ -5007,7 +5153,7 @@ void DBDriverSqlite3::saveOptimizedMeshQuery(
 			else
 			{
 				UDEBUG("Cloud points=%d", cloud.cols);
-				compressedCloud	= compressData2(cloud);
+				compressedCloud	= compressData2(cloud, (CompressionCodec)getCompressionCodec());
 			}
 			UDEBUG("Cloud compressed bytes=%d", compressedCloud.cols);
 			rc = sqlite3_bind_blob(ppStmt, index++, compressedCloud.data, compressedCloud.cols, SQLITE_STATIC);
@@ -5098,7 +5244,7 @@ void DBDriverSqlite3::saveOptimizedMeshQuery(
 				}
 
 				UDEBUG("serializedPolygons=%d", (int)serializedPolygons.size());
-				compressedPolygons = compressData2(cv::Mat(1,serializedPolygons.size(), CV_32SC1, serializedPolygons.data()));
+				compressedPolygons = compressData2(cv::Mat(1,serializedPolygons.size(), CV_32SC1, serializedPolygons.data()), (CompressionCodec)getCompressionCodec());
 
 				// polygon size
 				rc = sqlite3_bind_int(ppStmt, index++, polygonSize);
@@ -5120,7 +5266,7 @@ void DBDriverSqlite3::saveOptimizedMeshQuery(
 				else
 				{
 					UDEBUG("serializedTexCoords=%d", (int)serializedTexCoords.size());
-					compressedTexCoords = compressData2(cv::Mat(1,serializedTexCoords.size(), CV_32FC1, serializedTexCoords.data()));
+					compressedTexCoords = compressData2(cv::Mat(1,serializedTexCoords.size(), CV_32FC1, serializedTexCoords.data()), (CompressionCodec)getCompressionCodec());
 					rc = sqlite3_bind_blob(ppStmt, index++, compressedTexCoords.data, compressedTexCoords.cols, SQLITE_STATIC);
 					UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
 
@@ -5755,7 +5901,7 @@ void DBDriverSqlite3::stepScanUpdate(sqlite3_stmt * ppStmt, int nodeId, const La
 	}
 	else
 	{
-		scanCompressed = compressData2(scan.data());
+		scanCompressed = compressData2(scan.data(), (CompressionCodec)getCompressionCodec());
 	}
 	if(!scanCompressed.empty())
 	{
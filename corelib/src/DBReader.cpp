@@ -33,6 +33,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UStl.h>
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UEventsManager.h>
+#include <rtabmap/utilite/UThread.h>
+#include <rtabmap/utilite/UMutex.h>
+#include <rtabmap/utilite/USemaphore.h>
+
+#include <algorithm>
+#include <exception>
 
 #include "rtabmap/core/CameraEvent.h"
 #include "rtabmap/core/RtabmapEvent.h"
@@ -42,6 +48,178 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace rtabmap {
 
+/**
+ * Loads the next nodes in batched queries and decompresses their
+ * data with the compression thread pool, up to "window" nodes
+ * ahead of the consumer. A null signature marks the end of the nodes.
+ * An exception thrown while loading ends the nodes and is rethrown by take().
+ */
+class DBReader::ReadAheadThread : public UThread
+{
+public:
+	ReadAheadThread(DBDriver * driver, const std::list<int> & ids, int window) :
+		driver_(driver),
+		ids_(ids),
+		window_(window),
+		batch_(window>1?window/2:1),
+		free_(window),
+		loaded_(0),
+		loadingTime_(0.0)
+	{
+		UASSERT(driver_ != 0 && window_ > 0);
+	}
+	virtual ~ReadAheadThread()
+	{
+		join(true);
+		for(std::list<Signature*>::iterator iter=queue_.begin(); iter!=queue_.end(); ++iter)
+		{
+			delete *iter;
+		}
+	}
+
+	// Blocking, the caller takes ownership of the signature (null when there are no more nodes).
+	Signature * take()
+	{
+		ready_.acquire();
+		UScopeMutex lock(mutex_);
+		UASSERT(!queue_.empty());
+		Signature * s = queue_.front();
+		if(s == 0)
+		{
+			// keep the end marker for the next calls
+			ready_.release();
+			if(exception_)
+			{
+				std::exception_ptr exception = exception_;
+				exception_ = std::exception_ptr();
+				std::rethrow_exception(exception);
+			}
+		}
+		else
+		{
+			queue_.pop_front();
+			free_.release();
+		}
+		return s;
+	}
+
+	int size() const
+	{
+		UScopeMutex lock(mutex_);
+		return queue_.empty() || queue_.back() != 0?(int)queue_.size():(int)queue_.size()-1;
+	}
+
+	float frameRate() const
+	{
+		UScopeMutex lock(mutex_);
+		return loadingTime_>0.0?float(double(loaded_)/loadingTime_):0.0f;
+	}
+
+private:
+	virtual void mainLoop()
+	{
+		if(ids_.empty())
+		{
+			mutex_.lock();
+			queue_.push_back(0);
+			mutex_.unlock();
+			ready_.release();
+			this->kill();
+			return;
+		}
+
+		int n = std::min(batch_, (int)ids_.size());
+		free_.acquire(n);
+		if(this->isKilled())
+		{
+			return;
+		}
+
+		UTimer timer;
+		std::list<int> ids;
+		for(int i=0; i<n; ++i)
+		{
+			ids.push_back(ids_.front());
+			ids_.pop_front();
+		}
+		std::list<Signature *> signatures;
+		std::map<int, Signature*> loaded;
+		try
+		{
+			driver_->loadSignatures(ids, signatures);
+			driver_->loadNodeData(signatures);
+			std::vector<SensorData*> data;
+			data.reserve(signatures.size());
+			for(std::list<Signature *>::iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
+			{
+				data.push_back(&(*iter)->sensorData());
+				loaded.insert(std::make_pair((*iter)->id(), *iter));
+			}
+			SensorData::uncompressData(data);
+		}
+		catch(...)
+		{
+			for(std::list<Signature *>::iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
+			{
+				delete *iter;
+			}
+			mutex_.lock();
+			exception_ = std::current_exception();
+			queue_.push_back(0);
+			mutex_.unlock();
+			ready_.release();
+			this->kill();
+			return;
+		}
+
+		// keep the ids order, stop at the first node not found
+		std::list<Signature *> batch;
+		for(std::list<int>::iterator iter=ids.begin(); iter!=ids.end(); ++iter)
+		{
+			std::map<int, Signature*>::iterator jter = loaded.find(*iter);
+			if(jter == loaded.end())
+			{
+				UWARN("Node %d not found in the database, stopping read-ahead.", *iter);
+				ids_.clear();
+				break;
+			}
+			batch.push_back(jter->second);
+			loaded.erase(jter);
+		}
+		for(std::map<int, Signature*>::iterator iter=loaded.begin(); iter!=loaded.end(); ++iter)
+		{
+			delete iter->second;
+		}
+		free_.release(n - (int)batch.size());
+
+		double time = timer.ticks();
+		mutex_.lock();
+		queue_.insert(queue_.end(), batch.begin(), batch.end());
+		loaded_ += (int)batch.size();
+		loadingTime_ += time;
+		mutex_.unlock();
+		ready_.release((int)batch.size());
+		UDEBUG("Loaded %d nodes in %fs (%d ready)", (int)batch.size(), time, size());
+	}
+	virtual void mainLoopKill()
+	{
+		free_.release(window_);
+	}
+
+private:
+	DBDriver * driver_;
+	std::list<int> ids_;
+	int window_;
+	int batch_;
+	USemaphore free_;
+	USemaphore ready_;
+	UMutex mutex_;
+	std::list<Signature *> queue_;
+	std::exception_ptr exception_;
+	int loaded_;
+	double loadingTime_;
+};
+
 DBReader::DBReader(const std::string & databasePath,
 				   float frameRate,
 				   bool odometryIgnored,
@@ -58,7 +236,9 @@ DBReader::DBReader(const std::string & databasePath,
 	_startIndex(startIndex),
 	_maxFrames(maxFrames),
 	_cameraIndex(cameraIndex),
+	_readAhead(0),
 	_dbDriver(0),
+	_readAheadThread(0),
 	_currentId(_ids.end()),
 	_previousMapId(-1),
 	_previousStamp(0),
@@ -84,7 +264,9 @@ DBReader::DBReader(const std::list<std::string> & databasePaths,
 	_startIndex(startIndex),
 	_maxFrames(maxFrames),
 	_cameraIndex(cameraIndex),
+	_readAhead(0),
 	_dbDriver(0),
+	_readAheadThread(0),
 	_currentId(_ids.end()),
 	_previousMapId(-1),
 	_previousStamp(0),
@@ -96,6 +278,7 @@ DBReader::DBReader(const std::list<std::string> & databasePaths,
 
 DBReader::~DBReader()
 {
+	delete _readAheadThread;
 	if(_dbDriver)
 	{
 		_dbDriver->closeConnection();
@@ -107,6 +290,8 @@ bool DBReader::init(
 		const std::string & calibrationFolder,
 		const std::string & cameraName)
 {
+	delete _readAheadThread;
+	_readAheadThread = 0;
 	if(_dbDriver)
 	{
 		_dbDriver->closeConnection();
@@ -202,6 +387,20 @@ bool DBReader::init(
 		_calibrated = true; // database is empty, make sure calibration warning is not shown.
 	}
 
+	if(_readAhead > 0 && _currentId != _ids.end())
+	{
+		std::list<int> ids;
+		for(std::set<int>::iterator iter=_currentId;
+			iter!=_ids.end() && (_maxFrames<=0 || (int)ids.size()<_maxFrames);
+			++iter)
+		{
+			ids.push_back(*iter);
+		}
+		UINFO("Reading ahead %d nodes (%d to load)", _readAhead, (int)ids.size());
+		_readAheadThread = new ReadAheadThread(_dbDriver, ids, _readAhead);
+		_readAheadThread->start();
+	}
+
 	_timer.start();
 
 	return true;
@@ -217,6 +416,16 @@ std::string DBReader::getSerial() const
 	return "DBReader";
 }
 
+int DBReader::getReadAheadQueueSize() const
+{
+	return _readAheadThread?_readAheadThread->size():0;
+}
+
+float DBReader::getReadAheadFrameRate() const
+{
+	return _readAheadThread?_readAheadThread->frameRate():0.0f;
+}
+
 SensorData DBReader::captureImage(CameraInfo * info)
 {
 	if(_maxFrames>0 && ++_framesPublished > _maxFrames)
@@ -320,6 +529,19 @@ SensorData DBReader::captureImage(CameraInfo * info)
 	return data;
 }
 
+static std::multimap<int, Link> linksOfType(const std::multimap<int, Link> & links, Link::Type type)
+{
+	std::multimap<int, Link> output;
+	for(std::multimap<int, Link>::const_iterator iter=links.begin(); iter!=links.end(); ++iter)
+	{
+		if(iter->second.type() == type)
+		{
+			output.insert(*iter);
+		}
+	}
+	return output;
+}
+
 SensorData DBReader::getNextData(CameraInfo * info)
 {
 	SensorData data;
@@ -327,16 +549,30 @@ SensorData DBReader::getNextData(CameraInfo * info)
 	{
 		if(_currentId != _ids.end())
 		{
-			std::list<int> signIds;
-			signIds.push_back(*_currentId);
-			std::list<Signature *> signatures;
-			_dbDriver->loadSignatures(signIds, signatures);
-			if(signatures.empty())
+			Signature * s = 0;
+			if(_readAheadThread)
 			{
-				return data;
+				s = _readAheadThread->take();
+				if(s == 0)
+				{
+					return data;
+				}
+				UASSERT(s->id() == *_currentId);
+				UDEBUG("Read-ahead: %d/%d nodes ready, %f nodes/s", _readAheadThread->size(), _readAhead, _readAheadThread->frameRate());
+			}
+			else
+			{
+				std::list<int> signIds;
+				signIds.push_back(*_currentId);
+				std::list<Signature *> signatures;
+				_dbDriver->loadSignatures(signIds, signatures);
+				if(signatures.empty())
+				{
+					return data;
+				}
+				_dbDriver->loadNodeData(signatures);
+				s = signatures.front();
 			}
-			_dbDriver->loadNodeData(signatures);
-			Signature * s  = signatures.front();
 			data = s->sensorData();
 
 			// info
@@ -344,8 +580,8 @@ SensorData DBReader::getNextData(CameraInfo * info)
 			Transform globalPose;
 			cv::Mat globalPoseCov;
 
-			std::multimap<int, Link> priorLinks;
-			_dbDriver->loadLinks(*_currentId, priorLinks, Link::kPosePrior);
+			// links are already loaded with the signature
+			std::multimap<int, Link> priorLinks = linksOfType(s->getLinks(), Link::kPosePrior);
 			if( priorLinks.size() &&
 				!priorLinks.begin()->second.transform().isNull() &&
 				priorLinks.begin()->second.infMatrix().cols == 6 &&
@@ -364,8 +600,7 @@ SensorData DBReader::getNextData(CameraInfo * info)
 			}
 
 			Transform gravityTransform;
-			std::multimap<int, Link> gravityLinks;
-			_dbDriver->loadLinks(*_currentId, gravityLinks, Link::kGravity);
+			std::multimap<int, Link> gravityLinks = linksOfType(s->getLinks(), Link::kGravity);
 			if( gravityLinks.size() &&
 				!gravityLinks.begin()->second.transform().isNull() &&
 				gravityLinks.begin()->second.infMatrix().cols == 6 &&
@@ -377,8 +612,7 @@ SensorData DBReader::getNextData(CameraInfo * info)
 			cv::Mat infMatrix = cv::Mat::eye(6,6,CV_64FC1);
 			if(!_odometryIgnored)
 			{
-				std::multimap<int, Link> links;
-				_dbDriver->loadLinks(*_currentId, links, Link::kNeighbor);
+				std::multimap<int, Link> links = linksOfType(s->getLinks(), Link::kNeighbor);
 				if(links.size() && links.begin()->first < *_currentId)
 				{
 					// assume the first is the backward neighbor, take its variance
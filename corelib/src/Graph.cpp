@@ -34,6 +34,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UFile.h>
 #include <rtabmap/core/GeodeticCoords.h>
 #include <rtabmap/core/Memory.h>
+#include <rtabmap/core/PosesIndex.h>
 #include <rtabmap/core/util3d_filtering.h>
 #include <rtabmap/core/util3d_registration.h>
 #include <pcl/search/kdtree.h>
@@ -42,6 +43,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <set>
 #include <queue>
 #include <fstream>
+#include <algorithm>
 
 #include <rtabmap/core/optimizer/OptimizerTORO.h>
 #include <rtabmap/core/optimizer/OptimizerG2O.h>
@@ -1227,53 +1229,40 @@ std::map<int, Transform> radiusPosesFiltering(
 {
 	if(poses.size() > 2 && radius > 0.0f)
 	{
-		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-		cloud->resize(poses.size());
-		int i=0;
-		for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter, ++i)
-		{
-			(*cloud)[i] = pcl::PointXYZ(iter->second.x(), iter->second.y(), iter->second.z());
-			UASSERT_MSG(pcl::isFinite((*cloud)[i]), uFormat("Invalid pose (%d) %s", iter->first, iter->second.prettyPrint().c_str()).c_str());
-		}
+		PosesIndex index(radius);
+		index.update(poses);
 
 		// radius filtering
-		std::vector<int> names = uKeys(poses);
-		std::vector<Transform> transforms = uValues(poses);
-
-		pcl::search::KdTree<pcl::PointXYZ>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZ> (false));
-		tree->setInputCloud(cloud);
-		std::set<int> indicesChecked;
-		std::set<int> indicesKept;
+		std::set<int> idsChecked;
+		std::set<int> idsKept;
 
-		for(unsigned int i=0; i<cloud->size(); ++i)
+		for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
 		{
-			if(indicesChecked.find(i) == indicesChecked.end())
+			if(idsChecked.find(iter->first) == idsChecked.end())
 			{
-				std::vector<int> kIndices;
-				std::vector<float> kDistances;
-				tree->radiusSearch(cloud->at(i), radius, kIndices, kDistances);
+				const Transform & currentT = iter->second;
+				std::map<int, float> neighbors = index.radiusSearch(cv::Point3f(currentT.x(), currentT.y(), currentT.z()), radius);
 
-				std::set<int> cloudIndices;
-				const Transform & currentT = transforms.at(i);
+				std::set<int> cloudIds;
 				Eigen::Vector3f vA = currentT.toEigen3f().linear()*Eigen::Vector3f(1,0,0);
-				for(unsigned int j=0; j<kIndices.size(); ++j)
+				for(std::map<int, float>::iterator jter=neighbors.begin(); jter!=neighbors.end(); ++jter)
 				{
-					if(indicesChecked.find(kIndices[j]) == indicesChecked.end())
+					if(idsChecked.find(jter->first) == idsChecked.end())
 					{
 						if(angle > 0.0f)
 						{
-							const Transform & checkT = transforms.at(kIndices[j]);
+							const Transform & checkT = index.pose(jter->first);
 							// same orientation?
 							Eigen::Vector3f vB = checkT.toEigen3f().linear()*Eigen::Vector3f(1,0,0);
 							double a = pcl::getAngle3D(Eigen::Vector4f(vA[0], vA[1], vA[2], 0), Eigen::Vector4f(vB[0], vB[1], vB[2], 0));
 							if(a <= angle)
 							{
-								cloudIndices.insert(kIndices[j]);
+								cloudIds.insert(jter->first);
 							}
 						}
 						else
 						{
-							cloudIndices.insert(kIndices[j]);
+							cloudIds.insert(jter->first);
 						}
 					}
 				}
@@ -1281,42 +1270,38 @@ std::map<int, Transform> radiusPosesFiltering(
 				if(keepLatest)
 				{
 					bool lastAdded = false;
-					for(std::set<int>::reverse_iterator iter = cloudIndices.rbegin(); iter!=cloudIndices.rend(); ++iter)
+					for(std::set<int>::reverse_iterator jter = cloudIds.rbegin(); jter!=cloudIds.rend(); ++jter)
 					{
 						if(!lastAdded)
 						{
-							indicesKept.insert(*iter);
+							idsKept.insert(*jter);
 							lastAdded = true;
 						}
-						indicesChecked.insert(*iter);
+						idsChecked.insert(*jter);
 					}
 				}
 				else
 				{
 					bool firstAdded = false;
-					for(std::set<int>::iterator iter = cloudIndices.begin(); iter!=cloudIndices.end(); ++iter)
+					for(std::set<int>::iterator jter = cloudIds.begin(); jter!=cloudIds.end(); ++jter)
 					{
 						if(!firstAdded)
 						{
-							indicesKept.insert(*iter);
+							idsKept.insert(*jter);
 							firstAdded = true;
 						}
-						indicesChecked.insert(*iter);
+						idsChecked.insert(*jter);
 					}
 				}
 			}
 		}
 
-		//pcl::IndicesPtr indicesOut(new std::vector<int>);
-		//indicesOut->insert(indicesOut->end(), indicesKept.begin(), indicesKept.end());
-		UINFO("Cloud filtered In = %d, Out = %d", cloud->size(), indicesKept.size());
-		//pcl::io::savePCDFile("duplicateIn.pcd", *cloud);
-		//pcl::io::savePCDFile("duplicateOut.pcd", *cloud, *indicesOut);
+		UINFO("Cloud filtered In = %d, Out = %d", (int)poses.size(), (int)idsKept.size());
 
 		std::map<int, Transform> keptPoses;
-		for(std::set<int>::iterator iter = indicesKept.begin(); iter!=indicesKept.end(); ++iter)
+		for(std::set<int>::iterator iter = idsKept.begin(); iter!=idsKept.end(); ++iter)
 		{
-			keptPoses.insert(std::make_pair(names.at(*iter), transforms.at(*iter)));
+			keptPoses.insert(keptPoses.end(), std::make_pair(*iter, poses.at(*iter)));
 		}
 
 		// make sure the first and last poses are still here
@@ -1336,49 +1321,34 @@ std::multimap<int, int> radiusPosesClustering(const std::map<int, Transform> & p
 	std::multimap<int, int> clusters;
 	if(poses.size() > 1 && radius > 0.0f)
 	{
-		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-		cloud->resize(poses.size());
-		int i=0;
-		for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter, ++i)
-		{
-			(*cloud)[i] = pcl::PointXYZ(iter->second.x(), iter->second.y(), iter->second.z());
-			UASSERT_MSG(pcl::isFinite((*cloud)[i]), uFormat("Invalid pose (%d) %s", iter->first, iter->second.prettyPrint().c_str()).c_str());
-		}
+		PosesIndex index(radius);
+		index.update(poses);
 
 		// radius clustering (nearest neighbors)
-		std::vector<int> ids = uKeys(poses);
-		std::vector<Transform> transforms = uValues(poses);
-
-		pcl::search::KdTree<pcl::PointXYZ>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZ> (false));
-		tree->setInputCloud(cloud);
-
-		for(unsigned int i=0; i<cloud->size(); ++i)
+		for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
 		{
-			std::vector<int> kIndices;
-			std::vector<float> kDistances;
-			tree->radiusSearch(cloud->at(i), radius, kIndices, kDistances);
+			const Transform & currentT = iter->second;
+			std::map<int, float> neighbors = index.radiusSearch(cv::Point3f(currentT.x(), currentT.y(), currentT.z()), radius);
 
-			std::set<int> cloudIndices;
-			const Transform & currentT = transforms.at(i);
 			Eigen::Vector3f vA = currentT.toEigen3f().linear()*Eigen::Vector3f(1,0,0);
-			for(unsigned int j=0; j<kIndices.size(); ++j)
+			for(std::map<int, float>::iterator jter=neighbors.begin(); jter!=neighbors.end(); ++jter)
 			{
-				if((int)i != kIndices[j])
+				if(iter->first != jter->first)
 				{
 					if(angle > 0.0f)
 					{
-						const Transform & checkT = transforms.at(kIndices[j]);
+						const Transform & checkT = index.pose(jter->first);
 						// same orientation?
 						Eigen::Vector3f vB = checkT.toEigen3f().linear()*Eigen::Vector3f(1,0,0);
 						double a = pcl::getAngle3D(Eigen::Vector4f(vA[0], vA[1], vA[2], 0), Eigen::Vector4f(vB[0], vB[1], vB[2], 0));
 						if(a <= angle)
 						{
-							clusters.insert(std::make_pair(ids[i], ids[kIndices[j]]));
+							clusters.insert(std::make_pair(iter->first, jter->first));
 						}
 					}
 					else
 					{
-						clusters.insert(std::make_pair(ids[i], ids[kIndices[j]]));
+						clusters.insert(std::make_pair(iter->first, jter->first));
 					}
 				}
 			}
@@ -2070,34 +2040,55 @@ std::vector<int> findNearestNodes(
 		int k)
 {
 	std::vector<int> nearestIds;
-	if(nodes.size() && !targetPose.isNull())
+	if(nodes.size() && !targetPose.isNull() && k > 0)
 	{
-		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-		cloud->resize(nodes.size());
-		std::vector<int> ids(nodes.size());
+		// a single query, a linear search is faster than building a tree
+		std::vector<std::pair<float, int> > distances(nodes.size());
 		int oi = 0;
 		for(std::map<int, Transform>::const_iterator iter = nodes.begin(); iter!=nodes.end(); ++iter)
 		{
-			(*cloud)[oi] = pcl::PointXYZ(iter->second.x(), iter->second.y(), iter->second.z());
-			ids[oi++] = iter->first;
+			distances[oi++] = std::make_pair(targetPose.getDistanceSquared(iter->second), iter->first);
 		}
+		int n = std::min(k, (int)distances.size());
+		std::partial_sort(distances.begin(), distances.begin()+n, distances.end());
 
-		pcl::search::KdTree<pcl::PointXYZ>::Ptr kdTree(new pcl::search::KdTree<pcl::PointXYZ>);
-		kdTree->setInputCloud(cloud);
-		std::vector<int> ind;
-		std::vector<float> dist;
-		pcl::PointXYZ pt(targetPose.x(), targetPose.y(), targetPose.z());
-		kdTree->nearestKSearch(pt, k, ind, dist);
-
-		nearestIds.resize(ind.size());
-		for(unsigned int i=0; i<ind.size(); ++i)
+		nearestIds.resize(n);
+		for(int i=0; i<n; ++i)
 		{
-			nearestIds[i] = ids[ind[i]];
+			nearestIds[i] = distances[i].second;
 		}
 	}
 	return nearestIds;
 }
 
+int findNearestNode(
+		const PosesIndex & nodes,
+		const rtabmap::Transform & targetPose,
+		bool ignoreLandmarks)
+{
+	int id = 0;
+	std::vector<int> nearestNodes = findNearestNodes(nodes, targetPose, 1, ignoreLandmarks);
+	if(nearestNodes.size())
+	{
+		id = nearestNodes[0];
+	}
+	return id;
+}
+
+std::vector<int> findNearestNodes(
+		const PosesIndex & nodes,
+		const rtabmap::Transform & targetPose,
+		int k,
+		bool ignoreLandmarks)
+{
+	std::vector<int> nearestIds;
+	if(!nodes.empty() && !targetPose.isNull())
+	{
+		nearestIds = nodes.nearestKSearch(cv::Point3f(targetPose.x(), targetPose.y(), targetPose.z()), k, ignoreLandmarks);
+	}
+	return nearestIds;
+}
+
 // return <id, sqrd distance>, excluding query
 std::map<int, float> getNodesInRadius(
 		int nodeId,
@@ -2111,38 +2102,19 @@ std::map<int, float> getNodesInRadius(
 		return foundNodes;
 	}
 
-	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-	cloud->resize(nodes.size());
-	std::vector<int> ids(nodes.size());
-	int oi = 0;
+	// a single query, a linear search is faster than building a tree
+	const Transform & fromT = nodes.at(nodeId);
+	float radiusSqrd = radius*radius;
 	for(std::map<int, Transform>::const_iterator iter = nodes.begin(); iter!=nodes.end(); ++iter)
 	{
 		if(iter->first != nodeId)
 		{
-			(*cloud)[oi] = pcl::PointXYZ(iter->second.x(), iter->second.y(), iter->second.z());
-			UASSERT_MSG(pcl::isFinite((*cloud)[oi]), uFormat("Invalid pose (%d) %s", iter->first, iter->second.prettyPrint().c_str()).c_str());
-			ids[oi] = iter->first;
-			++oi;
-		}
-	}
-	cloud->resize(oi);
-	ids.resize(oi);
-
-	Transform fromT = nodes.at(nodeId);
-
-	if(cloud->size())
-	{
-		pcl::search::KdTree<pcl::PointXYZ>::Ptr kdTree(new pcl::search::KdTree<pcl::PointXYZ>);
-		kdTree->setInputCloud(cloud);
-		std::vector<int> ind;
-		std::vector<float> sqrdDist;
-		pcl::PointXYZ pt(fromT.x(), fromT.y(), fromT.z());
-		kdTree->radiusSearch(pt, radius, ind, sqrdDist, 0);
-		for(unsigned int i=0; i<ind.size(); ++i)
-		{
-			if(ind[i] >=0)
+			UASSERT_MSG(uIsFinite(iter->second.x()) && uIsFinite(iter->second.y()) && uIsFinite(iter->second.z()),
+					uFormat("Invalid pose (%d) %s", iter->first, iter->second.prettyPrint().c_str()).c_str());
+			float sqrdDist = fromT.getDistanceSquared(iter->second);
+			if(sqrdDist <= radiusSqrd)
 			{
-				foundNodes.insert(std::make_pair(ids[ind[i]], sqrdDist[i]));
+				foundNodes.insert(foundNodes.end(), std::make_pair(iter->first, sqrdDist));
 			}
 		}
 	}
@@ -2150,6 +2122,19 @@ std::map<int, float> getNodesInRadius(
 	return foundNodes;
 }
 
+// return <id, sqrd distance>, excluding query
+std::map<int, float> getNodesInRadius(
+		int nodeId,
+		const PosesIndex & nodes,
+		float radius)
+{
+	const Transform & fromT = nodes.pose(nodeId);
+	std::map<int, float> foundNodes = nodes.radiusSearch(cv::Point3f(fromT.x(), fromT.y(), fromT.z()), radius);
+	foundNodes.erase(nodeId);
+	UDEBUG("found nodes=%d", (int)foundNodes.size());
+	return foundNodes;
+}
+
 // return <id, Transform>, excluding query
 std::map<int, Transform> getPosesInRadius(
 		int nodeId,
@@ -2157,63 +2142,65 @@ std::map<int, Transform> getPosesInRadius(
 		float radius,
 		float angle)
 {
-	UASSERT(uContains(nodes, nodeId));
+	std::map<int, float> nearNodes = getNodesInRadius(nodeId, nodes, radius);
 	std::map<int, Transform> foundNodes;
-	if(nodes.size() <= 1)
-	{
-		return foundNodes;
-	}
-
-	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-	cloud->resize(nodes.size());
-	std::vector<int> ids(nodes.size());
-	int oi = 0;
-	for(std::map<int, Transform>::const_iterator iter = nodes.begin(); iter!=nodes.end(); ++iter)
+	if(nearNodes.size())
 	{
-		if(iter->first != nodeId)
+		const Transform & fromT = nodes.at(nodeId);
+		Eigen::Vector3f vA = fromT.toEigen3f().linear()*Eigen::Vector3f(1,0,0);
+		for(std::map<int, float>::iterator iter=nearNodes.begin(); iter!=nearNodes.end(); ++iter)
 		{
-			(*cloud)[oi] = pcl::PointXYZ(iter->second.x(), iter->second.y(), iter->second.z());
-			UASSERT_MSG(pcl::isFinite((*cloud)[oi]), uFormat("Invalid pose (%d) %s", iter->first, iter->second.prettyPrint().c_str()).c_str());
-			ids[oi] = iter->first;
-			++oi;
+			const Transform & checkT = nodes.at(iter->first);
+			if(angle > 0.0f)
+			{
+				// same orientation?
+				Eigen::Vector3f vB = checkT.toEigen3f().linear()*Eigen::Vector3f(1,0,0);
+				double a = pcl::getAngle3D(Eigen::Vector4f(vA[0], vA[1], vA[2], 0), Eigen::Vector4f(vB[0], vB[1], vB[2], 0));
+				if(a <= angle)
+				{
+					foundNodes.insert(foundNodes.end(), std::make_pair(iter->first, checkT));
+				}
+			}
+			else
+			{
+				foundNodes.insert(foundNodes.end(), std::make_pair(iter->first, checkT));
+			}
 		}
 	}
-	cloud->resize(oi);
-	ids.resize(oi);
-
-	Transform fromT = nodes.at(nodeId);
+	UDEBUG("found nodes=%d", (int)foundNodes.size());
+	return foundNodes;
+}
 
-	if(cloud->size())
+// return <id, Transform>, excluding query
+std::map<int, Transform> getPosesInRadius(
+		int nodeId,
+		const PosesIndex & nodes,
+		float radius,
+		float angle)
+{
+	std::map<int, float> nearNodes = getNodesInRadius(nodeId, nodes, radius);
+	std::map<int, Transform> foundNodes;
+	if(nearNodes.size())
 	{
-		pcl::search::KdTree<pcl::PointXYZ>::Ptr kdTree(new pcl::search::KdTree<pcl::PointXYZ>);
-		kdTree->setInputCloud(cloud);
-		std::vector<int> ind;
-		std::vector<float> sqrdDist;
-		pcl::PointXYZ pt(fromT.x(), fromT.y(), fromT.z());
-		kdTree->radiusSearch(pt, radius, ind, sqrdDist, 0);
-
+		const Transform & fromT = nodes.pose(nodeId);
 		Eigen::Vector3f vA = fromT.toEigen3f().linear()*Eigen::Vector3f(1,0,0);
-
-		for(unsigned int i=0; i<ind.size(); ++i)
+		for(std::map<int, float>::iterator iter=nearNodes.begin(); iter!=nearNodes.end(); ++iter)
 		{
-			if(ind[i] >=0)
+			const Transform & checkT = nodes.pose(iter->first);
+			if(angle > 0.0f)
 			{
-				if(angle > 0.0f)
+				// same orientation?
+				Eigen::Vector3f vB = checkT.toEigen3f().linear()*Eigen::Vector3f(1,0,0);
+				double a = pcl::getAngle3D(Eigen::Vector4f(vA[0], vA[1], vA[2], 0), Eigen::Vector4f(vB[0], vB[1], vB[2], 0));
+				if(a <= angle)
 				{
-					const Transform & checkT = nodes.at(ids[ind[i]]);
-					// same orientation?
-					Eigen::Vector3f vB = checkT.toEigen3f().linear()*Eigen::Vector3f(1,0,0);
-					double a = pcl::getAngle3D(Eigen::Vector4f(vA[0], vA[1], vA[2], 0), Eigen::Vector4f(vB[0], vB[1], vB[2], 0));
-					if(a <= angle)
-					{
-						foundNodes.insert(std::make_pair(ids[ind[i]], nodes.at(ids[ind[i]])));
-					}
-				}
-				else
-				{
-					foundNodes.insert(std::make_pair(ids[ind[i]], nodes.at(ids[ind[i]])));
+					foundNodes.insert(foundNodes.end(), std::make_pair(iter->first, checkT));
 				}
 			}
+			else
+			{
+				foundNodes.insert(foundNodes.end(), std::make_pair(iter->first, checkT));
+			}
 		}
 	}
 	UDEBUG("found nodes=%d", (int)foundNodes.size());
@@ -26,6 +26,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "rtabmap/core/IMUThread.h"
+#include "rtabmap/core/Trace.h"
 #include "rtabmap/core/IMU.h"
 #include <rtabmap/utilite/UTimer.h>
 #include <rtabmap/utilite/ULogger.h>
@@ -84,6 +85,7 @@ void IMUThread::setRate(int rate)
 void IMUThread::mainLoopBegin()
 {
 	ULogger::registerCurrentThread("IMU");
+	RTABMAP_TRACE_THREAD_NAME("IMU");
 	frameRateTimer_.start();
 }
 
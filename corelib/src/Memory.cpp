@@ -29,6 +29,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/ULogger.h>
 #include <rtabmap/utilite/UTimer.h>
 #include <rtabmap/utilite/UConversion.h>
+#include <rtabmap/core/Trace.h>
 #include <rtabmap/utilite/UProcessInfo.h>
 #include <rtabmap/utilite/UMath.h>
 
@@ -79,6 +80,10 @@ Memory::Memory(const ParametersMap & parameters) :
 	_notLinkedNodesKeptInDb(Parameters::defaultMemNotLinkedNodesKept()),
 	_saveIntermediateNodeData(Parameters::defaultMemIntermediateNodeDataKept()),
 	_rgbCompressionFormat(Parameters::defaultMemImageCompressionFormat()),
+	_depthCompressionFormat(Parameters::defaultMemDepthCompressionFormat()),
+	_laserScanCompressionCodec(Parameters::defaultMemLaserScanCompressionCodec()),
+	_userDataCompressionCodec(Parameters::defaultMemUserDataCompressionCodec()),
+	_occupancyGridCompressionCodec(Parameters::defaultMemOccupancyGridCompressionCodec()),
 	_incrementalMemory(Parameters::defaultMemIncrementalMemory()),
 	_reduceGraph(Parameters::defaultMemReduceGraph()),
 	_maxStMemSize(Parameters::defaultMemSTMSize()),
@@ -540,6 +545,19 @@ void Memory::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(params, Parameters::kMemNotLinkedNodesKept(), _notLinkedNodesKeptInDb);
 	Parameters::parse(params, Parameters::kMemIntermediateNodeDataKept(), _saveIntermediateNodeData);
 	Parameters::parse(params, Parameters::kMemImageCompressionFormat(), _rgbCompressionFormat);
+	Parameters::parse(params, Parameters::kMemDepthCompressionFormat(), _depthCompressionFormat);
+	Parameters::parse(params, Parameters::kMemLaserScanCompressionCodec(), _laserScanCompressionCodec);
+	Parameters::parse(params, Parameters::kMemUserDataCompressionCodec(), _userDataCompressionCodec);
+	Parameters::parse(params, Parameters::kMemOccupancyGridCompressionCodec(), _occupancyGridCompressionCodec);
+	int * codecs[3] = {&_laserScanCompressionCodec, &_userDataCompressionCodec, &_occupancyGridCompressionCodec};
+	for(int i=0; i<3; ++i)
+	{
+		if(!isCompressionCodecAvailable((CompressionCodec)*codecs[i]))
+		{
+			UWARN("Compression codec %d is not available (RTAB-Map is not built with it), zlib is used instead.", *codecs[i]);
+			*codecs[i] = kCompressionZlib;
+		}
+	}
 	Parameters::parse(params, Parameters::kMemRehearsalIdUpdatedToNewOne(), _idUpdatedToNewOneRehearsal);
 	Parameters::parse(params, Parameters::kMemGenerateIds(), _generateIds);
 	Parameters::parse(params, Parameters::kMemBadSignaturesIgnored(), _badSignaturesIgnored);
@@ -764,6 +782,7 @@ bool Memory::update(
 		const std::vector<float> & velocity,
 		Statistics * stats)
 {
+	RTABMAP_TRACE_SCOPE("Memory::update");
 	UDEBUG("");
 	UTimer timer;
 	UTimer totalTimer;
@@ -776,7 +795,7 @@ bool Memory::update(
 	UDEBUG("pre-updating...");
 	this->preUpdate();
 	t=timer.ticks()*1000;
-	if(stats) stats->addStatistic(Statistics::kTimingMemPre_update(), t);
+	if(stats) stats->addStatistic(Statistics::idTimingMemPre_update(), t);
 	UDEBUG("time preUpdate=%f ms", t);
 
 	//============================================================
@@ -794,7 +813,7 @@ bool Memory::update(
 	}
 
 	t=timer.ticks()*1000;
-	if(stats) stats->addStatistic(Statistics::kTimingMemSignature_creation(), t);
+	if(stats) stats->addStatistic(Statistics::idTimingMemSignature_creation(), t);
 	UDEBUG("time creating signature=%f ms", t);
 
 	// It will be added to the short-term memory, no need to delete it...
@@ -815,7 +834,7 @@ bool Memory::update(
 			this->rehearsal(signature, stats);
 		}
 		t=timer.ticks()*1000;
-		if(stats) stats->addStatistic(Statistics::kTimingMemRehearsal(), t);
+		if(stats) stats->addStatistic(Statistics::idTimingMemRehearsal(), t);
 		UDEBUG("time rehearsal=%f ms", t);
 	}
 	else
@@ -1770,6 +1789,7 @@ void Memory::clear()
  */
 std::map<int, float> Memory::computeLikelihood(const Signature * signature, const std::list<int> & ids)
 {
+	RTABMAP_TRACE_SCOPE("Memory::computeLikelihood");
 	if(!_tfIdfLikelihoodUsed)
 	{
 		UTimer timer;
@@ -3458,6 +3478,7 @@ void Memory::dumpMemoryTree(const char * fileNameTree) const
 
 void Memory::rehearsal(Signature * signature, Statistics * stats)
 {
+	RTABMAP_TRACE_SCOPE("Memory::rehearsal");
 	UTimer timer;
 	if(signature->isBadSignature())
 	{
@@ -3501,15 +3522,15 @@ void Memory::rehearsal(Signature * signature, Statistics * stats)
 			}
 		}
 
-		if(stats) stats->addStatistic(Statistics::kMemoryRehearsal_merged(), merged);
-		if(stats) stats->addStatistic(Statistics::kMemoryRehearsal_sim(), sim);
-		if(stats) stats->addStatistic(Statistics::kMemoryRehearsal_id(), sim >= _similarityThreshold?id:0);
+		if(stats) stats->addStatistic(Statistics::idMemoryRehearsal_merged(), merged);
+		if(stats) stats->addStatistic(Statistics::idMemoryRehearsal_sim(), sim);
+		if(stats) stats->addStatistic(Statistics::idMemoryRehearsal_id(), sim >= _similarityThreshold?id:0);
 		UDEBUG("merged=%d, sim=%f t=%fs", merged, sim, timer.ticks());
 	}
 	else
 	{
-		if(stats) stats->addStatistic(Statistics::kMemoryRehearsal_merged(), 0);
-		if(stats) stats->addStatistic(Statistics::kMemoryRehearsal_sim(), 0);
+		if(stats) stats->addStatistic(Statistics::idMemoryRehearsal_merged(), 0);
+		if(stats) stats->addStatistic(Statistics::idMemoryRehearsal_sim(), 0);
 	}
 }
 
@@ -3990,6 +4011,7 @@ private:
 
 Signature * Memory::createSignature(const SensorData & inputData, const Transform & pose, Statistics * stats)
 {
+	RTABMAP_TRACE_SCOPE("Memory::createSignature");
 	UDEBUG("");
 	SensorData data = inputData;
 	UASSERT(data.imageRaw().empty() ||
@@ -4140,7 +4162,7 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 			return 0;
 		}
 		t = timer.ticks();
-		if(stats) stats->addStatistic(Statistics::kTimingMemRectification(), t*1000.0f);
+		if(stats) stats->addStatistic(Statistics::idTimingMemRectification(), t*1000.0f);
 		UDEBUG("time rectification = %fs", t);
 	}
 
@@ -4259,12 +4281,12 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 				_feature2D->parseParameters(tmpMaxFeatureParameter); // reset back
 			}
 			t = timer.ticks();
-			if(stats) stats->addStatistic(Statistics::kTimingMemKeypoints_detection(), t*1000.0f);
+			if(stats) stats->addStatistic(Statistics::idTimingMemKeypoints_detection(), t*1000.0f);
 			UDEBUG("time keypoints (%d) = %fs", (int)keypoints.size(), t);
 
 			descriptors = _feature2D->generateDescriptors(imageMono, keypoints);
 			t = timer.ticks();
-			if(stats) stats->addStatistic(Statistics::kTimingMemDescriptors_extraction(), t*1000.0f);
+			if(stats) stats->addStatistic(Statistics::idTimingMemDescriptors_extraction(), t*1000.0f);
 			UDEBUG("time descriptors (%d) = %fs", descriptors.rows, t);
 
 			UDEBUG("ratio=%f, meanWordsPerLocation=%d", _badSignRatio, meanWordsPerLocation);
@@ -4388,7 +4410,7 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 					descriptors = descriptorsValid;
 
 					t = timer.ticks();
-					if(stats) stats->addStatistic(Statistics::kTimingMemRectification(), t*1000.0f);
+					if(stats) stats->addStatistic(Statistics::idTimingMemRectification(), t*1000.0f);
 					UDEBUG("time rectification = %fs", t);
 				}
 
@@ -4397,7 +4419,7 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 				{
 					keypoints3D = _feature2D->generateKeypoints3D(decimatedData, keypoints);
 					t = timer.ticks();
-					if(stats) stats->addStatistic(Statistics::kTimingMemKeypoints_3D(), t*1000.0f);
+					if(stats) stats->addStatistic(Statistics::idTimingMemKeypoints_3D(), t*1000.0f);
 					UDEBUG("time keypoints 3D (%d) = %fs", (int)keypoints3D.size(), t);
 				}
 			}
@@ -4436,7 +4458,7 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 			_feature2D->limitKeypoints(keypoints, keypoints3D, descriptors, maxFeatures);
 		}
 		t = timer.ticks();
-		if(stats) stats->addStatistic(Statistics::kTimingMemKeypoints_detection(), t*1000.0f);
+		if(stats) stats->addStatistic(Statistics::idTimingMemKeypoints_detection(), t*1000.0f);
 		UDEBUG("time keypoints (%d) = %fs", (int)keypoints.size(), t);
 
 		if(descriptors.empty())
@@ -4455,7 +4477,7 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 			descriptors = _feature2D->generateDescriptors(imageMono, keypoints);
 		}
 		t = timer.ticks();
-		if(stats) stats->addStatistic(Statistics::kTimingMemDescriptors_extraction(), t*1000.0f);
+		if(stats) stats->addStatistic(Statistics::idTimingMemDescriptors_extraction(), t*1000.0f);
 		UDEBUG("time descriptors (%d) = %fs", descriptors.rows, t);
 
 		if(keypoints3D.empty() &&
@@ -4493,7 +4515,7 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 			}
 		}
 		t = timer.ticks();
-		if(stats) stats->addStatistic(Statistics::kTimingMemKeypoints_3D(), t*1000.0f);
+		if(stats) stats->addStatistic(Statistics::idTimingMemKeypoints_3D(), t*1000.0f);
 		UDEBUG("time keypoints 3D (%d) = %fs", (int)keypoints3D.size(), t);
 
 		UDEBUG("ratio=%f, meanWordsPerLocation=%d", _badSignRatio, meanWordsPerLocation);
@@ -4511,7 +4533,7 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 	}
 
 	t = timer.ticks();
-	if(stats) stats->addStatistic(Statistics::kTimingMemJoining_dictionary_update(), t*1000.0f);
+	if(stats) stats->addStatistic(Statistics::idTimingMemJoining_dictionary_update(), t*1000.0f);
 	if(_parallelized)
 	{
 		UDEBUG("time descriptor and memory update (%d of size=%d) = %fs", descriptors.rows, descriptors.cols, t);
@@ -4584,7 +4606,7 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 		}
 
 		t = timer.ticks();
-		if(stats) stats->addStatistic(Statistics::kTimingMemAdd_new_words(), t*1000.0f);
+		if(stats) stats->addStatistic(Statistics::idTimingMemAdd_new_words(), t*1000.0f);
 		UDEBUG("time addNewWords %fs indexed=%d not=%d", t, _vwd->getIndexedWordsCount(), _vwd->getNotIndexedWordsCount());
 	}
 	else if(id>0)
@@ -4672,7 +4694,7 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 			UWARN("Input data has already landmarks, cannot do marker detection.");
 		}
 		t = timer.ticks();
-		if(stats) stats->addStatistic(Statistics::kTimingMemMarkers_detection(), t*1000.0f);
+		if(stats) stats->addStatistic(Statistics::idTimingMemMarkers_detection(), t*1000.0f);
 		UDEBUG("time markers detection = %fs", t);
 	}
 
@@ -4717,7 +4739,7 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 		}
 
 		t = timer.ticks();
-		if(stats) stats->addStatistic(Statistics::kTimingMemPost_decimation(), t*1000.0f);
+		if(stats) stats->addStatistic(Statistics::idTimingMemPost_decimation(), t*1000.0f);
 		UDEBUG("time post-decimation = %fs", t);
 	}
 
@@ -4809,11 +4831,11 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 				}
 			}
 			UDEBUG("added3DPointsWithoutDepth=%d", added3DPointsWithoutDepth);
-			if(stats) stats->addStatistic(Statistics::kMemoryTriangulated_points(), (float)added3DPointsWithoutDepth);
+			if(stats) stats->addStatistic(Statistics::idMemoryTriangulated_points(), (float)added3DPointsWithoutDepth);
 
 			t = timer.ticks();
 			UASSERT(words3D.size() == words.size());
-			if(stats) stats->addStatistic(Statistics::kTimingMemKeypoints_3D_motion(), t*1000.0f);
+			if(stats) stats->addStatistic(Statistics::idTimingMemKeypoints_3D_motion(), t*1000.0f);
 			UDEBUG("time keypoints 3D by motion (%d) = %fs", (int)words3D.size(), t);
 		}
 	}
@@ -4857,10 +4879,15 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 				_laserScanNormalK,
 				_laserScanNormalRadius);
 		t = timer.ticks();
-		if(stats) stats->addStatistic(Statistics::kTimingMemScan_filtering(), t*1000.0f);
+		if(stats) stats->addStatistic(Statistics::idTimingMemScan_filtering(), t*1000.0f);
 		UDEBUG("time normals scan = %fs", t);
 	}
 
+	// LZ4/zstd blobs cannot be read by older versions, zlib is used with older databases
+	int laserScanCodec = _dbDriver?_dbDriver->getCompressionCodec(_laserScanCompressionCodec):_laserScanCompressionCodec;
+	int userDataCodec = _dbDriver?_dbDriver->getCompressionCodec(_userDataCompressionCodec):_userDataCompressionCodec;
+	int occupancyGridCodec = _dbDriver?_dbDriver->getCompressionCodec(_occupancyGridCompressionCodec):_occupancyGridCompressionCodec;
+
 	Signature * s;
 	if(this->isBinDataKept() && (!isIntermediateNode || _saveIntermediateNodeData))
 	{
@@ -4879,36 +4906,38 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 			depthOrRightImage = util2d::cvtDepthFromFloat(depthOrRightImage);
 		}
 
+		std::string depthFormat = depthOrRightImage.type() == CV_32FC1?std::string(".png"):
+								  depthOrRightImage.type() == CV_16UC1?_depthCompressionFormat:
+								  _rgbCompressionFormat;
+
 		cv::Mat compressedImage;
 		cv::Mat compressedDepth;
 		cv::Mat compressedScan;
 		cv::Mat compressedUserData;
 		if(_compressionParallelized)
 		{
-			rtabmap::CompressionThread ctImage(image, _rgbCompressionFormat);
-			rtabmap::CompressionThread ctDepth(depthOrRightImage, depthOrRightImage.type() == CV_32FC1 || depthOrRightImage.type() == CV_16UC1?std::string(".png"):_rgbCompressionFormat);
-			rtabmap::CompressionThread ctLaserScan(laserScan.data());
-			rtabmap::CompressionThread ctUserData(data.userDataRaw());
+			rtabmap::CompressionTask ctImage(image, _rgbCompressionFormat);
+			rtabmap::CompressionTask ctDepth(depthOrRightImage, depthFormat);
+			rtabmap::CompressionTask ctLaserScan(laserScan.data(), "", (CompressionCodec)laserScanCodec);
+			rtabmap::CompressionTask ctUserData(data.userDataRaw(), "", (CompressionCodec)userDataCodec);
+			std::vector<rtabmap::CompressionTask*> tasks;
 			if(!image.empty())
 			{
-				ctImage.start();
+				tasks.push_back(&ctImage);
 			}
 			if(!depthOrRightImage.empty())
 			{
-				ctDepth.start();
+				tasks.push_back(&ctDepth);
 			}
 			if(!laserScan.isEmpty())
 			{
-				ctLaserScan.start();
+				tasks.push_back(&ctLaserScan);
 			}
 			if(!data.userDataRaw().empty())
 			{
-				ctUserData.start();
+				tasks.push_back(&ctUserData);
 			}
-			ctImage.join();
-			ctDepth.join();
-			ctLaserScan.join();
-			ctUserData.join();
+			rtabmap::runCompressionTasks(tasks);
 
 			compressedImage = ctImage.getCompressedData();
 			compressedDepth = ctDepth.getCompressedData();
@@ -4918,9 +4947,9 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 		else
 		{
 			compressedImage = compressImage2(image, _rgbCompressionFormat);
-			compressedDepth = compressImage2(depthOrRightImage, depthOrRightImage.type() == CV_32FC1 || depthOrRightImage.type() == CV_16UC1?std::string(".png"):_rgbCompressionFormat);
-			compressedScan = compressData2(laserScan.data());
-			compressedUserData = compressData2(data.userDataRaw());
+			compressedDepth = compressImage2(depthOrRightImage, depthFormat);
+			compressedScan = compressData2(laserScan.data(), (CompressionCodec)laserScanCodec);
+			compressedUserData = compressData2(data.userDataRaw(), (CompressionCodec)userDataCodec);
 		}
 
 		s = new Signature(id,
@@ -4985,26 +5014,26 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 		cv::Mat compressedUserData;
 		if(_compressionParallelized)
 		{
-			rtabmap::CompressionThread ctUserData(data.userDataRaw());
-			rtabmap::CompressionThread ctLaserScan(laserScan.data());
+			rtabmap::CompressionTask ctUserData(data.userDataRaw(), "", (CompressionCodec)userDataCodec);
+			rtabmap::CompressionTask ctLaserScan(laserScan.data(), "", (CompressionCodec)laserScanCodec);
+			std::vector<rtabmap::CompressionTask*> tasks;
 			if(!data.userDataRaw().empty() && !isIntermediateNode)
 			{
-				ctUserData.start();
+				tasks.push_back(&ctUserData);
 			}
 			if(!laserScan.isEmpty() && !isIntermediateNode)
 			{
-				ctLaserScan.start();
+				tasks.push_back(&ctLaserScan);
 			}
-			ctUserData.join();
-			ctLaserScan.join();
+			rtabmap::runCompressionTasks(tasks);
 
 			compressedScan = ctLaserScan.getCompressedData();
 			compressedUserData = ctUserData.getCompressedData();
 		}
 		else
 		{
-			compressedScan = compressData2(laserScan.data());
-			compressedUserData = compressData2(data.userDataRaw());
+			compressedScan = compressData2(laserScan.data(), (CompressionCodec)laserScanCodec);
+			compressedUserData = compressData2(data.userDataRaw(), (CompressionCodec)userDataCodec);
 		}
 
 		s = new Signature(id,
@@ -5080,7 +5109,7 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 	s->sensorData().setEnvSensors(data.envSensors());
 
 	t = timer.ticks();
-	if(stats) stats->addStatistic(Statistics::kTimingMemCompressing_data(), t*1000.0f);
+	if(stats) stats->addStatistic(Statistics::idTimingMemCompressing_data(), t*1000.0f);
 	UDEBUG("time compressing data (id=%d) %fs", id, t);
 	if(words.size())
 	{
@@ -5097,10 +5126,10 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 			cv::Point3f viewPoint(0,0,0);
 			_occupancy->createLocalMap(*s, ground, obstacles, empty, viewPoint);
 			cellSize = _occupancy->getCellSize();
-			s->sensorData().setOccupancyGrid(ground, obstacles, empty, cellSize, viewPoint);
+			s->sensorData().setOccupancyGrid(ground, obstacles, empty, cellSize, viewPoint, occupancyGridCodec);
 
 			t = timer.ticks();
-			if(stats) stats->addStatistic(Statistics::kTimingMemOccupancy_grid(), t*1000.0f);
+			if(stats) stats->addStatistic(Statistics::idTimingMemOccupancy_grid(), t*1000.0f);
 			UDEBUG("time grid map = %fs", t);
 		}
 		else if(data.gridCellSize() != 0.0f)
@@ -5110,7 +5139,8 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 					data.gridObstacleCellsRaw(),
 					data.gridEmptyCellsRaw(),
 					data.gridCellSize(),
-					data.gridViewPoint());
+					data.gridViewPoint(),
+					occupancyGridCodec);
 		}
 	}
 
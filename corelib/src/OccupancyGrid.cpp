@@ -84,7 +84,12 @@ OccupancyGrid::OccupancyGrid(const ParametersMap & parameters) :
 	cloudAssembling_(false),
 	assembledGround_(new pcl::PointCloud<pcl::PointXYZRGB>),
 	assembledObstacles_(new pcl::PointCloud<pcl::PointXYZRGB>),
-	assembledEmptyCells_(new pcl::PointCloud<pcl::PointXYZRGB>)
+	assembledEmptyCells_(new pcl::PointCloud<pcl::PointXYZRGB>),
+	tileSize_(Parameters::defaultGridGlobalTileSize()),
+	mapVersion_(0),
+	tilesResetVersion_(0),
+	tilesXMin_(0.0f),
+	tilesYMin_(0.0f)
 {
 	this->parseParameters(parameters);
 }
@@ -135,6 +140,14 @@ void OccupancyGrid::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(parameters, Parameters::kGridGlobalEroded(), erode_);
 	Parameters::parse(parameters, Parameters::kGridGlobalFootprintRadius(), footprintRadius_);
 	Parameters::parse(parameters, Parameters::kGridGlobalUpdateError(), updateError_);
+	int tileSize = tileSize_;
+	if(Parameters::parse(parameters, Parameters::kGridGlobalTileSize(), tileSize) && tileSize != tileSize_)
+	{
+		// regenerate all tiles with the new size
+		removeTiles(mapVersion_+1);
+		tileSize_ = tileSize;
+		updateTiles(cv::Rect(0, 0, map_.cols, map_.rows));
+	}
 
 	Parameters::parse(parameters, Parameters::kGridGlobalOccupancyThr(), occupancyThr_);
 	if(Parameters::parse(parameters, Parameters::kGridGlobalProbHit(), probHit_))
@@ -252,6 +265,7 @@ void OccupancyGrid::setMap(const cv::Mat & map, float xMin, float yMin, float ce
 		yMin_ = yMin;
 		cellSize_ = cellSize;
 		addedNodes_.insert(poses.lower_bound(1), poses.end());
+		updateTiles(cv::Rect(0, 0, map_.cols, map_.rows));
 	}
 }
 
@@ -599,6 +613,7 @@ void OccupancyGrid::clear()
 	addedNodes_.clear();
 	assembledGround_->clear();
 	assembledObstacles_->clear();
+	updateTiles(cv::Rect());
 }
 
 cv::Mat OccupancyGrid::getMap(float & xMin, float & yMin) const
@@ -672,6 +687,200 @@ cv::Mat OccupancyGrid::getProbMap(float & xMin, float & yMin) const
 	return map;
 }
 
+std::map<std::pair<int, int>, cv::Mat> OccupancyGrid::getMapTiles(
+		int sinceVersion,
+		float & xMin,
+		float & yMin,
+		std::list<std::pair<int, int> > * removedTiles,
+		bool * reset) const
+{
+	xMin = tilesXMin_;
+	yMin = tilesYMin_;
+
+	// removed tiles are not kept across resets, the caller should restart from scratch
+	bool all = sinceVersion < tilesResetVersion_;
+	if(reset)
+	{
+		*reset = all;
+	}
+	if(all)
+	{
+		sinceVersion = 0;
+	}
+
+	std::map<std::pair<int, int>, cv::Mat> tiles;
+	for(std::map<std::pair<int, int>, std::pair<cv::Mat, int> >::const_iterator iter=tiles_.begin(); iter!=tiles_.end(); ++iter)
+	{
+		if(iter->second.second > sinceVersion)
+		{
+			tiles.insert(tiles.end(), std::make_pair(iter->first, iter->second.first));
+		}
+	}
+	if(removedTiles && !all)
+	{
+		for(std::map<std::pair<int, int>, int>::const_iterator iter=removedTiles_.begin(); iter!=removedTiles_.end(); ++iter)
+		{
+			if(iter->second > sinceVersion)
+			{
+				removedTiles->push_back(iter->first);
+			}
+		}
+	}
+	return tiles;
+}
+
+void OccupancyGrid::removeTiles(int version)
+{
+	if(!tiles_.empty() || !removedTiles_.empty())
+	{
+		tiles_.clear();
+		removedTiles_.clear();
+		tilesResetVersion_ = version;
+		mapVersion_ = version;
+	}
+}
+
+// floor(a/b) for b>0
+static int floorDiv(int a, int b)
+{
+	return a>=0?a/b:-((-a+b-1)/b);
+}
+
+static bool isShared(const cv::Mat & mat)
+{
+#if CV_MAJOR_VERSION < 3
+	return mat.refcount && *mat.refcount > 1;
+#else
+	return mat.u && mat.u->refcount > 1;
+#endif
+}
+
+void OccupancyGrid::updateTiles(const cv::Rect & regionIn)
+{
+	if(tileSize_ <= 0)
+	{
+		return;
+	}
+
+	UTimer timer;
+	int version = mapVersion_+1;
+	if(map_.empty())
+	{
+		removeTiles(version);
+		return;
+	}
+
+	float offsetXf = (xMin_ - tilesXMin_)/cellSize_;
+	float offsetYf = (yMin_ - tilesYMin_)/cellSize_;
+	int offsetX = cvRound(offsetXf);
+	int offsetY = cvRound(offsetYf);
+	cv::Rect region = regionIn & cv::Rect(0, 0, map_.cols, map_.rows);
+	if(tiles_.empty() || fabs(offsetXf - float(offsetX)) > 0.01f || fabs(offsetYf - float(offsetY)) > 0.01f)
+	{
+		// Origin of the map is not aligned anymore with the tiles (e.g., the map
+		// has been rebuilt), restart from the current origin.
+		removeTiles(version);
+		tilesXMin_ = xMin_;
+		tilesYMin_ = yMin_;
+		offsetX = 0;
+		offsetY = 0;
+		region = cv::Rect(0, 0, map_.cols, map_.rows);
+	}
+	if(region.area() == 0)
+	{
+		return;
+	}
+
+	bool fromProb = occupancyThr_ != 0.0f;
+	float occThr = logodds(occupancyThr_);
+	UASSERT(mapInfo_.cols == map_.cols && mapInfo_.rows == map_.rows);
+
+	int colBegin = floorDiv(region.x + offsetX, tileSize_);
+	int colEnd = floorDiv(region.x + region.width - 1 + offsetX, tileSize_);
+	int rowBegin = floorDiv(region.y + offsetY, tileSize_);
+	int rowEnd = floorDiv(region.y + region.height - 1 + offsetY, tileSize_);
+	int modified = 0;
+	cv::Mat tile; // reused until it is kept in tiles_
+	for(int tr=rowBegin; tr<=rowEnd; ++tr)
+	{
+		for(int tc=colBegin; tc<=colEnd; ++tc)
+		{
+			tile.create(tileSize_, tileSize_, CV_8SC1);
+			tile.setTo(cv::Scalar(-1));
+			int known = 0;
+			for(int i=0; i<tileSize_; ++i)
+			{
+				int y = tr*tileSize_ + i - offsetY;
+				if(y < 0 || y >= map_.rows)
+				{
+					continue;
+				}
+				char * out = tile.ptr<char>(i);
+				for(int j=0; j<tileSize_; ++j)
+				{
+					int x = tc*tileSize_ + j - offsetX;
+					if(x < 0 || x >= map_.cols)
+					{
+						continue;
+					}
+					char value = map_.at<char>(y, x);
+					if(fromProb)
+					{
+						const float * info = mapInfo_.ptr<float>(y, x);
+						value = info[3] == 0.0f?-1:info[3] >= occThr?100:0;
+					}
+					out[j] = value;
+					if(value != -1)
+					{
+						++known;
+					}
+				}
+			}
+
+			std::pair<int, int> key(tc, tr);
+			std::map<std::pair<int, int>, std::pair<cv::Mat, int> >::iterator iter = tiles_.find(key);
+			if(known == 0)
+			{
+				if(iter != tiles_.end())
+				{
+					tiles_.erase(iter);
+					removedTiles_[key] = version;
+					++modified;
+				}
+			}
+			else if(iter == tiles_.end())
+			{
+				tiles_.insert(std::make_pair(key, std::make_pair(tile, version)));
+				tile.release();
+				removedTiles_.erase(key);
+				++modified;
+			}
+			else if(memcmp(iter->second.first.data, tile.data, tile.total()) != 0)
+			{
+				if(isShared(iter->second.first))
+				{
+					// Don't write in the old tile, it is still used by a subscriber
+					iter->second.first = tile;
+					tile.release();
+				}
+				else
+				{
+					// the old tile is reused for the next one
+					cv::swap(iter->second.first, tile);
+				}
+				iter->second.second = version;
+				++modified;
+			}
+		}
+	}
+	if(modified)
+	{
+		mapVersion_ = version;
+	}
+	UDEBUG("Tiles updated (region=%dx%d, modified=%d, total=%d, version=%d) = %fs",
+			region.width, region.height, modified, (int)tiles_.size(), mapVersion_, timer.ticks());
+}
+
 void OccupancyGrid::addToCache(
 		int nodeId,
 		const cv::Mat & ground,
@@ -701,6 +910,7 @@ bool OccupancyGrid::update(const std::map<int, Transform> & posesIn)
 	bool undefinedSize = minMapSize_ == 0.0f;
 	std::map<int, cv::Mat> emptyLocalMaps;
 	std::map<int, cv::Mat> occupiedLocalMaps;
+	cv::Rect dirtyRegion; // cells modified in the current map, used to update the tiles
 
 	// First, check of the graph has changed. If so, re-create the map by moving all occupied nodes (fullUpdate==false).
 	bool graphOptimized = false; // If a loop closure happened (e.g., poses are modified)
@@ -1148,6 +1358,8 @@ bool OccupancyGrid::update(const std::map<int, Transform> & posesIn)
 				}
 				UASSERT(map.cols == mapInfo.cols && map.rows == mapInfo.rows);
 				UDEBUG("map %d %d", map.cols, map.rows);
+				cv::Point2i dirtyMin(map.cols, map.rows);
+				cv::Point2i dirtyMax(-1, -1);
 				if(poses.size())
 				{
 					UDEBUG("first pose= %d last pose=%d", poses.begin()->first, poses.rbegin()->first);
@@ -1177,6 +1389,10 @@ bool OccupancyGrid::update(const std::map<int, Transform> & posesIn)
 							char & value = map.at<char>(pt.y, pt.x);
 							if(value != -2 && (!incrementalGraphUpdate || value==-1))
 							{
+								dirtyMin.x = std::min(dirtyMin.x, pt.x);
+								dirtyMin.y = std::min(dirtyMin.y, pt.y);
+								dirtyMax.x = std::max(dirtyMax.x, pt.x);
+								dirtyMax.y = std::max(dirtyMax.y, pt.y);
 								float * info = mapInfo.ptr<float>(pt.y, pt.x);
 								int nodeId = (int)info[0];
 								if(value != -1)
@@ -1244,6 +1460,13 @@ bool OccupancyGrid::update(const std::map<int, Transform> & posesIn)
 							ptBegin.y = 0;
 						if(ptEnd.y >= map.rows)
 							ptEnd.y = map.rows-1;
+						if(ptBegin.x < ptEnd.x && ptBegin.y < ptEnd.y)
+						{
+							dirtyMin.x = std::min(dirtyMin.x, ptBegin.x);
+							dirtyMin.y = std::min(dirtyMin.y, ptBegin.y);
+							dirtyMax.x = std::max(dirtyMax.x, ptEnd.x-1);
+							dirtyMax.y = std::max(dirtyMax.y, ptEnd.y-1);
+						}
 						for(int i=ptBegin.x; i<ptEnd.x; ++i)
 						{
 							for(int j=ptBegin.y; j<ptEnd.y; ++j)
@@ -1301,6 +1524,10 @@ bool OccupancyGrid::update(const std::map<int, Transform> & posesIn)
 							char & value = map.at<char>(pt.y, pt.x);
 							if(value != -2)
 							{
+								dirtyMin.x = std::min(dirtyMin.x, pt.x);
+								dirtyMin.y = std::min(dirtyMin.y, pt.y);
+								dirtyMax.x = std::max(dirtyMax.x, pt.x);
+								dirtyMax.y = std::max(dirtyMax.y, pt.y);
 								float * info = mapInfo.ptr<float>(pt.y, pt.x);
 								int nodeId = (int)info[0];
 								if(value != -1)
@@ -1473,6 +1700,10 @@ bool OccupancyGrid::update(const std::map<int, Transform> & posesIn)
 				mapInfo_ = mapInfo;
 				xMin_ = xMin;
 				yMin_ = yMin;
+				if(dirtyMax.x >= dirtyMin.x && dirtyMax.y >= dirtyMin.y)
+				{
+					dirtyRegion = cv::Rect(dirtyMin, dirtyMax+cv::Point2i(1,1));
+				}
 
 				// clean cellCount_
 				for(std::map<int, std::pair<int, int> >::iterator iter= cellCount_.begin(); iter!=cellCount_.end();)
@@ -1528,6 +1759,10 @@ bool OccupancyGrid::update(const std::map<int, Transform> & posesIn)
 	}
 
 	bool updated = !poses.empty() || graphOptimized || graphChanged;
+	if(updated)
+	{
+		updateTiles((graphOptimized || graphChanged)?cv::Rect(0, 0, map_.cols, map_.rows):dirtyRegion);
+	}
 	UDEBUG("Occupancy Grid update time = %f s (updated=%s)", timer.ticks(), updated?"true":"false");
 	return updated;
 }
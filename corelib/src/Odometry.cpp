@@ -26,6 +26,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "rtabmap/core/Odometry.h"
+#include "rtabmap/core/Trace.h"
 #include <rtabmap/core/odometry/OdometryF2M.h>
 #include "rtabmap/core/odometry/OdometryF2F.h"
 #include "rtabmap/core/odometry/OdometryFovis.h"
@@ -281,6 +282,7 @@ Transform Odometry::process(SensorData & data, OdometryInfo * info)
 
 Transform Odometry::process(SensorData & data, const Transform & guessIn, OdometryInfo * info)
 {
+	RTABMAP_TRACE_SCOPE("Odometry::process");
 	UASSERT_MSG(data.id() >= 0, uFormat("Input data should have ID greater or equal than 0 (id=%d)!", data.id()).c_str());
 
 	if(!_imagesAlreadyRectified && !this->canProcessRawImages())
@@ -26,6 +26,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "rtabmap/core/OdometryThread.h"
+#include "rtabmap/core/Trace.h"
 #include "rtabmap/core/Odometry.h"
 #include "rtabmap/core/odometry/OdometryMono.h"
 #include "rtabmap/core/OdometryInfo.h"
@@ -36,8 +37,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 namespace rtabmap {
 
 OdometryThread::OdometryThread(Odometry * odometry, unsigned int dataBufferMaxSize) :
+	_dataBuffer(dataBufferMaxSize),
 	_odometry(odometry),
-	_dataBufferMaxSize(dataBufferMaxSize),
 	_resetOdometry(false),
 	_resetPose(Transform::getIdentity()),
 	_lastImuStamp(0.0),
@@ -54,6 +55,12 @@ OdometryThread::~OdometryThread()
 	UDEBUG("");
 }
 
+void OdometryThread::setDataBufferPolicy(int policy)
+{
+	UASSERT(policy == URingBuffer<SensorData>::kFifo || policy == URingBuffer<SensorData>::kLatestOnly);
+	_dataBuffer.setDropPolicy((URingBuffer<SensorData>::DropPolicy)policy);
+}
+
 bool OdometryThread::handleEvent(UEvent * event)
 {
 	if(this->isRunning())
@@ -91,6 +98,7 @@ bool OdometryThread::handleEvent(UEvent * event)
 void OdometryThread::mainLoopBegin()
 {
 	ULogger::registerCurrentThread("Odometry");
+	RTABMAP_TRACE_THREAD_NAME("Odometry");
 }
 
 void OdometryThread::mainLoopKill()
@@ -107,16 +115,19 @@ void OdometryThread::mainLoop()
 	{
 		_odometry->reset(_resetPose);
 		_resetOdometry = false;
-		UScopeMutex lock(_dataMutex);
 		_dataBuffer.clear();
 		_imuBuffer.clear();
+		UScopeMutex lock(_dataMutex);
 		_lastImuStamp = 0.0f;
 	}
 
-	SensorData data;
-	if(getData(data))
+	double queuedTime = 0.0;
+	SensorData * dataPtr = getData(queuedTime);
+	if(dataPtr)
 	{
+		SensorData & data = *dataPtr;
 		OdometryInfo info;
+		info.timeQueued = queuedTime;
 		UDEBUG("Processing data...");
 		Transform pose = _odometry->process(data, &info);
 		if(!data.imageRaw().empty() || (pose.isNull() && data.imu().empty()))
@@ -125,6 +136,7 @@ void OdometryThread::mainLoop()
 			// a null pose notify that odometry could not be computed
 			this->post(new OdometryEvent(data, pose, info));
 		}
+		delete dataPtr;
 	}
 }
 
@@ -151,58 +163,47 @@ void OdometryThread::addData(const SensorData & data)
 		}
 	}
 
-	bool notify = true;
-	_dataMutex.lock();
+	if(!data.imageRaw().empty() || !data.laserScanRaw().isEmpty() || data.imu().empty())
 	{
-		if(!data.imageRaw().empty() || !data.laserScanRaw().isEmpty() || data.imu().empty())
+		if(_dataBuffer.push(new SensorData(data)) == 0)
 		{
-			_dataBuffer.push_back(data);
-			while(_dataBufferMaxSize > 0 && _dataBuffer.size() > _dataBufferMaxSize)
-			{
-				UDEBUG("Data buffer is full, the oldest data is removed to add the new one.");
-				_dataBuffer.erase(_dataBuffer.begin());
-				notify = false;
-			}
+			_dataAdded.release();
 		}
 		else
 		{
-			_imuBuffer.push_back(data);
-			if(_lastImuStamp != 0.0 && data.stamp() > _lastImuStamp)
-			{
-				_imuEstimatedDelay = data.stamp() - _lastImuStamp;
-			}
-			_lastImuStamp = data.stamp();
+			UDEBUG("Data buffer is full, the oldest data is removed to add the new one.");
 		}
 	}
-	_dataMutex.unlock();
-
-	if(notify)
+	else
 	{
-		_dataAdded.release();
+		_imuBuffer.push(new SensorData(data));
+		UScopeMutex lock(_dataMutex);
+		if(_lastImuStamp != 0.0 && data.stamp() > _lastImuStamp)
+		{
+			_imuEstimatedDelay = data.stamp() - _lastImuStamp;
+		}
+		_lastImuStamp = data.stamp();
 	}
 }
 
-bool OdometryThread::getData(SensorData & data)
+SensorData * OdometryThread::getData(double & queuedTime)
 {
-	bool dataFilled = false;
 	_dataAdded.acquire();
-	_dataMutex.lock();
+	SensorData * data = _dataBuffer.pop(&queuedTime);
+	if(data)
 	{
-		if(!_dataBuffer.empty())
+		// The IMU buffer is never full and only emptied by this thread, so
+		// its front can be used here. IMU data are processed without
+		// blocking the threads adding data.
+		const SensorData * imu = 0;
+		while((imu = _imuBuffer.front()) != 0 && imu->stamp() <= data->stamp())
 		{
-			while(!_imuBuffer.empty() && _imuBuffer.front().stamp() <= _dataBuffer.front().stamp())
-			{
-				_odometry->process(_imuBuffer.front());
-				_imuBuffer.pop_front();
-			}
-
-			data = _dataBuffer.front();
-			_dataBuffer.pop_front();
-			dataFilled = true;
+			SensorData * imuData = _imuBuffer.pop();
+			_odometry->process(*imuData);
+			delete imuData;
 		}
 	}
-	_dataMutex.unlock();
-	return dataFilled;
+	return data;
 }
 
 } // namespace rtabmap
@@ -35,6 +35,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/RegistrationVis.h>
 #include <set>
 #include <queue>
+#include <limits>
+#include <algorithm>
 
 #include <rtabmap/core/optimizer/OptimizerTORO.h>
 #include <rtabmap/core/optimizer/OptimizerG2O.h>
@@ -441,6 +443,280 @@ std::map<int, Transform> Optimizer::optimize(
 	return std::map<int, Transform>();
 }
 
+// Adjoint of a transform for (x,y,z,roll,pitch,yaw) tangent vectors
+static Eigen::Matrix<double, 6, 6> adjoint(const Transform & t)
+{
+	Eigen::Matrix3d R = t.toEigen3d().linear();
+	Eigen::Matrix3d tx;
+	tx << 0, -t.z(), t.y(),
+		  t.z(), 0, -t.x(),
+		  -t.y(), t.x(), 0;
+	Eigen::Matrix<double, 6, 6> ad = Eigen::Matrix<double, 6, 6>::Zero();
+	ad.block<3,3>(0,0) = R;
+	ad.block<3,3>(0,3) = tx*R;
+	ad.block<3,3>(3,3) = R;
+	return ad;
+}
+
+static Eigen::Matrix<double, 6, 6> linkCovariance(const Link & link, bool covarianceIgnored)
+{
+	Eigen::Matrix<double, 6, 6> covariance = Eigen::Matrix<double, 6, 6>::Identity();
+	if(!covarianceIgnored)
+	{
+		cv::Mat c = link.infMatrix().inv();
+		for(int i=0; i<6; ++i)
+		{
+			for(int j=0; j<6; ++j)
+			{
+				covariance(i,j) = c.at<double>(i,j);
+			}
+		}
+	}
+	return covariance;
+}
+
+double Optimizer::computeLinkChi2(
+		const std::map<int, Transform> & poses,
+		const std::multimap<int, Link> & links,
+		const Link & link,
+		cv::Mat * relativeCovariance) const
+{
+	std::vector<cv::Mat> relativeCovariances;
+	std::vector<double> chi2 = computeLinksChi2(poses, links, std::vector<Link>(1, link), 0, relativeCovariance?&relativeCovariances:0);
+	if(relativeCovariance)
+	{
+		*relativeCovariance = relativeCovariances[0];
+	}
+	return chi2[0];
+}
+
+static int poseIndex(const std::vector<int> & ids, int id)
+{
+	std::vector<int>::const_iterator iter = std::lower_bound(ids.begin(), ids.end(), id);
+	return iter!=ids.end() && *iter == id?int(iter-ids.begin()):-1;
+}
+
+static void addGraphLinks(
+		const std::multimap<int, Link> & links,
+		const std::vector<int> & ids,
+		const std::set<std::pair<int, int> > & excluded,
+		std::vector<const Link *> & graphLinks,
+		std::vector<std::pair<int, int> > & graphIndices)
+{
+	for(std::multimap<int, Link>::const_iterator iter=links.begin(); iter!=links.end(); ++iter)
+	{
+		const Link & l = iter->second;
+		if(l.from() == l.to() ||
+		   excluded.find(std::make_pair(std::min(l.from(), l.to()), std::max(l.from(), l.to()))) != excluded.end())
+		{
+			continue;
+		}
+		int i = poseIndex(ids, l.from());
+		int j = poseIndex(ids, l.to());
+		if(i >= 0 && j >= 0)
+		{
+			graphLinks.push_back(&l);
+			graphIndices.push_back(std::make_pair(i, j));
+		}
+	}
+}
+
+std::vector<double> Optimizer::computeLinksChi2(
+		const std::map<int, Transform> & poses,
+		const std::multimap<int, Link> & links,
+		const std::vector<Link> & candidates,
+		const std::multimap<int, Link> * extraLinks,
+		std::vector<cv::Mat> * relativeCovariances) const
+{
+	std::vector<double> chi2s(candidates.size(), -1.0);
+	if(relativeCovariances)
+	{
+		relativeCovariances->resize(candidates.size());
+	}
+
+	// contiguous indices of the poses
+	std::vector<int> ids;
+	std::vector<const Transform *> posesPtr;
+	ids.reserve(poses.size());
+	posesPtr.reserve(poses.size());
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		ids.push_back(iter->first);
+		posesPtr.push_back(&iter->second);
+	}
+
+	// candidates grouped by their "from" pose, one search is done for each group
+	std::set<std::pair<int, int> > excluded;
+	std::map<int, std::vector<int> > sources;
+	for(unsigned int c=0; c<candidates.size(); ++c)
+	{
+		const Link & link = candidates[c];
+		excluded.insert(std::make_pair(std::min(link.from(), link.to()), std::max(link.from(), link.to())));
+		int i = poseIndex(ids, link.from());
+		if(i >= 0 && poseIndex(ids, link.to()) >= 0 && link.from() != link.to())
+		{
+			sources[i].push_back(c);
+		}
+	}
+	if(sources.empty())
+	{
+		return chi2s;
+	}
+
+	// undirected adjacency in compressed rows, without unary links and
+	// without the candidates, built once for all candidates
+	std::vector<const Link *> graphLinks;
+	std::vector<std::pair<int, int> > graphIndices;
+	addGraphLinks(links, ids, excluded, graphLinks, graphIndices);
+	if(extraLinks)
+	{
+		addGraphLinks(*extraLinks, ids, excluded, graphLinks, graphIndices);
+	}
+	std::vector<int> rowOffsets(ids.size()+1, 0);
+	for(unsigned int e=0; e<graphIndices.size(); ++e)
+	{
+		++rowOffsets[graphIndices[e].first+1];
+		++rowOffsets[graphIndices[e].second+1];
+	}
+	for(unsigned int i=1; i<rowOffsets.size(); ++i)
+	{
+		rowOffsets[i] += rowOffsets[i-1];
+	}
+	std::vector<int> columns(rowOffsets.back()); // link indices
+	std::vector<int> fill(rowOffsets.begin(), rowOffsets.end()-1);
+	for(unsigned int e=0; e<graphIndices.size(); ++e)
+	{
+		columns[fill[graphIndices[e].first]++] = e;
+		columns[fill[graphIndices[e].second]++] = e;
+	}
+
+	std::vector<double> costs(ids.size());
+	std::vector<int> parents(ids.size()); // link index
+	std::vector<unsigned char> closed(ids.size());
+	for(std::map<int, std::vector<int> >::iterator sourceIter=sources.begin(); sourceIter!=sources.end(); ++sourceIter)
+	{
+		int fromIndex = sourceIter->first;
+		std::set<int> targets;
+		for(unsigned int k=0; k<sourceIter->second.size(); ++k)
+		{
+			targets.insert(poseIndex(ids, candidates[sourceIter->second[k]].to()));
+		}
+
+		// Dijkstra: most certain paths from the "from" pose to all targets
+		std::fill(costs.begin(), costs.end(), std::numeric_limits<double>::max());
+		std::fill(parents.begin(), parents.end(), -1);
+		std::fill(closed.begin(), closed.end(), 0);
+		std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int> >, std::greater<std::pair<double, int> > > queue;
+		costs[fromIndex] = 0.0;
+		queue.push(std::make_pair(0.0, fromIndex));
+		int targetsLeft = (int)targets.size();
+		while(!queue.empty() && targetsLeft > 0)
+		{
+			std::pair<double, int> top = queue.top();
+			queue.pop();
+			int i = top.second;
+			if(closed[i])
+			{
+				continue;
+			}
+			closed[i] = 1;
+			if(targets.find(i) != targets.end())
+			{
+				--targetsLeft;
+			}
+			for(int k=rowOffsets[i]; k<rowOffsets[i+1]; ++k)
+			{
+				int e = columns[k];
+				int other = graphIndices[e].first == i?graphIndices[e].second:graphIndices[e].first;
+				if(closed[other])
+				{
+					continue;
+				}
+				const Link * l = graphLinks[e];
+				double cost = top.first + (isCovarianceIgnored()?1.0:l->transVariance(false) + l->rotVariance(false));
+				if(cost < costs[other])
+				{
+					costs[other] = cost;
+					parents[other] = e;
+					queue.push(std::make_pair(cost, other));
+				}
+			}
+		}
+
+		for(unsigned int k=0; k<sourceIter->second.size(); ++k)
+		{
+			int c = sourceIter->second[k];
+			const Link & link = candidates[c];
+			int toIndex = poseIndex(ids, link.to());
+			if(!closed[toIndex])
+			{
+				UDEBUG("Link %d->%d cannot be evaluated, poses are not connected", link.from(), link.to());
+				continue;
+			}
+
+			// Propagate the covariance of each link along the path in the frame
+			// of link.from() (noise of a link is applied on the side of its "to" pose)
+			Transform fromPoseInv = posesPtr[fromIndex]->inverse();
+			Eigen::Matrix<double, 6, 6> sigma = Eigen::Matrix<double, 6, 6>::Zero();
+			int pathLength = 0;
+			for(int i = toIndex; i != fromIndex; ++pathLength)
+			{
+				int e = parents[i];
+				Eigen::Matrix<double, 6, 6> ad = adjoint(fromPoseInv * *posesPtr[graphIndices[e].second]);
+				sigma += ad * linkCovariance(*graphLinks[e], isCovarianceIgnored()) * ad.transpose();
+				i = graphIndices[e].first == i?graphIndices[e].second:graphIndices[e].first;
+			}
+
+			// ...then in the frame of link.to(), like the link residual
+			Transform relative = fromPoseInv * *posesPtr[toIndex];
+			Eigen::Matrix<double, 6, 6> adInv = adjoint(relative.inverse());
+			sigma = adInv * sigma * adInv.transpose();
+			if(relativeCovariances)
+			{
+				cv::Mat & relativeCovariance = relativeCovariances->at(c);
+				relativeCovariance = cv::Mat(6, 6, CV_64FC1);
+				for(int i=0; i<6; ++i)
+				{
+					for(int j=0; j<6; ++j)
+					{
+						relativeCovariance.at<double>(i,j) = sigma(i,j);
+					}
+				}
+			}
+			sigma += linkCovariance(link, isCovarianceIgnored());
+
+			float x,y,z,roll,pitch,yaw;
+			(link.transform().inverse() * relative).getTranslationAndEulerAngles(x,y,z,roll,pitch,yaw);
+			Eigen::Matrix<double, 6, 1> error;
+			error << x, y, z, roll, pitch, yaw;
+
+			double chi2;
+			if(isSlam2d())
+			{
+				const int indices[3] = {0, 1, 5}; // x, y, yaw
+				Eigen::Matrix3d sigma2d;
+				Eigen::Vector3d error2d;
+				for(int i=0; i<3; ++i)
+				{
+					error2d[i] = error[indices[i]];
+					for(int j=0; j<3; ++j)
+					{
+						sigma2d(i,j) = sigma(indices[i], indices[j]);
+					}
+				}
+				chi2 = error2d.dot(sigma2d.inverse() * error2d);
+			}
+			else
+			{
+				chi2 = error.dot(sigma.inverse() * error);
+			}
+			UDEBUG("Link %d->%d: chi2=%f (path of %d links)", link.from(), link.to(), chi2, pathLength);
+			chi2s[c] = chi2;
+		}
+	}
+	return chi2s;
+}
+
 std::map<int, Transform> Optimizer::optimizeBA(
 		int rootId,
 		const std::map<int, Transform> & poses,
@@ -553,6 +553,9 @@ const char * Parameters::showUsage()
 			"   --logconsole         Set logger console type\n"
 			"   --logfile \"path\"     Set logger file type\n"
 			"   --logfilea \"path\"    Set logger file type with appending mode if the file already exists\n"
+			"   --logbinary \"path\"   Set logger binary file type (decode it with rtabmap-log_decoder)\n"
+			"   --logbinarya \"path\"  Set logger binary file type with appending mode if the file already exists\n"
+			"   --logasync           Format and write log messages in a background thread\n"
 			"   --udebug             Set logger level to debug\n"
 			"   --uinfo              Set logger level to info\n"
 			"   --uwarn              Set logger level to warn\n"
@@ -826,6 +829,34 @@ ParametersMap Parameters::parseArguments(int argc, char * argv[], bool onlyParam
 					UERROR("\"--logfilea\" argument requires following file path");
 				}
 			}
+			else if(strcmp(argv[i], "--logbinary") == 0)
+			{
+				++i;
+				if(i < argc)
+				{
+					ULogger::setType(ULogger::kTypeBinaryFile, argv[i], false);
+				}
+				else
+				{
+					UERROR("\"--logbinary\" argument requires following file path");
+				}
+			}
+			else if(strcmp(argv[i], "--logbinarya") == 0)
+			{
+				++i;
+				if(i < argc)
+				{
+					ULogger::setType(ULogger::kTypeBinaryFile, argv[i], true);
+				}
+				else
+				{
+					UERROR("\"--logbinarya\" argument requires following file path");
+				}
+			}
+			else if(strcmp(argv[i], "--logasync") == 0)
+			{
+				ULogger::setAsynchronous(true);
+			}
 			else if(strcmp(argv[i], "--udebug") == 0)
 			{
 				ULogger::setLevel(ULogger::kDebug);
@@ -0,0 +1,511 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/PathGraph.h"
+
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+namespace rtabmap {
+
+PathGraph::PathGraph() :
+	links_(0),
+	changes_(0),
+	mark_(1)
+{
+}
+
+void PathGraph::clear()
+{
+	idToIndex_.clear();
+	ids_.clear();
+	poses_.clear();
+	positions_.clear();
+	rowOffsets_.clear();
+	columns_.clear();
+	columnMarks_.clear();
+	addedLinks_.clear();
+	links_ = 0;
+	changes_ = 0;
+	costs_.clear();
+	parents_.clear();
+	closed_.clear();
+}
+
+int PathGraph::lookup(int id) const
+{
+	std::map<int, int>::const_iterator iter = idToIndex_.find(id);
+	return iter!=idToIndex_.end()?iter->second:-1;
+}
+
+void PathGraph::addNode(int id, const Transform & pose)
+{
+	int index = lookup(id);
+	if(index >= 0)
+	{
+		poses_[index] = pose;
+		positions_[index] = cv::Point3f(pose.x(), pose.y(), pose.z());
+	}
+	else
+	{
+		addNodeIndex(id, pose);
+	}
+}
+
+bool PathGraph::removeNode(int id)
+{
+	int index = lookup(id);
+	if(index >= 0)
+	{
+		removeNodeIndex(index);
+		return true;
+	}
+	return false;
+}
+
+bool PathGraph::addLink(int from, int to)
+{
+	int i = lookup(from);
+	int j = lookup(to);
+	if(i >= 0 && j >= 0)
+	{
+		addLinkIndex(i, j);
+		return true;
+	}
+	return false;
+}
+
+bool PathGraph::removeLink(int from, int to)
+{
+	int i = lookup(from);
+	int j = lookup(to);
+	if(i >= 0 && j >= 0)
+	{
+		return removeLinkIndex(i, j);
+	}
+	return false;
+}
+
+bool PathGraph::hasLink(int from, int to) const
+{
+	int i = lookup(from);
+	int j = lookup(to);
+	return i >= 0 && j >= 0 && findLinkIndex(i, j) != 0;
+}
+
+int PathGraph::addNodeIndex(int id, const Transform & pose)
+{
+	UASSERT(!pose.isNull());
+	int index = (int)ids_.size();
+	ids_.push_back(id);
+	poses_.push_back(pose);
+	positions_.push_back(cv::Point3f(pose.x(), pose.y(), pose.z()));
+	addedLinks_.push_back(std::vector<std::pair<int, unsigned int> >());
+	idToIndex_.insert(std::make_pair(id, index));
+	++changes_;
+	return index;
+}
+
+void PathGraph::removeNodeIndex(int index)
+{
+	std::vector<int> neighbors;
+	getNeighbors(index, neighbors);
+	for(unsigned int k=0; k<neighbors.size(); ++k)
+	{
+		removeLinkIndex(index, neighbors[k]);
+	}
+	idToIndex_.erase(ids_[index]);
+	ids_[index] = 0;
+	poses_[index] = Transform();
+	++changes_;
+}
+
+const unsigned int * PathGraph::findLinkIndex(int i, int j) const
+{
+	if(i+1 < (int)rowOffsets_.size())
+	{
+		std::vector<int>::const_iterator begin = columns_.begin()+rowOffsets_[i];
+		std::vector<int>::const_iterator end = columns_.begin()+rowOffsets_[i+1];
+		std::vector<int>::const_iterator iter = std::lower_bound(begin, end, j);
+		if(iter != end && *iter == j && columnMarks_[iter-columns_.begin()] != 0)
+		{
+			return &columnMarks_[iter-columns_.begin()];
+		}
+	}
+	const std::vector<std::pair<int, unsigned int> > & added = addedLinks_[i];
+	for(unsigned int k=0; k<added.size(); ++k)
+	{
+		if(added[k].first == j)
+		{
+			return &added[k].second;
+		}
+	}
+	return 0;
+}
+
+unsigned int * PathGraph::findLinkIndex(int i, int j)
+{
+	return const_cast<unsigned int *>(static_cast<const PathGraph*>(this)->findLinkIndex(i, j));
+}
+
+bool PathGraph::addLinkIndex(int i, int j)
+{
+	if(i == j)
+	{
+		return false;
+	}
+	unsigned int * mark = findLinkIndex(i, j);
+	if(mark)
+	{
+		// already there, just refresh it
+		*mark = mark_;
+		mark = findLinkIndex(j, i);
+		UASSERT(mark != 0);
+		*mark = mark_;
+		return false;
+	}
+	addedLinks_[i].push_back(std::make_pair(j, mark_));
+	addedLinks_[j].push_back(std::make_pair(i, mark_));
+	++links_;
+	++changes_;
+	return true;
+}
+
+bool PathGraph::removeLinkIndex(int i, int j)
+{
+	bool removed = false;
+	for(int n=0; n<2; ++n)
+	{
+		int a = n==0?i:j;
+		int b = n==0?j:i;
+		if(a+1 < (int)rowOffsets_.size())
+		{
+			std::vector<int>::iterator begin = columns_.begin()+rowOffsets_[a];
+			std::vector<int>::iterator end = columns_.begin()+rowOffsets_[a+1];
+			std::vector<int>::iterator iter = std::lower_bound(begin, end, b);
+			if(iter != end && *iter == b && columnMarks_[iter-columns_.begin()] != 0)
+			{
+				columnMarks_[iter-columns_.begin()] = 0;
+				removed = true;
+			}
+		}
+		std::vector<std::pair<int, unsigned int> > & added = addedLinks_[a];
+		for(std::vector<std::pair<int, unsigned int> >::iterator iter=added.begin(); iter!=added.end(); ++iter)
+		{
+			if(iter->first == b)
+			{
+				added.erase(iter);
+				removed = true;
+				break;
+			}
+		}
+	}
+	if(removed)
+	{
+		--links_;
+		++changes_;
+	}
+	return removed;
+}
+
+void PathGraph::getNeighbors(int i, std::vector<int> & neighbors) const
+{
+	neighbors.clear();
+	if(i+1 < (int)rowOffsets_.size())
+	{
+		for(int k=rowOffsets_[i]; k<rowOffsets_[i+1]; ++k)
+		{
+			if(columnMarks_[k] != 0)
+			{
+				neighbors.push_back(columns_[k]);
+			}
+		}
+	}
+	const std::vector<std::pair<int, unsigned int> > & added = addedLinks_[i];
+	for(unsigned int k=0; k<added.size(); ++k)
+	{
+		neighbors.push_back(added[k].first);
+	}
+}
+
+void PathGraph::update(const std::map<int, Transform> & poses, const std::multimap<int, Link> & links)
+{
+	UTimer timer;
+	int changes = changes_;
+
+	updateNodes(poses);
+
+	// Links, all links seen are marked so that we can remove those not found anymore
+	++mark_;
+	bool fromCached = false;
+	int from = 0;
+	int fromIndex = -1;
+	for(std::multimap<int, Link>::const_iterator lter=links.begin(); lter!=links.end(); ++lter)
+	{
+		if(lter->second.from() == lter->second.to())
+		{
+			continue;
+		}
+		if(!fromCached || from != lter->second.from())
+		{
+			from = lter->second.from();
+			fromIndex = lookup(from);
+			fromCached = true;
+		}
+		int toIndex = lookup(lter->second.to());
+		if(fromIndex >= 0 && toIndex >= 0)
+		{
+			addLinkIndex(fromIndex, toIndex);
+		}
+	}
+	int removed = removeUnmarkedLinks();
+
+	UDEBUG("Graph updated: nodes=%d links=%d changes=%d removed links=%d (%fs)",
+			nodes(), links_, changes_-changes, removed, timer.ticks());
+}
+
+void PathGraph::update(const std::map<int, Transform> & poses, const std::multimap<int, int> & links)
+{
+	UTimer timer;
+	int changes = changes_;
+
+	updateNodes(poses);
+
+	++mark_;
+	int from = 0;
+	int fromIndex = -1;
+	for(std::multimap<int, int>::const_iterator lter=links.begin(); lter!=links.end(); ++lter)
+	{
+		if(lter->first == lter->second)
+		{
+			continue;
+		}
+		if(lter == links.begin() || from != lter->first)
+		{
+			from = lter->first;
+			fromIndex = lookup(from);
+		}
+		int toIndex = lookup(lter->second);
+		if(fromIndex >= 0 && toIndex >= 0)
+		{
+			addLinkIndex(fromIndex, toIndex);
+		}
+	}
+	int removed = removeUnmarkedLinks();
+
+	UDEBUG("Graph updated: nodes=%d links=%d changes=%d removed links=%d (%fs)",
+			nodes(), links_, changes_-changes, removed, timer.ticks());
+}
+
+void PathGraph::updateNodes(const std::map<int, Transform> & poses)
+{
+	// Nodes (both maps are sorted by id)
+	std::map<int, Transform>::const_iterator pter = poses.begin();
+	std::map<int, int>::iterator iter = idToIndex_.begin();
+	while(pter != poses.end() || iter != idToIndex_.end())
+	{
+		if(iter == idToIndex_.end() || (pter != poses.end() && pter->first < iter->first))
+		{
+			addNodeIndex(pter->first, pter->second);
+			++pter;
+		}
+		else if(pter == poses.end() || iter->first < pter->first)
+		{
+			int index = iter->second;
+			++iter;
+			removeNodeIndex(index);
+		}
+		else
+		{
+			poses_[iter->second] = pter->second;
+			positions_[iter->second] = cv::Point3f(pter->second.x(), pter->second.y(), pter->second.z());
+			++iter;
+			++pter;
+		}
+	}
+}
+
+int PathGraph::removeUnmarkedLinks()
+{
+	std::vector<std::pair<int, int> > removed;
+	for(std::map<int, int>::iterator iter=idToIndex_.begin(); iter!=idToIndex_.end(); ++iter)
+	{
+		int i = iter->second;
+		if(i+1 < (int)rowOffsets_.size())
+		{
+			for(int k=rowOffsets_[i]; k<rowOffsets_[i+1]; ++k)
+			{
+				if(columns_[k] > i && columnMarks_[k] != 0 && columnMarks_[k] != mark_)
+				{
+					removed.push_back(std::make_pair(i, columns_[k]));
+				}
+			}
+		}
+		const std::vector<std::pair<int, unsigned int> > & added = addedLinks_[i];
+		for(unsigned int k=0; k<added.size(); ++k)
+		{
+			if(added[k].first > i && added[k].second != mark_)
+			{
+				removed.push_back(std::make_pair(i, added[k].first));
+			}
+		}
+	}
+	for(unsigned int k=0; k<removed.size(); ++k)
+	{
+		removeLinkIndex(removed[k].first, removed[k].second);
+	}
+	return (int)removed.size();
+}
+
+void PathGraph::compact()
+{
+	UTimer timer;
+	std::vector<int> newIndices(ids_.size(), -1);
+	std::vector<int> ids;
+	std::vector<Transform> poses;
+	std::vector<cv::Point3f> positions;
+	ids.reserve(idToIndex_.size());
+	poses.reserve(idToIndex_.size());
+	positions.reserve(idToIndex_.size());
+	for(std::map<int, int>::iterator iter=idToIndex_.begin(); iter!=idToIndex_.end(); ++iter)
+	{
+		newIndices[iter->second] = (int)ids.size();
+		ids.push_back(iter->first);
+		poses.push_back(poses_[iter->second]);
+		positions.push_back(positions_[iter->second]);
+	}
+
+	std::vector<int> rowOffsets(ids.size()+1, 0);
+	std::vector<int> columns;
+	columns.reserve(links_*2);
+	std::vector<int> neighbors;
+	int row = 0;
+	for(std::map<int, int>::iterator iter=idToIndex_.begin(); iter!=idToIndex_.end(); ++iter, ++row)
+	{
+		getNeighbors(iter->second, neighbors);
+		size_t begin = columns.size();
+		for(unsigned int k=0; k<neighbors.size(); ++k)
+		{
+			UASSERT(newIndices[neighbors[k]] >= 0);
+			columns.push_back(newIndices[neighbors[k]]);
+		}
+		std::sort(columns.begin()+begin, columns.end());
+		rowOffsets[row+1] = (int)columns.size();
+		iter->second = row;
+	}
+
+	ids_.swap(ids);
+	poses_.swap(poses);
+	positions_.swap(positions);
+	rowOffsets_.swap(rowOffsets);
+	columns_.swap(columns);
+	columnMarks_.assign(columns_.size(), mark_);
+	addedLinks_.clear();
+	addedLinks_.resize(ids_.size());
+	UASSERT(int(columns_.size()) == links_*2);
+	changes_ = 0;
+
+	UDEBUG("Graph compacted: nodes=%d links=%d (%fs)", nodes(), links_, timer.ticks());
+}
+
+std::list<std::pair<int, Transform> > PathGraph::computePath(int from, int to)
+{
+	std::list<std::pair<int, Transform> > path;
+
+	if(changes_ > std::max(100, links_/10))
+	{
+		compact();
+	}
+
+	int start = lookup(from);
+	int goal = lookup(to);
+	if(start < 0 || goal < 0)
+	{
+		UWARN("Nodes %d (%s) and %d (%s) should be in the graph!",
+				from, start<0?"not found":"found",
+				to, goal<0?"not found":"found");
+		return path;
+	}
+
+	UTimer timer;
+	costs_.assign(ids_.size(), std::numeric_limits<float>::max());
+	parents_.assign(ids_.size(), -1);
+	closed_.assign(ids_.size(), 0);
+
+	typedef std::pair<float, int> Entry; // <cost + heuristic, index>
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+	const cv::Point3f goalPosition = positions_[goal];
+	costs_[start] = 0.0f;
+	open.push(Entry((float)cv::norm(positions_[start] - goalPosition), start));
+	int visited = 0;
+	while(!open.empty())
+	{
+		int i = open.top().second;
+		open.pop();
+		if(closed_[i])
+		{
+			// already visited with a lower cost
+			continue;
+		}
+		closed_[i] = 1;
+		++visited;
+
+		if(i == goal)
+		{
+			for(int k=goal; k>=0; k=parents_[k])
+			{
+				path.push_front(std::make_pair(ids_[k], poses_[k]));
+			}
+			break;
+		}
+
+		getNeighbors(i, neighbors_);
+		for(unsigned int k=0; k<neighbors_.size(); ++k)
+		{
+			int j = neighbors_[k];
+			if(!closed_[j])
+			{
+				float cost = costs_[i] + (float)cv::norm(positions_[j] - positions_[i]);
+				if(cost < costs_[j])
+				{
+					costs_[j] = cost;
+					parents_[j] = i;
+					open.push(Entry(cost + (float)cv::norm(positions_[j] - goalPosition), j));
+				}
+			}
+		}
+	}
+	UDEBUG("A* from %d to %d: path=%d nodes, visited=%d/%d (%fs)",
+			from, to, (int)path.size(), visited, nodes(), timer.ticks());
+	return path;
+}
+
+} /* namespace rtabmap */
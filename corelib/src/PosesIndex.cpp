@@ -0,0 +1,387 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/PosesIndex.h"
+
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UMath.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <algorithm>
+
+namespace rtabmap {
+
+// cell coordinates are packed on 21 bits each
+static const int kCellOffset = 1<<20;
+
+PosesIndex::PosesIndex(float cellSize) :
+	cellSize_(cellSize)
+{
+	UASSERT(cellSize_ > 0.0f);
+}
+
+void PosesIndex::setCellSize(float cellSize)
+{
+	UASSERT(cellSize > 0.0f);
+	if(cellSize != cellSize_)
+	{
+		std::map<int, Transform> poses;
+		for(std::map<int, Entry>::iterator iter=poses_.begin(); iter!=poses_.end(); ++iter)
+		{
+			poses.insert(poses.end(), std::make_pair(iter->first, iter->second.pose));
+		}
+		this->clear();
+		cellSize_ = cellSize;
+		this->update(poses);
+	}
+}
+
+void PosesIndex::clear()
+{
+	poses_.clear();
+	cells_.clear();
+	minCell_ = cv::Point3i();
+	maxCell_ = cv::Point3i();
+}
+
+cv::Point3i PosesIndex::cellCoordinates(const cv::Point3f & position) const
+{
+	cv::Point3i cell(
+			cvFloor(position.x/cellSize_),
+			cvFloor(position.y/cellSize_),
+			cvFloor(position.z/cellSize_));
+	cell.x = std::max(std::min(cell.x, kCellOffset-1), -kCellOffset);
+	cell.y = std::max(std::min(cell.y, kCellOffset-1), -kCellOffset);
+	cell.z = std::max(std::min(cell.z, kCellOffset-1), -kCellOffset);
+	return cell;
+}
+
+long long PosesIndex::cellKey(const cv::Point3i & cell)
+{
+	return ((long long)(cell.x + kCellOffset) << 42) |
+		   ((long long)(cell.y + kCellOffset) << 21) |
+		   (long long)(cell.z + kCellOffset);
+}
+
+void PosesIndex::insertInCell(int id, const cv::Point3f & position, const cv::Point3i & cell)
+{
+	if(cells_.empty())
+	{
+		minCell_ = maxCell_ = cell;
+	}
+	else
+	{
+		minCell_.x = std::min(minCell_.x, cell.x);
+		minCell_.y = std::min(minCell_.y, cell.y);
+		minCell_.z = std::min(minCell_.z, cell.z);
+		maxCell_.x = std::max(maxCell_.x, cell.x);
+		maxCell_.y = std::max(maxCell_.y, cell.y);
+		maxCell_.z = std::max(maxCell_.z, cell.z);
+	}
+	cells_[cellKey(cell)].push_back(std::make_pair(id, position));
+}
+
+void PosesIndex::removeFromCell(int id, long long cell)
+{
+	std::map<long long, std::vector<std::pair<int, cv::Point3f> > >::iterator iter = cells_.find(cell);
+	UASSERT(iter != cells_.end());
+	std::vector<std::pair<int, cv::Point3f> > & ids = iter->second;
+	for(unsigned int i=0; i<ids.size(); ++i)
+	{
+		if(ids[i].first == id)
+		{
+			ids[i] = ids.back();
+			ids.pop_back();
+			break;
+		}
+	}
+	if(ids.empty())
+	{
+		cells_.erase(iter);
+	}
+}
+
+void PosesIndex::add(int id, const Transform & pose)
+{
+	std::map<int, Entry>::iterator iter = poses_.find(id);
+	if(iter == poses_.end())
+	{
+		UASSERT_MSG(!pose.isNull() && uIsFinite(pose.x()) && uIsFinite(pose.y()) && uIsFinite(pose.z()),
+				uFormat("Invalid pose (%d) %s", id, pose.prettyPrint().c_str()).c_str());
+		Entry entry;
+		entry.pose = pose;
+		entry.position = cv::Point3f(pose.x(), pose.y(), pose.z());
+		cv::Point3i cell = cellCoordinates(entry.position);
+		entry.cell = cellKey(cell);
+		poses_.insert(std::make_pair(id, entry));
+		insertInCell(id, entry.position, cell);
+	}
+	else
+	{
+		move(iter, pose);
+	}
+}
+
+void PosesIndex::move(std::map<int, Entry>::iterator & iter, const Transform & pose)
+{
+	Entry & entry = iter->second;
+	entry.pose = pose;
+	if(entry.position.x != pose.x() || entry.position.y != pose.y() || entry.position.z != pose.z())
+	{
+		UASSERT_MSG(!pose.isNull() && uIsFinite(pose.x()) && uIsFinite(pose.y()) && uIsFinite(pose.z()),
+				uFormat("Invalid pose (%d) %s", iter->first, pose.prettyPrint().c_str()).c_str());
+		removeFromCell(iter->first, entry.cell);
+		entry.position = cv::Point3f(pose.x(), pose.y(), pose.z());
+		cv::Point3i cell = cellCoordinates(entry.position);
+		entry.cell = cellKey(cell);
+		insertInCell(iter->first, entry.position, cell);
+	}
+}
+
+bool PosesIndex::remove(int id)
+{
+	std::map<int, Entry>::iterator iter = poses_.find(id);
+	if(iter != poses_.end())
+	{
+		removeFromCell(id, iter->second.cell);
+		poses_.erase(iter);
+		return true;
+	}
+	return false;
+}
+
+void PosesIndex::update(const std::map<int, Transform> & poses)
+{
+	// both maps are sorted by id
+	std::map<int, Transform>::const_iterator pter = poses.begin();
+	std::map<int, Entry>::iterator iter = poses_.begin();
+	while(pter != poses.end() || iter != poses_.end())
+	{
+		if(iter == poses_.end() || (pter != poses.end() && pter->first < iter->first))
+		{
+			add(pter->first, pter->second);
+			++pter;
+		}
+		else if(pter == poses.end() || iter->first < pter->first)
+		{
+			removeFromCell(iter->first, iter->second.cell);
+			poses_.erase(iter++);
+		}
+		else
+		{
+			move(iter, pter->second);
+			++iter;
+			++pter;
+		}
+	}
+}
+
+const Transform & PosesIndex::pose(int id) const
+{
+	std::map<int, Entry>::const_iterator iter = poses_.find(id);
+	UASSERT_MSG(iter != poses_.end(), uFormat("Pose %d not found in the index", id).c_str());
+	return iter->second.pose;
+}
+
+std::map<int, float> PosesIndex::radiusSearch(const cv::Point3f & center, float radius) const
+{
+	std::map<int, float> found;
+	if(poses_.empty() || radius <= 0.0f)
+	{
+		return found;
+	}
+	float radiusSqrd = radius*radius;
+	cv::Point3i a = cellCoordinates(cv::Point3f(center.x-radius, center.y-radius, center.z-radius));
+	cv::Point3i b = cellCoordinates(cv::Point3f(center.x+radius, center.y+radius, center.z+radius));
+	a.x = std::max(a.x, minCell_.x); a.y = std::max(a.y, minCell_.y); a.z = std::max(a.z, minCell_.z);
+	b.x = std::min(b.x, maxCell_.x); b.y = std::min(b.y, maxCell_.y); b.z = std::min(b.z, maxCell_.z);
+	if(a.x > b.x || a.y > b.y || a.z > b.z)
+	{
+		return found;
+	}
+
+	long long cellsToSearch = (long long)(b.x-a.x+1)*(long long)(b.y-a.y+1)*(long long)(b.z-a.z+1);
+	if(cellsToSearch > (long long)cells_.size())
+	{
+		// radius is large compared to the map, check all cells
+		for(std::map<long long, std::vector<std::pair<int, cv::Point3f> > >::const_iterator iter=cells_.begin(); iter!=cells_.end(); ++iter)
+		{
+			for(unsigned int i=0; i<iter->second.size(); ++i)
+			{
+				const cv::Point3f & pt = iter->second[i].second;
+				float d = (pt.x-center.x)*(pt.x-center.x) + (pt.y-center.y)*(pt.y-center.y) + (pt.z-center.z)*(pt.z-center.z);
+				if(d <= radiusSqrd)
+				{
+					found.insert(std::make_pair(iter->second[i].first, d));
+				}
+			}
+		}
+	}
+	else
+	{
+		for(int x=a.x; x<=b.x; ++x)
+		{
+			for(int y=a.y; y<=b.y; ++y)
+			{
+				for(int z=a.z; z<=b.z; ++z)
+				{
+					std::map<long long, std::vector<std::pair<int, cv::Point3f> > >::const_iterator iter = cells_.find(cellKey(cv::Point3i(x,y,z)));
+					if(iter != cells_.end())
+					{
+						for(unsigned int i=0; i<iter->second.size(); ++i)
+						{
+							const cv::Point3f & pt = iter->second[i].second;
+							float d = (pt.x-center.x)*(pt.x-center.x) + (pt.y-center.y)*(pt.y-center.y) + (pt.z-center.z)*(pt.z-center.z);
+							if(d <= radiusSqrd)
+							{
+								found.insert(std::make_pair(iter->second[i].first, d));
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	return found;
+}
+
+void PosesIndex::searchCell(
+		const cv::Point3i & cell,
+		const cv::Point3f & center,
+		bool ignoreLandmarks,
+		std::vector<std::pair<float, int> > & candidates) const
+{
+	std::map<long long, std::vector<std::pair<int, cv::Point3f> > >::const_iterator iter = cells_.find(cellKey(cell));
+	if(iter != cells_.end())
+	{
+		for(unsigned int i=0; i<iter->second.size(); ++i)
+		{
+			if(!ignoreLandmarks || iter->second[i].first > 0)
+			{
+				const cv::Point3f & pt = iter->second[i].second;
+				float d = (pt.x-center.x)*(pt.x-center.x) + (pt.y-center.y)*(pt.y-center.y) + (pt.z-center.z)*(pt.z-center.z);
+				candidates.push_back(std::make_pair(d, iter->second[i].first));
+			}
+		}
+	}
+}
+
+std::vector<int> PosesIndex::nearestKSearch(
+		const cv::Point3f & center,
+		int k,
+		bool ignoreLandmarks,
+		std::vector<float> * sqrdDistances) const
+{
+	std::vector<int> ids;
+	if(k <= 0 || poses_.empty())
+	{
+		return ids;
+	}
+
+	std::vector<std::pair<float, int> > candidates;
+	cv::Point3i c = cellCoordinates(center);
+	int maxRing = std::max(std::max(std::max(abs(c.x-minCell_.x), abs(c.x-maxCell_.x)),
+							std::max(abs(c.y-minCell_.y), abs(c.y-maxCell_.y))),
+							std::max(abs(c.z-minCell_.z), abs(c.z-maxCell_.z)));
+	long long cellsVisited = 0;
+	bool bruteForce = false;
+	for(int r=0; r<=maxRing && !bruteForce; ++r)
+	{
+		// visit only cells on the shell of the cube of half size r
+		for(int dx=-r; dx<=r && !bruteForce; ++dx)
+		{
+			int x = c.x+dx;
+			if(x < minCell_.x || x > maxCell_.x)
+			{
+				continue;
+			}
+			for(int dy=-r; dy<=r; ++dy)
+			{
+				int y = c.y+dy;
+				if(y < minCell_.y || y > maxCell_.y)
+				{
+					continue;
+				}
+				bool shell = r==0 || dx==-r || dx==r || dy==-r || dy==r;
+				for(int dz=-r; dz<=r; dz+=shell?1:2*r)
+				{
+					int z = c.z+dz;
+					if(z >= minCell_.z && z <= maxCell_.z)
+					{
+						searchCell(cv::Point3i(x,y,z), center, ignoreLandmarks, candidates);
+						++cellsVisited;
+					}
+				}
+			}
+			// Too many empty cells (query far from the poses), check all poses instead
+			bruteForce = cellsVisited > 4*(long long)cells_.size()+27;
+		}
+
+		if(!bruteForce && (int)candidates.size() >= k)
+		{
+			// poses not visited yet are at least r cells away
+			std::nth_element(candidates.begin(), candidates.begin()+(k-1), candidates.end());
+			float minDistance = float(r)*cellSize_;
+			if(candidates[k-1].first <= minDistance*minDistance)
+			{
+				break;
+			}
+		}
+	}
+
+	if(bruteForce)
+	{
+		candidates.clear();
+		for(std::map<int, Entry>::const_iterator iter=poses_.begin(); iter!=poses_.end(); ++iter)
+		{
+			if(!ignoreLandmarks || iter->first > 0)
+			{
+				const cv::Point3f & pt = iter->second.position;
+				float d = (pt.x-center.x)*(pt.x-center.x) + (pt.y-center.y)*(pt.y-center.y) + (pt.z-center.z)*(pt.z-center.z);
+				candidates.push_back(std::make_pair(d, iter->first));
+			}
+		}
+	}
+
+	int n = std::min(k, (int)candidates.size());
+	std::partial_sort(candidates.begin(), candidates.begin()+n, candidates.end());
+	ids.resize(n);
+	if(sqrdDistances)
+	{
+		sqrdDistances->resize(n);
+	}
+	for(int i=0; i<n; ++i)
+	{
+		ids[i] = candidates[i].second;
+		if(sqrdDistances)
+		{
+			sqrdDistances->at(i) = candidates[i].first;
+		}
+	}
+	return ids;
+}
+
+} /* namespace rtabmap */
@@ -28,6 +28,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <rtabmap/core/RegistrationVis.h>
 #include <rtabmap/core/RegistrationIcp.h>
+#include <rtabmap/core/Trace.h>
 #include <rtabmap/utilite/ULogger.h>
 #include <rtabmap/utilite/UTimer.h>
 
@@ -191,6 +192,7 @@ Transform Registration::computeTransformationMod(
 		Transform guess,
 		RegistrationInfo * infoOut) const
 {
+	RTABMAP_TRACE_SCOPE("Registration::computeTransformation");
 	UTimer time;
 	RegistrationInfo info;
 	if(infoOut)
@@ -27,6 +27,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "rtabmap/core/Rtabmap.h"
 #include "rtabmap/core/Version.h"
+#include "rtabmap/core/Trace.h"
 #include "rtabmap/core/Features2d.h"
 #include "rtabmap/core/Optimizer.h"
 #include "rtabmap/core/Graph.h"
@@ -46,6 +47,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UProcessInfo.h>
+#include <rtabmap/utilite/UThreadPool.h>
 
 #include <pcl/search/kdtree.h>
 #include <pcl/filters/crop_box.h>
@@ -116,6 +118,7 @@ Rtabmap::Rtabmap() :
 	_databasePath(""),
 	_optimizeFromGraphEnd(Parameters::defaultRGBDOptimizeFromGraphEnd()),
 	_optimizationMaxError(Parameters::defaultRGBDOptimizeMaxError()),
+	_optimizationMaxChi2(Parameters::defaultRGBDOptimizeMaxChi2()),
 	_startNewMapOnLoopClosure(Parameters::defaultRtabmapStartNewMapOnLoopClosure()),
 	_startNewMapOnGoodSignature(Parameters::defaultRtabmapStartNewMapOnGoodSignature()),
 	_goalReachedRadius(Parameters::defaultRGBDGoalReachedRadius()),
@@ -142,7 +145,10 @@ Rtabmap::Rtabmap() :
 	_mapCorrection(Transform::getIdentity()),
 	_lastLocalizationNodeId(0),
 	_currentSessionHasGPS(false),
+	_posesIndexTime(0.0),
 	_pathStatus(0),
+	_pathGraphOutdated(true),
+	_wmPathGraphOutdated(true),
 	_pathCurrentIndex(0),
 	_pathGoalIndex(0),
 	_pathTransformToGoal(Transform::getIdentity()),
@@ -329,6 +335,9 @@ void Rtabmap::init(const ParametersMap & parameters, const std::string & databas
 		// Get just the links
 		_memory->getMetricConstraints(uKeysSet(_optimizedPoses), tmp, _constraints, false, true);
 	}
+	_pathGraphOutdated = true;
+	_wmPathGraphOutdated = true;
+	_posesIndex.update(_optimizedPoses);
 
 	if(_databasePath.empty())
 	{
@@ -398,6 +407,11 @@ void Rtabmap::close(bool databaseSaved, const std::string & ouputDatabasePath)
 		_memory = 0;
 	}
 	_optimizedPoses.clear();
+	_pathGraph.clear();
+	_wmPathGraph.clear();
+	_pathGraphOutdated = true;
+	_wmPathGraphOutdated = true;
+	_posesIndex.clear();
 	_lastLocalizationPose.setNull();
 
 	if(_bayesFilter)
@@ -458,6 +472,7 @@ void Rtabmap::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(parameters, Parameters::kRGBDProximityBySpace(), _proximityBySpace);
 	Parameters::parse(parameters, Parameters::kRGBDScanMatchingIdsSavedInLinks(), _scanMatchingIdsSavedInLinks);
 	Parameters::parse(parameters, Parameters::kRGBDLocalRadius(), _localRadius);
+	_posesIndex.setCellSize(_localRadius>0.0f?_localRadius:1.0f);
 	Parameters::parse(parameters, Parameters::kRGBDLocalImmunizationRatio(), _localImmunizationRatio);
 	Parameters::parse(parameters, Parameters::kRGBDProximityMaxGraphDepth(), _proximityMaxGraphDepth);
 	Parameters::parse(parameters, Parameters::kRGBDProximityMaxPaths(), _proximityMaxPaths);
@@ -470,6 +485,7 @@ void Rtabmap::parseParameters(const ParametersMap & parameters)
 	}
 	Parameters::parse(parameters, Parameters::kRGBDOptimizeFromGraphEnd(), _optimizeFromGraphEnd);
 	Parameters::parse(parameters, Parameters::kRGBDOptimizeMaxError(), _optimizationMaxError);
+	Parameters::parse(parameters, Parameters::kRGBDOptimizeMaxChi2(), _optimizationMaxChi2);
 	if(_optimizationMaxError > 0.0 && _optimizationMaxError < 1.0)
 	{
 		UWARN("RGBD/OptimizeMaxError (value=%f) is smaller than 1.0, setting to default %f "
@@ -698,6 +714,9 @@ void Rtabmap::setInitialPose(const Transform & initialPose)
 			{
 				cv::Mat covariance;
 				this->optimizeCurrentMap(_memory->getLastWorkingSignature()->id(), false, _optimizedPoses, covariance, &_constraints);
+				_pathGraphOutdated = true;
+				_wmPathGraphOutdated = true;
+				_posesIndex.update(_optimizedPoses);
 			}
 		}
 		else
@@ -724,6 +743,9 @@ int Rtabmap::triggerNewMap()
 		UINFO("New map triggered, new map = %d", mapId);
 		_optimizedPoses.clear();
 		_constraints.clear();
+		_pathGraph.clear();
+		_wmPathGraph.clear();
+		_posesIndex.clear();
 		_lastLocalizationNodeId = 0;
 		_odomCachePoses.clear();
 		_odomCacheConstraints.clear();
@@ -870,6 +892,9 @@ void Rtabmap::resetMemory()
 	_someNodesHaveBeenTransferred = false;
 	_optimizedPoses.clear();
 	_constraints.clear();
+	_pathGraph.clear();
+	_wmPathGraph.clear();
+	_posesIndex.clear();
 	_mapCorrection.setIdentity();
 	_mapCorrectionBackup.setNull();
 	_lastLocalizationPose.setNull();
@@ -886,6 +911,9 @@ void Rtabmap::resetMemory()
 		{
 			cv::Mat covariance;
 			optimizeCurrentMap(_memory->getLastWorkingSignature()->id(), false, _optimizedPoses, covariance, &_constraints);
+			_pathGraphOutdated = true;
+			_wmPathGraphOutdated = true;
+			_posesIndex.update(_optimizedPoses);
 		}
 		if(_bayesFilter)
 		{
@@ -960,6 +988,7 @@ bool Rtabmap::process(
 		const std::vector<float> & odomVelocity,
 		const std::map<std::string, float> & externalStats)
 {
+	RTABMAP_TRACE_SCOPE("Rtabmap::process");
 	UDEBUG("");
 
 	//============================================================
@@ -975,6 +1004,7 @@ bool Rtabmap::process(
 	double timeCleaningNeighbors = 0;
 	double timeReactivations = 0;
 	double timeAddLoopClosureLink = 0;
+	double timeLoopClosureGating = 0;
 	double timeMapOptimization = 0;
 	double timeRetrievalDbAccess = 0;
 	double timeLikelihoodCalculation = 0;
@@ -987,6 +1017,7 @@ bool Rtabmap::process(
 	double timeFinalizingStatistics = 0;
 	double timeJoiningTrash = 0;
 	double timeStatsCreation = 0;
+	_posesIndexTime = 0.0;
 
 	float hypothesisRatio = 0.0f; // Only used for statistics
 	bool rejectedHypothesis = false;
@@ -1049,8 +1080,7 @@ bool Rtabmap::process(
 				{
 					//set map->odom so that odom is moved back to last saved localization
 					_mapCorrection = _lastLocalizationPose * odomPose.inverse();
-					std::map<int, Transform> nodesOnly(_optimizedPoses.lower_bound(1), _optimizedPoses.end());
-					_lastLocalizationNodeId = graph::findNearestNode(nodesOnly, _lastLocalizationPose);
+					_lastLocalizationNodeId = findNearestNode(_lastLocalizationPose, true);
 					UWARN("Update map correction based on last localization saved in database! correction = %s, nearest id = %d of last pose = %s, odom = %s",
 							_mapCorrection.prettyPrint().c_str(),
 							_lastLocalizationNodeId,
@@ -1065,6 +1095,9 @@ bool Rtabmap::process(
 					{
 						iter->second = mapCorrectionInv * iter->second;
 					}
+					_pathGraphOutdated = true;
+					_wmPathGraphOutdated = true;
+					_posesIndex.update(_optimizedPoses);
 				}
 			}
 		}
@@ -1158,14 +1191,17 @@ bool Rtabmap::process(
 	std::list<int> signaturesRemoved;
 	if(_rgbdSlamMode)
 	{
-		statistics_.addStatistic(Statistics::kMemoryOdometry_variance_lin(), odomCovariance.empty()?1.0f:(float)odomCovariance.at<double>(0,0));
-		statistics_.addStatistic(Statistics::kMemoryOdometry_variance_ang(), odomCovariance.empty()?1.0f:(float)odomCovariance.at<double>(5,5));
+		statistics_.addStatistic(Statistics::idMemoryOdometry_variance_lin(), odomCovariance.empty()?1.0f:(float)odomCovariance.at<double>(0,0));
+		statistics_.addStatistic(Statistics::idMemoryOdometry_variance_ang(), odomCovariance.empty()?1.0f:(float)odomCovariance.at<double>(5,5));
 
 		//Verify if there was a rehearsal
-		int rehearsedId = (int)uValue(statistics_.data(), Statistics::kMemoryRehearsal_merged(), 0.0f);
+		int rehearsedId = (int)statistics_.value(Statistics::idMemoryRehearsal_merged(), 0.0f);
 		if(rehearsedId > 0)
 		{
 			_optimizedPoses.erase(rehearsedId);
+			_pathGraph.removeNode(rehearsedId);
+			_wmPathGraph.removeNode(rehearsedId);
+			_posesIndex.remove(rehearsedId);
 		}
 		else
 		{
@@ -1269,6 +1305,9 @@ bool Rtabmap::process(
 							{
 								iter->second = mapCorrectionInv * up * iter->second;
 							}
+							_pathGraphOutdated = true;
+							_wmPathGraphOutdated = true;
+							_posesIndex.update(_optimizedPoses);
 						}
 					}
 					else
@@ -1280,13 +1319,13 @@ bool Rtabmap::process(
 							_memory->updateLink(Link(oldId, signature->id(), signature->getLinks().begin()->second.type(), guess, (info.covariance*100.0).inv()));
 						}
 					}
-					statistics_.addStatistic(Statistics::kNeighborLinkRefiningAccepted(), !t.isNull()?1.0f:0);
-					statistics_.addStatistic(Statistics::kNeighborLinkRefiningInliers(), info.inliers);
-					statistics_.addStatistic(Statistics::kNeighborLinkRefiningICP_inliers_ratio(), info.icpInliersRatio);
-					statistics_.addStatistic(Statistics::kNeighborLinkRefiningICP_rotation(), info.icpRotation);
-					statistics_.addStatistic(Statistics::kNeighborLinkRefiningICP_translation(), info.icpTranslation);
-					statistics_.addStatistic(Statistics::kNeighborLinkRefiningICP_complexity(), info.icpStructuralComplexity);
-					statistics_.addStatistic(Statistics::kNeighborLinkRefiningPts(), signature->sensorData().laserScanRaw().size());
+					statistics_.addStatistic(Statistics::idNeighborLinkRefiningAccepted(), !t.isNull()?1.0f:0);
+					statistics_.addStatistic(Statistics::idNeighborLinkRefiningInliers(), info.inliers);
+					statistics_.addStatistic(Statistics::idNeighborLinkRefiningICP_inliers_ratio(), info.icpInliersRatio);
+					statistics_.addStatistic(Statistics::idNeighborLinkRefiningICP_rotation(), info.icpRotation);
+					statistics_.addStatistic(Statistics::idNeighborLinkRefiningICP_translation(), info.icpTranslation);
+					statistics_.addStatistic(Statistics::idNeighborLinkRefiningICP_complexity(), info.icpStructuralComplexity);
+					statistics_.addStatistic(Statistics::idNeighborLinkRefiningPts(), signature->sensorData().laserScanRaw().size());
 				}
 				timeNeighborLinkRefining = timer.ticks();
 				ULOGGER_INFO("timeOdometryRefining=%fs", timeNeighborLinkRefining);
@@ -1294,7 +1333,7 @@ bool Rtabmap::process(
 				UASSERT(oldS->hasLink(signature->id()));
 				UASSERT(uContains(_optimizedPoses, oldId));
 
-				statistics_.addStatistic(Statistics::kNeighborLinkRefiningVariance(), oldS->getLinks().find(signature->id())->second.transVariance());
+				statistics_.addStatistic(Statistics::idNeighborLinkRefiningVariance(), oldS->getLinks().find(signature->id())->second.transVariance());
 
 				newPose = _optimizedPoses.at(oldId) * oldS->getLinks().find(signature->id())->second.transform();
 				_mapCorrection = newPose * signature->getPose().inverse();
@@ -1319,6 +1358,9 @@ bool Rtabmap::process(
 		UDEBUG("Added pose %s (odom=%s)", newPose.prettyPrint().c_str(), signature->getPose().prettyPrint().c_str());
 		// Update Poses and Constraints
 		_optimizedPoses.insert(std::make_pair(signature->id(), newPose));
+		_pathGraph.addNode(signature->id(), newPose);
+		_wmPathGraph.addNode(signature->id(), newPose);
+		_posesIndex.add(signature->id(), newPose);
 		if(_memory->isIncremental() && signature->getWeight() >= 0)
 		{
 			for(std::map<int, Link>::const_iterator iter = signature->getLandmarks().begin(); iter!=signature->getLandmarks().end(); ++iter)
@@ -1326,8 +1368,12 @@ bool Rtabmap::process(
 				if(_optimizedPoses.find(iter->first) == _optimizedPoses.end())
 				{
 					_optimizedPoses.insert(std::make_pair(iter->first, newPose*iter->second.transform()));
+					_pathGraph.addNode(iter->first, newPose*iter->second.transform());
+					_wmPathGraph.addNode(iter->first, newPose*iter->second.transform());
+					_posesIndex.add(iter->first, newPose*iter->second.transform());
 				}
 				_constraints.insert(std::make_pair(iter->first, iter->second.inverse()));
+				_pathGraph.addLink(iter->first, signature->id());
 			}
 		}
 		if(signature->getLinks().size() &&
@@ -1352,9 +1398,17 @@ bool Rtabmap::process(
 					tmp = _constraints.rbegin()->second.merge(tmp, tmp.type());
 					_optimizedPoses.erase(s->id());
 					_constraints.erase(--_constraints.end());
+					_pathGraph.removeNode(s->id());
+					_wmPathGraph.removeNode(s->id());
+					_posesIndex.remove(s->id());
 				}
 			}
 			_constraints.insert(std::make_pair(tmp.from(), tmp));
+			if(!_pathGraph.addLink(tmp.from(), tmp.to()))
+			{
+				// previous node not in the graph, the link will be added on next synchronization
+				_pathGraphOutdated = true;
+			}
 		}
 		// Localization mode stuff
 		_lastLocalizationPose = newPose; // keep in cache the latest corrected pose
@@ -1415,6 +1469,11 @@ bool Rtabmap::process(
 				int erased = (int)_optimizedPoses.erase(iter->first);
 				if(erased)
 				{
+					_pathGraph.removeNode(iter->first);
+					_wmPathGraph.removeNode(iter->first);
+					_posesIndex.remove(iter->first);
+					// links of the merged node have been moved to other nodes
+					_wmPathGraphOutdated = true;
 					for(std::multimap<int, Link>::iterator jter = _constraints.begin(); jter!=_constraints.end();)
 					{
 						if(jter->second.from() == iter->first || jter->second.to() == iter->first)
@@ -1523,7 +1582,7 @@ bool Rtabmap::process(
 					if(_optimizedPoses.size() && _memory->isIncremental())
 					{
 						//Search for latest node having GPS linked to current signature not too far.
-						std::map<int, float> nearestIds = graph::getNodesInRadius(signature->id(), _optimizedPoses, _localRadius);
+						std::map<int, float> nearestIds = getNodesInRadius(signature->id(), _localRadius);
 						for(std::map<int, float>::reverse_iterator iter=nearestIds.rbegin(); iter!=nearestIds.rend() && iter->first>0; ++iter)
 						{
 							const Signature * s = _memory->getSignature(iter->first);
@@ -1961,17 +2020,12 @@ bool Rtabmap::process(
 					(_localRadius==0 ||
 					 _optimizedPoses.at(signature->id()).getDistance(_optimizedPoses.at(nearestId)) < _localRadius))
 				{
-					std::multimap<int, int> links;
-					for(std::multimap<int, Link>::iterator iter=_constraints.begin(); iter!=_constraints.end(); ++iter)
+					if(_pathGraphOutdated)
 					{
-						if(uContains(_optimizedPoses, iter->second.from()) && uContains(_optimizedPoses, iter->second.to()))
-						{
-							links.insert(std::make_pair(iter->second.from(), iter->second.to()));
-							links.insert(std::make_pair(iter->second.to(), iter->second.from())); // <->
-						}
+						_pathGraph.update(_optimizedPoses, _constraints);
+						_pathGraphOutdated = false;
 					}
-
-					std::list<std::pair<int, Transform> > path = graph::computePath(_optimizedPoses, links, nearestId, signature->id());
+					std::list<std::pair<int, Transform> > path = _pathGraph.computePath(nearestId, signature->id());
 					if(path.size() == 0)
 					{
 						UWARN("Could not compute a path between %d and %d", nearestId, signature->id());
@@ -2019,7 +2073,7 @@ bool Rtabmap::process(
 
 			// retrieval based on the nodes close the the nearest pose in WM
 			// immunize closest nodes
-			std::map<int, float> nearNodes = graph::getNodesInRadius(signature->id(), _optimizedPoses, _localRadius);
+			std::map<int, float> nearNodes = getNodesInRadius(signature->id(), _localRadius);
 			// sort by distance
 			std::multimap<float, int> nearNodesByDist;
 			for(std::map<int, float>::iterator iter=nearNodes.lower_bound(1); iter!=nearNodes.end(); ++iter)
@@ -2245,7 +2299,7 @@ bool Rtabmap::process(
 				}
 				else
 				{
-					nearestIds = graph::getNodesInRadius(signature->id(), _optimizedPoses, _localRadius);
+					nearestIds = getNodesInRadius(signature->id(), _localRadius);
 				}
 				UDEBUG("nearestIds=%d/%d", (int)nearestIds.size(), (int)_optimizedPoses.size());
 				std::map<int, Transform> nearestPoses;
@@ -2546,6 +2600,81 @@ bool Rtabmap::process(
 		}
 	}
 
+	//============================================================
+	// Loop closure gating
+	//============================================================
+	float maxLoopClosureChi2 = 0.0f;
+	if(_rgbdSlamMode &&
+	   _memory->isIncremental() && // like the max error check below, only in mapping mode
+	   _optimizationMaxChi2 > 0.0f &&
+	   loopClosureLinksAdded.size() &&
+	   uContains(_optimizedPoses, signature->id()))
+	{
+		// Evaluate the added loop closures at the current solution, without
+		// re-optimizing the graph. The new node is connected to the graph
+		// by its other links.
+		std::multimap<int, Link> newLinks;
+		for(std::multimap<int, Link>::const_iterator iter=signature->getLinks().begin(); iter!=signature->getLinks().end(); ++iter)
+		{
+			if(iter->second.type() == Link::kNeighbor ||
+			   iter->second.type() == Link::kNeighborMerged)
+			{
+				newLinks.insert(std::make_pair(iter->second.from(), iter->second));
+			}
+		}
+		std::vector<Link> candidates;
+		std::vector<std::pair<int, int> > candidateIds;
+		for(std::list<std::pair<int, int> >::iterator iter=loopClosureLinksAdded.begin(); iter!=loopClosureLinksAdded.end(); ++iter)
+		{
+			std::multimap<int, Link>::const_iterator linkIter = graph::findLink(signature->getLinks(), iter->first, iter->second, false);
+			if(linkIter != signature->getLinks().end())
+			{
+				candidates.push_back(linkIter->second);
+				candidateIds.push_back(*iter);
+			}
+		}
+		std::vector<double> chi2s = _graphOptimizer->computeLinksChi2(_optimizedPoses, _constraints, candidates, &newLinks);
+		bool reject = false;
+		for(unsigned int i=0; !reject && i<chi2s.size(); ++i)
+		{
+			double chi2 = chi2s[i];
+			if(chi2 >= 0.0)
+			{
+				UINFO("Loop closure %d->%d chi2=%f", candidateIds[i].first, candidateIds[i].second, chi2);
+				maxLoopClosureChi2 = std::max(maxLoopClosureChi2, (float)chi2);
+				if(chi2 > _optimizationMaxChi2)
+				{
+					UWARN("Rejecting all added loop closures (%d, first is %d <-> %d) in this "
+						  "iteration because loop closure %d->%d would increase the graph chi2 "
+						  "by %f. The maximum chi2 parameter \"%s\" is %f.",
+						  (int)loopClosureLinksAdded.size(),
+						  loopClosureLinksAdded.front().first,
+						  loopClosureLinksAdded.front().second,
+						  candidateIds[i].first,
+						  candidateIds[i].second,
+						  chi2,
+						  Parameters::kRGBDOptimizeMaxChi2().c_str(),
+						  _optimizationMaxChi2);
+					reject = true;
+				}
+			}
+		}
+
+		if(reject)
+		{
+			for(std::list<std::pair<int, int> >::iterator iter=loopClosureLinksAdded.begin(); iter!=loopClosureLinksAdded.end(); ++iter)
+			{
+				_memory->removeLink(iter->first, iter->second);
+				UWARN("Loop closure %d->%d rejected!", iter->first, iter->second);
+			}
+			loopClosureLinksAdded.clear();
+			_loopClosureHypothesis.first = 0;
+			lastProximitySpaceClosureId = 0;
+			rejectedHypothesis = true;
+		}
+		timeLoopClosureGating = timer.ticks();
+	}
+
 	//============================================================
 	// Optimize map graph
 	//============================================================
@@ -2611,6 +2740,8 @@ bool Rtabmap::process(
 					UWARN("Both optimized pose references are null! Flushing cached odometry poses. Localization won't be verified.");
 					_odomCachePoses.clear();
 					_constraints.clear();
+					_pathGraphOutdated = true;
+					_wmPathGraphOutdated = true;
 				}
 				else
 				{
@@ -2747,7 +2878,7 @@ bool Rtabmap::process(
 							targetRotation = Transform(0,0,0,roll,pitch,targetRotation.theta());
 							Transform error = transform.rotation().inverse() * iterGravitySign->second.transform().rotation().inverse() * targetRotation;
 							transform *= error;
-
+
 							u  = signature->getPose() * transform;
 						}
 						else
@@ -2761,6 +2892,9 @@ bool Rtabmap::process(
 						iter->second = mapCorrectionInv * up * iter->second;
 					}
 					_optimizedPoses.at(signature->id()) = signature->getPose();
+					_pathGraphOutdated = true;
+					_wmPathGraphOutdated = true;
+					_posesIndex.update(_optimizedPoses);
 				}
 				else
 				{
@@ -2808,6 +2942,9 @@ bool Rtabmap::process(
 						}
 					}
 					_optimizedPoses.at(signature->id()) = newPose;
+					_pathGraph.addNode(signature->id(), newPose);
+					_wmPathGraph.addNode(signature->id(), newPose);
+					_posesIndex.add(signature->id(), newPose);
 				}
 				localizationCovariance = localizationLinks.begin()->second.infMatrix().inv();
 
@@ -2964,6 +3101,9 @@ bool Rtabmap::process(
 				UINFO("Updated local map (old size=%d, new size=%d)", (int)_optimizedPoses.size(), (int)poses.size());
 				_optimizedPoses = poses;
 				_constraints = constraints;
+				_pathGraphOutdated = true;
+				_wmPathGraphOutdated = true;
+				_posesIndex.update(_optimizedPoses);
 				localizationCovariance = covariance;
 			}
 		}
@@ -2995,6 +3135,9 @@ bool Rtabmap::process(
 			}
 		}
 	}
+	// All links of the new node are known at this point (neighbor, loop closure and proximity links)
+	addWMPathGraphLinks(signature->id());
+
 	int newLocId = _loopClosureHypothesis.first>0?_loopClosureHypothesis.first:lastProximitySpaceClosureId>0?lastProximitySpaceClosureId:0;
 	_lastLocalizationNodeId = newLocId!=0?newLocId:_lastLocalizationNodeId;
 	if(newLocId==0 && landmarkDetected!=0)
@@ -3020,8 +3163,8 @@ bool Rtabmap::process(
 	int refWordsCount = 0;
 	int refUniqueWordsCount = 0;
 	int lcHypothesisReactivated = 0;
-	float rehearsalValue = uValue(statistics_.data(), Statistics::kMemoryRehearsal_sim(), 0.0f);
-	int rehearsalMaxId = (int)uValue(statistics_.data(), Statistics::kMemoryRehearsal_merged(), 0.0f);
+	float rehearsalValue = statistics_.value(Statistics::idMemoryRehearsal_sim(), 0.0f);
+	int rehearsalMaxId = (int)statistics_.value(Statistics::idMemoryRehearsal_merged(), 0.0f);
 	sLoop = _memory->getSignature(_loopClosureHypothesis.first?_loopClosureHypothesis.first:lastProximitySpaceClosureId?lastProximitySpaceClosureId:_highestHypothesis.first);
 	if(sLoop)
 	{
@@ -3052,34 +3195,35 @@ bool Rtabmap::process(
 			ULOGGER_INFO("send all stats...");
 			statistics_.setExtended(1);
 
-			statistics_.addStatistic(Statistics::kLoopAccepted_hypothesis_id(), _loopClosureHypothesis.first);
-			statistics_.addStatistic(Statistics::kLoopHighest_hypothesis_id(), _highestHypothesis.first);
-			statistics_.addStatistic(Statistics::kLoopHighest_hypothesis_value(), _highestHypothesis.second);
-			statistics_.addStatistic(Statistics::kLoopHypothesis_reactivated(), lcHypothesisReactivated);
-			statistics_.addStatistic(Statistics::kLoopVp_hypothesis(), vpHypothesis);
-			statistics_.addStatistic(Statistics::kLoopReactivate_id(), retrievalId);
-			statistics_.addStatistic(Statistics::kLoopHypothesis_ratio(), hypothesisRatio);
-			statistics_.addStatistic(Statistics::kLoopVisual_inliers(), loopClosureVisualInliers);
-			statistics_.addStatistic(Statistics::kLoopVisual_matches(), loopClosureVisualMatches);
-			statistics_.addStatistic(Statistics::kLoopLinear_variance(), loopClosureLinearVariance);
-			statistics_.addStatistic(Statistics::kLoopAngular_variance(), loopClosureAngularVariance);
-			statistics_.addStatistic(Statistics::kLoopLast_id(), _memory->getLastGlobalLoopClosureId());
-			statistics_.addStatistic(Statistics::kLoopOptimization_max_error(), maxLinearError);
-			statistics_.addStatistic(Statistics::kLoopOptimization_max_error_ratio(), maxLinearErrorRatio);
-			statistics_.addStatistic(Statistics::kLoopOptimization_error(), optimizationError);
-			statistics_.addStatistic(Statistics::kLoopOptimization_iterations(), optimizationIterations);
-			statistics_.addStatistic(Statistics::kLoopLandmark_detected(), -landmarkDetected);
-			statistics_.addStatistic(Statistics::kLoopLandmark_detected_node_ref(), landmarkDetectedNodesRef.empty()?0:*landmarkDetectedNodesRef.begin());
-			statistics_.addStatistic(Statistics::kLoopVisual_inliers_mean_dist(), loopClosureVisualInliersMeanDist);
-			statistics_.addStatistic(Statistics::kLoopVisual_inliers_distribution(), loopClosureVisualInliersDistribution);
-
-			statistics_.addStatistic(Statistics::kProximityTime_detections(), proximityDetectionsInTimeFound);
-			statistics_.addStatistic(Statistics::kProximitySpace_detections_added_visually(), proximityDetectionsAddedVisually);
-			statistics_.addStatistic(Statistics::kProximitySpace_detections_added_icp_only(), proximityDetectionsAddedByICPOnly);
-			statistics_.addStatistic(Statistics::kProximitySpace_paths(), proximitySpacePaths);
-			statistics_.addStatistic(Statistics::kProximitySpace_visual_paths_checked(), localVisualPathsChecked);
-			statistics_.addStatistic(Statistics::kProximitySpace_scan_paths_checked(), localScanPathsChecked);
-			statistics_.addStatistic(Statistics::kProximitySpace_last_detection_id(), lastProximitySpaceClosureId);
+			statistics_.addStatistic(Statistics::idLoopAccepted_hypothesis_id(), _loopClosureHypothesis.first);
+			statistics_.addStatistic(Statistics::idLoopHighest_hypothesis_id(), _highestHypothesis.first);
+			statistics_.addStatistic(Statistics::idLoopHighest_hypothesis_value(), _highestHypothesis.second);
+			statistics_.addStatistic(Statistics::idLoopHypothesis_reactivated(), lcHypothesisReactivated);
+			statistics_.addStatistic(Statistics::idLoopVp_hypothesis(), vpHypothesis);
+			statistics_.addStatistic(Statistics::idLoopReactivate_id(), retrievalId);
+			statistics_.addStatistic(Statistics::idLoopHypothesis_ratio(), hypothesisRatio);
+			statistics_.addStatistic(Statistics::idLoopVisual_inliers(), loopClosureVisualInliers);
+			statistics_.addStatistic(Statistics::idLoopVisual_matches(), loopClosureVisualMatches);
+			statistics_.addStatistic(Statistics::idLoopLinear_variance(), loopClosureLinearVariance);
+			statistics_.addStatistic(Statistics::idLoopAngular_variance(), loopClosureAngularVariance);
+			statistics_.addStatistic(Statistics::idLoopLast_id(), _memory->getLastGlobalLoopClosureId());
+			statistics_.addStatistic(Statistics::idLoopOptimization_max_error(), maxLinearError);
+			statistics_.addStatistic(Statistics::idLoopOptimization_max_error_ratio(), maxLinearErrorRatio);
+			statistics_.addStatistic(Statistics::idLoopOptimization_error(), optimizationError);
+			statistics_.addStatistic(Statistics::idLoopOptimization_iterations(), optimizationIterations);
+			statistics_.addStatistic(Statistics::idLoopOptimization_max_chi2(), maxLoopClosureChi2);
+			statistics_.addStatistic(Statistics::idLoopLandmark_detected(), -landmarkDetected);
+			statistics_.addStatistic(Statistics::idLoopLandmark_detected_node_ref(), landmarkDetectedNodesRef.empty()?0:*landmarkDetectedNodesRef.begin());
+			statistics_.addStatistic(Statistics::idLoopVisual_inliers_mean_dist(), loopClosureVisualInliersMeanDist);
+			statistics_.addStatistic(Statistics::idLoopVisual_inliers_distribution(), loopClosureVisualInliersDistribution);
+
+			statistics_.addStatistic(Statistics::idProximityTime_detections(), proximityDetectionsInTimeFound);
+			statistics_.addStatistic(Statistics::idProximitySpace_detections_added_visually(), proximityDetectionsAddedVisually);
+			statistics_.addStatistic(Statistics::idProximitySpace_detections_added_icp_only(), proximityDetectionsAddedByICPOnly);
+			statistics_.addStatistic(Statistics::idProximitySpace_paths(), proximitySpacePaths);
+			statistics_.addStatistic(Statistics::idProximitySpace_visual_paths_checked(), localVisualPathsChecked);
+			statistics_.addStatistic(Statistics::idProximitySpace_scan_paths_checked(), localScanPathsChecked);
+			statistics_.addStatistic(Statistics::idProximitySpace_last_detection_id(), lastProximitySpaceClosureId);
 			statistics_.setProximityDetectionId(lastProximitySpaceClosureId);
 			statistics_.setProximityDetectionMapId(_memory->getMapId(lastProximitySpaceClosureId));
 			if(_loopClosureHypothesis.first || lastProximitySpaceClosureId)
@@ -3096,17 +3240,17 @@ bool Rtabmap::process(
 				{
 					Transform transformGT = sLoop->getGroundTruthPose().inverse() * signature->getGroundTruthPose();
 					Transform error = loopIter->second.transform().inverse() * transformGT;
-					statistics_.addStatistic(Statistics::kGtLocalization_linear_error(), error.getNorm());
-					statistics_.addStatistic(Statistics::kGtLocalization_angular_error(), error.getAngle(1,0,0)*180/M_PI);
+					statistics_.addStatistic(Statistics::idGtLocalization_linear_error(), error.getNorm());
+					statistics_.addStatistic(Statistics::idGtLocalization_angular_error(), error.getAngle(1,0,0)*180/M_PI);
 				}
 
 				// Map correction (/map -> /odom)
-				statistics_.addStatistic(Statistics::kLoopMap_correction_norm(), _mapCorrection.getNorm());
+				statistics_.addStatistic(Statistics::idLoopMap_correction_norm(), _mapCorrection.getNorm());
 				float roll,pitch,yaw;
 				_mapCorrection.getEulerAngles(roll, pitch, yaw);
-				statistics_.addStatistic(Statistics::kLoopMap_correction_roll(),  roll*180/M_PI);
-				statistics_.addStatistic(Statistics::kLoopMap_correction_pitch(),  pitch*180/M_PI);
-				statistics_.addStatistic(Statistics::kLoopMap_correction_yaw(), yaw*180/M_PI);
+				statistics_.addStatistic(Statistics::idLoopMap_correction_roll(),  roll*180/M_PI);
+				statistics_.addStatistic(Statistics::idLoopMap_correction_pitch(),  pitch*180/M_PI);
+				statistics_.addStatistic(Statistics::idLoopMap_correction_yaw(), yaw*180/M_PI);
 			}
 			statistics_.setMapCorrection(_mapCorrection);
 			UINFO("Set map correction = %s", _mapCorrection.prettyPrint().c_str());
@@ -3114,37 +3258,39 @@ bool Rtabmap::process(
 			statistics_.setProximityDetectionId(lastProximitySpaceClosureId);
 
 			// timings...
-			statistics_.addStatistic(Statistics::kTimingMemory_update(), timeMemoryUpdate*1000);
-			statistics_.addStatistic(Statistics::kTimingNeighbor_link_refining(), timeNeighborLinkRefining*1000);
-			statistics_.addStatistic(Statistics::kTimingProximity_by_time(), timeProximityByTimeDetection*1000);
-			statistics_.addStatistic(Statistics::kTimingProximity_by_space_visual(), timeProximityBySpaceVisualDetection*1000);
-			statistics_.addStatistic(Statistics::kTimingProximity_by_space(), timeProximityBySpaceDetection*1000);
-			statistics_.addStatistic(Statistics::kTimingReactivation(), timeReactivations*1000);
-			statistics_.addStatistic(Statistics::kTimingAdd_loop_closure_link(), timeAddLoopClosureLink*1000);
-			statistics_.addStatistic(Statistics::kTimingMap_optimization(), timeMapOptimization*1000);
-			statistics_.addStatistic(Statistics::kTimingLikelihood_computation(), timeLikelihoodCalculation*1000);
-			statistics_.addStatistic(Statistics::kTimingPosterior_computation(), timePosteriorCalculation*1000);
-			statistics_.addStatistic(Statistics::kTimingHypotheses_creation(), timeHypothesesCreation*1000);
-			statistics_.addStatistic(Statistics::kTimingHypotheses_validation(), timeHypothesesValidation*1000);
-			statistics_.addStatistic(Statistics::kTimingCleaning_neighbors(), timeCleaningNeighbors*1000);
+			statistics_.addStatistic(Statistics::idTimingMemory_update(), timeMemoryUpdate*1000);
+			statistics_.addStatistic(Statistics::idTimingNeighbor_link_refining(), timeNeighborLinkRefining*1000);
+			statistics_.addStatistic(Statistics::idTimingProximity_by_time(), timeProximityByTimeDetection*1000);
+			statistics_.addStatistic(Statistics::idTimingProximity_by_space_visual(), timeProximityBySpaceVisualDetection*1000);
+			statistics_.addStatistic(Statistics::idTimingProximity_by_space(), timeProximityBySpaceDetection*1000);
+			statistics_.addStatistic(Statistics::idTimingReactivation(), timeReactivations*1000);
+			statistics_.addStatistic(Statistics::idTimingAdd_loop_closure_link(), timeAddLoopClosureLink*1000);
+			statistics_.addStatistic(Statistics::idTimingLoop_closure_gating(), timeLoopClosureGating*1000);
+			statistics_.addStatistic(Statistics::idTimingMap_optimization(), timeMapOptimization*1000);
+			statistics_.addStatistic(Statistics::idTimingPoses_index(), _posesIndexTime*1000);
+			statistics_.addStatistic(Statistics::idTimingLikelihood_computation(), timeLikelihoodCalculation*1000);
+			statistics_.addStatistic(Statistics::idTimingPosterior_computation(), timePosteriorCalculation*1000);
+			statistics_.addStatistic(Statistics::idTimingHypotheses_creation(), timeHypothesesCreation*1000);
+			statistics_.addStatistic(Statistics::idTimingHypotheses_validation(), timeHypothesesValidation*1000);
+			statistics_.addStatistic(Statistics::idTimingCleaning_neighbors(), timeCleaningNeighbors*1000);
 
 			// retrieval
-			statistics_.addStatistic(Statistics::kMemorySignatures_retrieved(), (float)signaturesRetrieved.size());
+			statistics_.addStatistic(Statistics::idMemorySignatures_retrieved(), (float)signaturesRetrieved.size());
 
 			// Surf specific parameters
-			statistics_.addStatistic(Statistics::kKeypointDictionary_size(), dictionarySize);
-			statistics_.addStatistic(Statistics::kKeypointIndexed_words(), _memory->getVWDictionary()->getIndexedWordsCount());
-			statistics_.addStatistic(Statistics::kKeypointIndex_memory_usage(), _memory->getVWDictionary()->getIndexMemoryUsed());
+			statistics_.addStatistic(Statistics::idKeypointDictionary_size(), dictionarySize);
+			statistics_.addStatistic(Statistics::idKeypointIndexed_words(), _memory->getVWDictionary()->getIndexedWordsCount());
+			statistics_.addStatistic(Statistics::idKeypointIndex_memory_usage(), _memory->getVWDictionary()->getIndexMemoryUsed());
 
 			//Epipolar geometry constraint
-			statistics_.addStatistic(Statistics::kLoopRejectedHypothesis(), rejectedHypothesis?1.0f:0);
+			statistics_.addStatistic(Statistics::idLoopRejectedHypothesis(), rejectedHypothesis?1.0f:0);
 
-			statistics_.addStatistic(Statistics::kMemorySmall_movement(), smallDisplacement?1.0f:0);
-			statistics_.addStatistic(Statistics::kMemoryDistance_travelled(), _distanceTravelled);
-			statistics_.addStatistic(Statistics::kMemoryFast_movement(), tooFastMovement?1.0f:0);
+			statistics_.addStatistic(Statistics::idMemorySmall_movement(), smallDisplacement?1.0f:0);
+			statistics_.addStatistic(Statistics::idMemoryDistance_travelled(), _distanceTravelled);
+			statistics_.addStatistic(Statistics::idMemoryFast_movement(), tooFastMovement?1.0f:0);
 			if(_publishRAMUsage)
 			{
-				statistics_.addStatistic(Statistics::kMemoryRAM_usage(), UProcessInfo::getMemoryUsage()/(1024*1024));
+				statistics_.addStatistic(Statistics::idMemoryRAM_usage(), UProcessInfo::getMemoryUsage()/(1024*1024));
 			}
 
 			if(_publishLikelihood || _publishPdf)
@@ -3336,6 +3482,9 @@ bool Rtabmap::process(
 				UDEBUG("Detected that only last signature has been removed");
 				int lastId = signaturesRemoved.front();
 				_optimizedPoses.erase(lastId);
+				_pathGraph.removeNode(lastId);
+				_wmPathGraph.removeNode(lastId);
+				_posesIndex.remove(lastId);
 				for(std::multimap<int, Link>::iterator iter=_constraints.find(lastId); iter!=_constraints.end() && iter->first==lastId;++iter)
 				{
 					iter->second.to();
@@ -3357,6 +3506,9 @@ bool Rtabmap::process(
 					{
 						UDEBUG("Removed %d from local map", iter->first);
 						UASSERT(iter->first != _lastLocalizationNodeId);
+						_pathGraph.removeNode(iter->first);
+						_wmPathGraph.removeNode(iter->first);
+						_posesIndex.remove(iter->first);
 						_optimizedPoses.erase(iter++);
 					}
 					else
@@ -3381,6 +3533,9 @@ bool Rtabmap::process(
 		{
 			_optimizedPoses.clear();
 			_constraints.clear();
+			_pathGraph.clear();
+			_wmPathGraph.clear();
+			_posesIndex.clear();
 		}
 	}
 	// just some verifications to make sure that planning path is still in the local map!
@@ -3402,23 +3557,23 @@ bool Rtabmap::process(
 	int localGraphSize = 0;
 	if(_publishStats)
 	{
-		statistics_.addStatistic(Statistics::kTimingStatistics_creation(), timeStatsCreation*1000);
-		statistics_.addStatistic(Statistics::kTimingTotal(), totalTime*1000);
-		statistics_.addStatistic(Statistics::kTimingForgetting(), timeRealTimeLimitReachedProcess*1000);
-		statistics_.addStatistic(Statistics::kTimingJoining_trash(), timeJoiningTrash*1000);
-		statistics_.addStatistic(Statistics::kTimingEmptying_trash(), timeEmptyingTrash*1000);
-		statistics_.addStatistic(Statistics::kTimingMemory_cleanup(), timeMemoryCleanup*1000);
+		statistics_.addStatistic(Statistics::idTimingStatistics_creation(), timeStatsCreation*1000);
+		statistics_.addStatistic(Statistics::idTimingTotal(), totalTime*1000);
+		statistics_.addStatistic(Statistics::idTimingForgetting(), timeRealTimeLimitReachedProcess*1000);
+		statistics_.addStatistic(Statistics::idTimingJoining_trash(), timeJoiningTrash*1000);
+		statistics_.addStatistic(Statistics::idTimingEmptying_trash(), timeEmptyingTrash*1000);
+		statistics_.addStatistic(Statistics::idTimingMemory_cleanup(), timeMemoryCleanup*1000);
 
 		// Transfer
-		statistics_.addStatistic(Statistics::kMemorySignatures_removed(), signaturesRemoved.size());
-		statistics_.addStatistic(Statistics::kMemoryImmunized_globally(), immunizedGlobally);
-		statistics_.addStatistic(Statistics::kMemoryImmunized_locally(), immunizedLocally);
-		statistics_.addStatistic(Statistics::kMemoryImmunized_locally_max(), maxLocalLocationsImmunized);
+		statistics_.addStatistic(Statistics::idMemorySignatures_removed(), signaturesRemoved.size());
+		statistics_.addStatistic(Statistics::idMemoryImmunized_globally(), immunizedGlobally);
+		statistics_.addStatistic(Statistics::idMemoryImmunized_locally(), immunizedLocally);
+		statistics_.addStatistic(Statistics::idMemoryImmunized_locally_max(), maxLocalLocationsImmunized);
 
 		// place after transfer because the memory/local graph may have changed
-		statistics_.addStatistic(Statistics::kMemoryWorking_memory_size(), _memory->getWorkingMem().size());
-		statistics_.addStatistic(Statistics::kMemoryShort_time_memory_size(), _memory->getStMem().size());
-		statistics_.addStatistic(Statistics::kMemoryDatabase_memory_used(), _memory->getDatabaseMemoryUsed());
+		statistics_.addStatistic(Statistics::idMemoryWorking_memory_size(), _memory->getWorkingMem().size());
+		statistics_.addStatistic(Statistics::idMemoryShort_time_memory_size(), _memory->getStMem().size());
+		statistics_.addStatistic(Statistics::idMemoryDatabase_memory_used(), _memory->getDatabaseMemoryUsed());
 
 		// Set local graph
 		std::map<int, Transform> poses;
@@ -3470,7 +3625,7 @@ bool Rtabmap::process(
 		statistics_.setPoses(poses);
 		statistics_.setConstraints(constraints);
 
-		statistics_.addStatistic(Statistics::kMemoryLocal_graph_size(), poses.size());
+		statistics_.addStatistic(Statistics::idMemoryLocal_graph_size(), poses.size());
 
 		if(_computeRMSE && _memory->getGroundTruths().size())
 		{
@@ -3504,18 +3659,18 @@ bool Rtabmap::process(
 					rotational_min,
 					rotational_max);
 
-			statistics_.addStatistic(Statistics::kGtTranslational_rmse(), translational_rmse);
-			statistics_.addStatistic(Statistics::kGtTranslational_mean(), translational_mean);
-			statistics_.addStatistic(Statistics::kGtTranslational_median(), translational_median);
-			statistics_.addStatistic(Statistics::kGtTranslational_std(), translational_std);
-			statistics_.addStatistic(Statistics::kGtTranslational_min(), translational_min);
-			statistics_.addStatistic(Statistics::kGtTranslational_max(), translational_max);
-			statistics_.addStatistic(Statistics::kGtRotational_rmse(), rotational_rmse);
-			statistics_.addStatistic(Statistics::kGtRotational_mean(), rotational_mean);
-			statistics_.addStatistic(Statistics::kGtRotational_median(), rotational_median);
-			statistics_.addStatistic(Statistics::kGtRotational_std(), rotational_std);
-			statistics_.addStatistic(Statistics::kGtRotational_min(), rotational_min);
-			statistics_.addStatistic(Statistics::kGtRotational_max(), rotational_max);
+			statistics_.addStatistic(Statistics::idGtTranslational_rmse(), translational_rmse);
+			statistics_.addStatistic(Statistics::idGtTranslational_mean(), translational_mean);
+			statistics_.addStatistic(Statistics::idGtTranslational_median(), translational_median);
+			statistics_.addStatistic(Statistics::idGtTranslational_std(), translational_std);
+			statistics_.addStatistic(Statistics::idGtTranslational_min(), translational_min);
+			statistics_.addStatistic(Statistics::idGtTranslational_max(), translational_max);
+			statistics_.addStatistic(Statistics::idGtRotational_rmse(), rotational_rmse);
+			statistics_.addStatistic(Statistics::idGtRotational_mean(), rotational_mean);
+			statistics_.addStatistic(Statistics::idGtRotational_median(), rotational_median);
+			statistics_.addStatistic(Statistics::idGtRotational_std(), rotational_std);
+			statistics_.addStatistic(Statistics::idGtRotational_min(), rotational_min);
+			statistics_.addStatistic(Statistics::idGtRotational_max(), rotational_max);
 			UDEBUG("Computing RMSE...done!");
 		}
 
@@ -3622,7 +3777,7 @@ bool Rtabmap::process(
 	UDEBUG("End process, timeFinalizingStatistics=%fs", timeFinalizingStatistics);
 	if(_publishStats)
 	{
-		statistics_.addStatistic(Statistics::kTimingFinalizing_statistics(), timeFinalizingStatistics*1000);
+		statistics_.addStatistic(Statistics::idTimingFinalizing_statistics(), timeFinalizingStatistics*1000);
 	}
 
 	return true;
@@ -3697,6 +3852,8 @@ void Rtabmap::rejectLastLoopClosure()
 					}
 				}
 				linksRemoved = true;
+				_pathGraphOutdated = true;
+				_wmPathGraphOutdated = true;
 			}
 		}
 
@@ -3722,6 +3879,9 @@ void Rtabmap::rejectLastLoopClosure()
 					UINFO("Updated local map (old size=%d, new size=%d)", (int)_optimizedPoses.size(), (int)poses.size());
 					_optimizedPoses = poses;
 					_constraints = constraints;
+					_pathGraphOutdated = true;
+					_wmPathGraphOutdated = true;
+					_posesIndex.update(_optimizedPoses);
 					_mapCorrection = _optimizedPoses.at(_memory->getLastWorkingSignature()->id()) * _memory->getLastWorkingSignature()->getPose().inverse();
 				}
 			}
@@ -3740,6 +3900,9 @@ void Rtabmap::deleteLastLocation()
 		{
 			UINFO("Update graph");
 			_optimizedPoses.erase(lastId);
+			_pathGraph.removeNode(lastId);
+			_wmPathGraph.removeNode(lastId);
+			_posesIndex.remove(lastId);
 			std::map<int, Transform> poses = _optimizedPoses;
 			//remove all constraints with last localization id
 			for(std::multimap<int, Link>::iterator iter=_constraints.begin(); iter!=_constraints.end();)
@@ -3772,6 +3935,9 @@ void Rtabmap::deleteLastLocation()
 				{
 					_optimizedPoses = poses;
 					_constraints = constraints;
+					_pathGraphOutdated = true;
+					_wmPathGraphOutdated = true;
+					_posesIndex.update(_optimizedPoses);
 					_mapCorrection = _optimizedPoses.at(_memory->getLastWorkingSignature()->id()) * _memory->getLastWorkingSignature()->getPose().inverse();
 				}
 			}
@@ -3782,6 +3948,9 @@ void Rtabmap::deleteLastLocation()
 void Rtabmap::setOptimizedPoses(const std::map<int, Transform> & poses)
 {
 	_optimizedPoses = poses;
+	_pathGraphOutdated = true;
+	_wmPathGraphOutdated = true;
+	_posesIndex.update(_optimizedPoses);
 }
 
 void Rtabmap::dumpData() const
@@ -3800,6 +3969,30 @@ void Rtabmap::dumpData() const
 	}
 }
 
+const PosesIndex & Rtabmap::getPosesIndex() const
+{
+	return _posesIndex;
+}
+
+// return <id, sqrd distance>, excluding nodeId
+std::map<int, float> Rtabmap::getNodesInRadius(int nodeId, float radius) const
+{
+	const PosesIndex & index = getPosesIndex();
+	UTimer timer;
+	std::map<int, float> nodes = graph::getNodesInRadius(nodeId, index, radius);
+	_posesIndexTime += timer.ticks();
+	return nodes;
+}
+
+int Rtabmap::findNearestNode(const Transform & pose, bool ignoreLandmarks) const
+{
+	const PosesIndex & index = getPosesIndex();
+	UTimer timer;
+	int id = graph::findNearestNode(index, pose, ignoreLandmarks);
+	_posesIndexTime += timer.ticks();
+	return id;
+}
+
 // fromId must be in _memory and in _optimizedPoses
 // Get poses in front of the robot, return optimized poses
 std::map<int, Transform> Rtabmap::getForwardWMPoses(
@@ -3830,7 +4023,7 @@ std::map<int, Transform> Rtabmap::getForwardWMPoses(
 		}
 		else
 		{
-			foundIds = graph::getNodesInRadius(fromId, _optimizedPoses, radius);
+			foundIds = getNodesInRadius(fromId, radius);
 		}
 
 		float radiusSqrd = radius * radius;
@@ -4056,6 +4249,7 @@ std::map<int, Transform> Rtabmap::optimizeGraph(
 		double * error,
 		int * iterationsDone) const
 {
+	RTABMAP_TRACE_SCOPE("Rtabmap::optimizeGraph");
 	UTimer timer;
 	std::map<int, Transform> optimizedPoses;
 	std::map<int, Transform> poses;
@@ -4431,13 +4625,43 @@ void Rtabmap::getGraph(
 	}
 }
 
+// Registration of a loop closure candidate on copies of the signatures, so
+// that the signatures shared between tasks are not modified.
+class LoopClosureRegistrationTask : public UThreadPoolTask
+{
+public:
+	LoopClosureRegistrationTask(const Memory * memory, const Signature * from, const Signature * to) :
+		memory_(memory),
+		from_(from),
+		to_(to)
+	{}
+	virtual void run()
+	{
+		Signature from = *from_;
+		Signature to = *to_;
+		RegistrationInfo info;
+		// use signatures instead of IDs because some signatures may not be in WM
+		transform = memory_->computeTransform(from, to, Transform(), &info);
+		covariance = info.covariance;
+	}
+
+	Transform transform;
+	cv::Mat covariance;
+
+private:
+	const Memory * memory_;
+	const Signature * from_;
+	const Signature * to_;
+};
+
 int Rtabmap::detectMoreLoopClosures(
 		float clusterRadius,
 		float clusterAngle,
 		int iterations,
 		bool intraSession,
 		bool interSession,
-		const ProgressState * processState)
+		const ProgressState * processState,
+		int threads)
 {
 	UASSERT(iterations>0);
 
@@ -4459,6 +4683,12 @@ int Rtabmap::detectMoreLoopClosures(
 
 	std::list<Link> loopClosuresAdded;
 	std::multimap<int, int> checkedLoopClosures;
+	// <<from, to>, <transform, covariance>>, registrations are kept between
+	// iterations, pairs skipped in one iteration can be accepted in the next one
+	std::map<std::pair<int, int>, std::pair<Transform, cv::Mat> > registrations;
+	UThreadPool pool(threads);
+	int pairsRegistered = 0;
+	double registrationTime = 0.0;
 
 	std::map<int, Transform> posesToCheckLoopClosures;
 	std::map<int, Transform> poses;
@@ -4489,6 +4719,93 @@ int Rtabmap::detectMoreLoopClosures(
 
 		UINFO("Looking for more loop closures, clustering poses... found %d clusters.", (int)clusters.size());
 
+		// Register in parallel all pairs that could be accepted in this iteration.
+		// Registration doesn't modify Memory: each task works on copies of
+		// the signatures. Links are merged sequentially below in clusters
+		// order, so the same loop closures are added than a sequential detection.
+		std::vector<std::pair<int, int> > pairs;
+		for(std::multimap<int, int>::iterator iter=clusters.begin(); iter!= clusters.end(); ++iter)
+		{
+			int from = std::max(iter->first, iter->second);
+			int to = std::min(iter->first, iter->second);
+			int mapIdFrom = uValue(mapIds, from, 0);
+			int mapIdTo = uValue(mapIds, to, 0);
+			if(((interSession && mapIdFrom != mapIdTo) ||
+			    (intraSession && mapIdFrom == mapIdTo)) &&
+			   registrations.find(std::make_pair(from, to)) == registrations.end() &&
+			   rtabmap::graph::findLink(links, from, to) == links.end())
+			{
+				bool alreadyChecked = false;
+				for(std::multimap<int, int>::iterator jter = checkedLoopClosures.lower_bound(from);
+					!alreadyChecked && jter!=checkedLoopClosures.end() && jter->first == from;
+					++jter)
+				{
+					alreadyChecked = to == jter->second;
+				}
+				if(!alreadyChecked)
+				{
+					UASSERT(signatures.find(from) != signatures.end());
+					UASSERT(signatures.find(to) != signatures.end());
+					registrations.insert(std::make_pair(std::make_pair(from, to), std::make_pair(Transform(), cv::Mat())));
+					pairs.push_back(std::make_pair(from, to));
+				}
+			}
+		}
+
+		// Load data from the database sequentially
+		std::set<int> pairsIds;
+		for(unsigned int j=0; j<pairs.size(); ++j)
+		{
+			pairsIds.insert(pairs[j].first);
+			pairsIds.insert(pairs[j].second);
+		}
+		for(std::set<int>::iterator iter=pairsIds.begin(); iter!=pairsIds.end(); ++iter)
+		{
+			SensorData & data = signatures.at(*iter).sensorData();
+			if(data.imageCompressed().empty() && data.laserScanCompressed().isEmpty() && data.userDataCompressed().empty())
+			{
+				data = _memory->getNodeData(*iter);
+			}
+		}
+
+		UTimer registrationTimer;
+		int chunkSize = std::max(64, pool.threads()*16);
+		for(unsigned int j=0; j<pairs.size(); j+=chunkSize)
+		{
+			if(processState && processState->isCanceled())
+			{
+				return -1;
+			}
+
+			unsigned int end = std::min((unsigned int)pairs.size(), j+chunkSize);
+			std::vector<LoopClosureRegistrationTask> tasks;
+			tasks.reserve(end-j);
+			for(unsigned int k=j; k<end; ++k)
+			{
+				tasks.push_back(LoopClosureRegistrationTask(_memory, &signatures.at(pairs[k].first), &signatures.at(pairs[k].second)));
+			}
+			std::vector<UThreadPoolTask*> tasksPtr(tasks.size());
+			for(unsigned int k=0; k<tasks.size(); ++k)
+			{
+				tasksPtr[k] = &tasks[k];
+			}
+			pool.run(tasksPtr);
+			for(unsigned int k=0; k<tasks.size(); ++k)
+			{
+				registrations.at(pairs[j+k]) = std::make_pair(tasks[k].transform, tasks[k].covariance);
+			}
+
+			std::string msg = uFormat("Iteration %d/%d: Registered %d/%d pairs (%.1f pairs/s)",
+					n+1, iterations, (int)end, (int)pairs.size(), double(end)/registrationTimer.elapsed());
+			UINFO(msg.c_str());
+			if(processState && !processState->callback(msg))
+			{
+				return -1;
+			}
+		}
+		pairsRegistered += (int)pairs.size();
+		registrationTime += registrationTimer.elapsed();
+
 		int i=0;
 		std::set<int> addedLinks;
 		for(std::multimap<int, int>::iterator iter=clusters.begin(); iter!= clusters.end(); ++iter, ++i)
@@ -4537,9 +4854,10 @@ int Rtabmap::detectMoreLoopClosures(
 						UASSERT(signatures.find(from) != signatures.end());
 						UASSERT(signatures.find(to) != signatures.end());
 
-						RegistrationInfo info;
-						// use signatures instead of IDs because some signatures may not be in WM
-						Transform t = _memory->computeTransform(signatures.at(from), signatures.at(to), Transform(), &info);
+						std::map<std::pair<int, int>, std::pair<Transform, cv::Mat> >::iterator rter = registrations.find(std::make_pair(from, to));
+						UASSERT(rter != registrations.end());
+						Transform t = rter->second.first;
+						const cv::Mat & covariance = rter->second.second;
 
 						if(!t.isNull())
 						{
@@ -4560,7 +4878,7 @@ int Rtabmap::detectMoreLoopClosures(
 									}
 								}
 								std::multimap<int, Link> linksIn = links;
-								linksIn.insert(std::make_pair(from, Link(from, to, Link::kUserClosure, t, getInformation(info.covariance))));
+								linksIn.insert(std::make_pair(from, Link(from, to, Link::kUserClosure, t, getInformation(covariance))));
 								const Link * maxLinearLink = 0;
 								const Link * maxAngularLink = 0;
 								float maxLinearError = 0.0f;
@@ -4646,7 +4964,7 @@ int Rtabmap::detectMoreLoopClosures(
 							{
 								addedLinks.insert(from);
 								addedLinks.insert(to);
-								cv::Mat inf = getInformation(info.covariance);
+								cv::Mat inf = getInformation(covariance);
 								links.insert(std::make_pair(from, Link(from, to, Link::kUserClosure, t, inf)));
 								loopClosuresAdded.push_back(Link(from, to, Link::kUserClosure, t, inf));
 								std::string msg = uFormat("Iteration %d/%d: Added loop closure %d->%d! (%d/%d)", n+1, iterations, from, to, i+1, (int)clusters.size());
@@ -4700,6 +5018,17 @@ int Rtabmap::detectMoreLoopClosures(
 	}
 	UINFO("Total added %d loop closures.", (int)loopClosuresAdded.size());
 
+	if(pairsRegistered)
+	{
+		std::string msg = uFormat("Registered %d pairs in %.3fs (%.1f pairs/s, %d threads)",
+				pairsRegistered, registrationTime, double(pairsRegistered)/registrationTime, pool.threads());
+		UINFO(msg.c_str());
+		if(processState)
+		{
+			processState->callback(msg);
+		}
+	}
+
 	if(loopClosuresAdded.size())
 	{
 		for(std::list<Link>::iterator iter=loopClosuresAdded.begin(); iter!=loopClosuresAdded.end(); ++iter)
@@ -4718,6 +5047,9 @@ int Rtabmap::detectMoreLoopClosures(
 		std::map<int, Transform> tmp;
 		// Update also the links if some have been added in WM
 		_memory->getMetricConstraints(uKeysSet(_optimizedPoses), tmp, _constraints, false);
+		_pathGraphOutdated = true;
+		_wmPathGraphOutdated = true;
+		_posesIndex.update(_optimizedPoses);
 		// This will force rtabmap_ros to regenerate the global occupancy grid if there was one
 		_memory->save2DMap(cv::Mat(), 0, 0, 0);
 	}
@@ -4924,6 +5256,9 @@ bool Rtabmap::addLink(const Link & link)
 		std::map<int, Transform> tmp;
 		// Update also the links if some have been added in WM
 		_memory->getMetricConstraints(uKeysSet(_optimizedPoses), tmp, _constraints, false);
+		_pathGraphOutdated = true;
+		_wmPathGraphOutdated = true;
+		_posesIndex.update(_optimizedPoses);
 		// This will force rtabmap_ros to regenerate the global occupancy grid if there was one
 		_memory->save2DMap(cv::Mat(), 0, 0, 0);
 
@@ -5013,29 +5348,35 @@ bool Rtabmap::computePath(int targetNode, bool global)
 				UWARN("Last localization pose is null... cannot compute a path");
 				return false;
 			}
-			if(_optimizedPoses.begin()->first < 0)
-			{
-				std::map<int, Transform> poses(_optimizedPoses.lower_bound(1), _optimizedPoses.end());
-				currentNode = graph::findNearestNode(poses, _lastLocalizationPose);
-			}
-			else
-			{
-				currentNode = graph::findNearestNode(_optimizedPoses, _lastLocalizationPose);
-			}
+			currentNode = findNearestNode(_lastLocalizationPose, true);
 		}
 		if(currentNode && targetNode)
 		{
-			std::list<std::pair<int, Transform> > path = graph::computePath(
-					currentNode,
-					targetNode,
-					_memory,
-					global,
-					false,
-					_pathLinearVelocity,
-					_pathAngularVelocity);
+			std::list<std::pair<int, Transform> > path;
+			Transform t = Transform::getIdentity();
+			if(!global && targetNode > 0 && _pathLinearVelocity <= 0.0f && _pathAngularVelocity <= 0.0f)
+			{
+				// Plan in the local map, poses are already in map referential
+				updateWMPathGraph();
+				path = _wmPathGraph.computePath(currentNode, targetNode);
+				UINFO("A* time = %fs", timer.ticks());
+			}
+			if(path.empty())
+			{
+				// Nodes in the database, landmarks, time costs or nodes not
+				// in the local map can only be reached by traversing the memory.
+				path = graph::computePath(
+						currentNode,
+						targetNode,
+						_memory,
+						global,
+						false,
+						_pathLinearVelocity,
+						_pathAngularVelocity);
 
-			//transform in current referential
-			Transform t = uValue(_optimizedPoses, currentNode, Transform::getIdentity());
+				//transform in current referential
+				t = uValue(_optimizedPoses, currentNode, Transform::getIdentity());
+			}
 			_path.resize(path.size());
 			int oi = 0;
 			for(std::list<std::pair<int, Transform> >::iterator iter=path.begin(); iter!=path.end();++iter)
@@ -5135,23 +5476,9 @@ bool Rtabmap::computePath(const Transform & targetPose, float tolerance)
 
 	//Find the nearest node
 	UTimer timer;
-	std::map<int, Transform> nodes = _optimizedPoses;
-	std::multimap<int, int> links;
-	for(std::map<int, Transform>::iterator iter=nodes.upper_bound(0); iter!=nodes.end(); ++iter)
-	{
-		const Signature * s = _memory->getSignature(iter->first);
-		UASSERT(s);
-		for(std::map<int, Link>::const_iterator jter=s->getLinks().begin(); jter!=s->getLinks().end(); ++jter)
-		{
-			// only add links for which poses are in "nodes"
-			if(jter->second.from() != jter->second.to() && uContains(nodes, jter->second.to()))
-			{
-				links.insert(std::make_pair(jter->second.from(), jter->second.to()));
-				//links.insert(std::make_pair(jter->second.to(), jter->second.from())); // <-> (commented: already added when iterating in nodes)
-			}
-		}
-	}
-	UINFO("Time getting links = %fs", timer.ticks());
+	const std::map<int, Transform> & nodes = _optimizedPoses;
+	updateWMPathGraph();
+	UINFO("Time updating path graph = %fs", timer.ticks());
 
 	int currentNode = 0;
 	if(_memory->isIncremental())
@@ -5170,15 +5497,7 @@ bool Rtabmap::computePath(const Transform & targetPose, float tolerance)
 			UWARN("Last localization pose is null... cannot compute a path");
 			return false;
 		}
-		if(_optimizedPoses.begin()->first < 0)
-		{
-			std::map<int, Transform> poses(_optimizedPoses.lower_bound(1), _optimizedPoses.end());
-			currentNode = graph::findNearestNode(poses, _lastLocalizationPose);
-		}
-		else
-		{
-			currentNode = graph::findNearestNode(_optimizedPoses, _lastLocalizationPose);
-		}
+		currentNode = findNearestNode(_lastLocalizationPose, true);
 	}
 
 	int nearestId;
@@ -5189,7 +5508,7 @@ bool Rtabmap::computePath(const Transform & targetPose, float tolerance)
 	}
 	else
 	{
-		nearestId = rtabmap::graph::findNearestNode(nodes, targetPose);
+		nearestId = findNearestNode(targetPose, false);
 	}
 	UINFO("Nearest node found=%d ,%fs", nearestId, timer.ticks());
 	if(nearestId > 0)
@@ -5203,7 +5522,7 @@ bool Rtabmap::computePath(const Transform & targetPose, float tolerance)
 		{
 			UINFO("Computing path from location %d to %d", currentNode, nearestId);
 			UTimer timer;
-			_path = uListToVector(rtabmap::graph::computePath(nodes, links, currentNode, nearestId));
+			_path = uListToVector(_wmPathGraph.computePath(currentNode, nearestId));
 			UINFO("A* time = %fs", timer.ticks());
 
 			if(_path.size() == 0)
@@ -5304,6 +5623,47 @@ int Rtabmap::getPathCurrentGoalId() const
 	return 0;
 }
 
+void Rtabmap::updateWMPathGraph()
+{
+	if(_wmPathGraphOutdated)
+	{
+		std::multimap<int, int> links;
+		for(std::map<int, Transform>::iterator iter=_optimizedPoses.upper_bound(0); iter!=_optimizedPoses.end(); ++iter)
+		{
+			const Signature * s = _memory->getSignature(iter->first);
+			UASSERT(s);
+			for(std::multimap<int, Link>::const_iterator jter=s->getLinks().begin(); jter!=s->getLinks().end(); ++jter)
+			{
+				// Landmarks cannot be traversed and virtual links are removed before each planning
+				if(jter->first > 0 && jter->first != iter->first && jter->second.type() != Link::kVirtualClosure)
+				{
+					links.insert(links.end(), std::make_pair(iter->first, jter->first));
+				}
+			}
+		}
+		_wmPathGraph.update(_optimizedPoses, links);
+		_wmPathGraphOutdated = false;
+	}
+}
+
+void Rtabmap::addWMPathGraphLinks(int id)
+{
+	if(!_wmPathGraphOutdated && _wmPathGraph.hasNode(id))
+	{
+		const Signature * s = _memory->getSignature(id);
+		if(s)
+		{
+			for(std::multimap<int, Link>::const_iterator iter=s->getLinks().begin(); iter!=s->getLinks().end(); ++iter)
+			{
+				if(iter->first > 0 && iter->second.type() != Link::kVirtualClosure)
+				{
+					_wmPathGraph.addLink(id, iter->first);
+				}
+			}
+		}
+	}
+}
+
 void Rtabmap::updateGoalIndex()
 {
 	if(!_rgbdSlamMode)
@@ -27,6 +27,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "rtabmap/core/Rtabmap.h"
 #include "rtabmap/core/RtabmapThread.h"
+#include "rtabmap/core/Trace.h"
 #include "rtabmap/core/RtabmapEvent.h"
 #include "rtabmap/core/Camera.h"
 #include "rtabmap/core/CameraEvent.h"
@@ -44,7 +45,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 namespace rtabmap {
 
 RtabmapThread::RtabmapThread(Rtabmap * rtabmap) :
+		_dataBuffer(Parameters::defaultRtabmapImageBufferSize(), (URingBuffer<OdometryEvent>::DropPolicy)Parameters::defaultRtabmapImageBufferPolicy()),
 		_dataBufferMaxSize(Parameters::defaultRtabmapImageBufferSize()),
+		_dataBufferPolicy(Parameters::defaultRtabmapImageBufferPolicy()),
 		_rate(Parameters::defaultRtabmapDetectionRate()),
 		_createIntermediateNodes(Parameters::defaultRtabmapCreateIntermediateNodes()),
 		_frameRateTimer(new UTimer()),
@@ -108,6 +111,14 @@ void RtabmapThread::setDetectorRate(float rate)
 void RtabmapThread::setDataBufferSize(unsigned int size)
 {
 	_dataBufferMaxSize = size;
+	_dataBuffer.setCapacity(_dataBufferMaxSize);
+}
+
+void RtabmapThread::setDataBufferPolicy(int policy)
+{
+	UASSERT(policy >= URingBuffer<OdometryEvent>::kFifo && policy <= URingBuffer<OdometryEvent>::kKeepKeyFrames);
+	_dataBufferPolicy = policy;
+	_dataBuffer.setDropPolicy((URingBuffer<OdometryEvent>::DropPolicy)_dataBufferPolicy);
 }
 
 void RtabmapThread::createIntermediateNodes(bool enabled)
@@ -170,6 +181,7 @@ void RtabmapThread::publishMap(bool optimized, bool full, bool graphOnly) const
 void RtabmapThread::mainLoopBegin()
 {
 	ULogger::registerCurrentThread("Rtabmap");
+	RTABMAP_TRACE_THREAD_NAME("Rtabmap");
 	if(_rtabmap == 0)
 	{
 		UERROR("Cannot start rtabmap thread if no rtabmap object is set! Stopping the thread...");
@@ -215,18 +227,24 @@ void RtabmapThread::mainLoop()
 		str = parameters.at("RtabmapThread/DatabasePath");
 		parameters.erase("RtabmapThread/DatabasePath");
 		Parameters::parse(parameters, Parameters::kRtabmapImageBufferSize(), _dataBufferMaxSize);
+		Parameters::parse(parameters, Parameters::kRtabmapImageBufferPolicy(), _dataBufferPolicy);
 		Parameters::parse(parameters, Parameters::kRtabmapDetectionRate(), _rate);
 		Parameters::parse(parameters, Parameters::kRtabmapCreateIntermediateNodes(), _createIntermediateNodes);
 		UASSERT(_dataBufferMaxSize >= 0);
 		UASSERT(_rate >= 0.0f);
+		setDataBufferSize(_dataBufferMaxSize);
+		setDataBufferPolicy(_dataBufferPolicy);
 		_rtabmap->init(parameters, str);
 		break;
 	case kStateChangingParameters:
 		Parameters::parse(parameters, Parameters::kRtabmapImageBufferSize(), _dataBufferMaxSize);
+		Parameters::parse(parameters, Parameters::kRtabmapImageBufferPolicy(), _dataBufferPolicy);
 		Parameters::parse(parameters, Parameters::kRtabmapDetectionRate(), _rate);
 		Parameters::parse(parameters, Parameters::kRtabmapCreateIntermediateNodes(), _createIntermediateNodes);
 		UASSERT(_dataBufferMaxSize >= 0);
 		UASSERT(_rate >= 0.0f);
+		setDataBufferSize(_dataBufferMaxSize);
+		setDataBufferPolicy(_dataBufferPolicy);
 		_rtabmap->parseParameters(parameters);
 		break;
 	case kStateReseting:
@@ -530,16 +548,29 @@ bool RtabmapThread::handleEvent(UEvent* event)
 //============================================================
 void RtabmapThread::process()
 {
-	OdometryEvent data;
-	if(_state.empty() && getData(data))
+	double queuedTime = 0.0;
+	OdometryEvent * dataPtr = 0;
+	if(_state.empty() && (dataPtr = getData(queuedTime)) != 0)
 	{
+		OdometryEvent & data = *dataPtr;
+		double latency = data.data().captureTime()>0.0?UTimer::now() - data.data().captureTime():0.0;
 		if(_rtabmap->getMemory())
 		{
 			bool wasPlanning = _rtabmap->getPath().size()>0;
 			if(_rtabmap->process(data.data(), data.pose(), data.covariance(), data.velocity()))
 			{
 				Statistics stats = _rtabmap->getStatistics();
-				stats.addStatistic(Statistics::kMemoryImages_buffered(), (float)_dataBuffer.size());
+				stats.addStatistic(Statistics::idMemoryImages_buffered(), (float)_dataBuffer.size());
+				stats.addStatistic(Statistics::idMemoryImages_dropped(), (float)_dataBuffer.dropped());
+				stats.addStatistic(Statistics::idTimingOdometry_queue(), data.info().timeQueued*1000.0f);
+				stats.addStatistic(Statistics::idTimingRtabmap_queue(), queuedTime*1000.0);
+				if(latency > 0.0)
+				{
+					// from Camera::takeImage() to Rtabmap::process()
+					stats.addStatistic(Statistics::idTimingPipeline_latency(), latency*1000.0);
+				}
+				// Build the statistics map now, the event may be shared between subscriber threads
+				stats.data();
 				ULOGGER_DEBUG("posting statistics_ event...");
 				this->post(new RtabmapEvent(stats));
 
@@ -554,6 +585,7 @@ void RtabmapThread::process()
 		{
 			UERROR("RTAB-Map is not initialized! Ignoring received data...");
 		}
+		delete dataPtr;
 	}
 }
 
@@ -611,47 +643,42 @@ void RtabmapThread::addData(const OdometryEvent & odomEvent)
 
 		lastPose_ = odomEvent.pose();
 
-		bool notify = true;
-
 		if(covariance_.empty())
 		{
 			covariance_ = cv::Mat::eye(6,6,CV_64FC1);
 		}
 		OdometryInfo odomInfo = odomEvent.info().copyWithoutData();
 		odomInfo.reg.covariance = covariance_;
+		OdometryEvent * event = 0;
 		if(ignoreFrame)
 		{
 			// set negative id so rtabmap will detect it as an intermediate node
 			SensorData tmp = odomEvent.data();
 			tmp.setId(-1);
 			tmp.setFeatures(std::vector<cv::KeyPoint>(), std::vector<cv::Point3f>(), cv::Mat());// remove features
-			_dataBuffer.push_back(OdometryEvent(tmp, odomEvent.pose(), odomInfo));
+			event = new OdometryEvent(tmp, odomEvent.pose(), odomInfo);
 		}
 		else
 		{
-			_dataBuffer.push_back(OdometryEvent(odomEvent.data(), odomEvent.pose(), odomInfo));
+			event = new OdometryEvent(odomEvent.data(), odomEvent.pose(), odomInfo);
 		}
 		UINFO("Added data %d", odomEvent.data().id());
 
 		covariance_ = cv::Mat();
-		while(_dataBufferMaxSize > 0 && _dataBuffer.size() > _dataBufferMaxSize)
-		{
-			if(_rate > 0.0f)
-			{
-				ULOGGER_WARN("Data buffer is full, the oldest data is removed to add the new one.");
-			}
-			_dataBuffer.pop_front();
-			notify = false;
-		}
 
-		if(notify)
+		// intermediate nodes are dropped first with kKeepKeyFrames policy
+		if(_dataBuffer.push(event, !ignoreFrame) == 0)
 		{
 			_dataAdded.release();
 		}
+		else if(_rate > 0.0f)
+		{
+			ULOGGER_WARN("Data buffer is full, the oldest data is removed to add the new one.");
+		}
 	}
 }
 
-bool RtabmapThread::getData(OdometryEvent & data)
+OdometryEvent * RtabmapThread::getData(double & queuedTime)
 {
 	ULOGGER_DEBUG("");
 
@@ -659,33 +686,28 @@ bool RtabmapThread::getData(OdometryEvent & data)
 	_dataAdded.acquire();
 	ULOGGER_INFO("wake-up");
 
-	bool dataFilled = false;
+	OdometryEvent * data = 0;
 	bool triggerNewMap = false;
 	_dataMutex.lock();
 	{
-		if(_state.empty() && !_dataBuffer.empty())
+		if(_state.empty() && (data = _dataBuffer.pop(&queuedTime)) != 0)
 		{
-			data = _dataBuffer.front();
-			_dataBuffer.pop_front();
-
 			_userDataMutex.lock();
 			{
 				if(!_userData.empty())
 				{
-					data.data().setUserData(_userData);
+					data->data().setUserData(_userData);
 					_userData = cv::Mat();
 				}
 			}
 			_userDataMutex.unlock();
 
-			while(_newMapEvents.size() && _newMapEvents.front() <= data.data().stamp())
+			while(_newMapEvents.size() && _newMapEvents.front() <= data->data().stamp())
 			{
-				UWARN("Triggering new map %f<=%f...", _newMapEvents.front() , data.data().stamp());
+				UWARN("Triggering new map %f<=%f...", _newMapEvents.front() , data->data().stamp());
 				triggerNewMap = true;
 				_newMapEvents.pop_front();
 			}
-
-			dataFilled = true;
 		}
 	}
 	_dataMutex.unlock();
@@ -695,7 +717,7 @@ bool RtabmapThread::getData(OdometryEvent & data)
 		_rtabmap->triggerNewMap();
 	}
 
-	return dataFilled;
+	return data;
 }
 
 } /* namespace rtabmap */
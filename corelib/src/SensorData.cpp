@@ -40,6 +40,7 @@ namespace rtabmap
 SensorData::SensorData() :
 		_id(0),
 		_stamp(0.0),
+		_captureTime(0.0),
 		_cellSize(0.0f)
 {
 }
@@ -52,6 +53,7 @@ SensorData::SensorData(
 		const cv::Mat & userData) :
 		_id(id),
 		_stamp(stamp),
+		_captureTime(0.0),
 		_cellSize(0.0f)
 {
 	setRGBDImage(image, cv::Mat(), CameraModel());
@@ -67,6 +69,7 @@ SensorData::SensorData(
 		const cv::Mat & userData) :
 		_id(id),
 		_stamp(stamp),
+		_captureTime(0.0),
 		_cellSize(0.0f)
 {
 	setRGBDImage(image, cv::Mat(), cameraModel);
@@ -83,6 +86,7 @@ SensorData::SensorData(
 		const cv::Mat & userData) :
 		_id(id),
 		_stamp(stamp),
+		_captureTime(0.0),
 		_cellSize(0.0f)
 {
 	setRGBDImage(rgb, depth, cameraModel);
@@ -100,6 +104,7 @@ SensorData::SensorData(
 		const cv::Mat & userData) :
 		_id(id),
 		_stamp(stamp),
+		_captureTime(0.0),
 		_cellSize(0.0f)
 {
 	setRGBDImage(rgb, depth, cameraModel);
@@ -117,6 +122,7 @@ SensorData::SensorData(
 		const cv::Mat & userData) :
 		_id(id),
 		_stamp(stamp),
+		_captureTime(0.0),
 		_cellSize(0.0f)
 {
 	setRGBDImage(rgb, depth, cameraModels);
@@ -134,6 +140,7 @@ SensorData::SensorData(
 		const cv::Mat & userData) :
 		_id(id),
 		_stamp(stamp),
+		_captureTime(0.0),
 		_cellSize(0.0f)
 {
 	setRGBDImage(rgb, depth, cameraModels);
@@ -151,6 +158,7 @@ SensorData::SensorData(
 		const cv::Mat & userData):
 		_id(id),
 		_stamp(stamp),
+		_captureTime(0.0),
 		_cellSize(0.0f)
 {
 	setStereoImage(left, right, cameraModel);
@@ -168,6 +176,7 @@ SensorData::SensorData(
 		const cv::Mat & userData) :
 		_id(id),
 		_stamp(stamp),
+		_captureTime(0.0),
 		_cellSize(0.0f)
 {
 	setStereoImage(left, right, cameraModel);
@@ -181,6 +190,7 @@ SensorData::SensorData(
 	double stamp) :
 		_id(id),
 		_stamp(stamp),
+		_captureTime(0.0),
 		_cellSize(0.0f)
 {
 	imu_ = imu;
@@ -402,7 +412,8 @@ void SensorData::setOccupancyGrid(
 			const cv::Mat & obstacles,
 			const cv::Mat & empty,
 			float cellSize,
-			const cv::Point3f & viewPoint)
+			const cv::Point3f & viewPoint,
+			int compressionCodec)
 {
 	UDEBUG("ground=%d obstacles=%d empty=%d", ground.cols, obstacles.cols, empty.cols);
 	if((!ground.empty() && (!_groundCellsCompressed.empty() || !_groundCellsRaw.empty())) ||
@@ -421,16 +432,17 @@ void SensorData::setOccupancyGrid(
 	_emptyCellsRaw = cv::Mat();
 	_emptyCellsCompressed = cv::Mat();
 
-	CompressionThread ctGround(ground);
-	CompressionThread ctObstacles(obstacles);
-	CompressionThread ctEmpty(empty);
+	CompressionTask ctGround(ground, "", (CompressionCodec)compressionCodec);
+	CompressionTask ctObstacles(obstacles, "", (CompressionCodec)compressionCodec);
+	CompressionTask ctEmpty(empty, "", (CompressionCodec)compressionCodec);
+	std::vector<CompressionTask*> tasks;
 
 	if(!ground.empty())
 	{
 		if(ground.type() == CV_32FC2 || ground.type() == CV_32FC3 || ground.type() == CV_32FC(4) || ground.type() == CV_32FC(5) || ground.type() == CV_32FC(6) || ground.type() == CV_32FC(7))
 		{
 			_groundCellsRaw = ground;
-			ctGround.start();
+			tasks.push_back(&ctGround);
 		}
 		else if(ground.type() == CV_8UC1)
 		{
@@ -442,7 +454,7 @@ void SensorData::setOccupancyGrid(
 		if(obstacles.type() == CV_32FC2 || obstacles.type() == CV_32FC3 || obstacles.type() == CV_32FC(4) || obstacles.type() == CV_32FC(5) || obstacles.type() == CV_32FC(6) || obstacles.type() == CV_32FC(7))
 		{
 			_obstacleCellsRaw = obstacles;
-			ctObstacles.start();
+			tasks.push_back(&ctObstacles);
 		}
 		else if(obstacles.type() == CV_8UC1)
 		{
@@ -454,16 +466,14 @@ void SensorData::setOccupancyGrid(
 		if(empty.type() == CV_32FC2 || empty.type() == CV_32FC3 || empty.type() == CV_32FC(4) || empty.type() == CV_32FC(5) || empty.type() == CV_32FC(6) || empty.type() == CV_32FC(7))
 		{
 			_emptyCellsRaw = empty;
-			ctEmpty.start();
+			tasks.push_back(&ctEmpty);
 		}
 		else if(empty.type() == CV_8UC1)
 		{
 			_emptyCellsCompressed = empty;
 		}
 	}
-	ctGround.join();
-	ctObstacles.join();
-	ctEmpty.join();
+	runCompressionTasks(tasks);
 	if(!_groundCellsRaw.empty())
 	{
 		_groundCellsCompressed = ctGround.getCompressedData();
@@ -494,6 +504,35 @@ void SensorData::uncompressData()
 				_emptyCellsCompressed.empty()?0:&tmpG);
 }
 
+class UncompressSensorDataTask : public UThreadPoolTask
+{
+public:
+	UncompressSensorDataTask(SensorData * data) : data_(data) {}
+	virtual void run()
+	{
+		data_->uncompressData();
+	}
+private:
+	SensorData * data_;
+};
+
+void SensorData::uncompressData(const std::vector<SensorData*> & data)
+{
+	std::vector<UncompressSensorDataTask> tasks;
+	tasks.reserve(data.size());
+	for(unsigned int i=0; i<data.size(); ++i)
+	{
+		UASSERT(data[i] != 0);
+		tasks.push_back(UncompressSensorDataTask(data[i]));
+	}
+	std::vector<UThreadPoolTask*> tasksPtr(tasks.size());
+	for(unsigned int i=0; i<tasks.size(); ++i)
+	{
+		tasksPtr[i] = &tasks[i];
+	}
+	compressionThreadPool().run(tasksPtr);
+}
+
 void SensorData::uncompressData(
 		cv::Mat * imageRaw,
 		cv::Mat * depthRaw,
@@ -621,55 +660,50 @@ void SensorData::uncompressDataConst(
 		(obstacleCellsRaw && obstacleCellsRaw->empty()) ||
 		(emptyCellsRaw && emptyCellsRaw->empty()))
 	{
-		rtabmap::CompressionThread ctImage(_imageCompressed, true);
-		rtabmap::CompressionThread ctDepth(_depthOrRightCompressed, true);
-		rtabmap::CompressionThread ctLaserScan(_laserScanCompressed.data(), false);
-		rtabmap::CompressionThread ctUserData(_userDataCompressed, false);
-		rtabmap::CompressionThread ctGroundCells(_groundCellsCompressed, false);
-		rtabmap::CompressionThread ctObstacleCells(_obstacleCellsCompressed, false);
-		rtabmap::CompressionThread ctEmptyCells(_emptyCellsCompressed, false);
+		rtabmap::CompressionTask ctImage(_imageCompressed, true);
+		rtabmap::CompressionTask ctDepth(_depthOrRightCompressed, true);
+		rtabmap::CompressionTask ctLaserScan(_laserScanCompressed.data(), false);
+		rtabmap::CompressionTask ctUserData(_userDataCompressed, false);
+		rtabmap::CompressionTask ctGroundCells(_groundCellsCompressed, false);
+		rtabmap::CompressionTask ctObstacleCells(_obstacleCellsCompressed, false);
+		rtabmap::CompressionTask ctEmptyCells(_emptyCellsCompressed, false);
+		std::vector<rtabmap::CompressionTask*> tasks;
 		if(imageRaw && imageRaw->empty() && !_imageCompressed.empty())
 		{
 			UASSERT(_imageCompressed.type() == CV_8UC1);
-			ctImage.start();
+			tasks.push_back(&ctImage);
 		}
 		if(depthRaw && depthRaw->empty() && !_depthOrRightCompressed.empty())
 		{
 			UASSERT(_depthOrRightCompressed.type() == CV_8UC1);
-			ctDepth.start();
+			tasks.push_back(&ctDepth);
 		}
 		if(laserScanRaw && laserScanRaw->isEmpty() && !_laserScanCompressed.isEmpty())
 		{
 			UASSERT(_laserScanCompressed.isCompressed());
-			ctLaserScan.start();
+			tasks.push_back(&ctLaserScan);
 		}
 		if(userDataRaw && userDataRaw->empty() && !_userDataCompressed.empty())
 		{
 			UASSERT(_userDataCompressed.type() == CV_8UC1);
-			ctUserData.start();
+			tasks.push_back(&ctUserData);
 		}
 		if(groundCellsRaw && groundCellsRaw->empty() && !_groundCellsCompressed.empty())
 		{
 			UASSERT(_groundCellsCompressed.type() == CV_8UC1);
-			ctGroundCells.start();
+			tasks.push_back(&ctGroundCells);
 		}
 		if(obstacleCellsRaw && obstacleCellsRaw->empty() && !_obstacleCellsCompressed.empty())
 		{
 			UASSERT(_obstacleCellsCompressed.type() == CV_8UC1);
-			ctObstacleCells.start();
+			tasks.push_back(&ctObstacleCells);
 		}
 		if(emptyCellsRaw && emptyCellsRaw->empty() && !_emptyCellsCompressed.empty())
 		{
 			UASSERT(_emptyCellsCompressed.type() == CV_8UC1);
-			ctEmptyCells.start();
-		}
-		ctImage.join();
-		ctDepth.join();
-		ctLaserScan.join();
-		ctUserData.join();
-		ctGroundCells.join();
-		ctObstacleCells.join();
-		ctEmptyCells.join();
+			tasks.push_back(&ctEmptyCells);
+		}
+		rtabmap::runCompressionTasks(tasks);
 
 		if(imageRaw && imageRaw->empty())
 		{
@@ -28,11 +28,57 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/Statistics.h"
 #include <rtabmap/utilite/UStl.h>
 #include <rtabmap/utilite/UConversion.h>
+#include <rtabmap/utilite/UMutex.h>
+#include <rtabmap/utilite/ULogger.h>
 
 namespace rtabmap {
 std::map<std::string, float> Statistics::_defaultData;
 bool Statistics::_defaultDataInitialized = false;
 
+// Never deleted: ids are resolved from static initializers and other static destructors
+static UMutex & registryMutex()
+{
+	static UMutex * mutex = new UMutex();
+	return *mutex;
+}
+static std::map<std::string, int> & registryIds()
+{
+	static std::map<std::string, int> * ids = new std::map<std::string, int>();
+	return *ids;
+}
+static std::vector<std::string> & registryNames()
+{
+	static std::vector<std::string> * names = new std::vector<std::string>();
+	return *names;
+}
+
+int Statistics::statisticId(const std::string & name)
+{
+	UScopeMutex lock(registryMutex());
+	std::map<std::string, int>::iterator iter = registryIds().find(name);
+	if(iter != registryIds().end())
+	{
+		return iter->second;
+	}
+	int id = (int)registryNames().size();
+	registryIds().insert(std::make_pair(name, id));
+	registryNames().push_back(name);
+	return id;
+}
+
+std::string Statistics::statisticName(int id)
+{
+	UScopeMutex lock(registryMutex());
+	UASSERT(id >= 0 && id < (int)registryNames().size());
+	return registryNames()[id];
+}
+
+int Statistics::statisticsCount()
+{
+	UScopeMutex lock(registryMutex());
+	return (int)registryNames().size();
+}
+
 const std::map<std::string, float> & Statistics::defaultData()
 {
 	Statistics stat;
@@ -71,6 +117,50 @@ std::map<std::string, float> Statistics::deserializeData(const std::string & dat
 	return output;
 }
 
+cv::Mat Statistics::serializeDataBinary(const std::vector<std::pair<int, float> > & data)
+{
+	int count = (int)data.size();
+	cv::Mat output(1, sizeof(int) + count*(sizeof(int)+sizeof(float)), CV_8UC1);
+	int * ids = (int *)(output.data + sizeof(int));
+	float * values = (float *)(output.data + sizeof(int) + count*sizeof(int));
+	memcpy(output.data, &count, sizeof(int));
+	for(int i=0; i<count; ++i)
+	{
+		ids[i] = data[i].first;
+		values[i] = data[i].second;
+	}
+	return output;
+}
+
+std::vector<std::pair<int, float> > Statistics::deserializeDataBinary(const cv::Mat & data)
+{
+	std::vector<std::pair<int, float> > output;
+	if(data.empty())
+	{
+		return output;
+	}
+	UASSERT(data.type() == CV_8UC1 && data.rows == 1);
+	int count = 0;
+	if(data.cols >= (int)sizeof(int))
+	{
+		memcpy(&count, data.data, sizeof(int));
+	}
+	if(count < 0 || (size_t)data.cols != sizeof(int) + count*(sizeof(int)+sizeof(float)))
+	{
+		UERROR("Corrupted binary statistics (size=%d, count=%d)", data.cols, count);
+		return output;
+	}
+	const unsigned char * ids = data.data + sizeof(int);
+	const unsigned char * values = ids + count*sizeof(int);
+	output.resize(count);
+	for(int i=0; i<count; ++i)
+	{
+		memcpy(&output[i].first, ids + i*sizeof(int), sizeof(int));
+		memcpy(&output[i].second, values + i*sizeof(float), sizeof(float));
+	}
+	return output;
+}
+
 Statistics::Statistics() :
 	_extended(0),
 	_refImageId(0),
@@ -80,7 +170,8 @@ Statistics::Statistics() :
 	_proximiyDetectionId(0),
 	_proximiyDetectionMapId(-1),
 	_stamp(0.0f),
-	_currentGoalId(0)
+	_currentGoalId(0),
+	_dataUpdated(true)
 {
 	_defaultDataInitialized = true;
 }
@@ -92,7 +183,54 @@ Statistics::~Statistics()
 // name format = "Grp/Name/unit"
 void Statistics::addStatistic(const std::string & name, float value)
 {
-	uInsert(_data, std::pair<std::string, float>(name, value));
+	addStatistic(statisticId(name), value);
+}
+
+void Statistics::addStatistic(int id, float value)
+{
+	UASSERT(id >= 0);
+	if(id >= (int)_values.size())
+	{
+		// room for all registered statistics, they are likely to be added too
+		int size = std::max(id+1, statisticsCount());
+		_values.resize(size, 0.0f);
+		_valuesSet.resize(size, 0);
+	}
+	_values[id] = value;
+	_valuesSet[id] = 1;
+	_dataUpdated = false;
+}
+
+const std::map<std::string, float> & Statistics::data() const
+{
+	// The same statistics can be read from many threads (e.g., a RtabmapEvent
+	// delivered to queued subscribers), so the map is rebuilt under the lock.
+	UScopeMutex lock(registryMutex());
+	if(!_dataUpdated)
+	{
+		_data.clear();
+		for(unsigned int i=0; i<_values.size(); ++i)
+		{
+			if(_valuesSet[i])
+			{
+				_data.insert(std::make_pair(registryNames()[i], _values[i]));
+			}
+		}
+		_dataUpdated = true;
+	}
+	return _data;
+}
+
+void Statistics::getValues(std::vector<std::pair<int, float> > & values) const
+{
+	values.clear();
+	for(unsigned int i=0; i<_values.size(); ++i)
+	{
+		if(_valuesSet[i])
+		{
+			values.push_back(std::make_pair((int)i, _values[i]));
+		}
+	}
 }
 
 }
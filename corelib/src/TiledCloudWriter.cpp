@@ -0,0 +1,444 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/TiledCloudWriter.h"
+
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UFile.h>
+#include <rtabmap/utilite/UDirectory.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace rtabmap {
+
+// Points accumulated in a voxel, this is also the record
+// format of the temporary files.
+struct TiledCloudWriter::Voxel
+{
+	Key key;
+	int count;
+	float sum[10]; // x, y, z, normal x, y, z, curvature, r, g, b
+};
+
+struct TiledCloudWriter::Tile
+{
+	Tile() : spilled(0) {}
+
+	// @return true if the voxel was not in memory
+	bool add(const Voxel & voxel)
+	{
+		std::pair<std::map<Key, int>::iterator, bool> inserted =
+				index.insert(std::make_pair(voxel.key, (int)voxels.size()));
+		if(inserted.second)
+		{
+			voxels.push_back(voxel);
+			return true;
+		}
+		Voxel & v = voxels[inserted.first->second];
+		v.count += voxel.count;
+		for(int n=0; n<10; ++n)
+		{
+			v.sum[n] += voxel.sum[n];
+		}
+		return false;
+	}
+
+	void release()
+	{
+		std::map<Key, int>().swap(index);
+		std::vector<Voxel>().swap(voxels);
+	}
+
+	std::map<Key, int> index; // voxel -> position in voxels
+	std::vector<Voxel> voxels;
+	int spilled; // voxels in the temporary file
+};
+
+static int floorDiv(int a, int b)
+{
+	return a>=0?a/b:-((-a-1)/b)-1;
+}
+
+static const int kPLYVertexSize = 31; // x y z red green blue normal_x normal_y normal_z curvature
+
+static void writePLYHeader(FILE * file, unsigned long points)
+{
+	int one = 1;
+	bool littleEndian = *(char*)&one == 1;
+	// fixed width count, it is rewritten when all points are written
+	fprintf(file,
+			"ply\n"
+			"format %s 1.0\n"
+			"element vertex %010lu\n"
+			"property float x\n"
+			"property float y\n"
+			"property float z\n"
+			"property uchar red\n"
+			"property uchar green\n"
+			"property uchar blue\n"
+			"property float normal_x\n"
+			"property float normal_y\n"
+			"property float normal_z\n"
+			"property float curvature\n"
+			"end_header\n",
+			littleEndian?"binary_little_endian":"binary_big_endian",
+			points);
+}
+
+TiledCloudWriter::TiledCloudWriter(
+		const std::string & path,
+		float voxelSize,
+		float tileSize,
+		bool splitTiles,
+		int maxBufferedVoxels) :
+	path_(path),
+	tmpDir_(path + ".tmp"),
+	voxelSize_(voxelSize),
+	tileVoxels_(1),
+	splitTiles_(splitTiles),
+	maxBufferedVoxels_(maxBufferedVoxels),
+	bufferedVoxels_(0),
+	failed_(false),
+	closed_(false),
+	output_(0),
+	index_(0),
+	points_(0)
+{
+	UASSERT(!path_.empty());
+	UASSERT(voxelSize_ > 0.0f);
+	UASSERT(maxBufferedVoxels_ > 0);
+	if(tileSize > voxelSize_)
+	{
+		tileVoxels_ = (int)std::floor(tileSize/voxelSize_ + 0.5f);
+	}
+	UDEBUG("path=%s voxel=%f tile=%f (%d voxels) split=%d", path_.c_str(), voxelSize_, tileVoxels_*voxelSize_, tileVoxels_, splitTiles_?1:0);
+}
+
+TiledCloudWriter::~TiledCloudWriter()
+{
+	clear();
+}
+
+void TiledCloudWriter::add(const pcl::PointCloud<pcl::PointXYZRGBNormal> & cloud)
+{
+	UASSERT_MSG(!closed_, "Clouds cannot be added after close()");
+
+	float inverseVoxelSize = 1.0f/voxelSize_;
+	Key tileKey = {0, 0, 0};
+	Tile * tile = 0;
+	for(unsigned int n=0; n<cloud.size(); ++n)
+	{
+		const pcl::PointXYZRGBNormal & pt = cloud.at(n);
+		if(!pcl::isFinite(pt))
+		{
+			continue;
+		}
+		Voxel voxel;
+		voxel.key.i = (int)std::floor(pt.x * inverseVoxelSize);
+		voxel.key.j = (int)std::floor(pt.y * inverseVoxelSize);
+		voxel.key.k = (int)std::floor(pt.z * inverseVoxelSize);
+		voxel.count = 1;
+		voxel.sum[0] = pt.x;
+		voxel.sum[1] = pt.y;
+		voxel.sum[2] = pt.z;
+		voxel.sum[3] = pt.normal_x;
+		voxel.sum[4] = pt.normal_y;
+		voxel.sum[5] = pt.normal_z;
+		voxel.sum[6] = pt.curvature;
+		voxel.sum[7] = float(pt.r);
+		voxel.sum[8] = float(pt.g);
+		voxel.sum[9] = float(pt.b);
+
+		// voxels are never split between tiles
+		Key key;
+		key.i = floorDiv(voxel.key.i, tileVoxels_);
+		key.j = floorDiv(voxel.key.j, tileVoxels_);
+		key.k = floorDiv(voxel.key.k, tileVoxels_);
+		if(tile == 0 || !(key == tileKey))
+		{
+			std::map<Key, Tile*>::iterator iter = tiles_.find(key);
+			if(iter == tiles_.end())
+			{
+				iter = tiles_.insert(std::make_pair(key, new Tile())).first;
+			}
+			tileKey = key;
+			tile = iter->second;
+		}
+		if(tile->add(voxel))
+		{
+			++bufferedVoxels_;
+		}
+	}
+
+	if(bufferedVoxels_ > maxBufferedVoxels_)
+	{
+		flush();
+	}
+}
+
+bool TiledCloudWriter::flush()
+{
+	UDEBUG("Spilling %d voxels of %d tiles to \"%s\"", bufferedVoxels_, (int)tiles_.size(), tmpDir_.c_str());
+	if(!UDirectory::exists(tmpDir_) && !UDirectory::makeDir(tmpDir_))
+	{
+		UERROR("Cannot create temporary directory \"%s\"", tmpDir_.c_str());
+		failed_ = true;
+	}
+	for(std::map<Key, Tile*>::iterator iter=tiles_.begin(); !failed_ && iter!=tiles_.end(); ++iter)
+	{
+		Tile & tile = *iter->second;
+		if(tile.voxels.empty())
+		{
+			continue;
+		}
+		std::string tmpPath = tmpDir_ + UDirectory::separator() + tileName(iter->first) + ".bin";
+		// overwrite files from a previous run
+		FILE * file = fopen(tmpPath.c_str(), tile.spilled?"ab":"wb");
+		if(file == 0 ||
+		   fwrite(&tile.voxels[0], sizeof(Voxel), tile.voxels.size(), file) != tile.voxels.size())
+		{
+			UERROR("Cannot write temporary file \"%s\"", tmpPath.c_str());
+			failed_ = true;
+		}
+		if(file)
+		{
+			fclose(file);
+		}
+		tile.spilled += (int)tile.voxels.size();
+		tile.release();
+	}
+	bufferedVoxels_ = 0;
+	return !failed_;
+}
+
+bool TiledCloudWriter::mergeTile(const Key & key, Tile & tile)
+{
+	if(tile.spilled)
+	{
+		std::string tmpPath = tmpDir_ + UDirectory::separator() + tileName(key) + ".bin";
+		FILE * file = fopen(tmpPath.c_str(), "rb");
+		if(file == 0)
+		{
+			UERROR("Cannot read temporary file \"%s\"", tmpPath.c_str());
+			failed_ = true;
+			return false;
+		}
+		std::vector<Voxel> chunk(4096);
+		size_t read = 0;
+		int loaded = 0;
+		while((read = fread(&chunk[0], sizeof(Voxel), chunk.size(), file)) > 0)
+		{
+			for(size_t n=0; n<read; ++n)
+			{
+				tile.add(chunk[n]);
+			}
+			loaded += (int)read;
+		}
+		fclose(file);
+		UFile::erase(tmpPath);
+		if(loaded != tile.spilled)
+		{
+			UERROR("Temporary file \"%s\" is truncated (%d/%d voxels)", tmpPath.c_str(), loaded, tile.spilled);
+			failed_ = true;
+			return false;
+		}
+		tile.spilled = 0;
+	}
+
+	std::vector<std::pair<Key, int> > order(tile.voxels.size());
+	for(unsigned int n=0; n<tile.voxels.size(); ++n)
+	{
+		order[n] = std::make_pair(tile.voxels[n].key, (int)n);
+	}
+	std::sort(order.begin(), order.end());
+
+	std::vector<unsigned char> data(order.size()*kPLYVertexSize);
+	unsigned char * ptr = data.empty()?0:&data[0];
+	float min[3] = {0,0,0};
+	float max[3] = {0,0,0};
+	for(unsigned int n=0; n<order.size(); ++n)
+	{
+		const Voxel & voxel = tile.voxels[order[n].second];
+		float count = float(voxel.count);
+		float xyz[3] = {voxel.sum[0] / count, voxel.sum[1] / count, voxel.sum[2] / count};
+		float normal[4] = {voxel.sum[3] / count, voxel.sum[4] / count, voxel.sum[5] / count, voxel.sum[6] / count};
+		memcpy(ptr, xyz, sizeof(xyz));
+		ptr += sizeof(xyz);
+		*ptr++ = (unsigned char)(voxel.sum[7] / count);
+		*ptr++ = (unsigned char)(voxel.sum[8] / count);
+		*ptr++ = (unsigned char)(voxel.sum[9] / count);
+		memcpy(ptr, normal, sizeof(normal));
+		ptr += sizeof(normal);
+
+		for(int d=0; d<3; ++d)
+		{
+			min[d] = n==0?xyz[d]:std::min(min[d], xyz[d]);
+			max[d] = n==0?xyz[d]:std::max(max[d], xyz[d]);
+		}
+	}
+	tile.release();
+
+	FILE * file = output_;
+	std::string name;
+	if(splitTiles_)
+	{
+		name = basePath() + "_" + tileName(key) + ".ply";
+		file = fopen(name.c_str(), "wb");
+		if(file == 0)
+		{
+			UERROR("Cannot write \"%s\"", name.c_str());
+			failed_ = true;
+			return false;
+		}
+		writePLYHeader(file, (unsigned long)order.size());
+	}
+	UASSERT(file != 0);
+	bool written = data.empty() || fwrite(&data[0], 1, data.size(), file) == data.size();
+	if(splitTiles_)
+	{
+		fclose(file);
+		UASSERT(index_ != 0);
+		written = fprintf(index_, "%s %f %f %f %f %f %f %d\n",
+				UFile::getName(name).c_str(), min[0], min[1], min[2], max[0], max[1], max[2], (int)order.size()) > 0 && written;
+	}
+	if(!written)
+	{
+		UERROR("Failed writing points of tile %s", tileName(key).c_str());
+		failed_ = true;
+		return false;
+	}
+	points_ += (unsigned long)order.size();
+	return true;
+}
+
+bool TiledCloudWriter::close()
+{
+	UASSERT_MSG(!closed_, "close() already called");
+	closed_ = true;
+
+	if(!failed_)
+	{
+		if(splitTiles_)
+		{
+			std::string indexPath = basePath() + "_index.txt";
+			index_ = fopen(indexPath.c_str(), "w");
+			if(index_)
+			{
+				fprintf(index_, "# file x_min y_min z_min x_max y_max z_max points\n");
+			}
+			else
+			{
+				UERROR("Cannot write \"%s\"", indexPath.c_str());
+				failed_ = true;
+			}
+		}
+		else
+		{
+			output_ = fopen(path_.c_str(), "wb");
+			if(output_)
+			{
+				writePLYHeader(output_, 0);
+			}
+			else
+			{
+				UERROR("Cannot write \"%s\"", path_.c_str());
+				failed_ = true;
+			}
+		}
+	}
+
+	// one tile in memory at a time
+	for(std::map<Key, Tile*>::iterator iter=tiles_.begin(); !failed_ && iter!=tiles_.end(); ++iter)
+	{
+		mergeTile(iter->first, *iter->second);
+	}
+
+	if(output_)
+	{
+		if(!failed_)
+		{
+			fseek(output_, 0, SEEK_SET);
+			writePLYHeader(output_, points_);
+		}
+		fclose(output_);
+		output_ = 0;
+	}
+	if(index_)
+	{
+		fclose(index_);
+		index_ = 0;
+	}
+	UDEBUG("Written %lu points in %d tiles", points_, (int)tiles_.size());
+
+	clear();
+	return !failed_;
+}
+
+std::string TiledCloudWriter::tileName(const Key & key) const
+{
+	return uFormat("%d_%d_%d", key.i, key.j, key.k);
+}
+
+std::string TiledCloudWriter::basePath() const
+{
+	std::string ext = UFile::getExtension(path_);
+	return ext.empty()?path_:path_.substr(0, path_.size()-ext.size()-1);
+}
+
+void TiledCloudWriter::clear()
+{
+	// tiles are kept for tiles()
+	for(std::map<Key, Tile*>::iterator iter=tiles_.begin(); iter!=tiles_.end(); ++iter)
+	{
+		if(iter->second && iter->second->spilled)
+		{
+			UFile::erase(tmpDir_ + UDirectory::separator() + tileName(iter->first) + ".bin");
+		}
+		delete iter->second;
+		iter->second = 0;
+	}
+	if(UDirectory::exists(tmpDir_))
+	{
+		UDirectory::removeDir(tmpDir_);
+	}
+	if(output_)
+	{
+		fclose(output_);
+		output_ = 0;
+	}
+	if(index_)
+	{
+		fclose(index_);
+		index_ = 0;
+	}
+	bufferedVoxels_ = 0;
+}
+
+} // namespace rtabmap
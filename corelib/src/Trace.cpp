@@ -0,0 +1,321 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/Trace.h"
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UMutex.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <vector>
+#include <stdio.h>
+
+namespace rtabmap {
+
+namespace {
+
+struct TraceEvent
+{
+	const char * name;
+	long long start;
+	long long duration;
+};
+
+// Events are only written by the owner thread. They are stored in blocks
+// allocated on demand, the block table is allocated once so that other
+// threads can read the events [0, size) without locking.
+class ThreadBuffer
+{
+public:
+	static const int kBlockSize = 1024;
+
+	ThreadBuffer(int id, int maxEvents) :
+		finished(false),
+		id_(id),
+		maxEvents_(maxEvents),
+		blocks_((maxEvents+kBlockSize-1)/kBlockSize, (TraceEvent*)0),
+		size_(0),
+		dropped_(0)
+	{}
+	~ThreadBuffer()
+	{
+		for(unsigned int i=0; i<blocks_.size(); ++i)
+		{
+			delete [] blocks_[i];
+		}
+	}
+
+	int id() const {return id_;}
+	int size() const {return size_.load(std::memory_order_acquire);}
+	int dropped() const {return dropped_.load(std::memory_order_relaxed);}
+	const TraceEvent & at(int i) const {return blocks_[i/kBlockSize][i%kBlockSize];}
+
+	void add(const char * name, long long start, long long duration)
+	{
+		int i = size_.load(std::memory_order_relaxed);
+		if(i >= maxEvents_)
+		{
+			dropped_.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		TraceEvent *& block = blocks_[i/kBlockSize];
+		if(block == 0)
+		{
+			block = new TraceEvent[kBlockSize];
+		}
+		TraceEvent & event = block[i%kBlockSize];
+		event.name = name;
+		event.start = start;
+		event.duration = duration;
+		size_.store(i+1, std::memory_order_release);
+	}
+	void clear()
+	{
+		size_.store(0, std::memory_order_release);
+		dropped_.store(0, std::memory_order_relaxed);
+	}
+
+	// protected by the registry mutex
+	std::string name;
+	bool finished;
+
+private:
+	int id_;
+	int maxEvents_;
+	std::vector<TraceEvent*> blocks_;
+	std::atomic<int> size_;
+	std::atomic<int> dropped_;
+};
+
+std::atomic<bool> g_started(false);
+std::atomic<int> g_maxEvents(1000000);
+const std::chrono::steady_clock::time_point g_origin = std::chrono::steady_clock::now();
+// Buffers are never deleted: the events of finished threads can still be
+// saved, and threads still running at exit can still record.
+UMutex & registryMutex()
+{
+	static UMutex * mutex = new UMutex();
+	return *mutex;
+}
+std::list<ThreadBuffer> & registry()
+{
+	static std::list<ThreadBuffer> * buffers = new std::list<ThreadBuffer>();
+	return *buffers;
+}
+
+// The buffer of a thread is released when the thread exits, it is then reused
+// by the next thread with the same name (e.g., the DBDriver trash thread
+// started for each update), which appears on the same row in the trace.
+class ThreadState
+{
+public:
+	ThreadState() : buffer(0) {}
+	~ThreadState()
+	{
+		if(buffer)
+		{
+			UScopeMutex lock(registryMutex());
+			buffer->finished = true;
+		}
+	}
+	ThreadBuffer * buffer;
+	std::string name;
+};
+thread_local ThreadState t_state;
+
+ThreadBuffer & threadBuffer()
+{
+	ThreadState & state = t_state;
+	if(state.buffer == 0)
+	{
+		UScopeMutex lock(registryMutex());
+		std::list<ThreadBuffer> & buffers = registry();
+		for(std::list<ThreadBuffer>::iterator iter=buffers.begin(); iter!=buffers.end() && state.buffer==0; ++iter)
+		{
+			if(iter->finished && iter->name.compare(state.name) == 0)
+			{
+				iter->finished = false;
+				state.buffer = &(*iter);
+			}
+		}
+		if(state.buffer == 0)
+		{
+			buffers.emplace_back((int)buffers.size()+1, g_maxEvents.load());
+			buffers.back().name = state.name;
+			state.buffer = &buffers.back();
+		}
+	}
+	return *state.buffer;
+}
+
+std::string escapeJson(const std::string & str)
+{
+	std::string out;
+	out.reserve(str.size());
+	for(unsigned int i=0; i<str.size(); ++i)
+	{
+		if(str[i] == '"' || str[i] == '\\')
+		{
+			out.push_back('\\');
+			out.push_back(str[i]);
+		}
+		else if((unsigned char)str[i] < 0x20)
+		{
+			out.push_back(' ');
+		}
+		else
+		{
+			out.push_back(str[i]);
+		}
+	}
+	return out;
+}
+
+} // namespace
+
+void Trace::start(int maxEventsPerThread)
+{
+	UASSERT(maxEventsPerThread > 0);
+	g_maxEvents = maxEventsPerThread;
+	g_started.store(true, std::memory_order_release);
+}
+
+void Trace::stop()
+{
+	g_started.store(false, std::memory_order_release);
+}
+
+bool Trace::isStarted()
+{
+	return g_started.load(std::memory_order_relaxed);
+}
+
+void Trace::clear()
+{
+	UScopeMutex lock(registryMutex());
+	std::list<ThreadBuffer> & buffers = registry();
+	for(std::list<ThreadBuffer>::iterator iter=buffers.begin(); iter!=buffers.end(); ++iter)
+	{
+		iter->clear();
+	}
+}
+
+bool Trace::save(const std::string & path)
+{
+	FILE * file = 0;
+#ifdef _MSC_VER
+	fopen_s(&file, path.c_str(), "w");
+#else
+	file = fopen(path.c_str(), "w");
+#endif
+	if(file == 0)
+	{
+		UERROR("Cannot open file \"%s\"", path.c_str());
+		return false;
+	}
+
+	UScopeMutex lock(registryMutex());
+	const std::list<ThreadBuffer> & buffers = registry();
+	int events = 0;
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for(std::list<ThreadBuffer>::const_iterator iter=buffers.begin(); iter!=buffers.end(); ++iter)
+	{
+		std::string name = iter->name.empty()?uFormat("Thread %d", iter->id()):iter->name;
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				first?"":",\n", iter->id(), escapeJson(name).c_str());
+		first = false;
+		int size = iter->size();
+		for(int i=0; i<size; ++i)
+		{
+			const TraceEvent & event = iter->at(i);
+			fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"rtabmap\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%lld,\"dur\":%lld}",
+					escapeJson(event.name).c_str(), iter->id(), event.start, event.duration);
+		}
+		events += size;
+	}
+	fprintf(file, "\n]}\n");
+	bool success = ferror(file) == 0;
+	fclose(file);
+	if(success)
+	{
+		UINFO("Saved %d trace events to \"%s\"", events, path.c_str());
+	}
+	else
+	{
+		UERROR("Failed writing trace to \"%s\"", path.c_str());
+	}
+	return success;
+}
+
+int Trace::events()
+{
+	UScopeMutex lock(registryMutex());
+	const std::list<ThreadBuffer> & buffers = registry();
+	int events = 0;
+	for(std::list<ThreadBuffer>::const_iterator iter=buffers.begin(); iter!=buffers.end(); ++iter)
+	{
+		events += iter->size();
+	}
+	return events;
+}
+
+int Trace::droppedEvents()
+{
+	UScopeMutex lock(registryMutex());
+	const std::list<ThreadBuffer> & buffers = registry();
+	int dropped = 0;
+	for(std::list<ThreadBuffer>::const_iterator iter=buffers.begin(); iter!=buffers.end(); ++iter)
+	{
+		dropped += iter->dropped();
+	}
+	return dropped;
+}
+
+void Trace::setThreadName(const std::string & name)
+{
+	ThreadState & state = t_state;
+	state.name = name;
+	if(state.buffer)
+	{
+		UScopeMutex lock(registryMutex());
+		state.buffer->name = name;
+	}
+}
+
+void Trace::add(const char * name, long long start, long long duration)
+{
+	threadBuffer().add(name, start, duration);
+}
+
+long long Trace::now()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_origin).count();
+}
+
+} // namespace rtabmap
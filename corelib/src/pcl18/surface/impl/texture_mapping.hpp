@@ -41,6 +41,8 @@
 #include <pcl/common/distances.h>
 #include <pcl18/surface/texture_mapping.h>
 #include <pcl/search/octree.h>
+#include <opencv2/core/core.hpp>
+#include <rtabmap/utilite/UTimer.h>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 template<typename PointInT> std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> >
@@ -1049,40 +1051,48 @@ bool ptInTriangle(const pcl::PointXY & p0, const pcl::PointXY & p1, const pcl::P
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
-template<typename PointInT> bool
-pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
-		pcl::TextureMesh &mesh,
-		const pcl::texture_mapping::CameraVector &cameras,
-		const rtabmap::ProgressState * state,
-		std::vector<std::map<int, pcl::PointXY> > * vertexToPixels)
+// Visible faces of a batch of cameras: each camera is projected, its occluded
+// faces and its small clusters are removed independently of the other cameras,
+// so the cameras of the batch are processed in parallel. Each camera only writes
+// its own visibleFaces and messages entries.
+template<typename PointInT>
+class pcl::TextureMapping<PointInT>::VisibilityBody : public cv::ParallelLoopBody
 {
+public:
+	VisibilityBody(
+			pcl::TextureMapping<PointInT> & mapping,
+			const pcl::PointCloud<PointInT> & meshCloud,
+			const std::vector<pcl::Vertices> & faces,
+			const pcl::texture_mapping::CameraVector & cameras,
+			int firstCamera,
+			std::vector<std::map<int, FaceInfo> > & visibleFaces,
+			std::vector<std::string> & messages) :
+		mapping_(mapping),
+		meshCloud_(meshCloud),
+		faces_(faces),
+		cameras_(cameras),
+		firstCamera_(firstCamera),
+		visibleFaces_(visibleFaces),
+		messages_(messages)
+	{}
 
-	if (mesh.tex_polygons.size () != 1)
-		return false;
-
-	typename pcl::PointCloud<PointInT>::Ptr mesh_cloud (new pcl::PointCloud<PointInT>);
-
-	pcl::fromPCLPointCloud2 (mesh.cloud, *mesh_cloud);
-
-	std::vector<pcl::Vertices> faces;
-	faces.swap(mesh.tex_polygons[0]);
-
-	mesh.tex_polygons.clear();
-	mesh.tex_polygons.resize(cameras.size()+1);
-	mesh.tex_coordinates.clear();
-	mesh.tex_coordinates.resize(cameras.size()+1);
+	virtual void operator()(const cv::Range & range) const
+	{
+		for(int i=range.start; i<range.end; ++i)
+		{
+			process(firstCamera_ + i);
+		}
+	}
 
-	// pre compute all cam inverse and visibility
-	std::vector<std::map<int, FaceInfo > > visibleFaces(cameras.size());
-	std::vector<Eigen::Affine3f> invCamTransform(cameras.size());
-	std::vector<std::list<int> > faceCameras(faces.size());
-	UINFO("Precompute visible faces per cam (%d faces, %d cams)", (int)faces.size(), (int)cameras.size());
-	for (unsigned int current_cam = 0; current_cam < cameras.size(); ++current_cam)
+private:
+	void process(unsigned int current_cam) const
 	{
 		UDEBUG("Texture camera %d...", current_cam);
+		const std::vector<pcl::Vertices> & faces = faces_;
+		std::map<int, FaceInfo> & cameraVisibleFaces = visibleFaces_[current_cam];
 
 		typename pcl::PointCloud<PointInT>::Ptr camera_cloud (new pcl::PointCloud<PointInT>);
-		pcl::transformPointCloud(*mesh_cloud, *camera_cloud, cameras[current_cam].pose.inverse());
+		pcl::transformPointCloud(meshCloud_, *camera_cloud, cameras_[current_cam].pose.inverse());
 
 		std::vector<int> visibilityIndices;
 		visibilityIndices.resize (faces.size ());
@@ -1092,7 +1102,7 @@ pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
 		int oi=0;
 		for(unsigned int idx_face=0; idx_face<faces.size(); ++idx_face)
 		{
-			pcl::Vertices & face = faces[idx_face];
+			const pcl::Vertices & face = faces[idx_face];
 
 			int j=oi*3;
 			pcl::PointXY & uv_coords1 = projections->at(j);
@@ -1101,7 +1111,7 @@ pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
 			PointInT & pt0 = camera_cloud->points[face.vertices[0]];
 			PointInT & pt1 = camera_cloud->points[face.vertices[1]];
 			PointInT & pt2 = camera_cloud->points[face.vertices[2]];
-			if (isFaceProjected (cameras[current_cam],
+			if (mapping_.isFaceProjected (cameras_[current_cam],
 					pt0,
 					pt1,
 					pt2,
@@ -1135,7 +1145,7 @@ pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
 						pt2.x - pt1.x,
 						pt2.y - pt1.y,
 						pt2.z - pt1.z);
-				if(facingTheCam && this->max_angle_)
+				if(facingTheCam && mapping_.max_angle_)
 				{
 					Eigen::Vector3f normal3D;
 					normal3D = e0.cross(e1);
@@ -1151,7 +1161,7 @@ pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
 				pcl::PointXY center;
 				center.x = (uv_coords1.x+uv_coords2.x+uv_coords3.x)/3.0f;
 				center.y = (uv_coords1.y+uv_coords2.y+uv_coords3.y)/3.0f;
-				visibleFaces[current_cam].insert(visibleFaces[current_cam].end(), std::make_pair(idx_face, FaceInfo(distanceToCam, angleToCam, longestEdgeSqrd, facingTheCam, uv_coords1, uv_coords2, uv_coords3, center)));
+				cameraVisibleFaces.insert(cameraVisibleFaces.end(), std::make_pair(idx_face, FaceInfo(distanceToCam, angleToCam, longestEdgeSqrd, facingTheCam, uv_coords1, uv_coords2, uv_coords3, center)));
 				sortedVisibleFaces.insert(std::make_pair(distanceToCam, idx_face));
 				visibilityIndices[oi] = idx_face;
 				++oi;
@@ -1177,8 +1187,8 @@ pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
 		{
 			int idx_face = jter->second;
 			//int idx_face = visibilityIndices[idx];
-			std::map<int, FaceInfo>::iterator iter= visibleFaces[current_cam].find(idx_face);
-			UASSERT(iter != visibleFaces[current_cam].end());
+			typename std::map<int, FaceInfo>::iterator iter= cameraVisibleFaces.find(idx_face);
+			UASSERT(iter != cameraVisibleFaces.end());
 
 			FaceInfo & info = iter->second;
 
@@ -1187,7 +1197,7 @@ pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
 			double radius;
 			pcl::PointXY center;
 			// getTriangleCircumcenterAndSize (info.uv_coord1, info.uv_coord2, info.uv_coord3, center, radius);
-			getTriangleCircumcscribedCircleCentroid(info.uv_coord1, info.uv_coord2, info.uv_coord3, center, radius); // this function yields faster results than getTriangleCircumcenterAndSize
+			mapping_.getTriangleCircumcscribedCircleCentroid(info.uv_coord1, info.uv_coord2, info.uv_coord3, center, radius); // this function yields faster results than getTriangleCircumcenterAndSize
 
 			// get points inside circ.circle
 			if (kdtree.radiusSearch (center, radius, idxNeighbors, neighborsSquaredDistance) > 0 )
@@ -1196,22 +1206,17 @@ pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
 				for (size_t i = 0; i < idxNeighbors.size (); ++i)
 				{
 					int neighborFaceIndex = idxNeighbors[i]/3;
-					//std::map<int, FaceInfo>::iterator jter= visibleFaces[current_cam].find(visibilityIndices[neighborFaceIndex]);
-					//if(jter != visibleFaces[current_cam].end())
+					if (std::max(camera_cloud->points[faces[idx_face].vertices[0]].z,
+								std::max (camera_cloud->points[faces[idx_face].vertices[1]].z,
+										camera_cloud->points[faces[idx_face].vertices[2]].z))
+						< camera_cloud->points[faces[visibilityIndices[neighborFaceIndex]].vertices[idxNeighbors[i]%3]].z)
 					{
-						if (std::max(camera_cloud->points[faces[idx_face].vertices[0]].z,
-									std::max (camera_cloud->points[faces[idx_face].vertices[1]].z,
-											camera_cloud->points[faces[idx_face].vertices[2]].z))
-							< camera_cloud->points[faces[visibilityIndices[neighborFaceIndex]].vertices[idxNeighbors[i]%3]].z)
-						//if (info.distance < jter->second.distance)
+						// neighbor is farther than all the face's points. Check if it falls into the triangle
+						if (mapping_.checkPointInsideTriangle(info.uv_coord1, info.uv_coord2, info.uv_coord3, projections->at(idxNeighbors[i])))
 						{
-							// neighbor is farther than all the face's points. Check if it falls into the triangle
-							if (checkPointInsideTriangle(info.uv_coord1, info.uv_coord2, info.uv_coord3, projections->at(idxNeighbors[i])))
-							{
-								// current neighbor is inside triangle and is closer => the corresponding face
-								occludedFaces.insert(visibilityIndices[neighborFaceIndex]);
-								//TODO we could remove the projections of this face from the kd-tree cloud, but I fond it slower, and I need the point to keep ordered to querry UV coordinates later
-							}
+							// current neighbor is inside triangle and is closer => the corresponding face
+							occludedFaces.insert(visibilityIndices[neighborFaceIndex]);
+							//TODO we could remove the projections of this face from the kd-tree cloud, but I fond it slower, and I need the point to keep ordered to querry UV coordinates later
 						}
 					}
 				}
@@ -1221,16 +1226,16 @@ pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
 		// remove occluded faces
 		for(std::set<int>::iterator iter= occludedFaces.begin(); iter!=occludedFaces.end(); ++iter)
 		{
-			visibleFaces[current_cam].erase(*iter);
+			cameraVisibleFaces.erase(*iter);
 		}
 
 		// filter clusters
 		int clusterFaces = 0;
 
-		std::vector<pcl::Vertices> polygons(visibleFaces[current_cam].size());
-		std::vector<int> polygon_to_face_index(visibleFaces[current_cam].size());
+		std::vector<pcl::Vertices> polygons(cameraVisibleFaces.size());
+		std::vector<int> polygon_to_face_index(cameraVisibleFaces.size());
 		oi =0;
-		for(std::map<int, FaceInfo>::iterator iter=visibleFaces[current_cam].begin(); iter!=visibleFaces[current_cam].end(); ++iter)
+		for(typename std::map<int, FaceInfo>::iterator iter=cameraVisibleFaces.begin(); iter!=cameraVisibleFaces.end(); ++iter)
 		{
 			polygons[oi].vertices.resize(3);
 			polygons[oi].vertices[0] = faces[iter->first].vertices[0];
@@ -1248,22 +1253,21 @@ pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
 				vertexToPolygons);
 		std::list<std::list<int> > clusters = rtabmap::util3d::clusterPolygons(
 				neighbors,
-				min_cluster_size_);
+				mapping_.min_cluster_size_);
 		std::set<int> polygonsKept;
 		for(std::list<std::list<int> >::iterator iter=clusters.begin(); iter!=clusters.end(); ++iter)
 		{
 			for(std::list<int>::iterator jter=iter->begin(); jter!=iter->end(); ++jter)
 			{
 				polygonsKept.insert(polygon_to_face_index[*jter]);
-				faceCameras[polygon_to_face_index[*jter]].push_back(current_cam);
 			}
 		}
 
-		for(std::map<int, FaceInfo>::iterator iter=visibleFaces[current_cam].begin(); iter!=visibleFaces[current_cam].end();)
+		for(typename std::map<int, FaceInfo>::iterator iter=cameraVisibleFaces.begin(); iter!=cameraVisibleFaces.end();)
 		{
 			if(polygonsKept.find(iter->first) == polygonsKept.end())
 			{
-				visibleFaces[current_cam].erase(iter++);
+				cameraVisibleFaces.erase(iter++);
 				++clusterFaces;
 			}
 			else
@@ -1272,63 +1276,80 @@ pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
 			}
 		}
 
-		std::string msg = uFormat("Processed camera %d/%d: %d occluded and %d spurious polygons out of %d", (int)current_cam+1, (int)cameras.size(), (int)occludedFaces.size(), clusterFaces, (int)visibilityIndices.size());
-		UINFO(msg.c_str());
-		if(state && !state->callback(msg))
-		{
-			//cancelled!
-			UWARN("Texturing cancelled!");
-			return false;
-		}
+		messages_[current_cam] = uFormat("Processed camera %d/%d: %d occluded and %d spurious polygons out of %d", (int)current_cam+1, (int)cameras_.size(), (int)occludedFaces.size(), clusterFaces, (int)visibilityIndices.size());
 	}
 
-	std::string msg = uFormat("Texturing %d polygons...", (int)faces.size());
-	UINFO(msg.c_str());
-	if(state && !state->callback(msg))
-	{
-		//cancelled!
-		UWARN("Texturing cancelled!");
-		return false;
-	}
-	int textured = 0;
-	if(vertexToPixels)
-	{
-		*vertexToPixels = std::vector<std::map<int, pcl::PointXY> >(mesh_cloud->size());
-	}
-	for(unsigned int idx_face=0; idx_face<faces.size(); ++idx_face)
+private:
+	pcl::TextureMapping<PointInT> & mapping_;
+	const pcl::PointCloud<PointInT> & meshCloud_;
+	const std::vector<pcl::Vertices> & faces_;
+	const pcl::texture_mapping::CameraVector & cameras_;
+	int firstCamera_;
+	std::vector<std::map<int, FaceInfo> > & visibleFaces_;
+	std::vector<std::string> & messages_;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Best camera of the faces [firstFace, firstFace+range): the faces are independent,
+// the results are written in per-face slots (relative to firstFace) and are
+// appended to the mesh afterwards in face order.
+template<typename PointInT>
+class pcl::TextureMapping<PointInT>::FaceCameraBody : public cv::ParallelLoopBody
+{
+public:
+	FaceCameraBody(
+			const pcl::TextureMapping<PointInT> & mapping,
+			const pcl::texture_mapping::CameraVector & cameras,
+			const std::vector<std::list<int> > & faceCameras,
+			const std::vector<std::map<int, FaceInfo> > & visibleFaces,
+			int firstFace,
+			std::vector<int> & cameraIndices,
+			std::vector<std::vector<int> > * pixelCameras) :
+		mapping_(mapping),
+		cameras_(cameras),
+		faceCameras_(faceCameras),
+		visibleFaces_(visibleFaces),
+		firstFace_(firstFace),
+		cameraIndices_(cameraIndices),
+		pixelCameras_(pixelCameras)
+	{}
+
+	virtual void operator()(const cv::Range & range) const
 	{
-		if((idx_face+1)%10000 == 0)
+		for(int i=range.start; i<range.end; ++i)
 		{
-			UDEBUG("face %d/%d", idx_face+1, (int)faces.size());
-			if(state && !state->callback(uFormat("Textured %d/%d of %d polygons", textured, idx_face+1, (int)faces.size())))
-			{
-				//cancelled!
-				UWARN("Texturing cancelled!");
-				return false;
-			}
+			cameraIndices_[i] = process(firstFace_ + i, pixelCameras_?&pixelCameras_->at(i):0);
 		}
-		pcl::Vertices & face = faces[idx_face];
+	}
 
+private:
+	// Returns the camera texturing the face (-1 if none), pixelCameras are the
+	// cameras seeing the face with valid depth.
+	int process(int idx_face, std::vector<int> * pixelCameras) const
+	{
 		int cameraIndex = -1;
 		float smallestWeight = std::numeric_limits<float>::max();
 		bool depthSet = false;
-		pcl::PointXY uv_coords[3];
-		for (std::list<int>::iterator camIter = faceCameras[idx_face].begin(); camIter!=faceCameras[idx_face].end(); ++camIter)
+		if(pixelCameras)
+		{
+			pixelCameras->clear();
+		}
+		for (std::list<int>::const_iterator camIter = faceCameras_[idx_face].begin(); camIter!=faceCameras_[idx_face].end(); ++camIter)
 		{
 			int current_cam = *camIter;
-			std::map<int, FaceInfo>::iterator iter = visibleFaces[current_cam].find(idx_face);
-			UASSERT(iter != visibleFaces[current_cam].end());
-			if (iter->second.facingTheCam && (max_angle_ <=0.0f || iter->second.angle <= max_angle_))
+			typename std::map<int, FaceInfo>::const_iterator iter = visibleFaces_[current_cam].find(idx_face);
+			UASSERT(iter != visibleFaces_[current_cam].end());
+			if (iter->second.facingTheCam && (mapping_.max_angle_ <=0.0f || iter->second.angle <= mapping_.max_angle_))
 			{
 				float distanceToCam = iter->second.distance;
 				float vx = (iter->second.uv_coord1.x+iter->second.uv_coord2.x+ iter->second.uv_coord3.x)/3.0f-0.5f;
 				float vy = (iter->second.uv_coord1.y+iter->second.uv_coord2.y+ iter->second.uv_coord3.y)/3.0f-0.5f;
 				float distanceToCenter = vx*vx+vy*vy;
 
-				cv::Mat depth = cameras[current_cam].depth;
+				const cv::Mat & depth = cameras_[current_cam].depth;
 				bool currentDepthSet = false;
-				float maxDepthError = max_depth_error_==0.0f?std::sqrt(iter->second.longestEdgeSqrd)*2.0f : max_depth_error_;
-				if(!cameras[current_cam].depth.empty() && maxDepthError > 0.0f)
+				float maxDepthError = mapping_.max_depth_error_==0.0f?std::sqrt(iter->second.longestEdgeSqrd)*2.0f : mapping_.max_depth_error_;
+				if(!depth.empty() && maxDepthError > 0.0f)
 				{
 					float d1 = depth.type() == CV_32FC1?
 							depth.at<float>((1.0f-iter->second.uv_coord1.y)*depth.rows, iter->second.uv_coord1.x*depth.cols):
@@ -1376,11 +1397,9 @@ pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
 					}
 				}
 
-				if(vertexToPixels)
+				if(pixelCameras)
 				{
-					vertexToPixels->at(face.vertices[0]).insert(std::make_pair(current_cam, iter->second.uv_coord1));
-					vertexToPixels->at(face.vertices[1]).insert(std::make_pair(current_cam, iter->second.uv_coord2));
-					vertexToPixels->at(face.vertices[2]).insert(std::make_pair(current_cam, iter->second.uv_coord3));
+					pixelCameras->push_back(current_cam);
 				}
 
 				//UDEBUG("Process polygon %d cam =%d distanceToCam=%f", idx_face, current_cam, distanceToCam);
@@ -1389,9 +1408,6 @@ pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
 				{
 					cameraIndex = current_cam;
 					smallestWeight = distanceToCenter;
-					uv_coords[0] = iter->second.uv_coord1;
-					uv_coords[1] = iter->second.uv_coord2;
-					uv_coords[2] = iter->second.uv_coord3;
 					if(!depthSet && currentDepthSet)
 					{
 						depthSet = true;
@@ -1399,24 +1415,140 @@ pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
 				}
 			}
 		}
+		return cameraIndex;
+	}
+
+private:
+	const pcl::TextureMapping<PointInT> & mapping_;
+	const pcl::texture_mapping::CameraVector & cameras_;
+	const std::vector<std::list<int> > & faceCameras_;
+	const std::vector<std::map<int, FaceInfo> > & visibleFaces_;
+	int firstFace_;
+	std::vector<int> & cameraIndices_;
+	std::vector<std::vector<int> > * pixelCameras_;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointInT> bool
+pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
+		pcl::TextureMesh &mesh,
+		const pcl::texture_mapping::CameraVector &cameras,
+		const rtabmap::ProgressState * state,
+		std::vector<std::map<int, pcl::PointXY> > * vertexToPixels)
+{
+
+	if (mesh.tex_polygons.size () != 1)
+		return false;
+
+	typename pcl::PointCloud<PointInT>::Ptr mesh_cloud (new pcl::PointCloud<PointInT>);
+
+	pcl::fromPCLPointCloud2 (mesh.cloud, *mesh_cloud);
+
+	std::vector<pcl::Vertices> faces;
+	faces.swap(mesh.tex_polygons[0]);
+
+	mesh.tex_polygons.clear();
+	mesh.tex_polygons.resize(cameras.size()+1);
+	mesh.tex_coordinates.clear();
+	mesh.tex_coordinates.resize(cameras.size()+1);
+
+	// pre compute all cam inverse and visibility, the cameras are
+	// processed in batches of one camera per thread
+	std::vector<std::map<int, FaceInfo > > visibleFaces(cameras.size());
+	std::vector<std::list<int> > faceCameras(faces.size());
+	std::vector<std::string> messages(cameras.size());
+	int cameraBatch = std::max(1, cv::getNumThreads());
+	UTimer timer;
+	UINFO("Precompute visible faces per cam (%d faces, %d cams, %d threads)", (int)faces.size(), (int)cameras.size(), cameraBatch);
+	for (unsigned int firstCam = 0; firstCam < cameras.size(); firstCam+=cameraBatch)
+	{
+		int batch = std::min(cameraBatch, int(cameras.size() - firstCam));
+		cv::parallel_for_(cv::Range(0, batch), VisibilityBody(*this, *mesh_cloud, faces, cameras, firstCam, visibleFaces, messages), batch);
+
+		// in camera order, so that the cameras of a face are sorted
+		for (unsigned int current_cam = firstCam; current_cam < firstCam+batch; ++current_cam)
+		{
+			for(typename std::map<int, FaceInfo>::iterator iter=visibleFaces[current_cam].begin(); iter!=visibleFaces[current_cam].end(); ++iter)
+			{
+				faceCameras[iter->first].push_back(current_cam);
+			}
+
+			UINFO(messages[current_cam].c_str());
+			if(state && !state->callback(messages[current_cam]))
+			{
+				//cancelled!
+				UWARN("Texturing cancelled!");
+				return false;
+			}
+		}
+	}
+
+	std::string msg = uFormat("Texturing %d polygons... (visible faces of %d cameras computed in %fs)", (int)faces.size(), (int)cameras.size(), timer.ticks());
+	UINFO(msg.c_str());
+	if(state && !state->callback(msg))
+	{
+		//cancelled!
+		UWARN("Texturing cancelled!");
+		return false;
+	}
+	int textured = 0;
+	if(vertexToPixels)
+	{
+		*vertexToPixels = std::vector<std::map<int, pcl::PointXY> >(mesh_cloud->size());
+	}
+	// the faces are assigned in parallel by blocks, then appended in face order
+	const int faceBlock = 10000;
+	std::vector<int> cameraIndices(std::min((int)faces.size(), faceBlock));
+	std::vector<std::vector<int> > pixelCameras(vertexToPixels?cameraIndices.size():0);
+	for(unsigned int firstFace=0; firstFace<faces.size(); firstFace+=faceBlock)
+	{
+		int block = std::min(faceBlock, int(faces.size() - firstFace));
+		cv::parallel_for_(cv::Range(0, block), FaceCameraBody(*this, cameras, faceCameras, visibleFaces, firstFace, cameraIndices, vertexToPixels?&pixelCameras:0));
 
-		if(cameraIndex >= 0)
+		for(int i=0; i<block; ++i)
 		{
-			++textured;
-			mesh.tex_polygons[cameraIndex].push_back(face);
-			mesh.tex_coordinates[cameraIndex].push_back(Eigen::Vector2f(uv_coords[0].x, uv_coords[0].y));
-			mesh.tex_coordinates[cameraIndex].push_back(Eigen::Vector2f(uv_coords[1].x, uv_coords[1].y));
-			mesh.tex_coordinates[cameraIndex].push_back(Eigen::Vector2f(uv_coords[2].x, uv_coords[2].y));
+			unsigned int idx_face = firstFace + i;
+			pcl::Vertices & face = faces[idx_face];
+
+			if(vertexToPixels)
+			{
+				for(unsigned int j=0; j<pixelCameras[i].size(); ++j)
+				{
+					const FaceInfo & info = visibleFaces[pixelCameras[i][j]].find(idx_face)->second;
+					vertexToPixels->at(face.vertices[0]).insert(std::make_pair(pixelCameras[i][j], info.uv_coord1));
+					vertexToPixels->at(face.vertices[1]).insert(std::make_pair(pixelCameras[i][j], info.uv_coord2));
+					vertexToPixels->at(face.vertices[2]).insert(std::make_pair(pixelCameras[i][j], info.uv_coord3));
+				}
+			}
+
+			int cameraIndex = cameraIndices[i];
+			if(cameraIndex >= 0)
+			{
+				const FaceInfo & info = visibleFaces[cameraIndex].find(idx_face)->second;
+				++textured;
+				mesh.tex_polygons[cameraIndex].push_back(face);
+				mesh.tex_coordinates[cameraIndex].push_back(Eigen::Vector2f(info.uv_coord1.x, info.uv_coord1.y));
+				mesh.tex_coordinates[cameraIndex].push_back(Eigen::Vector2f(info.uv_coord2.x, info.uv_coord2.y));
+				mesh.tex_coordinates[cameraIndex].push_back(Eigen::Vector2f(info.uv_coord3.x, info.uv_coord3.y));
+			}
+			else
+			{
+				mesh.tex_polygons[cameras.size()].push_back(face);
+				mesh.tex_coordinates[cameras.size()].push_back(Eigen::Vector2f(-1.0,-1.0));
+				mesh.tex_coordinates[cameras.size()].push_back(Eigen::Vector2f(-1.0,-1.0));
+				mesh.tex_coordinates[cameras.size()].push_back(Eigen::Vector2f(-1.0,-1.0));
+			}
 		}
-		else
+
+		UDEBUG("face %d/%d", firstFace+block, (int)faces.size());
+		if(state && !state->callback(uFormat("Textured %d/%d of %d polygons", textured, firstFace+block, (int)faces.size())))
 		{
-			mesh.tex_polygons[cameras.size()].push_back(face);
-			mesh.tex_coordinates[cameras.size()].push_back(Eigen::Vector2f(-1.0,-1.0));
-			mesh.tex_coordinates[cameras.size()].push_back(Eigen::Vector2f(-1.0,-1.0));
-			mesh.tex_coordinates[cameras.size()].push_back(Eigen::Vector2f(-1.0,-1.0));
+			//cancelled!
+			UWARN("Texturing cancelled!");
+			return false;
 		}
 	}
-	UINFO("Process %d polygons...done! (%d textured)", (int)faces.size(), textured);
+	UINFO("Process %d polygons...done! (%d textured, %fs)", (int)faces.size(), textured, timer.ticks());
 
 	return true;
 }
@@ -458,6 +458,12 @@ namespace pcl
       inline bool
       checkPointInsideTriangle (const pcl::PointXY &p1, const pcl::PointXY &p2, const pcl::PointXY &p3, const pcl::PointXY &pt);
 
+      /** \brief Visible faces of a batch of cameras, one camera per thread (see textureMeshwithMultipleCameras2). */
+      class VisibilityBody;
+
+      /** \brief Best camera of a range of faces, computed in parallel (see textureMeshwithMultipleCameras2). */
+      class FaceCameraBody;
+
       /** \brief Class get name method. */
       std::string
       getClassName () const
@@ -42,6 +42,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <map>
 #include <Eigen/Core>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #if CV_MAJOR_VERSION >= 3
 #include <opencv2/photo/photo.hpp>
 #endif
@@ -889,6 +895,138 @@ cv::Mat depthFromStereoCorrespondences(
 	return depth;
 }
 
+// Depth conversions of one row, vectorized when SSE2 or NEON (aarch64) are
+// available. The vectorized paths do exactly the same float operations than
+// the scalar loops at the end, so the outputs are bit-identical.
+static int cvtDepthRowFromFloat(const float * depth32F, unsigned short * depth16U, int cols)
+{
+	int countOverMax = 0;
+	int j=0;
+#if defined(__SSE2__)
+	const __m128 scale = _mm_set1_ps(1000.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 maxDepth = _mm_set1_ps((float)USHRT_MAX);
+	// SSE2 has only a signed saturated pack, shift the values in the signed range
+	const __m128i offset32 = _mm_set1_epi32(32768);
+	const __m128i offset16 = _mm_set1_epi16(-32768);
+	for(; j+8<=cols; j+=8)
+	{
+		__m128 d0 = _mm_mul_ps(_mm_loadu_ps(depth32F+j), scale);
+		__m128 d1 = _mm_mul_ps(_mm_loadu_ps(depth32F+j+4), scale);
+		__m128 valid0 = _mm_and_ps(_mm_cmpgt_ps(d0, zero), _mm_cmple_ps(d0, maxDepth));
+		__m128 valid1 = _mm_and_ps(_mm_cmpgt_ps(d1, zero), _mm_cmple_ps(d1, maxDepth));
+		int over = _mm_movemask_ps(_mm_cmpgt_ps(d0, maxDepth)) | (_mm_movemask_ps(_mm_cmpgt_ps(d1, maxDepth))<<4);
+		for(; over; over &= over-1)
+		{
+			++countOverMax;
+		}
+		__m128i i0 = _mm_sub_epi32(_mm_and_si128(_mm_cvttps_epi32(d0), _mm_castps_si128(valid0)), offset32);
+		__m128i i1 = _mm_sub_epi32(_mm_and_si128(_mm_cvttps_epi32(d1), _mm_castps_si128(valid1)), offset32);
+		_mm_storeu_si128((__m128i*)(depth16U+j), _mm_add_epi16(_mm_packs_epi32(i0, i1), offset16));
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+	const float32x4_t maxDepth = vdupq_n_f32((float)USHRT_MAX);
+	uint32x4_t over = vdupq_n_u32(0);
+	for(; j+8<=cols; j+=8)
+	{
+		float32x4_t d0 = vmulq_n_f32(vld1q_f32(depth32F+j), 1000.0f);
+		float32x4_t d1 = vmulq_n_f32(vld1q_f32(depth32F+j+4), 1000.0f);
+		uint32x4_t valid0 = vandq_u32(vcgtq_f32(d0, zero), vcleq_f32(d0, maxDepth));
+		uint32x4_t valid1 = vandq_u32(vcgtq_f32(d1, zero), vcleq_f32(d1, maxDepth));
+		// true comparisons are all bits set (-1)
+		over = vsubq_u32(over, vcgtq_f32(d0, maxDepth));
+		over = vsubq_u32(over, vcgtq_f32(d1, maxDepth));
+		uint32x4_t i0 = vandq_u32(vcvtq_u32_f32(d0), valid0);
+		uint32x4_t i1 = vandq_u32(vcvtq_u32_f32(d1), valid1);
+		vst1q_u16(depth16U+j, vcombine_u16(vmovn_u32(i0), vmovn_u32(i1)));
+	}
+	countOverMax += (int)vaddvq_u32(over);
+#endif
+	for(; j<cols; ++j)
+	{
+		float depth = (depth32F[j]*1000.0f);
+		unsigned short depthMM = 0;
+		if(depth > 0 && depth <= (float)USHRT_MAX)
+		{
+			depthMM = (unsigned short)depth;
+		}
+		else if(depth > (float)USHRT_MAX)
+		{
+			++countOverMax;
+		}
+		depth16U[j] = depthMM;
+	}
+	return countOverMax;
+}
+
+static void cvtDepthRowToFloat(const unsigned short * depth16U, float * depth32F, int cols)
+{
+	int j=0;
+#if defined(__SSE2__)
+	const __m128 scale = _mm_set1_ps(1000.0f);
+	const __m128i zero = _mm_setzero_si128();
+	for(; j+8<=cols; j+=8)
+	{
+		__m128i d = _mm_loadu_si128((const __m128i*)(depth16U+j));
+		_mm_storeu_ps(depth32F+j, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(d, zero)), scale));
+		_mm_storeu_ps(depth32F+j+4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(d, zero)), scale));
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const float32x4_t scale = vdupq_n_f32(1000.0f);
+	for(; j+8<=cols; j+=8)
+	{
+		uint16x8_t d = vld1q_u16(depth16U+j);
+		vst1q_f32(depth32F+j, vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(d))), scale));
+		vst1q_f32(depth32F+j+4, vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(d))), scale));
+	}
+#endif
+	for(; j<cols; ++j)
+	{
+		depth32F[j] = float(depth16U[j])/1000.0f;
+	}
+}
+
+class CvtDepthFromFloatBody : public cv::ParallelLoopBody
+{
+public:
+	CvtDepthFromFloatBody(const cv::Mat & depth32F, cv::Mat & depth16U, std::vector<int> & countOverMax) :
+		depth32F_(depth32F),
+		depth16U_(&depth16U),
+		countOverMax_(&countOverMax)
+	{}
+	virtual void operator()(const cv::Range & range) const
+	{
+		for(int i=range.start; i<range.end; ++i)
+		{
+			countOverMax_->at(i) = cvtDepthRowFromFloat(depth32F_.ptr<float>(i), depth16U_->ptr<unsigned short>(i), depth32F_.cols);
+		}
+	}
+private:
+	cv::Mat depth32F_;
+	cv::Mat * depth16U_;
+	std::vector<int> * countOverMax_; // per row
+};
+
+class CvtDepthToFloatBody : public cv::ParallelLoopBody
+{
+public:
+	CvtDepthToFloatBody(const cv::Mat & depth16U, cv::Mat & depth32F) :
+		depth16U_(depth16U),
+		depth32F_(&depth32F)
+	{}
+	virtual void operator()(const cv::Range & range) const
+	{
+		for(int i=range.start; i<range.end; ++i)
+		{
+			cvtDepthRowToFloat(depth16U_.ptr<unsigned short>(i), depth32F_->ptr<float>(i), depth16U_.cols);
+		}
+	}
+private:
+	cv::Mat depth16U_;
+	cv::Mat * depth32F_;
+};
+
 cv::Mat cvtDepthFromFloat(const cv::Mat & depth32F)
 {
 	UASSERT(depth32F.empty() || depth32F.type() == CV_32FC1);
@@ -896,23 +1034,12 @@ cv::Mat cvtDepthFromFloat(const cv::Mat & depth32F)
 	if(!depth32F.empty())
 	{
 		depth16U = cv::Mat(depth32F.rows, depth32F.cols, CV_16UC1);
+		std::vector<int> countOverMaxPerRow(depth32F.rows, 0);
+		cv::parallel_for_(cv::Range(0, depth32F.rows), CvtDepthFromFloatBody(depth32F, depth16U, countOverMaxPerRow));
 		int countOverMax = 0;
-		for(int i=0; i<depth32F.rows; ++i)
+		for(unsigned int i=0; i<countOverMaxPerRow.size(); ++i)
 		{
-			for(int j=0; j<depth32F.cols; ++j)
-			{
-				float depth = (depth32F.at<float>(i,j)*1000.0f);
-				unsigned short depthMM = 0;
-				if(depth > 0 && depth <= (float)USHRT_MAX)
-				{
-					depthMM = (unsigned short)depth;
-				}
-				else if(depth > (float)USHRT_MAX)
-				{
-					++countOverMax;
-				}
-				depth16U.at<unsigned short>(i, j) = depthMM;
-			}
+			countOverMax += countOverMaxPerRow[i];
 		}
 		if(countOverMax)
 		{
@@ -932,14 +1059,7 @@ cv::Mat cvtDepthToFloat(const cv::Mat & depth16U)
 	if(!depth16U.empty())
 	{
 		depth32F = cv::Mat(depth16U.rows, depth16U.cols, CV_32FC1);
-		for(int i=0; i<depth16U.rows; ++i)
-		{
-			for(int j=0; j<depth16U.cols; ++j)
-			{
-				float depth = float(depth16U.at<unsigned short>(i,j))/1000.0f;
-				depth32F.at<float>(i, j) = depth;
-			}
-		}
+		cv::parallel_for_(cv::Range(0, depth16U.rows), CvtDepthToFloatBody(depth16U, depth32F));
 	}
 	return depth32F;
 }
@@ -1198,6 +1318,33 @@ cv::Rect computeRoi(const cv::Size & imageSize, const std::vector<float> & roiRa
 	}
 }
 
+template<typename T>
+class DecimateDepthBody : public cv::ParallelLoopBody
+{
+public:
+	DecimateDepthBody(const cv::Mat & image, cv::Mat & out, int decimation) :
+		image_(image),
+		out_(&out),
+		decimation_(decimation)
+	{}
+	virtual void operator()(const cv::Range & range) const
+	{
+		for(int j=range.start; j<range.end; ++j)
+		{
+			const T * in = image_.ptr<T>(j*decimation_);
+			T * out = out_->ptr<T>(j);
+			for(int i=0; i<out_->cols; ++i)
+			{
+				out[i] = in[i*decimation_];
+			}
+		}
+	}
+private:
+	cv::Mat image_;
+	cv::Mat * out_;
+	int decimation_;
+};
+
 cv::Mat decimate(const cv::Mat & image, int decimation)
 {
 	UASSERT(decimation >= 1);
@@ -1215,23 +1362,11 @@ cv::Mat decimate(const cv::Mat & image, int decimation)
 				out = cv::Mat(image.rows/decimation, image.cols/decimation, image.type());
 				if(image.type() == CV_32FC1)
 				{
-					for(int j=0; j<out.rows; ++j)
-					{
-						for(int i=0; i<out.cols; ++i)
-						{
-							out.at<float>(j, i) = image.at<float>(j*decimation, i*decimation);
-						}
-					}
+					cv::parallel_for_(cv::Range(0, out.rows), DecimateDepthBody<float>(image, out, decimation));
 				}
 				else // CV_16UC1
 				{
-					for(int j=0; j<out.rows; ++j)
-					{
-						for(int i=0; i<out.cols; ++i)
-						{
-							out.at<unsigned short>(j, i) = image.at<unsigned short>(j*decimation, i*decimation);
-						}
-					}
+					cv::parallel_for_(cv::Range(0, out.rows), DecimateDepthBody<unsigned short>(image, out, decimation));
 				}
 			}
 			else
@@ -1247,6 +1382,101 @@ cv::Mat decimate(const cv::Mat & image, int decimation)
 	return out;
 }
 
+// Bilinear interpolation of the depth between 4 pixels of the input image, done
+// by blocks of factor x factor pixels. Blocks of the same row of blocks share
+// a column and blocks of two consecutive rows of blocks share a row of
+// pixels. Each range of rows of blocks writes only its own rows of
+// pixels (the top row is owned by the previous row of blocks), so that
+// overlapping pixels get the same value they would get if the blocks were
+// interpolated sequentially.
+template<typename T>
+class InterpolateDepthBody : public cv::ParallelLoopBody
+{
+public:
+	InterpolateDepthBody(const cv::Mat & image, cv::Mat & out, int factor, float depthErrorRatio) :
+		image_(image),
+		out_(&out),
+		factor_(factor),
+		depthErrorRatio_(depthErrorRatio)
+	{}
+	virtual void operator()(const cv::Range & range) const
+	{
+		for(int k=range.start; k<range.end; ++k)
+		{
+			int j = (k+1)*factor_;
+			T * topRow = j==factor_?out_->ptr<T>(0):0;
+			T * bottomRow = out_->ptr<T>(j);
+			float slopeTop, slopeBottom, dTopLeft, dBottomLeft;
+			for(int i=factor_; i<out_->cols; i+=factor_)
+			{
+				if(slopes(j, i, dTopLeft, slopeTop, dBottomLeft, slopeBottom))
+				{
+					for(int z=i-factor_; z<=i; ++z)
+					{
+						T top = T(dTopLeft+(slopeTop*float(z-(i-factor_))));
+						T bottom = T(dBottomLeft+(slopeBottom*float(z-(i-factor_))));
+						if(topRow)
+						{
+							topRow[z] = top;
+						}
+						bottomRow[z] = bottom;
+
+						// fill the column
+						float slope = (float(bottom)-float(top))/float(factor_);
+						for(int d=j-factor_+1; d<j; ++d)
+						{
+							out_->at<T>(d, z) = T(float(top)+(slope*float(d-(j-factor_))));
+						}
+					}
+				}
+			}
+
+			// the next row of blocks overwrites our bottom row
+			if(j+factor_ < out_->rows)
+			{
+				for(int i=factor_; i<out_->cols; i+=factor_)
+				{
+					if(slopes(j+factor_, i, dTopLeft, slopeTop, dBottomLeft, slopeBottom))
+					{
+						for(int z=i-factor_; z<=i; ++z)
+						{
+							bottomRow[z] = T(dTopLeft+(slopeTop*float(z-(i-factor_))));
+						}
+					}
+				}
+			}
+		}
+	}
+private:
+	// false if the block ending at (j,i) should not be interpolated
+	bool slopes(int j, int i, float & dTopLeft, float & slopeTop, float & dBottomLeft, float & slopeBottom) const
+	{
+		dTopLeft = image_.at<T>(j/factor_-1, i/factor_-1);
+		float dTopRight = image_.at<T>(j/factor_-1, i/factor_);
+		dBottomLeft = image_.at<T>(j/factor_, i/factor_-1);
+		float dBottomRight = image_.at<T>(j/factor_, i/factor_);
+
+		if(dTopLeft>0 && dTopRight>0 && dBottomLeft>0 && dBottomRight > 0)
+		{
+			float depthError = depthErrorRatio_*(dTopLeft+dTopRight+dBottomLeft+dBottomRight)/4.0f;
+			if(fabs(dTopLeft-dTopRight) <= depthError &&
+			   fabs(dTopLeft-dBottomLeft) <= depthError &&
+			   fabs(dTopLeft-dBottomRight) <= depthError)
+			{
+				slopeTop = (dTopRight-dTopLeft)/float(factor_);
+				slopeBottom = (dBottomRight-dBottomLeft)/float(factor_);
+				return true;
+			}
+		}
+		return false;
+	}
+private:
+	cv::Mat image_;
+	cv::Mat * out_;
+	int factor_;
+	float depthErrorRatio_;
+};
+
 cv::Mat interpolate(const cv::Mat & image, int factor, float depthErrorRatio)
 {
 	UASSERT_MSG(factor >= 1, uFormat("factor=%d", factor).c_str());
@@ -1259,90 +1489,13 @@ cv::Mat interpolate(const cv::Mat & image, int factor, float depthErrorRatio)
 			{
 				UASSERT(depthErrorRatio>0.0f);
 				out = cv::Mat::zeros(image.rows*factor, image.cols*factor, image.type());
-				for(int j=0; j<out.rows; j+=factor)
+				if(image.type() == CV_32FC1)
 				{
-					for(int i=0; i<out.cols; i+=factor)
-					{
-						if(i>0 && j>0)
-						{
-							float dTopLeft;
-							float dTopRight;
-							float dBottomLeft;
-							float dBottomRight;
-							if(image.type() == CV_32FC1)
-							{
-								dTopLeft = image.at<float>(j/factor-1, i/factor-1);
-								dTopRight = image.at<float>(j/factor-1, i/factor);
-								dBottomLeft = image.at<float>(j/factor, i/factor-1);
-								dBottomRight = image.at<float>(j/factor, i/factor);
-							}
-							else
-							{
-								dTopLeft = image.at<unsigned short>(j/factor-1, i/factor-1);
-								dTopRight = image.at<unsigned short>(j/factor-1, i/factor);
-								dBottomLeft = image.at<unsigned short>(j/factor, i/factor-1);
-								dBottomRight = image.at<unsigned short>(j/factor, i/factor);
-							}
-
-							if(dTopLeft>0 && dTopRight>0 && dBottomLeft>0 && dBottomRight > 0)
-							{
-								float depthError = depthErrorRatio*(dTopLeft+dTopRight+dBottomLeft+dBottomRight)/4.0f;
-								if(fabs(dTopLeft-dTopRight) <= depthError &&
-								   fabs(dTopLeft-dBottomLeft) <= depthError &&
-								   fabs(dTopLeft-dBottomRight) <= depthError)
-								{
-									// bilinear interpolation
-									// do first and last rows then columns
-									float slopeTop = (dTopRight-dTopLeft)/float(factor);
-									float slopeBottom = (dBottomRight-dBottomLeft)/float(factor);
-									if(image.type() == CV_32FC1)
-									{
-										for(int z=i-factor; z<=i; ++z)
-										{
-											out.at<float>(j-factor, z) = dTopLeft+(slopeTop*float(z-(i-factor)));
-											out.at<float>(j, z) = dBottomLeft+(slopeBottom*float(z-(i-factor)));
-										}
-									}
-									else
-									{
-										for(int z=i-factor; z<=i; ++z)
-										{
-											out.at<unsigned short>(j-factor, z) = (unsigned short)(dTopLeft+(slopeTop*float(z-(i-factor))));
-											out.at<unsigned short>(j, z) = (unsigned short)(dBottomLeft+(slopeBottom*float(z-(i-factor))));
-										}
-									}
-
-									// fill the columns
-									if(image.type() == CV_32FC1)
-									{
-										for(int z=i-factor; z<=i; ++z)
-										{
-											float top = out.at<float>(j-factor, z);
-											float bottom = out.at<float>(j, z);
-											float slope = (bottom-top)/float(factor);
-											for(int d=j-factor+1; d<j; ++d)
-											{
-												out.at<float>(d, z) = top+(slope*float(d-(j-factor)));
-											}
-										}
-									}
-									else
-									{
-										for(int z=i-factor; z<=i; ++z)
-										{
-											float top = out.at<unsigned short>(j-factor, z);
-											float bottom = out.at<unsigned short>(j, z);
-											float slope = (bottom-top)/float(factor);
-											for(int d=j-factor+1; d<j; ++d)
-											{
-												out.at<unsigned short>(d, z) = (unsigned short)(top+(slope*float(d-(j-factor))));
-											}
-										}
-									}
-								}
-							}
-						}
-					}
+					cv::parallel_for_(cv::Range(0, image.rows-1), InterpolateDepthBody<float>(image, out, factor, depthErrorRatio));
+				}
+				else
+				{
+					cv::parallel_for_(cv::Range(0, image.rows-1), InterpolateDepthBody<unsigned short>(image, out, factor, depthErrorRatio));
 				}
 			}
 			else
@@ -1358,6 +1511,68 @@ cv::Mat interpolate(const cv::Mat & image, int factor, float depthErrorRatio)
 	return out;
 }
 
+// Project the depth pixels in the color camera, the results are written
+// in the registration order so the z-buffering can be done sequentially after.
+class RegisterDepthBody : public cv::ParallelLoopBody
+{
+public:
+	RegisterDepthBody(
+			const cv::Mat & depth,
+			float fx, float fy, float cx, float cy,
+			float rfx, float rfy, float rcx, float rcy,
+			const Eigen::Affine3f & proj,
+			cv::Mat & projected,
+			cv::Mat & projectedZ) :
+		depth_(depth),
+		fx_(fx), fy_(fy), cx_(cx), cy_(cy),
+		rfx_(rfx), rfy_(rfy), rcx_(rcx), rcy_(rcy),
+		proj_(proj),
+		projected_(&projected),
+		projectedZ_(&projectedZ)
+	{}
+	virtual void operator()(const cv::Range & range) const
+	{
+		bool depthInMM = depth_.type() == CV_16UC1;
+		Eigen::Vector4f P4,P3;
+		P4[3] = 1;
+		for(int y=range.start; y<range.end; ++y)
+		{
+			cv::Vec2i * projected = projected_->ptr<cv::Vec2i>(y);
+			float * projectedZ = projectedZ_->ptr<float>(y);
+			for(int x=0; x<depth_.cols; ++x)
+			{
+				//filtering
+				float dz = depthInMM?float(depth_.at<unsigned short>(y,x))*0.001f:depth_.at<float>(y,x); // put in meter for projection
+				if(dz>=0.0f)
+				{
+					// Project to 3D
+					P4[0] = (x - cx_) * dz / fx_; // Optimization: we could have (x-cx)/fx in a lookup table
+					P4[1] = (y - cy_) * dz / fy_; // Optimization: we could have (y-cy)/fy in a lookup table
+					P4[2] = dz;
+
+					P3 = proj_ * P4;
+					float z = P3[2];
+					float invZ = 1.0f/z;
+					projected[x][0] = (rfx_*P3[0])*invZ + rcx_;
+					projected[x][1] = (rfy_*P3[1])*invZ + rcy_;
+					projectedZ[x] = z;
+				}
+				else
+				{
+					projected[x][0] = projected[x][1] = -1;
+				}
+			}
+		}
+	}
+private:
+	cv::Mat depth_;
+	float fx_, fy_, cx_, cy_;
+	float rfx_, rfy_, rcx_, rcy_;
+	Eigen::Affine3f proj_;
+	cv::Mat * projected_;
+	cv::Mat * projectedZ_;
+};
+
 // Registration Depth to RGB (return registered depth image)
 cv::Mat registerDepth(
 		const cv::Mat & depth,
@@ -1386,48 +1601,41 @@ cv::Mat registerDepth(
 	//UDEBUG("color(%dx%d) fx=%f fy=%f cx=%f cy=%f", colorSize.width, colorSize.height, rfx, rfy, rcx, rcy);
 
 	Eigen::Affine3f proj = transform.toEigen3f();
-	Eigen::Vector4f P4,P3;
-	P4[3] = 1;
 	cv::Mat registered = cv::Mat::zeros(colorSize, depth.type());
 
+	// projection in parallel
+	cv::Mat projected(depth.size(), CV_32SC2);
+	cv::Mat projectedZ(depth.size(), CV_32FC1);
+	cv::parallel_for_(cv::Range(0, depth.rows), RegisterDepthBody(depth, fx, fy, cx, cy, rfx, rfy, rcx, rcy, proj, projected, projectedZ));
+
+	// z-buffering, the closest depth is kept
 	bool depthInMM = depth.type() == CV_16UC1;
 	for(int y=0; y<depth.rows; ++y)
 	{
+		const cv::Vec2i * projectedRow = projected.ptr<cv::Vec2i>(y);
+		const float * projectedZRow = projectedZ.ptr<float>(y);
 		for(int x=0; x<depth.cols; ++x)
 		{
-			//filtering
-			float dz = depthInMM?float(depth.at<unsigned short>(y,x))*0.001f:depth.at<float>(y,x); // put in meter for projection
-			if(dz>=0.0f)
+			int dx = projectedRow[x][0];
+			int dy = projectedRow[x][1];
+			if(uIsInBounds(dx, 0, registered.cols) && uIsInBounds(dy, 0, registered.rows))
 			{
-				// Project to 3D
-				P4[0] = (x - cx) * dz / fx; // Optimization: we could have (x-cx)/fx in a lookup table
-				P4[1] = (y - cy) * dz / fy; // Optimization: we could have (y-cy)/fy in a lookup table
-				P4[2] = dz;
-
-				P3 = proj * P4;
-				float z = P3[2];
-				float invZ = 1.0f/z;
-				int dx = (rfx*P3[0])*invZ + rcx;
-				int dy = (rfy*P3[1])*invZ + rcy;
-
-				if(uIsInBounds(dx, 0, registered.cols) && uIsInBounds(dy, 0, registered.rows))
+				float z = projectedZRow[x];
+				if(depthInMM)
 				{
-					if(depthInMM)
+					unsigned short z16 = z * 1000; //mm
+					unsigned short &zReg = registered.at<unsigned short>(dy, dx);
+					if(zReg == 0 || z16 < zReg)
 					{
-						unsigned short z16 = z * 1000; //mm
-						unsigned short &zReg = registered.at<unsigned short>(dy, dx);
-						if(zReg == 0 || z16 < zReg)
-						{
-							zReg = z16;
-						}
+						zReg = z16;
 					}
-					else
+				}
+				else
+				{
+					float &zReg = registered.at<float>(dy, dx);
+					if(zReg == 0 || z < zReg)
 					{
-						float &zReg = registered.at<float>(dy, dx);
-						if(zReg == 0 || z < zReg)
-						{
-							zReg = z;
-						}
+						zReg = z;
 					}
 				}
 			}
@@ -1436,29 +1644,20 @@ cv::Mat registerDepth(
 	return registered;
 }
 
-cv::Mat fillDepthHoles(const cv::Mat & depth, int maximumHoleSize, float errorRatio)
+// The holes are filled in place in the output image, in the scanning order (a
+// value can be averaged with a value set previously), so it is done sequentially.
+template<typename T>
+void fillDepthHolesImpl(const cv::Mat & depth, cv::Mat & output, int maximumHoleSize, float errorRatio)
 {
-	UASSERT(depth.type() == CV_16UC1 || depth.type() == CV_32FC1);
-	UASSERT(maximumHoleSize > 0);
-	cv::Mat output = depth.clone();
-	bool isMM = depth.type() == CV_16UC1;
 	for(int y=0; y<depth.rows-2; ++y)
 	{
+		const T * row = depth.ptr<T>(y);
+		const T * rowDown = depth.ptr<T>(y+1);
 		for(int x=0; x<depth.cols-2; ++x)
 		{
-			float a, bRight, bDown;
-			if(isMM)
-			{
-				a = depth.at<unsigned short>(y, x);
-				bRight = depth.at<unsigned short>(y, x+1);
-				bDown = depth.at<unsigned short>(y+1, x);
-			}
-			else
-			{
-				a = depth.at<float>(y, x);
-				bRight = depth.at<float>(y, x+1);
-				bDown = depth.at<float>(y+1, x);
-			}
+			float a = row[x];
+			float bRight = row[x+1];
+			float bDown = rowDown[x];
 
 			if(a > 0.0f && (bRight == 0.0f || bDown == 0.0f))
 			{
@@ -1476,7 +1675,7 @@ cv::Mat fillDepthHoles(const cv::Mat & depth, int maximumHoleSize, float errorRa
 						}
 						else
 						{
-							float c = isMM?depth.at<unsigned short>(y, x+1+h):depth.at<float>(y, x+1+h);
+							float c = row[x+1+h];
 							if(c == 0)
 							{
 								// ignore this size
@@ -1489,36 +1688,18 @@ cv::Mat fillDepthHoles(const cv::Mat & depth, int maximumHoleSize, float errorRa
 								{
 									//linear interpolation
 									float slope = (c-a)/float(h+1);
-									if(isMM)
+									T * outputRow = output.ptr<T>(y);
+									for(int z=x+1; z<x+1+h; ++z)
 									{
-										for(int z=x+1; z<x+1+h; ++z)
+										T & value = outputRow[z];
+										if(value == 0)
 										{
-											unsigned short & value = output.at<unsigned short>(y, z);
-											if(value == 0)
-											{
-												value = (unsigned short)(a+(slope*float(z-x)));
-											}
-											else
-											{
-												// average with the previously set value
-												value = (value+(unsigned short)(a+(slope*float(z-x))))/2;
-											}
+											value = T(a+(slope*float(z-x)));
 										}
-									}
-									else
-									{
-										for(int z=x+1; z<x+1+h; ++z)
+										else
 										{
-											float & value = output.at<float>(y, z);
-											if(value == 0)
-											{
-												value = a+(slope*float(z-x));
-											}
-											else
-											{
-												// average with the previously set value
-												value = (value+(a+(slope*float(z-x))))/2;
-											}
+											// average with the previously set value
+											value = (value+T(a+(slope*float(z-x))))/2;
 										}
 									}
 								}
@@ -1537,7 +1718,7 @@ cv::Mat fillDepthHoles(const cv::Mat & depth, int maximumHoleSize, float errorRa
 						}
 						else
 						{
-							float c = isMM?depth.at<unsigned short>(y+1+h, x):depth.at<float>(y+1+h, x);
+							float c = depth.at<T>(y+1+h, x);
 							if(c == 0)
 							{
 								// ignore this size
@@ -1550,36 +1731,17 @@ cv::Mat fillDepthHoles(const cv::Mat & depth, int maximumHoleSize, float errorRa
 								{
 									//linear interpolation
 									float slope = (c-a)/float(h+1);
-									if(isMM)
+									for(int z=y+1; z<y+1+h; ++z)
 									{
-										for(int z=y+1; z<y+1+h; ++z)
+										T & value = output.at<T>(z, x);
+										if(value == 0)
 										{
-											unsigned short & value = output.at<unsigned short>(z, x);
-											if(value == 0)
-											{
-												value = (unsigned short)(a+(slope*float(z-y)));
-											}
-											else
-											{
-												// average with the previously set value
-												value = (value+(unsigned short)(a+(slope*float(z-y))))/2;
-											}
+											value = T(a+(slope*float(z-y)));
 										}
-									}
-									else
-									{
-										for(int z=y+1; z<y+1+h; ++z)
+										else
 										{
-											float & value = output.at<float>(z, x);
-											if(value == 0)
-											{
-												value = (a+(slope*float(z-y)));
-											}
-											else
-											{
-												// average with the previously set value
-												value = (value+(a+(slope*float(z-y))))/2;
-											}
+											// average with the previously set value
+											value = (value+T(a+(slope*float(z-y))))/2;
 										}
 									}
 								}
@@ -1592,14 +1754,30 @@ cv::Mat fillDepthHoles(const cv::Mat & depth, int maximumHoleSize, float errorRa
 			}
 		}
 	}
+}
+
+cv::Mat fillDepthHoles(const cv::Mat & depth, int maximumHoleSize, float errorRatio)
+{
+	UASSERT(depth.type() == CV_16UC1 || depth.type() == CV_32FC1);
+	UASSERT(maximumHoleSize > 0);
+	cv::Mat output = depth.clone();
+	if(depth.type() == CV_16UC1)
+	{
+		fillDepthHolesImpl<unsigned short>(depth, output, maximumHoleSize, errorRatio);
+	}
+	else
+	{
+		fillDepthHolesImpl<float>(depth, output, maximumHoleSize, errorRatio);
+	}
 	return output;
 }
 
-void fillRegisteredDepthHoles(cv::Mat & registeredDepth, bool vertical, bool horizontal, bool fillDoubleHoles)
+// Fill the holes of the columns [start,end[. Pixels of the next columns are
+// modified only when horizontal holes are filled.
+static void fillRegisteredDepthHolesColumns(cv::Mat & registeredDepth, int start, int end, bool vertical, bool horizontal, bool fillDoubleHoles)
 {
-	UASSERT(registeredDepth.type() == CV_16UC1);
 	int margin = fillDoubleHoles?2:1;
-	for(int x=1; x<registeredDepth.cols-margin; ++x)
+	for(int x=start; x<end; ++x)
 	{
 		for(int y=1; y<registeredDepth.rows-margin; ++y)
 		{
@@ -1698,6 +1876,38 @@ void fillRegisteredDepthHoles(cv::Mat & registeredDepth, bool vertical, bool hor
 	}
 }
 
+class FillRegisteredDepthHolesBody : public cv::ParallelLoopBody
+{
+public:
+	FillRegisteredDepthHolesBody(cv::Mat & registeredDepth, bool fillDoubleHoles) :
+		registeredDepth_(&registeredDepth),
+		fillDoubleHoles_(fillDoubleHoles)
+	{}
+	virtual void operator()(const cv::Range & range) const
+	{
+		fillRegisteredDepthHolesColumns(*registeredDepth_, range.start, range.end, true, false, fillDoubleHoles_);
+	}
+private:
+	cv::Mat * registeredDepth_;
+	bool fillDoubleHoles_;
+};
+
+void fillRegisteredDepthHoles(cv::Mat & registeredDepth, bool vertical, bool horizontal, bool fillDoubleHoles)
+{
+	UASSERT(registeredDepth.type() == CV_16UC1);
+	int margin = fillDoubleHoles?2:1;
+	if(vertical && !horizontal)
+	{
+		// columns are independent
+		cv::parallel_for_(cv::Range(1, std::max(1, registeredDepth.cols-margin)), FillRegisteredDepthHolesBody(registeredDepth, fillDoubleHoles));
+	}
+	else if(vertical || horizontal)
+	{
+		// a column depends on the holes filled in the previous column
+		fillRegisteredDepthHolesColumns(registeredDepth, 1, registeredDepth.cols-margin, vertical, horizontal, fillDoubleHoles);
+	}
+}
+
 // used only for fastBilateralFiltering() below
 class Array3D
   {
@@ -41,6 +41,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/imgproc/types_c.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace rtabmap
 {
 
@@ -261,6 +265,365 @@ Eigen::Vector3f projectDepthTo3DRay(
 	return ray;
 }
 
+// Back-projection of a depth image by rows (every decimation pixels), used
+// by cloudFromDepth(), cloudFromDepthRGB() and laserScanFromDepth(). The
+// float operations are the same than projectDepthTo3D() without smoothing, so
+// the points are the same. The rows are projected in SoA buffers (vectorized
+// with SSE2 when available) before being copied in the output.
+class DepthRowProjector
+{
+public:
+	DepthRowProjector(
+			const cv::Mat & depth,
+			int decimation,
+			float cx, float cy,
+			float fx, float fy,
+			float minDepth, float maxDepth) :
+		depth_(depth),
+		decimation_(decimation),
+		fx_(fx),
+		fy_(fy),
+		minDepth_(minDepth),
+		maxDepth_(maxDepth<=0.0f?std::numeric_limits<float>::max():maxDepth),
+		raysX_(depth.cols/decimation)
+	{
+		UASSERT(depth_.type() == CV_16UC1 || depth_.type() == CV_32FC1);
+		// Use correct principal point from calibration
+		cx_ = cx > 0.0f ? cx : float(depth.cols/2) - 0.5f; //cameraInfo.K.at(2)
+		cy_ = cy > 0.0f ? cy : float(depth.rows/2) - 0.5f; //cameraInfo.K.at(5)
+		for(unsigned int i=0; i<raysX_.size(); ++i)
+		{
+			raysX_[i] = float(i*decimation_) - cx_;
+		}
+	}
+
+	int width() const {return (int)raysX_.size();}
+	int height() const {return depth_.rows/decimation_;}
+
+	/**
+	 * Project the row r of the decimated image, invalid points are NaN.
+	 * All buffers have width() values, "depths" is a working buffer.
+	 */
+	void project(int r, float * depths, float * xs, float * ys, float * zs) const
+	{
+		int n = width();
+		int h = r*decimation_;
+		if(depth_.type() == CV_16UC1)
+		{
+			const unsigned short * row = depth_.ptr<unsigned short>(h);
+			for(int i=0; i<n; ++i)
+			{
+				unsigned short d = row[i*decimation_];
+				depths[i] = d > 0 && d < std::numeric_limits<unsigned short>::max()?float(d)*0.001f:0.0f;
+			}
+		}
+		else
+		{
+			const float * row = depth_.ptr<float>(h);
+			for(int i=0; i<n; ++i)
+			{
+				float d = row[i*decimation_];
+				depths[i] = d > 0.0f && uIsFinite(d)?d:0.0f;
+			}
+		}
+
+		float rayY = float(h) - cy_;
+		const float bad_point = std::numeric_limits<float>::quiet_NaN();
+		int i=0;
+#ifdef __SSE2__
+		const __m128 nan = _mm_set1_ps(bad_point);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 maxFinite = _mm_set1_ps(std::numeric_limits<float>::max());
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		const __m128 fx = _mm_set1_ps(fx_);
+		const __m128 fy = _mm_set1_ps(fy_);
+		const __m128 ry = _mm_set1_ps(rayY);
+		const __m128 minDepth = _mm_set1_ps(minDepth_);
+		const __m128 maxDepth = _mm_set1_ps(maxDepth_);
+		for(; i+4<=n; i+=4)
+		{
+			__m128 d = _mm_loadu_ps(depths+i);
+			__m128 x = _mm_div_ps(_mm_mul_ps(_mm_loadu_ps(&raysX_[i]), d), fx);
+			__m128 y = _mm_div_ps(_mm_mul_ps(ry, d), fy);
+			__m128 valid = _mm_and_ps(_mm_cmpgt_ps(d, zero), _mm_cmple_ps(_mm_and_ps(x, absMask), maxFinite));
+			valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_and_ps(y, absMask), maxFinite));
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(d, minDepth), _mm_cmple_ps(d, maxDepth)));
+			_mm_storeu_ps(xs+i, _mm_or_ps(_mm_and_ps(valid, x), _mm_andnot_ps(valid, nan)));
+			_mm_storeu_ps(ys+i, _mm_or_ps(_mm_and_ps(valid, y), _mm_andnot_ps(valid, nan)));
+			_mm_storeu_ps(zs+i, _mm_or_ps(_mm_and_ps(valid, d), _mm_andnot_ps(valid, nan)));
+		}
+#endif
+		for(; i<n; ++i)
+		{
+			float d = depths[i];
+			float x = raysX_[i] * d / fx_;
+			float y = rayY * d / fy_;
+			if(d > 0.0f && uIsFinite(x) && uIsFinite(y) && d >= minDepth_ && d <= maxDepth_)
+			{
+				xs[i] = x;
+				ys[i] = y;
+				zs[i] = d;
+			}
+			else
+			{
+				xs[i] = ys[i] = zs[i] = bad_point;
+			}
+		}
+	}
+
+private:
+	cv::Mat depth_;
+	int decimation_;
+	float cx_;
+	float cy_;
+	float fx_;
+	float fy_;
+	float minDepth_;
+	float maxDepth_;
+	std::vector<float> raysX_;
+};
+
+inline void setPointColor(pcl::PointXYZ &, const cv::Mat &, int, int) {}
+inline void setPointColor(pcl::PointXYZRGB & pt, const cv::Mat & rgb, int x, int y)
+{
+	if(rgb.channels() == 3)
+	{
+		const unsigned char * bgr = rgb.ptr<unsigned char>(y,x);
+		pt.b = bgr[0];
+		pt.g = bgr[1];
+		pt.r = bgr[2];
+	}
+	else
+	{
+		unsigned char v = rgb.at<unsigned char>(y,x);
+		pt.b = v;
+		pt.g = v;
+		pt.r = v;
+	}
+}
+
+template<typename PointT>
+class CloudFromDepthBody : public cv::ParallelLoopBody
+{
+public:
+	CloudFromDepthBody(
+			const DepthRowProjector & projector,
+			const cv::Mat & rgb,
+			float rgbToDepthFactorX,
+			float rgbToDepthFactorY,
+			int decimation,
+			pcl::PointCloud<PointT> & cloud,
+			std::vector<unsigned char> & valid) :
+		projector_(projector),
+		rgb_(rgb),
+		rgbToDepthFactorX_(rgbToDepthFactorX),
+		rgbToDepthFactorY_(rgbToDepthFactorY),
+		decimation_(decimation),
+		cloud_(&cloud),
+		valid_(&valid)
+	{}
+	virtual void operator()(const cv::Range & range) const
+	{
+		int n = projector_.width();
+		std::vector<float> buffers(n*4);
+		float * depths = &buffers[0];
+		float * xs = depths+n;
+		float * ys = xs+n;
+		float * zs = ys+n;
+		for(int r=range.start; r<range.end; ++r)
+		{
+			projector_.project(r, depths, xs, ys, zs);
+			PointT * pts = &cloud_->points[r*n];
+			int y = int((r*decimation_)*rgbToDepthFactorY_);
+			for(int i=0; i<n; ++i)
+			{
+				PointT & pt = pts[i];
+				pt.x = xs[i];
+				pt.y = ys[i];
+				pt.z = zs[i];
+				valid_->at(r*n+i) = uIsFinite(zs[i])?1:0;
+				if(!rgb_.empty())
+				{
+					int x = int((i*decimation_)*rgbToDepthFactorX_);
+					UASSERT(x >=0 && x<rgb_.cols && y >=0 && y<rgb_.rows);
+					setPointColor(pt, rgb_, x, y);
+				}
+			}
+		}
+	}
+private:
+	const DepthRowProjector & projector_;
+	cv::Mat rgb_;
+	float rgbToDepthFactorX_;
+	float rgbToDepthFactorY_;
+	int decimation_;
+	pcl::PointCloud<PointT> * cloud_;
+	std::vector<unsigned char> * valid_;
+};
+
+// Organized clouds from disparity, the points are validated the same way than
+// before the rows were projected in parallel.
+template<typename PointT>
+class CloudFromDisparityBody : public cv::ParallelLoopBody
+{
+public:
+	CloudFromDisparityBody(
+			const cv::Mat & disparity,
+			const cv::Mat & rgb,
+			const StereoCameraModel & model,
+			int decimation,
+			float maxDepth,
+			float minDepth,
+			bool minDepthIncluded,
+			bool finiteOnly,
+			pcl::PointCloud<PointT> & cloud,
+			std::vector<unsigned char> & valid) :
+		disparity_(disparity),
+		rgb_(rgb),
+		model_(model),
+		decimation_(decimation),
+		maxDepth_(maxDepth),
+		minDepth_(minDepth),
+		minDepthIncluded_(minDepthIncluded),
+		finiteOnly_(finiteOnly),
+		cloud_(&cloud),
+		valid_(&valid)
+	{}
+	virtual void operator()(const cv::Range & range) const
+	{
+		for(int r=range.start; r<range.end; ++r)
+		{
+			int h = r*decimation_;
+			for(unsigned int i=0; i<cloud_->width; ++i)
+			{
+				int w = i*decimation_;
+				PointT & pt = cloud_->at(r*cloud_->width + i);
+				if(!rgb_.empty())
+				{
+					setPointColor(pt, rgb_, w, h);
+				}
+
+				float disp = disparity_.type()==CV_16SC1?float(disparity_.at<short>(h,w))/16.0f:disparity_.at<float>(h,w);
+				cv::Point3f ptXYZ = projectDisparityTo3D(cv::Point2f(w, h), disp, model_);
+				if((!finiteOnly_ || util3d::isFinite(ptXYZ)) &&
+				   (minDepthIncluded_?ptXYZ.z >= minDepth_:ptXYZ.z > minDepth_) &&
+				   (maxDepth_<=0.0f || ptXYZ.z <= maxDepth_))
+				{
+					pt.x = ptXYZ.x;
+					pt.y = ptXYZ.y;
+					pt.z = ptXYZ.z;
+					valid_->at(r*cloud_->width + i) = 1;
+				}
+				else
+				{
+					pt.x = pt.y = pt.z = std::numeric_limits<float>::quiet_NaN();
+					valid_->at(r*cloud_->width + i) = 0;
+				}
+			}
+		}
+	}
+private:
+	cv::Mat disparity_;
+	cv::Mat rgb_;
+	const StereoCameraModel & model_;
+	int decimation_;
+	float maxDepth_;
+	float minDepth_;
+	bool minDepthIncluded_;
+	bool finiteOnly_;
+	pcl::PointCloud<PointT> * cloud_;
+	std::vector<unsigned char> * valid_;
+};
+
+// return the number of valid points
+static int validPointIndices(const std::vector<unsigned char> & valid, std::vector<int> * validIndices)
+{
+	int oi = 0;
+	if(validIndices)
+	{
+		validIndices->resize(valid.size());
+	}
+	for(unsigned int i=0; i<valid.size(); ++i)
+	{
+		if(valid[i])
+		{
+			if(validIndices)
+			{
+				validIndices->at(oi) = i;
+			}
+			++oi;
+		}
+	}
+	if(validIndices)
+	{
+		validIndices->resize(oi);
+	}
+	return oi;
+}
+
+class LaserScanFromDepthBody : public cv::ParallelLoopBody
+{
+public:
+	LaserScanFromDepthBody(
+			const DepthRowProjector & projector,
+			const cv::Mat & rgb,
+			float rgbToDepthFactorX,
+			float rgbToDepthFactorY,
+			int decimation,
+			cv::Mat & scan) :
+		projector_(projector),
+		rgb_(rgb),
+		rgbToDepthFactorX_(rgbToDepthFactorX),
+		rgbToDepthFactorY_(rgbToDepthFactorY),
+		decimation_(decimation),
+		scan_(&scan)
+	{}
+	virtual void operator()(const cv::Range & range) const
+	{
+		int n = projector_.width();
+		int channels = scan_->channels();
+		std::vector<float> buffers(n*4);
+		float * depths = &buffers[0];
+		float * xs = depths+n;
+		float * ys = xs+n;
+		float * zs = ys+n;
+		for(int r=range.start; r<range.end; ++r)
+		{
+			projector_.project(r, depths, xs, ys, zs);
+			float * ptr = scan_->ptr<float>(r);
+			int y = int((r*decimation_)*rgbToDepthFactorY_);
+			for(int i=0; i<n; ++i, ptr+=channels)
+			{
+				ptr[0] = xs[i];
+				ptr[1] = ys[i];
+				ptr[2] = zs[i];
+				if(channels == 4)
+				{
+					int x = int((i*decimation_)*rgbToDepthFactorX_);
+					int * ptrInt = (int*)ptr;
+					if(rgb_.channels() == 3)
+					{
+						const unsigned char * bgr = rgb_.ptr<unsigned char>(y,x);
+						ptrInt[3] = int(bgr[0]) | (int(bgr[1]) << 8) | (int(bgr[2]) << 16);
+					}
+					else
+					{
+						int v = rgb_.at<unsigned char>(y,x);
+						ptrInt[3] = v | (v << 8) | (v << 16);
+					}
+				}
+			}
+		}
+	}
+private:
+	const DepthRowProjector & projector_;
+	cv::Mat rgb_;
+	float rgbToDepthFactorX_;
+	float rgbToDepthFactorY_;
+	int decimation_;
+	cv::Mat * scan_;
+};
+
 pcl::PointCloud<pcl::PointXYZ>::Ptr cloudFromDepth(
 		const cv::Mat & imageDepth,
 		float cx, float cy,
@@ -361,10 +724,6 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr cloudFromDepth(
 	cloud->width  = imageDepth.cols/decimation;
 	cloud->is_dense = false;
 	cloud->resize(cloud->height * cloud->width);
-	if(validIndices)
-	{
-		validIndices->resize(cloud->size());
-	}
 
 	float depthFx = model.fx() * rgbToDepthFactorX;
 	float depthFy = model.fy() * rgbToDepthFactorY;
@@ -378,35 +737,10 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr cloudFromDepth(
 			rgbToDepthFactorY,
 			decimation);
 
-	int oi = 0;
-	for(int h = 0; h < imageDepth.rows && h/decimation < (int)cloud->height; h+=decimation)
-	{
-		for(int w = 0; w < imageDepth.cols && w/decimation < (int)cloud->width; w+=decimation)
-		{
-			pcl::PointXYZ & pt = cloud->at((h/decimation)*cloud->width + (w/decimation));
-
-			pcl::PointXYZ ptXYZ = projectDepthTo3D(imageDepth, w, h, depthCx, depthCy, depthFx, depthFy, false);
-			if(pcl::isFinite(ptXYZ) && ptXYZ.z>=minDepth && (maxDepth<=0.0f || ptXYZ.z <= maxDepth))
-			{
-				pt.x = ptXYZ.x;
-				pt.y = ptXYZ.y;
-				pt.z = ptXYZ.z;
-				if(validIndices)
-				{
-					validIndices->at(oi++) = (h/decimation)*cloud->width + (w/decimation);
-				}
-			}
-			else
-			{
-				pt.x = pt.y = pt.z = std::numeric_limits<float>::quiet_NaN();
-			}
-		}
-	}
-
-	if(validIndices)
-	{
-		validIndices->resize(oi);
-	}
+	DepthRowProjector projector(imageDepth, decimation, depthCx, depthCy, depthFx, depthFy, minDepth, maxDepth);
+	std::vector<unsigned char> valid(cloud->size());
+	cv::parallel_for_(cv::Range(0, (int)cloud->height), CloudFromDepthBody<pcl::PointXYZ>(projector, cv::Mat(), 1.0f, 1.0f, decimation, *cloud, valid));
+	validPointIndices(valid, validIndices);
 
 	return cloud;
 }
@@ -513,16 +847,7 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromDepthRGB(
 		}
 	}
 
-	bool mono;
-	if(imageRgb.channels() == 3) // BGR
-	{
-		mono = false;
-	}
-	else if(imageRgb.channels() == 1) // Mono
-	{
-		mono = true;
-	}
-	else
+	if(imageRgb.channels() != 3 && imageRgb.channels() != 1) // BGR or Mono
 	{
 		return cloud;
 	}
@@ -532,10 +857,6 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromDepthRGB(
 	cloud->width  = imageDepth.cols/decimation;
 	cloud->is_dense = false;
 	cloud->resize(cloud->height * cloud->width);
-	if(validIndices)
-	{
-		validIndices->resize(cloud->size());
-	}
 
 	float rgbToDepthFactorX = float(imageRgb.cols) / float(imageDepth.cols);
 	float rgbToDepthFactorY = float(imageRgb.rows) / float(imageDepth.rows);
@@ -552,53 +873,10 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromDepthRGB(
 			rgbToDepthFactorY,
 			decimation);
 
-	int oi = 0;
-	for(int h = 0; h < imageDepth.rows && h/decimation < (int)cloud->height; h+=decimation)
-	{
-		for(int w = 0; w < imageDepth.cols && w/decimation < (int)cloud->width; w+=decimation)
-		{
-			pcl::PointXYZRGB & pt = cloud->at((h/decimation)*cloud->width + (w/decimation));
-
-			int x = int(w*rgbToDepthFactorX);
-			int y = int(h*rgbToDepthFactorY);
-			UASSERT(x >=0 && x<imageRgb.cols && y >=0 && y<imageRgb.rows);
-			if(!mono)
-			{
-				const unsigned char * bgr = imageRgb.ptr<unsigned char>(y,x);
-				pt.b = bgr[0];
-				pt.g = bgr[1];
-				pt.r = bgr[2];
-			}
-			else
-			{
-				unsigned char v = imageRgb.at<unsigned char>(y,x);
-				pt.b = v;
-				pt.g = v;
-				pt.r = v;
-			}
-
-			pcl::PointXYZ ptXYZ = projectDepthTo3D(imageDepth, w, h, depthCx, depthCy, depthFx, depthFy, false);
-			if (pcl::isFinite(ptXYZ) && ptXYZ.z >= minDepth && (maxDepth <= 0.0f || ptXYZ.z <= maxDepth))
-			{
-				pt.x = ptXYZ.x;
-				pt.y = ptXYZ.y;
-				pt.z = ptXYZ.z;
-				if (validIndices)
-				{
-					validIndices->at(oi) = (h / decimation)*cloud->width + (w / decimation);
-				}
-				++oi;
-			}
-			else
-			{
-				pt.x = pt.y = pt.z = std::numeric_limits<float>::quiet_NaN();
-			}
-		}
-	}
-	if(validIndices)
-	{
-		validIndices->resize(oi);
-	}
+	DepthRowProjector projector(imageDepth, decimation, depthCx, depthCy, depthFx, depthFy, minDepth, maxDepth);
+	std::vector<unsigned char> valid(cloud->size());
+	cv::parallel_for_(cv::Range(0, (int)cloud->height), CloudFromDepthBody<pcl::PointXYZRGB>(projector, imageRgb, rgbToDepthFactorX, rgbToDepthFactorY, decimation, *cloud, valid));
+	int oi = validPointIndices(valid, validIndices);
 	if(oi == 0)
 	{
 		UWARN("Cloud with only NaN values created!");
@@ -643,68 +921,20 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr cloudFromDisparity(
 	cloud->width  = imageDisparity.cols/decimation;
 	cloud->is_dense = false;
 	cloud->resize(cloud->height * cloud->width);
-	if(validIndices)
-	{
-		validIndices->resize(cloud->size());
-	}
 
-	int oi = 0;
-	if(imageDisparity.type()==CV_16SC1)
-	{
-		for(int h = 0; h < imageDisparity.rows && h/decimation < (int)cloud->height; h+=decimation)
-		{
-			for(int w = 0; w < imageDisparity.cols && w/decimation < (int)cloud->width; w+=decimation)
-			{
-				float disp = float(imageDisparity.at<short>(h,w))/16.0f;
-				cv::Point3f pt = projectDisparityTo3D(cv::Point2f(w, h), disp, model);
-				if(pt.z >= minDepth && (maxDepth <= 0.0f || pt.z <= maxDepth))
-				{
-					cloud->at((h/decimation)*cloud->width + (w/decimation)) = pcl::PointXYZ(pt.x, pt.y, pt.z);
-					if(validIndices)
-					{
-						validIndices->at(oi++) = (h/decimation)*cloud->width + (w/decimation);
-					}
-				}
-				else
-				{
-					cloud->at((h/decimation)*cloud->width + (w/decimation)) = pcl::PointXYZ(
-							std::numeric_limits<float>::quiet_NaN(),
-							std::numeric_limits<float>::quiet_NaN(),
-							std::numeric_limits<float>::quiet_NaN());
-				}
-			}
-		}
-	}
-	else
-	{
-		for(int h = 0; h < imageDisparity.rows && h/decimation < (int)cloud->height; h+=decimation)
-		{
-			for(int w = 0; w < imageDisparity.cols && w/decimation < (int)cloud->width; w+=decimation)
-			{
-				float disp = imageDisparity.at<float>(h,w);
-				cv::Point3f pt = projectDisparityTo3D(cv::Point2f(w, h), disp, model);
-				if(pt.z > minDepth && (maxDepth <= 0.0f || pt.z <= maxDepth))
-				{
-					cloud->at((h/decimation)*cloud->width + (w/decimation)) = pcl::PointXYZ(pt.x, pt.y, pt.z);
-					if(validIndices)
-					{
-						validIndices->at(oi++) = (h/decimation)*cloud->width + (w/decimation);
-					}
-				}
-				else
-				{
-					cloud->at((h/decimation)*cloud->width + (w/decimation)) = pcl::PointXYZ(
-							std::numeric_limits<float>::quiet_NaN(),
-							std::numeric_limits<float>::quiet_NaN(),
-							std::numeric_limits<float>::quiet_NaN());
-				}
-			}
-		}
-	}
-	if(validIndices)
-	{
-		validIndices->resize(oi);
-	}
+	std::vector<unsigned char> valid(cloud->size());
+	cv::parallel_for_(cv::Range(0, (int)cloud->height), CloudFromDisparityBody<pcl::PointXYZ>(
+			imageDisparity,
+			cv::Mat(),
+			model,
+			decimation,
+			maxDepth,
+			minDepth,
+			imageDisparity.type()==CV_16SC1, // float disparity excludes minDepth
+			false,
+			*cloud,
+			valid));
+	validPointIndices(valid, validIndices);
 	return cloud;
 }
 
@@ -744,68 +974,25 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromDisparityRGB(
 
 	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
 
-	bool mono;
-	if(imageRgb.channels() == 3) // BGR
-	{
-		mono = false;
-	}
-	else // Mono
-	{
-		mono = true;
-	}
-
 	//cloud.header = cameraInfo.header;
 	cloud->height = imageRgb.rows/decimation;
 	cloud->width  = imageRgb.cols/decimation;
 	cloud->is_dense = false;
 	cloud->resize(cloud->height * cloud->width);
-	if(validIndices)
-	{
-		validIndices->resize(cloud->size());
-	}
 
-	int oi=0;
-	for(int h = 0; h < imageRgb.rows && h/decimation < (int)cloud->height; h+=decimation)
-	{
-		for(int w = 0; w < imageRgb.cols && w/decimation < (int)cloud->width; w+=decimation)
-		{
-			pcl::PointXYZRGB & pt = cloud->at((h/decimation)*cloud->width + (w/decimation));
-			if(!mono)
-			{
-				pt.b = imageRgb.at<cv::Vec3b>(h,w)[0];
-				pt.g = imageRgb.at<cv::Vec3b>(h,w)[1];
-				pt.r = imageRgb.at<cv::Vec3b>(h,w)[2];
-			}
-			else
-			{
-				unsigned char v = imageRgb.at<unsigned char>(h,w);
-				pt.b = v;
-				pt.g = v;
-				pt.r = v;
-			}
-
-			float disp = imageDisparity.type()==CV_16SC1?float(imageDisparity.at<short>(h,w))/16.0f:imageDisparity.at<float>(h,w);
-			cv::Point3f ptXYZ = projectDisparityTo3D(cv::Point2f(w, h), disp, model);
-			if(util3d::isFinite(ptXYZ) && ptXYZ.z >= minDepth && (maxDepth<=0.0f || ptXYZ.z <= maxDepth))
-			{
-				pt.x = ptXYZ.x;
-				pt.y = ptXYZ.y;
-				pt.z = ptXYZ.z;
-				if(validIndices)
-				{
-					validIndices->at(oi++) = (h/decimation)*cloud->width + (w/decimation);
-				}
-			}
-			else
-			{
-				pt.x = pt.y = pt.z = std::numeric_limits<float>::quiet_NaN();
-			}
-		}
-	}
-	if(validIndices)
-	{
-		validIndices->resize(oi);
-	}
+	std::vector<unsigned char> valid(cloud->size());
+	cv::parallel_for_(cv::Range(0, (int)cloud->height), CloudFromDisparityBody<pcl::PointXYZRGB>(
+			imageDisparity,
+			imageRgb,
+			model,
+			decimation,
+			maxDepth,
+			minDepth,
+			true,
+			true,
+			*cloud,
+			valid));
+	validPointIndices(valid, validIndices);
 	return cloud;
 }
 
@@ -1194,6 +1381,72 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr RTABMAP_EXP cloudRGBFromSensorData(
 	return cloud;
 }
 
+LaserScan laserScanFromDepth(
+		const cv::Mat & depth,
+		const CameraModel & model,
+		int decimation,
+		float maxDepth,
+		float minDepth,
+		const cv::Mat & rgb)
+{
+	UASSERT(model.isValidForProjection());
+	UASSERT(!depth.empty() && (depth.type() == CV_16UC1 || depth.type() == CV_32FC1));
+	UASSERT(decimation >= 1);
+	UASSERT_MSG(depth.rows % decimation == 0 && depth.cols % decimation == 0,
+			uFormat("depth=%dx%d decimation=%d", depth.cols, depth.rows, decimation).c_str());
+	UASSERT_MSG(rgb.empty() || (rgb.rows % depth.rows == 0 && rgb.cols % depth.cols == 0 && (rgb.channels() == 3 || rgb.channels() == 1)),
+			uFormat("rgb=%dx%d (channels=%d) depth=%dx%d", rgb.cols, rgb.rows, rgb.channels(), depth.cols, depth.rows).c_str());
+
+	// the camera model is for the RGB image if set
+	float rgbToDepthFactorX = 1.0f;
+	float rgbToDepthFactorY = 1.0f;
+	if(!rgb.empty())
+	{
+		rgbToDepthFactorX = float(rgb.cols) / float(depth.cols);
+		rgbToDepthFactorY = float(rgb.rows) / float(depth.rows);
+	}
+	else if(model.imageWidth() > 0 && model.imageHeight() > 0)
+	{
+		rgbToDepthFactorX = float(model.imageWidth()) / float(depth.cols);
+		rgbToDepthFactorY = float(model.imageHeight()) / float(depth.rows);
+	}
+
+	DepthRowProjector projector(
+			depth,
+			decimation,
+			model.cx() / rgbToDepthFactorX,
+			model.cy() / rgbToDepthFactorY,
+			model.fx() / rgbToDepthFactorX,
+			model.fy() / rgbToDepthFactorY,
+			minDepth,
+			maxDepth);
+	cv::Mat organized(projector.height(), projector.width(), rgb.empty()?CV_32FC3:CV_32FC4);
+	cv::parallel_for_(cv::Range(0, organized.rows), LaserScanFromDepthBody(projector, rgb, rgbToDepthFactorX, rgbToDepthFactorY, decimation, organized));
+
+	// keep only valid points
+	cv::Mat scan(1, (int)organized.total(), organized.type());
+	int channels = organized.channels();
+	int oi = 0;
+	for(int r=0; r<organized.rows; ++r)
+	{
+		const float * ptr = organized.ptr<float>(r);
+		for(int i=0; i<organized.cols; ++i, ptr+=channels)
+		{
+			if(uIsFinite(ptr[2]))
+			{
+				memcpy(scan.ptr<float>(0, oi++), ptr, channels*sizeof(float));
+			}
+		}
+	}
+
+	return LaserScan(
+			oi?scan(cv::Range::all(), cv::Range(0,oi)):cv::Mat(),
+			(int)organized.total(),
+			maxDepth,
+			rgb.empty()?LaserScan::kXYZ:LaserScan::kXYZRGB,
+			model.localTransform());
+}
+
 pcl::PointCloud<pcl::PointXYZ> laserScanFromDepthImage(
 		const cv::Mat & depthImage,
 		float fx,
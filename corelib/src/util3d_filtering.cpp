@@ -50,6 +50,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UConversion.h>
 
+#include <algorithm>
+#include <cstring>
+
 #if PCL_VERSION_COMPARE(>=, 1, 8, 0)
 #include <pcl/impl/instantiate.hpp>
 #include <pcl/point_types.h>
@@ -71,6 +74,165 @@ namespace rtabmap
 namespace util3d
 {
 
+// Voxel grid working directly on the scan data, to avoid the round trip
+// LaserScan -> pcl::PointCloud -> pcl::VoxelGrid -> LaserScan. Points are
+// accumulated in a hash table of voxels. Like pcl::VoxelGrid, each voxel is
+// replaced by the centroid of its points (intensity and colors are averaged)
+// and voxels are returned ordered by their index in the bounding grid.
+class ScanVoxelGrid
+{
+public:
+	// maxPoints=0 creates an unused grid, voxelSize can then be 0
+	ScanVoxelGrid(const LaserScan & scan, float voxelSize, int maxPoints) :
+		inverseVoxelSize_(voxelSize>0.0f?1.0f/voxelSize:0.0f),
+		is2d_(scan.is2d()),
+		intensityOffset_(scan.getIntensityOffset()),
+		rgbOffset_(scan.getRGBOffset())
+	{
+		UASSERT(voxelSize > 0.0f || maxPoints == 0);
+		int tableSize = 1;
+		while(tableSize < maxPoints*2)
+		{
+			tableSize <<= 1;
+		}
+		table_.resize(tableSize, -1);
+		voxels_.reserve(maxPoints);
+	}
+
+	void add(const float * ptr)
+	{
+		float x = ptr[0];
+		float y = ptr[1];
+		float z = is2d_?0.0f:ptr[2];
+		if(!uIsFinite(x) || !uIsFinite(y) || !uIsFinite(z))
+		{
+			return;
+		}
+		int i = (int)std::floor(x * inverseVoxelSize_);
+		int j = (int)std::floor(y * inverseVoxelSize_);
+		int k = (int)std::floor(z * inverseVoxelSize_);
+
+		// open addressing, the table is at least twice the number of points
+		unsigned int mask = (unsigned int)table_.size()-1;
+		unsigned int h = (((unsigned int)i * 73856093u) ^ ((unsigned int)j * 19349663u) ^ ((unsigned int)k * 83492791u)) & mask;
+		while(table_[h] >= 0 &&
+			  (voxels_[table_[h]].i != i || voxels_[table_[h]].j != j || voxels_[table_[h]].k != k))
+		{
+			h = (h+1) & mask;
+		}
+		if(table_[h] < 0)
+		{
+			table_[h] = (int)voxels_.size();
+			voxels_.push_back(Voxel(i, j, k));
+		}
+
+		Voxel & voxel = voxels_[table_[h]];
+		++voxel.count;
+		voxel.sum[0] += x;
+		voxel.sum[1] += y;
+		voxel.sum[2] += z;
+		if(rgbOffset_ >= 0)
+		{
+			int rgb = *(const int*)(ptr + rgbOffset_);
+			voxel.sum[3] += float((rgb >> 16) & 0xFF);
+			voxel.sum[4] += float((rgb >> 8) & 0xFF);
+			voxel.sum[5] += float(rgb & 0xFF);
+		}
+		else if(intensityOffset_ >= 0)
+		{
+			voxel.sum[3] += ptr[intensityOffset_];
+		}
+	}
+
+	LaserScan::Format format() const
+	{
+		if(rgbOffset_ >= 0)
+		{
+			return LaserScan::kXYZRGB;
+		}
+		else if(intensityOffset_ >= 0)
+		{
+			return is2d_?LaserScan::kXYI:LaserScan::kXYZI;
+		}
+		return is2d_?LaserScan::kXY:LaserScan::kXYZ;
+	}
+
+	cv::Mat centroids() const
+	{
+		if(voxels_.empty())
+		{
+			return cv::Mat();
+		}
+
+		// same order than pcl::VoxelGrid
+		int minI = voxels_[0].i, maxI = voxels_[0].i;
+		int minJ = voxels_[0].j, maxJ = voxels_[0].j;
+		int minK = voxels_[0].k;
+		for(unsigned int n=1; n<voxels_.size(); ++n)
+		{
+			minI = std::min(minI, voxels_[n].i);
+			maxI = std::max(maxI, voxels_[n].i);
+			minJ = std::min(minJ, voxels_[n].j);
+			maxJ = std::max(maxJ, voxels_[n].j);
+			minK = std::min(minK, voxels_[n].k);
+		}
+		long long dx = (long long)maxI - minI + 1;
+		long long dxy = dx * ((long long)maxJ - minJ + 1);
+		std::vector<std::pair<long long, int> > order(voxels_.size());
+		for(unsigned int n=0; n<voxels_.size(); ++n)
+		{
+			order[n].first = (voxels_[n].i - minI) + (voxels_[n].j - minJ) * dx + (voxels_[n].k - minK) * dxy;
+			order[n].second = n;
+		}
+		std::sort(order.begin(), order.end());
+
+		cv::Mat output(1, (int)voxels_.size(), CV_32FC(LaserScan::channels(format())));
+		for(unsigned int n=0; n<order.size(); ++n)
+		{
+			const Voxel & voxel = voxels_[order[n].second];
+			float count = float(voxel.count);
+			float * ptr = output.ptr<float>(0, n);
+			int oi = 0;
+			ptr[oi++] = voxel.sum[0] / count;
+			ptr[oi++] = voxel.sum[1] / count;
+			if(!is2d_)
+			{
+				ptr[oi++] = voxel.sum[2] / count;
+			}
+			if(rgbOffset_ >= 0)
+			{
+				*(int*)(ptr + oi) = int(voxel.sum[5] / count) | (int(voxel.sum[4] / count) << 8) | (int(voxel.sum[3] / count) << 16);
+			}
+			else if(intensityOffset_ >= 0)
+			{
+				ptr[oi] = voxel.sum[3] / count;
+			}
+		}
+		return output;
+	}
+
+private:
+	struct Voxel
+	{
+		Voxel(int i, int j, int k) : i(i), j(j), k(k), count(0)
+		{
+			memset(sum, 0, sizeof(sum));
+		}
+		int i;
+		int j;
+		int k;
+		int count;
+		float sum[6]; // x, y, z, intensity or r, g, b
+	};
+
+	float inverseVoxelSize_;
+	bool is2d_;
+	int intensityOffset_;
+	int rgbOffset_;
+	std::vector<int> table_;
+	std::vector<Voxel> voxels_;
+};
+
 LaserScan commonFiltering(
 		const LaserScan & scanIn,
 		int downsamplingStep,
@@ -86,16 +248,25 @@ LaserScan commonFiltering(
 			scan.size(), (int)scan.format(), downsamplingStep, rangeMin, rangeMax, voxelSize, normalK, normalRadius);
 	if(!scan.isEmpty())
 	{
-		// combined downsampling and range filtering step
+		// combined downsampling, range and voxel filtering step
 		if(downsamplingStep<=1 || scan.size() <= downsamplingStep)
 		{
 			downsamplingStep = 1;
 		}
 
-		if(downsamplingStep > 1 || rangeMin > 0.0f || rangeMax > 0.0f)
+		bool computeNormals = normalK > 0 || normalRadius>0.0f;
+		if(downsamplingStep > 1 || rangeMin > 0.0f || rangeMax > 0.0f || voxelSize > 0.0f)
 		{
-			cv::Mat tmp = cv::Mat(1, scan.size()/downsamplingStep, scan.dataType());
+			// Kept points are either copied or directly added to the voxel grid
+			bool voxelize = voxelSize > 0.0f;
+			ScanVoxelGrid voxelGrid(scan, voxelSize, voxelize?scan.size()/downsamplingStep:0);
+			cv::Mat tmp;
+			if(!voxelize)
+			{
+				tmp = cv::Mat(1, scan.size()/downsamplingStep, scan.dataType());
+			}
 			bool is2d = scan.is2d();
+			size_t pointSize = scan.data().elemSize();
 			int oi = 0;
 			float rangeMinSqrd = rangeMin * rangeMin;
 			float rangeMaxSqrd = rangeMax * rangeMax;
@@ -125,172 +296,113 @@ LaserScan commonFiltering(
 					}
 				}
 
-				cv::Mat(scan.data(), cv::Range::all(), cv::Range(i,i+1)).copyTo(cv::Mat(tmp, cv::Range::all(), cv::Range(oi,oi+1)));
+				if(voxelize)
+				{
+					voxelGrid.add(ptr);
+				}
+				else
+				{
+					memcpy(tmp.ptr<float>(0, oi), ptr, pointSize);
+				}
 				++oi;
 			}
-			int previousSize = scan.size();
-			int scanMaxPtsTmp = scan.maxPoints();
-			if(scan.angleIncrement() > 0.0f)
+
+			cv::Mat filtered = voxelize?cv::Mat():cv::Mat(tmp, cv::Range::all(), cv::Range(0, oi));
+			if(downsamplingStep > 1 || rangeMin > 0.0f || rangeMax > 0.0f)
 			{
-				scan = LaserScan(
-						cv::Mat(tmp, cv::Range::all(), cv::Range(0, oi)),
-						scan.format(),
-						rangeMin>0.0f&&rangeMin>scan.rangeMin()?rangeMin:scan.rangeMin(),
-						rangeMax>0.0f&&rangeMax<scan.rangeMax()?rangeMax:scan.rangeMax(),
-						scan.angleMin(),
-						scan.angleMax(),
-						scan.angleIncrement() * (float)downsamplingStep,
-						scan.localTransform());
+				int previousSize = scan.size();
+				int scanMaxPtsTmp = scan.maxPoints();
+				if(scan.angleIncrement() > 0.0f)
+				{
+					scan = LaserScan(
+							filtered,
+							scan.format(),
+							rangeMin>0.0f&&rangeMin>scan.rangeMin()?rangeMin:scan.rangeMin(),
+							rangeMax>0.0f&&rangeMax<scan.rangeMax()?rangeMax:scan.rangeMax(),
+							scan.angleMin(),
+							scan.angleMax(),
+							scan.angleIncrement() * (float)downsamplingStep,
+							scan.localTransform());
+				}
+				else
+				{
+					scan = LaserScan(
+							filtered,
+							scanMaxPtsTmp/downsamplingStep,
+							rangeMax>0.0f&&rangeMax<scan.rangeMax()?rangeMax:scan.rangeMax(),
+							scan.format(),
+							scan.localTransform());
+				}
+				UDEBUG("Downsampling scan (step=%d): %d -> %d (scanMaxPts=%d->%d)", downsamplingStep, previousSize, oi, scanMaxPtsTmp, scan.maxPoints());
 			}
-			else
+
+			if(voxelize && oi)
 			{
-				scan = LaserScan(
-						cv::Mat(tmp, cv::Range::all(), cv::Range(0, oi)),
-						scanMaxPtsTmp/downsamplingStep,
-						rangeMax>0.0f&&rangeMax<scan.rangeMax()?rangeMax:scan.rangeMax(),
-						scan.format(),
-						scan.localTransform());
+				cv::Mat voxels = voxelGrid.centroids();
+				float ratio = float(voxels.cols) / oi;
+				int scanMaxPts = int(float(scan.maxPoints()) * ratio);
+				UDEBUG("Voxel filtering scan (voxel=%f m): %d -> %d (scanMaxPts=%d->%d)", voxelSize, oi, voxels.cols, scan.maxPoints(), scanMaxPts);
+				if(scan.hasNormals() && !computeNormals)
+				{
+					UWARN("Voxel filter is applied, but normal parameters are not set and input scan has normals. The returned scan has no normals.");
+				}
+				scan = LaserScan(voxels, scanMaxPts, scan.rangeMax(), voxelGrid.format(), scan.localTransform());
 			}
-			UDEBUG("Downsampling scan (step=%d): %d -> %d (scanMaxPts=%d->%d)", downsamplingStep, previousSize, scan.size(), scanMaxPtsTmp, scan.maxPoints());
 		}
 
-		if(scan.size() && (voxelSize > 0.0f || ((normalK > 0 || normalRadius>0.0f) && !scan.hasNormals())))
+		if(scan.size() && computeNormals && !scan.hasNormals())
 		{
-			// convert to compatible PCL format and filter it
+			// convert to compatible PCL format only to compute the normals
 			if(scan.hasRGB())
 			{
 				UASSERT(!scan.is2d());
 				pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = laserScanToPointCloudRGB(scan);
-				if(cloud->size())
-				{
-					int scanMaxPts = scan.maxPoints();
-					if(voxelSize > 0.0f)
-					{
-						cloud = voxelize(cloud, voxelSize);
-						float ratio = float(cloud->size()) / scan.size();
-						scanMaxPts = int(float(scanMaxPts) * ratio);
-						UDEBUG("Voxel filtering scan (voxel=%f m): %d -> %d (scanMaxPts=%d->%d)", voxelSize, scan.size(), cloud->size(), scan.maxPoints(), scanMaxPts);
-					}
-					if(cloud->size() && (normalK > 0 || normalRadius>0.0f))
-					{
-						pcl::PointCloud<pcl::Normal>::Ptr normals = util3d::computeNormals(cloud, normalK, normalRadius);
-						scan = LaserScan(laserScanFromPointCloud(*cloud, *normals), scanMaxPts, scan.rangeMax(), LaserScan::kXYZRGBNormal, scan.localTransform());
-						UDEBUG("Normals computed (k=%d radius=%f)", normalK, normalRadius);
-					}
-					else
-					{
-						if(scan.hasNormals())
-						{
-							UWARN("Voxel filter is applied, but normal parameters are not set and input scan has normals. The returned scan has no normals.");
-						}
-						scan = LaserScan(laserScanFromPointCloud(*cloud), scanMaxPts, scan.rangeMax(), LaserScan::kXYZRGB, scan.localTransform());
-					}
-				}
+				pcl::PointCloud<pcl::Normal>::Ptr normals = util3d::computeNormals(cloud, normalK, normalRadius);
+				scan = LaserScan(laserScanFromPointCloud(*cloud, *normals), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZRGBNormal, scan.localTransform());
 			}
 			else if(scan.hasIntensity())
 			{
 				pcl::PointCloud<pcl::PointXYZI>::Ptr cloud = laserScanToPointCloudI(scan);
-				if(cloud->size())
+				if(scan.is2d())
 				{
-					int scanMaxPts = scan.maxPoints();
-					if(voxelSize > 0.0f)
+					pcl::PointCloud<pcl::Normal>::Ptr normals = util3d::computeNormals2D(cloud, normalK, normalRadius);
+					if(scan.angleIncrement() > 0.0f)
 					{
-						cloud = voxelize(cloud, voxelSize);
-						float ratio = float(cloud->size()) / scan.size();
-						scanMaxPts = int(float(scanMaxPts) * ratio);
-						UDEBUG("Voxel filtering scan (voxel=%f m): %d -> %d (scanMaxPts=%d->%d)", voxelSize, scan.size(), cloud->size(), scan.maxPoints(), scanMaxPts);
-					}
-					if(cloud->size() && (normalK > 0 || normalRadius>0.0f))
-					{
-						pcl::PointCloud<pcl::Normal>::Ptr normals;
-						if(scan.is2d())
-						{
-							normals = util3d::computeNormals2D(cloud, normalK, normalRadius);
-							if(voxelSize == 0.0f && scan.angleIncrement() > 0.0f)
-							{
-								scan = LaserScan(laserScan2dFromPointCloud(*cloud, *normals), LaserScan::kXYINormal, scan.rangeMin(), scan.rangeMax(), scan.angleMin(), scan.angleMax(), scan.angleIncrement(), scan.localTransform());
-							}
-							else
-							{
-								scan = LaserScan(laserScan2dFromPointCloud(*cloud, *normals), scanMaxPts, scan.rangeMax(), LaserScan::kXYINormal, scan.localTransform());
-							}
-						}
-						else
-						{
-							normals = util3d::computeNormals(cloud, normalK, normalRadius);
-							scan = LaserScan(laserScanFromPointCloud(*cloud, *normals), scanMaxPts, scan.rangeMax(), LaserScan::kXYZINormal, scan.localTransform());
-						}
-						UDEBUG("Normals computed (k=%d radius=%f)", normalK, normalRadius);
+						scan = LaserScan(laserScan2dFromPointCloud(*cloud, *normals), LaserScan::kXYINormal, scan.rangeMin(), scan.rangeMax(), scan.angleMin(), scan.angleMax(), scan.angleIncrement(), scan.localTransform());
 					}
 					else
 					{
-						if(scan.hasNormals())
-						{
-							UWARN("Voxel filter i applied, but normal parameters are not set and input scan has normals. The returned scan has no normals.");
-						}
-						if(scan.is2d())
-						{
-							scan = LaserScan(laserScan2dFromPointCloud(*cloud), scanMaxPts, scan.rangeMax(), LaserScan::kXYI, scan.localTransform());
-						}
-						else
-						{
-							scan = LaserScan(laserScanFromPointCloud(*cloud), scanMaxPts, scan.rangeMax(), LaserScan::kXYZI, scan.localTransform());
-						}
+						scan = LaserScan(laserScan2dFromPointCloud(*cloud, *normals), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYINormal, scan.localTransform());
 					}
 				}
+				else
+				{
+					pcl::PointCloud<pcl::Normal>::Ptr normals = util3d::computeNormals(cloud, normalK, normalRadius);
+					scan = LaserScan(laserScanFromPointCloud(*cloud, *normals), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZINormal, scan.localTransform());
+				}
 			}
 			else
 			{
 				pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = laserScanToPointCloud(scan);
-				if(cloud->size())
+				if(scan.is2d())
 				{
-					int scanMaxPts = scan.maxPoints();
-					if(voxelSize > 0.0f)
+					pcl::PointCloud<pcl::Normal>::Ptr normals = util3d::computeNormals2D(cloud, normalK, normalRadius);
+					if(scan.angleIncrement() > 0.0f)
 					{
-						cloud = voxelize(cloud, voxelSize);
-						float ratio = float(cloud->size()) / scan.size();
-						scanMaxPts = int(float(scanMaxPts) * ratio);
-						UDEBUG("Voxel filtering scan (voxel=%f m): %d -> %d (scanMaxPts=%d->%d)", voxelSize, scan.size(), cloud->size(), scan.maxPoints(), scanMaxPts);
-					}
-					if(cloud->size() && (normalK > 0 || normalRadius>0.0f))
-					{
-						pcl::PointCloud<pcl::Normal>::Ptr normals;
-						if(scan.is2d())
-						{
-							normals = util3d::computeNormals2D(cloud, normalK, normalRadius);
-							if(voxelSize == 0.0f && scan.angleIncrement() > 0.0f)
-							{
-								scan = LaserScan(laserScan2dFromPointCloud(*cloud, *normals), LaserScan::kXYNormal, scan.rangeMin(), scan.rangeMax(), scan.angleMin(), scan.angleMax(), scan.angleIncrement(), scan.localTransform());
-							}
-							else
-							{
-								scan = LaserScan(laserScan2dFromPointCloud(*cloud, *normals), scanMaxPts, scan.rangeMax(), LaserScan::kXYNormal, scan.localTransform());
-							}
-						}
-						else
-						{
-							normals = util3d::computeNormals(cloud, normalK, normalRadius);
-							scan = LaserScan(laserScanFromPointCloud(*cloud, *normals), scanMaxPts, scan.rangeMax(), LaserScan::kXYZNormal, scan.localTransform());
-						}
-						UDEBUG("Normals computed (k=%d radius=%f)", normalK, normalRadius);
+						scan = LaserScan(laserScan2dFromPointCloud(*cloud, *normals), LaserScan::kXYNormal, scan.rangeMin(), scan.rangeMax(), scan.angleMin(), scan.angleMax(), scan.angleIncrement(), scan.localTransform());
 					}
 					else
 					{
-						if(scan.hasNormals())
-						{
-							UWARN("Voxel filter i applied, but normal parameters are not set and input scan has normals. The returned scan has no normals.");
-						}
-						if(scan.is2d())
-						{
-							scan = LaserScan(laserScan2dFromPointCloud(*cloud), scanMaxPts, scan.rangeMax(), LaserScan::kXY, scan.localTransform());
-						}
-						else
-						{
-							scan = LaserScan(laserScanFromPointCloud(*cloud), scanMaxPts, scan.rangeMax(), LaserScan::kXYZ, scan.localTransform());
-						}
+						scan = LaserScan(laserScan2dFromPointCloud(*cloud, *normals), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYNormal, scan.localTransform());
 					}
 				}
+				else
+				{
+					pcl::PointCloud<pcl::Normal>::Ptr normals = util3d::computeNormals(cloud, normalK, normalRadius);
+					scan = LaserScan(laserScanFromPointCloud(*cloud, *normals), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZNormal, scan.localTransform());
+				}
 			}
+			UDEBUG("Normals computed (k=%d radius=%f)", normalK, normalRadius);
 		}
 
 		if(scan.size() && !scan.is2d() && scan.hasNormals() && forceGroundNormalsUp)
@@ -893,9 +893,16 @@ void rayTrace(const cv::Point2i & start, const cv::Point2i & end, cv::Mat & grid
 
 //convert to gray scaled map
 cv::Mat convertMap2Image8U(const cv::Mat & map8S, bool pgmFormat)
+{
+	cv::Mat map8U;
+	convertMap2Image8U(map8S, map8U, pgmFormat);
+	return map8U;
+}
+
+void convertMap2Image8U(const cv::Mat & map8S, cv::Mat & map8U, bool pgmFormat)
 {
 	UASSERT(map8S.channels() == 1 && map8S.type() == CV_8S);
-	cv::Mat map8U = cv::Mat(map8S.rows, map8S.cols, CV_8U);
+	map8U.create(map8S.rows, map8S.cols, CV_8U);
 	for (int i = 0; i < map8S.rows; ++i)
 	{
 		for (int j = 0; j < map8S.cols; ++j)
@@ -921,7 +928,6 @@ cv::Mat convertMap2Image8U(const cv::Mat & map8S, bool pgmFormat)
 			map8U.at<unsigned char>(i, j) = gray;
 		}
 	}
-	return map8U;
 }
 
 //convert gray scaled image to map
@@ -41,6 +41,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <opencv2/core/core_c.h>
 #include <opencv2/imgproc/types_c.h>
 #include <pcl/search/kdtree.h>
+#include <pcl/common/centroid.h>
 #include <pcl/surface/gp3.h>
 #include <pcl/features/normal_3d_omp.h>
 #include <pcl/surface/mls.h>
@@ -859,6 +860,77 @@ pcl::TextureMesh::Ptr createTextureMesh(
 	return textureMesh;
 }
 
+// Removes the invalid polygons of the textures, the textures are independent
+// (firstPolygon is the index of their first polygon in the valid array) so they
+// are filtered in parallel.
+class CleanTexturesBody : public cv::ParallelLoopBody
+{
+public:
+	CleanTexturesBody(
+			const std::vector<unsigned char> & validPolygons,
+			const std::vector<unsigned int> & firstPolygon,
+			pcl::TextureMesh & textureMesh) :
+		validPolygons_(validPolygons),
+		firstPolygon_(firstPolygon),
+		textureMesh_(textureMesh)
+	{}
+
+	virtual void operator()(const cv::Range & range) const
+	{
+		for(int t=range.start; t<range.end; ++t)
+		{
+			if(textureMesh_.tex_polygons[t].empty())
+			{
+				continue;
+			}
+			UASSERT_MSG(firstPolygon_[t] < validPolygons_.size(), uFormat("%d vs %d", (int)firstPolygon_[t], (int)validPolygons_.size()).c_str());
+
+			std::vector<pcl::Vertices> filteredPolygons(textureMesh_.tex_polygons[t].size());
+#if PCL_VERSION_COMPARE(>=, 1, 8, 0)
+			std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > filteredCoordinates(textureMesh_.tex_coordinates[t].size());
+#else
+			std::vector<Eigen::Vector2f> filteredCoordinates(textureMesh_.tex_coordinates[t].size());
+#endif
+
+			// make index polygon to coordinate
+			std::vector<unsigned int> polygonToCoord(textureMesh_.tex_polygons[t].size());
+			unsigned int totalCoord = 0;
+			for(unsigned int i=0; i<textureMesh_.tex_polygons[t].size(); ++i)
+			{
+				polygonToCoord[i] = totalCoord;
+				totalCoord+=textureMesh_.tex_polygons[t][i].vertices.size();
+			}
+			UASSERT_MSG(totalCoord == textureMesh_.tex_coordinates[t].size(), uFormat("%d vs %d", totalCoord, (int)textureMesh_.tex_coordinates[t].size()).c_str());
+
+			int oi=0;
+			int ci=0;
+			for(unsigned int i=0; i<textureMesh_.tex_polygons[t].size(); ++i)
+			{
+				if(validPolygons_[firstPolygon_[t]+i])
+				{
+					filteredPolygons[oi] = textureMesh_.tex_polygons[t].at(i);
+					for(unsigned int j=0; j<filteredPolygons[oi].vertices.size(); ++j)
+					{
+						UASSERT(polygonToCoord[i] < textureMesh_.tex_coordinates[t].size());
+						filteredCoordinates[ci] = textureMesh_.tex_coordinates[t][polygonToCoord[i]+j];
+						++ci;
+					}
+					++oi;
+				}
+			}
+			filteredPolygons.resize(oi);
+			filteredCoordinates.resize(ci);
+			textureMesh_.tex_polygons[t].swap(filteredPolygons);
+			textureMesh_.tex_coordinates[t].swap(filteredCoordinates);
+		}
+	}
+
+private:
+	const std::vector<unsigned char> & validPolygons_;
+	const std::vector<unsigned int> & firstPolygon_;
+	pcl::TextureMesh & textureMesh_;
+};
+
 void cleanTextureMesh(
 		pcl::TextureMesh & textureMesh,
 		int minClusterSize)
@@ -902,7 +974,8 @@ void cleanTextureMesh(
 					neighbors,
 					minClusterSize<0?0:minClusterSize);
 
-			std::set<int> validPolygons;
+			std::vector<unsigned char> validPolygons(totalSize, 0);
+			int validPolygonsCount = 0;
 			if(minClusterSize < 0)
 			{
 				// only keep the biggest cluster
@@ -920,8 +993,9 @@ void cleanTextureMesh(
 				{
 					for(std::list<int>::iterator jter=biggestClusterIndex->begin(); jter!=biggestClusterIndex->end(); ++jter)
 					{
-						validPolygons.insert(*jter);
+						validPolygons[*jter] = 1;
 					}
+					validPolygonsCount = (int)biggestClusterSize;
 				}
 			}
 			else
@@ -930,64 +1004,26 @@ void cleanTextureMesh(
 				{
 					for(std::list<int>::iterator jter=iter->begin(); jter!=iter->end(); ++jter)
 					{
-						validPolygons.insert(*jter);
+						validPolygons[*jter] = 1;
 					}
+					validPolygonsCount += (int)iter->size();
 				}
 			}
 
-			if(validPolygons.size() == 0)
+			if(validPolygonsCount == 0)
 			{
 				UWARN("All %d polygons filtered after polygon cluster filtering. Cluster minimum size is %d.",totalSize, minClusterSize);
 			}
 
-			// for each texture
+			// filter each texture
+			std::vector<unsigned int> firstPolygon(textureMesh.tex_polygons.size());
 			unsigned int allPolygonsIndex = 0;
 			for(unsigned int t=0; t<textureMesh.tex_polygons.size(); ++t)
 			{
-				std::vector<pcl::Vertices> filteredPolygons(textureMesh.tex_polygons[t].size());
-#if PCL_VERSION_COMPARE(>=, 1, 8, 0)
-				std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > filteredCoordinates(textureMesh.tex_coordinates[t].size());
-#else
-				std::vector<Eigen::Vector2f> filteredCoordinates(textureMesh.tex_coordinates[t].size());
-#endif
-
-				if(textureMesh.tex_polygons[t].size())
-				{
-					UASSERT_MSG(allPolygonsIndex < allPolygons.size(), uFormat("%d vs %d", (int)allPolygonsIndex, (int)allPolygons.size()).c_str());
-
-					// make index polygon to coordinate
-					std::vector<unsigned int> polygonToCoord(textureMesh.tex_polygons[t].size());
-					unsigned int totalCoord = 0;
-					for(unsigned int i=0; i<textureMesh.tex_polygons[t].size(); ++i)
-					{
-						polygonToCoord[i] = totalCoord;
-						totalCoord+=textureMesh.tex_polygons[t][i].vertices.size();
-					}
-					UASSERT_MSG(totalCoord == textureMesh.tex_coordinates[t].size(), uFormat("%d vs %d", totalCoord, (int)textureMesh.tex_coordinates[t].size()).c_str());
-
-					int oi=0;
-					int ci=0;
-					for(unsigned int i=0; i<textureMesh.tex_polygons[t].size(); ++i)
-					{
-						if(validPolygons.find(allPolygonsIndex) != validPolygons.end())
-						{
-							filteredPolygons[oi] = textureMesh.tex_polygons[t].at(i);
-							for(unsigned int j=0; j<filteredPolygons[oi].vertices.size(); ++j)
-							{
-								UASSERT(polygonToCoord[i] < textureMesh.tex_coordinates[t].size());
-								filteredCoordinates[ci] = textureMesh.tex_coordinates[t][polygonToCoord[i]+j];
-								++ci;
-							}
-							++oi;
-						}
-						++allPolygonsIndex;
-					}
-					filteredPolygons.resize(oi);
-					filteredCoordinates.resize(ci);
-					textureMesh.tex_polygons[t] = filteredPolygons;
-					textureMesh.tex_coordinates[t] = filteredCoordinates;
-				}
+				firstPolygon[t] = allPolygonsIndex;
+				allPolygonsIndex += textureMesh.tex_polygons[t].size();
 			}
+			cv::parallel_for_(cv::Range(0, (int)textureMesh.tex_polygons.size()), CleanTexturesBody(validPolygons, firstPolygon, textureMesh));
 		}
 	}
 }
@@ -1420,6 +1456,94 @@ double sqr(uchar v)
 	return double(v)*double(v);
 }
 
+// Gain compensation of the textures assembled in the atlases, the
+// textures don't overlap so they are processed in parallel.
+class TextureGainsBody : public cv::ParallelLoopBody
+{
+public:
+	TextureGainsBody(
+			const std::vector<bool> & materialsKept,
+			const std::vector<int> & newCamIndex,
+			const std::vector<cv::Point2i> & imageOrigin,
+			const cv::Size & imageSize,
+			int imagesPerMaterial,
+			const cv::Mat_<double> & gains,
+			bool gainRGB,
+			cv::Mat & globalTextures) :
+		materialsKept_(materialsKept),
+		newCamIndex_(newCamIndex),
+		imageOrigin_(imageOrigin),
+		imageSize_(imageSize),
+		imagesPerMaterial_(imagesPerMaterial),
+		gains_(gains),
+		gainRGB_(gainRGB),
+		globalTextures_(globalTextures)
+	{}
+
+	virtual void operator()(const cv::Range & range) const
+	{
+		for(int t=range.start; t<range.end; ++t)
+		{
+			if(materialsKept_.at(t))
+			{
+				int u = imageOrigin_[t].x;
+				int v = imageOrigin_[t].y;
+
+				int indexMaterial = newCamIndex_[t] / imagesPerMaterial_;
+				cv::Mat roi = globalTextures_(cv::Rect(u+indexMaterial*globalTextures_.rows, v, imageSize_.width, imageSize_.height));
+
+				std::vector<cv::Mat> channels;
+				cv::split(roi, channels);
+
+				// assuming BGR
+				cv::multiply(channels[0], gains_(newCamIndex_[t], gainRGB_?3:0), channels[0]);
+				cv::multiply(channels[1], gains_(newCamIndex_[t], gainRGB_?2:0), channels[1]);
+				cv::multiply(channels[2], gains_(newCamIndex_[t], gainRGB_?1:0), channels[2]);
+
+				cv::merge(channels, roi);
+			}
+		}
+	}
+
+private:
+	const std::vector<bool> & materialsKept_;
+	const std::vector<int> & newCamIndex_;
+	const std::vector<cv::Point2i> & imageOrigin_;
+	cv::Size imageSize_;
+	int imagesPerMaterial_;
+	const cv::Mat_<double> & gains_;
+	bool gainRGB_;
+	cv::Mat & globalTextures_;
+};
+
+// Smooths the (decimated) blending gains of each atlas and applies them.
+class BlendingGainsBody : public cv::ParallelLoopBody
+{
+public:
+	BlendingGainsBody(
+			std::vector<cv::Mat> & blendGains,
+			cv::Mat & globalTextures) :
+		blendGains_(blendGains),
+		globalTextures_(globalTextures)
+	{}
+
+	virtual void operator()(const cv::Range & range) const
+	{
+		for(int i=range.start; i<range.end; ++i)
+		{
+			cv::Mat globalTexturesROI = globalTextures_(cv::Range::all(), cv::Range(i*globalTextures_.rows, (i+1)*globalTextures_.rows));
+			cv::Mat dst;
+			cv::blur(blendGains_[i], dst, cv::Size(3,3));
+			cv::resize(dst, blendGains_[i], globalTexturesROI.size(), 0, 0, cv::INTER_LINEAR);
+			cv::multiply(globalTexturesROI, blendGains_[i], globalTexturesROI, 1.0, CV_8UC3);
+		}
+	}
+
+private:
+	std::vector<cv::Mat> & blendGains_;
+	cv::Mat & globalTextures_;
+};
+
 cv::Mat mergeTextures(
 		pcl::TextureMesh & mesh,
 		const std::map<int, cv::Mat> & images,
@@ -1875,29 +1999,24 @@ cv::Mat mergeTextures(
 						gainsG.copyTo(gains.col(2));
 						gainsB.copyTo(gains.col(3));
 
+						// the textures don't overlap in the atlas, apply their gains in parallel
+						cv::parallel_for_(cv::Range(0, (int)textures.size()), TextureGainsBody(
+								materialsKept,
+								newCamIndex,
+								imageOrigin,
+								emptyImage.size(),
+								cols*rows,
+								gains,
+								gainRGB,
+								globalTextures));
+
 						for(int t=0; t<(int)textures.size(); ++t)
 						{
 							//break;
 							if(materialsKept.at(t))
 							{
-								int u = imageOrigin[t].x;
-								int v = imageOrigin[t].y;
-
 								UDEBUG("Gain cam%d = %f", newCamIndex[t], gainsGray(newCamIndex[t], 0));
 
-								int indexMaterial = newCamIndex[t] / (cols*rows);
-								cv::Mat roi = globalTextures(cv::Rect(u+indexMaterial*globalTextures.rows, v, emptyImage.cols, emptyImage.rows));
-
-								std::vector<cv::Mat> channels;
-								cv::split(roi, channels);
-
-								// assuming BGR
-								cv::multiply(channels[0], gains(newCamIndex[t], gainRGB?3:0), channels[0]);
-								cv::multiply(channels[1], gains(newCamIndex[t], gainRGB?2:0), channels[1]);
-								cv::multiply(channels[2], gains(newCamIndex[t], gainRGB?1:0), channels[2]);
-
-								cv::merge(channels, roi);
-
 								if(gainsOut)
 								{
 									cv::Vec4d g(
@@ -2076,36 +2195,8 @@ cv::Mat mergeTextures(
 							}
 						}
 
-						for(int i=0; i<materials; ++i)
-						{
-							/*std::vector<cv::Mat> channels;
-							cv::split(blendGains, channels);
-							cv::Mat img;
-							channels[0].convertTo(img,CV_8U,128.0,0);
-							cv::imwrite("blendSmallB.png", img);
-							channels[1].convertTo(img,CV_8U,128.0,0);
-							cv::imwrite("blendSmallG.png", img);
-							channels[2].convertTo(img,CV_8U,128.0,0);
-							cv::imwrite("blendSmallR.png", img);*/
-
-							cv::Mat globalTexturesROI = globalTextures(cv::Range::all(), cv::Range(i*globalTextures.rows, (i+1)*globalTextures.rows));
-							cv::Mat dst;
-							cv::blur(blendGains[i], dst, cv::Size(3,3));
-							cv::resize(dst, blendGains[i], globalTexturesROI.size(), 0, 0, cv::INTER_LINEAR);
-
-							/*cv::split(blendGains, channels);
-							channels[0].convertTo(img,CV_8U,128.0,0);
-							cv::imwrite("blendFullB.png", img);
-							channels[1].convertTo(img,CV_8U,128.0,0);
-							cv::imwrite("blendFullG.png", img);
-							channels[2].convertTo(img,CV_8U,128.0,0);
-							cv::imwrite("blendFullR.png", img);*/
-
-							cv::multiply(globalTexturesROI, blendGains[i], globalTexturesROI, 1.0, CV_8UC3);
-
-							//UWARN("Saving blending.png", globalTexture);
-							//cv::imwrite("blending.png", globalTexture);
-						}
+						// one atlas per thread
+						cv::parallel_for_(cv::Range(0, materials), BlendingGainsBody(blendGains, globalTextures), materials);
 
 						if(state) state->callback(uFormat("Blending (decimation=%d) %fs", decimation, timer.ticks()));
 					}
@@ -2555,14 +2646,98 @@ LaserScan computeNormals(
 	return LaserScan();
 }
 
+// cv::parallel_for_ stripes for a maximum number of threads (0=all cores)
+static double normalsStripes(int threads)
+{
+	return threads>0?double(threads):-1.0;
+}
+
+// Same estimation than pcl::NormalEstimation (PCA of the neighborhood, normal
+// oriented toward the view point), but the points are processed in parallel
+// with a shared search tree. Neighbor buffers are allocated once per range.
+template<typename PointT>
+class NormalsBody : public cv::ParallelLoopBody
+{
+public:
+	NormalsBody(
+			const pcl::PointCloud<PointT> & cloud,
+			const pcl::search::KdTree<PointT> & tree,
+			int searchK,
+			float searchRadius,
+			const Eigen::Vector3f & viewPoint,
+			pcl::PointCloud<pcl::Normal> & normals) :
+		cloud_(cloud),
+		tree_(tree),
+		searchK_(searchK),
+		searchRadius_(searchRadius),
+		viewPoint_(viewPoint),
+		normals_(&normals)
+	{}
+
+	virtual void operator()(const cv::Range & range) const
+	{
+		float bad_point = std::numeric_limits<float>::quiet_NaN ();
+		std::vector<int> k_indices(searchK_);
+		std::vector<float> k_sqr_distances(searchK_);
+		Eigen::Matrix3f covariance;
+		Eigen::Vector4f centroid;
+		for(int i=range.start; i<range.end; ++i)
+		{
+			const PointT & pt = cloud_.points[i];
+			pcl::Normal & normal = normals_->points[i];
+			int found = 0;
+			if(cloud_.is_dense || pcl::isFinite(pt))
+			{
+				if(searchRadius_ > 0.0f)
+				{
+					found = tree_.radiusSearch(pt, searchRadius_, k_indices, k_sqr_distances, 0);
+				}
+				else
+				{
+					found = tree_.nearestKSearch(pt, searchK_, k_indices, k_sqr_distances);
+				}
+			}
+			if(found < 3 || pcl::computeMeanAndCovarianceMatrix(cloud_, k_indices, covariance, centroid) == 0)
+			{
+				normal.normal_x = normal.normal_y = normal.normal_z = normal.curvature = bad_point;
+				continue;
+			}
+			pcl::solvePlaneParameters(covariance, normal.normal_x, normal.normal_y, normal.normal_z, normal.curvature);
+			pcl::flipNormalTowardsViewpoint(pt, viewPoint_[0], viewPoint_[1], viewPoint_[2], normal.normal_x, normal.normal_y, normal.normal_z);
+		}
+	}
+
+private:
+	const pcl::PointCloud<PointT> & cloud_;
+	const pcl::search::KdTree<PointT> & tree_;
+	int searchK_;
+	float searchRadius_;
+	Eigen::Vector3f viewPoint_;
+	pcl::PointCloud<pcl::Normal> * normals_;
+};
+
 template<typename PointT>
 pcl::PointCloud<pcl::Normal>::Ptr computeNormalsImpl(
 		const typename pcl::PointCloud<PointT>::Ptr & cloud,
 		const pcl::IndicesPtr & indices,
 		int searchK,
 		float searchRadius,
-		const Eigen::Vector3f & viewPoint)
+		const Eigen::Vector3f & viewPoint,
+		int threads)
 {
+	pcl::PointCloud<pcl::Normal>::Ptr normals (new pcl::PointCloud<pcl::Normal>);
+	if(searchK > 0 && searchRadius > 0.0f)
+	{
+		// same behavior than pcl::NormalEstimation
+		UERROR("Both radius (%f) and K (%d) defined! Set one of them to zero.", searchRadius, searchK);
+		return normals;
+	}
+	if(searchK <= 0 && searchRadius <= 0.0f)
+	{
+		UERROR("Neither radius nor K defined!");
+		return normals;
+	}
+
 	typename pcl::search::KdTree<PointT>::Ptr tree (new pcl::search::KdTree<PointT>);
 	if(indices->size())
 	{
@@ -2573,88 +2748,175 @@ pcl::PointCloud<pcl::Normal>::Ptr computeNormalsImpl(
 		tree->setInputCloud (cloud);
 	}
 
-	// Normal estimation*
-#ifdef PCL_OMP
-	pcl::NormalEstimationOMP<PointT, pcl::Normal> n;
-#else
-	pcl::NormalEstimation<PointT, pcl::Normal> n;
-#endif
-	pcl::PointCloud<pcl::Normal>::Ptr normals (new pcl::PointCloud<pcl::Normal>);
-	n.setInputCloud (cloud);
-	// Commented: Keep the output normals size the same as the input cloud
-	//if(indices->size())
-	//{
-	//	n.setIndices(indices);
-	//}
-	n.setSearchMethod (tree);
-	n.setKSearch (searchK);
-	n.setRadiusSearch (searchRadius);
-	n.setViewPoint(viewPoint[0], viewPoint[1], viewPoint[2]);
-	n.compute (*normals);
+	// Keep the output normals size the same as the input cloud
+	normals->header = cloud->header;
+	normals->resize(cloud->size());
+	normals->width = cloud->width;
+	normals->height = cloud->height;
+	cv::parallel_for_(
+			cv::Range(0, (int)cloud->size()),
+			NormalsBody<PointT>(*cloud, *tree, searchK, searchRadius, viewPoint, *normals),
+			normalsStripes(threads));
 
+	normals->is_dense = true;
+	for(unsigned int i=0; i<normals->size() && normals->is_dense; ++i)
+	{
+		normals->is_dense = uIsFinite(normals->points[i].normal_x);
+	}
 	return normals;
 }
 pcl::PointCloud<pcl::Normal>::Ptr computeNormals(
 		const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud,
 		int searchK,
 		float searchRadius,
-		const Eigen::Vector3f & viewPoint)
+		const Eigen::Vector3f & viewPoint,
+		int threads)
 {
 	pcl::IndicesPtr indices(new std::vector<int>);
-	return computeNormals(cloud, indices, searchK, searchRadius, viewPoint);
+	return computeNormals(cloud, indices, searchK, searchRadius, viewPoint, threads);
 }
 pcl::PointCloud<pcl::Normal>::Ptr computeNormals(
 		const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & cloud,
 		int searchK,
 		float searchRadius,
-		const Eigen::Vector3f & viewPoint)
+		const Eigen::Vector3f & viewPoint,
+		int threads)
 {
 	pcl::IndicesPtr indices(new std::vector<int>);
-	return computeNormals(cloud, indices, searchK, searchRadius, viewPoint);
+	return computeNormals(cloud, indices, searchK, searchRadius, viewPoint, threads);
 }
 pcl::PointCloud<pcl::Normal>::Ptr computeNormals(
 		const pcl::PointCloud<pcl::PointXYZI>::Ptr & cloud,
 		int searchK,
 		float searchRadius,
-		const Eigen::Vector3f & viewPoint)
+		const Eigen::Vector3f & viewPoint,
+		int threads)
 {
 	pcl::IndicesPtr indices(new std::vector<int>);
-	return computeNormals(cloud, indices, searchK, searchRadius, viewPoint);
+	return computeNormals(cloud, indices, searchK, searchRadius, viewPoint, threads);
 }
 pcl::PointCloud<pcl::Normal>::Ptr computeNormals(
 		const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud,
 		const pcl::IndicesPtr & indices,
 		int searchK,
 		float searchRadius,
-		const Eigen::Vector3f & viewPoint)
+		const Eigen::Vector3f & viewPoint,
+		int threads)
 {
-	return computeNormalsImpl<pcl::PointXYZ>(cloud, indices, searchK, searchRadius, viewPoint);
+	return computeNormalsImpl<pcl::PointXYZ>(cloud, indices, searchK, searchRadius, viewPoint, threads);
 }
 pcl::PointCloud<pcl::Normal>::Ptr computeNormals(
 		const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & cloud,
 		const pcl::IndicesPtr & indices,
 		int searchK,
 		float searchRadius,
-		const Eigen::Vector3f & viewPoint)
+		const Eigen::Vector3f & viewPoint,
+		int threads)
 {
-	return computeNormalsImpl<pcl::PointXYZRGB>(cloud, indices, searchK, searchRadius, viewPoint);
+	return computeNormalsImpl<pcl::PointXYZRGB>(cloud, indices, searchK, searchRadius, viewPoint, threads);
 }
 pcl::PointCloud<pcl::Normal>::Ptr computeNormals(
 		const pcl::PointCloud<pcl::PointXYZI>::Ptr & cloud,
 		const pcl::IndicesPtr & indices,
 		int searchK,
 		float searchRadius,
-		const Eigen::Vector3f & viewPoint)
+		const Eigen::Vector3f & viewPoint,
+		int threads)
 {
-	return computeNormalsImpl<pcl::PointXYZI>(cloud, indices, searchK, searchRadius, viewPoint);
+	return computeNormalsImpl<pcl::PointXYZI>(cloud, indices, searchK, searchRadius, viewPoint, threads);
 }
 
+template<typename PointT>
+class Normals2DBody : public cv::ParallelLoopBody
+{
+public:
+	Normals2DBody(
+			const pcl::PointCloud<PointT> & cloud,
+			const pcl::search::KdTree<PointT> & tree,
+			int searchK,
+			float searchRadius,
+			const Eigen::Vector3f & viewPoint,
+			pcl::PointCloud<pcl::Normal> & normals) :
+		cloud_(cloud),
+		tree_(tree),
+		searchK_(searchK),
+		searchRadius_(searchRadius),
+		viewPoint_(viewPoint),
+		normals_(&normals)
+	{}
+
+	virtual void operator()(const cv::Range & range) const
+	{
+		float bad_point = std::numeric_limits<float>::quiet_NaN ();
+		std::vector<int> k_indices(searchK_>0?searchK_:0);
+		std::vector<float> k_sqr_distances(searchK_>0?searchK_:0);
+		for(int i=range.start; i<range.end; ++i)
+		{
+			const PointT & pt = cloud_.at(i);
+			Eigen::Vector3f direction;
+			direction[0] = viewPoint_[0] - pt.x;
+			direction[1] = viewPoint_[1] - pt.y;
+			direction[2] = viewPoint_[2] - pt.z;
+
+			if(searchRadius_>0.0f)
+			{
+				tree_.radiusSearch(pt, searchRadius_, k_indices, k_sqr_distances, searchK_);
+			}
+			else
+			{
+				tree_.nearestKSearch(pt, searchK_, k_indices, k_sqr_distances);
+			}
+
+			Eigen::Vector3f meanNormal(0,0,0);
+			int neighbors = 0;
+			for(unsigned int j=0; j<k_indices.size(); ++j)
+			{
+				if(k_indices.at(j) != i)
+				{
+					const PointT & pt2 = cloud_.at(k_indices.at(j));
+					Eigen::Vector3f v(pt2.x-pt.x, pt2.y - pt.y, pt2.z - pt.z);
+					Eigen::Vector3f up = v.cross(direction);
+					Eigen::Vector3f n = up.cross(v);
+					n.normalize();
+					meanNormal += n;
+					++neighbors;
+				}
+			}
+
+			pcl::Normal & normal = normals_->at(i);
+			if(neighbors == 0)
+			{
+				normal.normal_x = bad_point;
+				normal.normal_y = bad_point;
+				normal.normal_z = bad_point;
+			}
+			else
+			{
+				meanNormal /= (float)neighbors;
+				meanNormal.normalize();
+				normal.normal_x = meanNormal[0];
+				normal.normal_y = meanNormal[1];
+				normal.normal_z = meanNormal[2];
+			}
+		}
+	}
+
+private:
+	const pcl::PointCloud<PointT> & cloud_;
+	const pcl::search::KdTree<PointT> & tree_;
+	int searchK_;
+	float searchRadius_;
+	Eigen::Vector3f viewPoint_;
+	pcl::PointCloud<pcl::Normal> * normals_;
+};
+
 template<typename PointT>
 pcl::PointCloud<pcl::Normal>::Ptr computeNormals2DImpl(
 		const typename pcl::PointCloud<PointT>::Ptr & cloud,
 		int searchK,
 		float searchRadius,
-		const Eigen::Vector3f & viewPoint)
+		const Eigen::Vector3f & viewPoint,
+		int threads)
 {
 	UASSERT(searchK>0 || searchRadius>0.0f);
 	pcl::PointCloud<pcl::Normal>::Ptr normals (new pcl::PointCloud<pcl::Normal>);
@@ -2664,62 +2926,11 @@ pcl::PointCloud<pcl::Normal>::Ptr computeNormals2DImpl(
 
 	normals->resize(cloud->size());
 
-	float bad_point = std::numeric_limits<float>::quiet_NaN ();
-
 	// assuming that points are ordered
-	for(unsigned int i=0; i<cloud->size(); ++i)
-	{
-		const PointT & pt = cloud->at(i);
-		std::vector<Eigen::Vector3f> neighborNormals;
-		Eigen::Vector3f direction;
-		direction[0] = viewPoint[0] - pt.x;
-		direction[1] = viewPoint[1] - pt.y;
-		direction[2] = viewPoint[2] - pt.z;
-
-		std::vector<int> k_indices;
-		std::vector<float> k_sqr_distances;
-		if(searchRadius>0.0f)
-		{
-			tree->radiusSearch(cloud->at(i), searchRadius, k_indices, k_sqr_distances, searchK);
-		}
-		else
-		{
-			tree->nearestKSearch(cloud->at(i), searchK, k_indices, k_sqr_distances);
-		}
-
-		for(unsigned int j=0; j<k_indices.size(); ++j)
-		{
-			if(k_indices.at(j) != (int)i)
-			{
-				const PointT & pt2 = cloud->at(k_indices.at(j));
-				Eigen::Vector3f v(pt2.x-pt.x, pt2.y - pt.y, pt2.z - pt.z);
-				Eigen::Vector3f up = v.cross(direction);
-				Eigen::Vector3f n = up.cross(v);
-				n.normalize();
-				neighborNormals.push_back(n);
-			}
-		}
-
-		if(neighborNormals.empty())
-		{
-			normals->at(i).normal_x = bad_point;
-			normals->at(i).normal_y = bad_point;
-			normals->at(i).normal_z = bad_point;
-		}
-		else
-		{
-			Eigen::Vector3f meanNormal(0,0,0);
-			for(unsigned int j=0; j<neighborNormals.size(); ++j)
-			{
-				meanNormal+=neighborNormals[j];
-			}
-			meanNormal /= (float)neighborNormals.size();
-			meanNormal.normalize();
-			normals->at(i).normal_x = meanNormal[0];
-			normals->at(i).normal_y = meanNormal[1];
-			normals->at(i).normal_z = meanNormal[2];
-		}
-	}
+	cv::parallel_for_(
+			cv::Range(0, (int)cloud->size()),
+			Normals2DBody<PointT>(*cloud, *tree, searchK, searchRadius, viewPoint, *normals),
+			normalsStripes(threads));
 
 	return normals;
 }
@@ -2727,111 +2938,145 @@ pcl::PointCloud<pcl::Normal>::Ptr computeNormals2D(
 		const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud,
 		int searchK,
 		float searchRadius,
-		const Eigen::Vector3f & viewPoint)
+		const Eigen::Vector3f & viewPoint,
+		int threads)
 {
-	return computeNormals2DImpl<pcl::PointXYZ>(cloud, searchK, searchRadius, viewPoint);
+	return computeNormals2DImpl<pcl::PointXYZ>(cloud, searchK, searchRadius, viewPoint, threads);
 }
 pcl::PointCloud<pcl::Normal>::Ptr computeNormals2D(
 		const pcl::PointCloud<pcl::PointXYZI>::Ptr & cloud,
 		int searchK,
 		float searchRadius,
-		const Eigen::Vector3f & viewPoint)
+		const Eigen::Vector3f & viewPoint,
+		int threads)
 {
-	return computeNormals2DImpl<pcl::PointXYZI>(cloud, searchK, searchRadius, viewPoint);
+	return computeNormals2DImpl<pcl::PointXYZI>(cloud, searchK, searchRadius, viewPoint, threads);
 }
 
 template<typename PointT>
-pcl::PointCloud<pcl::Normal>::Ptr computeFastOrganizedNormals2DImpl(
-		const typename pcl::PointCloud<PointT>::Ptr & cloud,
-		int searchK,
-		float searchRadius,
-		const Eigen::Vector3f & viewPoint)
+class FastOrganizedNormals2DBody : public cv::ParallelLoopBody
 {
-	UASSERT(searchK>0);
-	pcl::PointCloud<pcl::Normal>::Ptr normals (new pcl::PointCloud<pcl::Normal>);
-
-	normals->resize(cloud->size());
-	searchRadius *= searchRadius; // squared distance
-
-	float bad_point = std::numeric_limits<float>::quiet_NaN ();
+public:
+	FastOrganizedNormals2DBody(
+			const pcl::PointCloud<PointT> & cloud,
+			int searchK,
+			float searchRadiusSqrd,
+			const Eigen::Vector3f & viewPoint,
+			pcl::PointCloud<pcl::Normal> & normals) :
+		cloud_(cloud),
+		searchK_(searchK),
+		searchRadiusSqrd_(searchRadiusSqrd),
+		viewPoint_(viewPoint),
+		normals_(&normals)
+	{}
 
-	// assuming that points are ordered
-	for(int i=0; i<(int)cloud->size(); ++i)
+	virtual void operator()(const cv::Range & range) const
 	{
-		int li = i-searchK;
-		if(li<0)
-		{
-			li=0;
-		}
-		int hi = i+searchK;
-		if(hi>=(int)cloud->size())
-		{
-			hi=(int)cloud->size()-1;
-		}
-
-		// get points before not too far
-		const PointT & pt = cloud->at(i);
-		std::vector<Eigen::Vector3f> neighborNormals;
-		Eigen::Vector3f direction;
-		direction[0] = viewPoint[0] - cloud->at(i).x;
-		direction[1] = viewPoint[1] - cloud->at(i).y;
-		direction[2] = viewPoint[2] - cloud->at(i).z;
-		for(int j=i-1; j>=li; --j)
+		float bad_point = std::numeric_limits<float>::quiet_NaN ();
+		for(int i=range.start; i<range.end; ++i)
 		{
-			const PointT & pt2 = cloud->at(j);
-			Eigen::Vector3f vd(pt2.x-pt.x, pt2.y - pt.y, pt2.z - pt.z);
-			if(searchRadius<=0.0f || (vd[0]*vd[0] + vd[1]*vd[1] + vd[2]*vd[2]) < searchRadius)
+			int li = i-searchK_;
+			if(li<0)
 			{
-				Eigen::Vector3f v(pt2.x-pt.x, pt2.y - pt.y, pt2.z - pt.z);
-				Eigen::Vector3f up = v.cross(direction);
-				Eigen::Vector3f n = up.cross(v);
-				n.normalize();
-				neighborNormals.push_back(n);
+				li=0;
 			}
-			else
+			int hi = i+searchK_;
+			if(hi>=(int)cloud_.size())
 			{
-				break;
+				hi=(int)cloud_.size()-1;
 			}
-		}
-		for(int j=i+1; j<=hi; ++j)
-		{
-			const PointT & pt2 = cloud->at(j);
-			Eigen::Vector3f vd(pt2.x-pt.x, pt2.y - pt.y, pt2.z - pt.z);
-			if(searchRadius<=0.0f || (vd[0]*vd[0] + vd[1]*vd[1] + vd[2]*vd[2]) < searchRadius)
-			{
-				Eigen::Vector3f v(pt2.x-pt.x, pt2.y - pt.y, pt2.z - pt.z);
-				Eigen::Vector3f up = v[2]==0.0f?Eigen::Vector3f(0,0,1):v.cross(direction);
-				Eigen::Vector3f n = up.cross(v);
-				n.normalize();
-				neighborNormals.push_back(n);
+
+			// get points before not too far
+			const PointT & pt = cloud_.at(i);
+			Eigen::Vector3f meanNormal(0,0,0);
+			int neighbors = 0;
+			Eigen::Vector3f direction;
+			direction[0] = viewPoint_[0] - pt.x;
+			direction[1] = viewPoint_[1] - pt.y;
+			direction[2] = viewPoint_[2] - pt.z;
+			for(int j=i-1; j>=li; --j)
+			{
+				const PointT & pt2 = cloud_.at(j);
+				Eigen::Vector3f vd(pt2.x-pt.x, pt2.y - pt.y, pt2.z - pt.z);
+				if(searchRadiusSqrd_<=0.0f || (vd[0]*vd[0] + vd[1]*vd[1] + vd[2]*vd[2]) < searchRadiusSqrd_)
+				{
+					Eigen::Vector3f v(pt2.x-pt.x, pt2.y - pt.y, pt2.z - pt.z);
+					Eigen::Vector3f up = v.cross(direction);
+					Eigen::Vector3f n = up.cross(v);
+					n.normalize();
+					meanNormal += n;
+					++neighbors;
+				}
+				else
+				{
+					break;
+				}
 			}
-			else
+			for(int j=i+1; j<=hi; ++j)
 			{
-				break;
+				const PointT & pt2 = cloud_.at(j);
+				Eigen::Vector3f vd(pt2.x-pt.x, pt2.y - pt.y, pt2.z - pt.z);
+				if(searchRadiusSqrd_<=0.0f || (vd[0]*vd[0] + vd[1]*vd[1] + vd[2]*vd[2]) < searchRadiusSqrd_)
+				{
+					Eigen::Vector3f v(pt2.x-pt.x, pt2.y - pt.y, pt2.z - pt.z);
+					Eigen::Vector3f up = v[2]==0.0f?Eigen::Vector3f(0,0,1):v.cross(direction);
+					Eigen::Vector3f n = up.cross(v);
+					n.normalize();
+					meanNormal += n;
+					++neighbors;
+				}
+				else
+				{
+					break;
+				}
 			}
-		}
 
-		if(neighborNormals.empty())
-		{
-			normals->at(i).normal_x = bad_point;
-			normals->at(i).normal_y = bad_point;
-			normals->at(i).normal_z = bad_point;
-		}
-		else
-		{
-			Eigen::Vector3f meanNormal(0,0,0);
-			for(unsigned int j=0; j<neighborNormals.size(); ++j)
+			pcl::Normal & normal = normals_->at(i);
+			if(neighbors == 0)
 			{
-				meanNormal+=neighborNormals[j];
+				normal.normal_x = bad_point;
+				normal.normal_y = bad_point;
+				normal.normal_z = bad_point;
+			}
+			else
+			{
+				meanNormal /= (float)neighbors;
+				meanNormal.normalize();
+				normal.normal_x = meanNormal[0];
+				normal.normal_y = meanNormal[1];
+				normal.normal_z = meanNormal[2];
 			}
-			meanNormal /= (float)neighborNormals.size();
-			meanNormal.normalize();
-			normals->at(i).normal_x = meanNormal[0];
-			normals->at(i).normal_y = meanNormal[1];
-			normals->at(i).normal_z = meanNormal[2];
 		}
 	}
 
+private:
+	const pcl::PointCloud<PointT> & cloud_;
+	int searchK_;
+	float searchRadiusSqrd_;
+	Eigen::Vector3f viewPoint_;
+	pcl::PointCloud<pcl::Normal> * normals_;
+};
+
+template<typename PointT>
+pcl::PointCloud<pcl::Normal>::Ptr computeFastOrganizedNormals2DImpl(
+		const typename pcl::PointCloud<PointT>::Ptr & cloud,
+		int searchK,
+		float searchRadius,
+		const Eigen::Vector3f & viewPoint,
+		int threads)
+{
+	UASSERT(searchK>0);
+	pcl::PointCloud<pcl::Normal>::Ptr normals (new pcl::PointCloud<pcl::Normal>);
+
+	normals->resize(cloud->size());
+	searchRadius *= searchRadius; // squared distance
+
+	// assuming that points are ordered
+	cv::parallel_for_(
+			cv::Range(0, (int)cloud->size()),
+			FastOrganizedNormals2DBody<PointT>(*cloud, searchK, searchRadius, viewPoint, *normals),
+			normalsStripes(threads));
+
 	return normals;
 }
 
@@ -2839,17 +3084,19 @@ pcl::PointCloud<pcl::Normal>::Ptr computeFastOrganizedNormals2D(
 		const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud,
 		int searchK,
 		float searchRadius,
-		const Eigen::Vector3f & viewPoint)
+		const Eigen::Vector3f & viewPoint,
+		int threads)
 {
-	return computeFastOrganizedNormals2DImpl<pcl::PointXYZ>(cloud, searchK, searchRadius, viewPoint);
+	return computeFastOrganizedNormals2DImpl<pcl::PointXYZ>(cloud, searchK, searchRadius, viewPoint, threads);
 }
 pcl::PointCloud<pcl::Normal>::Ptr computeFastOrganizedNormals2D(
 		const pcl::PointCloud<pcl::PointXYZI>::Ptr & cloud,
 		int searchK,
 		float searchRadius,
-		const Eigen::Vector3f & viewPoint)
+		const Eigen::Vector3f & viewPoint,
+		int threads)
 {
-	return computeFastOrganizedNormals2DImpl<pcl::PointXYZI>(cloud, searchK, searchRadius, viewPoint);
+	return computeFastOrganizedNormals2DImpl<pcl::PointXYZI>(cloud, searchK, searchRadius, viewPoint, threads);
 }
 
 pcl::PointCloud<pcl::Normal>::Ptr computeFastOrganizedNormals(
@@ -193,6 +193,12 @@ int main(int argc, char * argv[])
 	// odometry and RTAB-Map.
 	UEventsManager::createPipe(&cameraThread, &odomThread, "CameraEvent");
 
+	// Odometry only buffers the camera data in its handleEvent(), it can then be
+	// called directly from the camera thread instead of the UEventsManager's thread.
+	UEventsManager::subscribe(&odomThread, "CameraEvent", UEventsManager::kDeliveryDirect);
+	UEventsManager::subscribe(&odomThread, "IMUEvent", UEventsManager::kDeliveryDirect);
+	UEventsManager::subscribe(&odomThread, "OdometryResetEvent");
+
 	// Let's start the threads
 	rtabmapThread.start();
 	odomThread.start();
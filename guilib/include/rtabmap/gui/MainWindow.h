@@ -162,6 +162,8 @@ protected Q_SLOTS:
 	void exportOctomap();
 	void postProcessing();
 	void depthCalibration();
+	void recordTrace(bool started);
+	void saveTrace();
 	void openWorkingDirectory();
 	void updateEditMenu();
 	void selectStream();
@@ -353,6 +355,11 @@ private:
 	std::map<int, LaserScan> _createdScans;
 
 	rtabmap::OccupancyGrid * _occupancyGrid;
+	int _gridTilesVersion;
+	cv::Mat _gridMap8U; // converted tiles of _occupancyGrid, only grown when new tiles are outside
+	cv::Rect _gridTilesRoi; // tiles (<column, row>) covered by _gridMap8U
+	float _gridXMin;
+	float _gridYMin;
 	rtabmap::OctoMap * _octomap;
 
 	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr> _createdFeatures;
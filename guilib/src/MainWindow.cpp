@@ -44,6 +44,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/OccupancyGrid.h"
 #include "rtabmap/core/GainCompensator.h"
 #include "rtabmap/core/Recovery.h"
+#include "rtabmap/core/Trace.h"
 #include "rtabmap/core/util2d.h"
 
 #include "rtabmap/gui/ImageView.h"
@@ -123,6 +124,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #endif
 
 #define LOG_FILE_NAME "LogRtabmap.txt"
+#define LOG_BINARY_FILE_NAME "LogRtabmap.bin"
 #define SHARE_SHOW_LOG_FILE "share/rtabmap/showlogs.m"
 #define SHARE_GET_PRECISION_RECALL_FILE "share/rtabmap/getPrecisionRecall.m"
 #define SHARE_IMPORT_FILE   "share/rtabmap/importfile.m"
@@ -163,6 +165,9 @@ MainWindow::MainWindow(PreferencesDialog * prefDialog, QWidget * parent, bool sh
 	_cachedMemoryUsage(0),
 	_createdCloudsMemoryUsage(0),
 	_occupancyGrid(0),
+	_gridTilesVersion(0),
+	_gridXMin(0.0f),
+	_gridYMin(0.0f),
 	_octomap(0),
 	_odometryCorrection(Transform::getIdentity()),
 	_processingOdometry(false),
@@ -339,6 +344,14 @@ MainWindow::MainWindow(PreferencesDialog * prefDialog, QWidget * parent, bool sh
 	statusBarAction->setCheckable(true);
 	statusBarAction->setChecked(statusBarShown);
 	connect(statusBarAction, SIGNAL(toggled(bool)), this->statusBar(), SLOT(setVisible(bool)));
+#ifdef RTABMAP_TRACING
+	_ui->menuAdvanced->addSeparator();
+	QAction * traceAction = _ui->menuAdvanced->addAction(tr("Record trace"));
+	traceAction->setCheckable(true);
+	connect(traceAction, SIGNAL(toggled(bool)), this, SLOT(recordTrace(bool)));
+	QAction * saveTraceAction = _ui->menuAdvanced->addAction(tr("Save trace..."));
+	connect(saveTraceAction, SIGNAL(triggered()), this, SLOT(saveTrace()));
+#endif
 
 	// connect actions with custom slots
 	connect(_ui->actionSave_GUI_config, SIGNAL(triggered()), this, SLOT(saveConfigGUI()));
@@ -958,6 +971,8 @@ void MainWindow::processCameraInfo(const rtabmap::CameraInfo & info)
 	_ui->statsToolBox->updateStat("Camera/Time mirroring/ms", _preferencesDialog->isTimeUsedInFigures()?info.stamp-_firstStamp:(float)info.id, info.timeMirroring*1000.0f, _preferencesDialog->isCacheSavedInFigures());
 	_ui->statsToolBox->updateStat("Camera/Time exposure compensation/ms", _preferencesDialog->isTimeUsedInFigures()?info.stamp-_firstStamp:(float)info.id, info.timeStereoExposureCompensation*1000.0f, _preferencesDialog->isCacheSavedInFigures());
 	_ui->statsToolBox->updateStat("Camera/Time scan from depth/ms", _preferencesDialog->isTimeUsedInFigures()?info.stamp-_firstStamp:(float)info.id, info.timeScanFromDepth*1000.0f, _preferencesDialog->isCacheSavedInFigures());
+	_ui->statsToolBox->updateStat("Camera/Time scan filtering/ms", _preferencesDialog->isTimeUsedInFigures()?info.stamp-_firstStamp:(float)info.id, info.timeScanFiltering*1000.0f, _preferencesDialog->isCacheSavedInFigures());
+	_ui->statsToolBox->updateStat("Camera/Time IMU filtering/ms", _preferencesDialog->isTimeUsedInFigures()?info.stamp-_firstStamp:(float)info.id, info.timeImuFiltering*1000.0f, _preferencesDialog->isCacheSavedInFigures());
 
 	Q_EMIT(cameraInfoProcessed());
 }
@@ -2798,13 +2813,88 @@ void MainWindow::updateMapCloud(
 			{
 				stats->insert(std::make_pair("GUI/Grid Update/ms", (float)timer.restart()*1000.0f));
 			}
-			map8S = _occupancyGrid->getMap(xMin, yMin);
+			if(_occupancyGrid->getTileSize() > 0 && !_occupancyGrid->isEroded())
+			{
+				// Convert only the tiles modified since last time instead of the whole map
+				if(_gridMap8U.empty() || _gridTilesVersion != _occupancyGrid->getMapVersion())
+				{
+					float tilesXMin, tilesYMin;
+					bool reset = false;
+					std::list<std::pair<int, int> > removedTiles;
+					std::map<std::pair<int, int>, cv::Mat> tiles = _occupancyGrid->getMapTiles(_gridTilesVersion, tilesXMin, tilesYMin, &removedTiles, &reset);
+					_gridTilesVersion = _occupancyGrid->getMapVersion();
+					if(reset)
+					{
+						_gridMap8U = cv::Mat();
+						_gridTilesRoi = cv::Rect();
+					}
+
+					int tileSize = _occupancyGrid->getTileSize();
+					unsigned char unknown = util3d::convertMap2Image8U(cv::Mat(1, 1, CV_8SC1, cv::Scalar(-1))).at<unsigned char>(0, 0);
+					if(!tiles.empty())
+					{
+						int colMin = tiles.begin()->first.first;
+						int colMax = colMin;
+						int rowMin = tiles.begin()->first.second;
+						int rowMax = rowMin;
+						for(std::map<std::pair<int, int>, cv::Mat>::iterator iter=tiles.begin(); iter!=tiles.end(); ++iter)
+						{
+							colMin = std::min(colMin, iter->first.first);
+							colMax = std::max(colMax, iter->first.first);
+							rowMin = std::min(rowMin, iter->first.second);
+							rowMax = std::max(rowMax, iter->first.second);
+						}
+						cv::Rect roi(colMin, rowMin, colMax-colMin+1, rowMax-rowMin+1);
+						if(!_gridMap8U.empty())
+						{
+							roi |= _gridTilesRoi;
+						}
+						if(_gridMap8U.empty() || roi != _gridTilesRoi)
+						{
+							// Grow the image, the tiles already converted are kept
+							cv::Mat map(roi.height*tileSize, roi.width*tileSize, CV_8UC1, cv::Scalar(unknown));
+							if(!_gridMap8U.empty())
+							{
+								_gridMap8U.copyTo(map(cv::Rect((_gridTilesRoi.x-roi.x)*tileSize, (_gridTilesRoi.y-roi.y)*tileSize, _gridMap8U.cols, _gridMap8U.rows)));
+							}
+							_gridMap8U = map;
+							_gridTilesRoi = roi;
+						}
+					}
+					if(!_gridMap8U.empty())
+					{
+						for(std::list<std::pair<int, int> >::iterator iter=removedTiles.begin(); iter!=removedTiles.end(); ++iter)
+						{
+							if(_gridTilesRoi.contains(cv::Point(iter->first, iter->second)))
+							{
+								_gridMap8U(cv::Rect((iter->first-_gridTilesRoi.x)*tileSize, (iter->second-_gridTilesRoi.y)*tileSize, tileSize, tileSize)).setTo(unknown);
+							}
+						}
+						for(std::map<std::pair<int, int>, cv::Mat>::iterator iter=tiles.begin(); iter!=tiles.end(); ++iter)
+						{
+							cv::Mat tile8U = _gridMap8U(cv::Rect((iter->first.first-_gridTilesRoi.x)*tileSize, (iter->first.second-_gridTilesRoi.y)*tileSize, tileSize, tileSize));
+							util3d::convertMap2Image8U(iter->second, tile8U);
+						}
+						_gridXMin = tilesXMin + float(_gridTilesRoi.x*tileSize)*resolution;
+						_gridYMin = tilesYMin + float(_gridTilesRoi.y*tileSize)*resolution;
+					}
+				}
+				map8U = _gridMap8U;
+				xMin = _gridXMin;
+				yMin = _gridYMin;
+			}
+			else
+			{
+				map8S = _occupancyGrid->getMap(xMin, yMin);
+			}
 		}
 		if(!map8S.empty())
 		{
 			//convert to gray scaled map
 			map8U = util3d::convertMap2Image8U(map8S);
-
+		}
+		if(!map8U.empty())
+		{
 			if(_preferencesDialog->getGridMapShown())
 			{
 				float opacity = _preferencesDialog->getGridMapOpacity();
@@ -4205,7 +4295,8 @@ void MainWindow::applyPrefSettings(PreferencesDialog::PANEL_FLAGS flags)
 		ULogger::setLevel((ULogger::Level)_preferencesDialog->getGeneralLoggerLevel());
 		ULogger::setEventLevel((ULogger::Level)_preferencesDialog->getGeneralLoggerEventLevel());
 		ULogger::setType((ULogger::Type)_preferencesDialog->getGeneralLoggerType(),
-						 (_preferencesDialog->getWorkingDirectory()+QDir::separator()+LOG_FILE_NAME).toStdString(), true);
+						 (_preferencesDialog->getWorkingDirectory()+QDir::separator()+
+						  (_preferencesDialog->getGeneralLoggerType()==ULogger::kTypeBinaryFile?LOG_BINARY_FILE_NAME:LOG_FILE_NAME)).toStdString(), true);
 		ULogger::setPrintTime(_preferencesDialog->getGeneralLoggerPrintTime());
 		ULogger::setPrintThreadId(_preferencesDialog->getGeneralLoggerPrintThreadId());
 		ULogger::setTreadIdFilter(_preferencesDialog->getGeneralLoggerThreads());
@@ -6193,6 +6284,35 @@ QString MainWindow::getWorkingDirectory() const
 	return _preferencesDialog->getWorkingDirectory();
 }
 
+void MainWindow::recordTrace(bool started)
+{
+	if(started)
+	{
+		Trace::clear();
+		Trace::start();
+	}
+	else
+	{
+		Trace::stop();
+	}
+}
+
+void MainWindow::saveTrace()
+{
+	QString path = QFileDialog::getSaveFileName(this, tr("Save trace"), _preferencesDialog->getWorkingDirectory()+QDir::separator()+QString("trace.json"), tr("Chrome trace files (*.json)"));
+	if(!path.isEmpty())
+	{
+		if(Trace::save(path.toStdString()))
+		{
+			UINFO("Saved %d trace events (%d dropped) to \"%s\"", Trace::events(), Trace::droppedEvents(), path.toStdString().c_str());
+		}
+		else
+		{
+			QMessageBox::warning(this, tr("Save trace"), tr("Failed to save the trace to \"%1\".").arg(path));
+		}
+	}
+}
+
 void MainWindow::openWorkingDirectory()
 {
 	QString filePath = _preferencesDialog->getWorkingDirectory();
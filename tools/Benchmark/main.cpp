@@ -0,0 +1,589 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <rtabmap/core/Rtabmap.h>
+#include <rtabmap/core/DBDriver.h>
+#include <rtabmap/core/DBReader.h>
+#include <rtabmap/core/Odometry.h>
+#include <rtabmap/core/OdometryInfo.h>
+#include <rtabmap/core/Version.h>
+#include <rtabmap/utilite/UFile.h>
+#include <rtabmap/utilite/UDirectory.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <rtabmap/utilite/UMath.h>
+#include <rtabmap/utilite/UProcessInfo.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <algorithm>
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("\nUsage:\n"
+			"   rtabmap-benchmark [options] \"input.db\"\n"
+			"   rtabmap-benchmark [options] \"input1.db;input2.db;input3.db\"\n"
+			"   Replay the databases as fast as possible (no rate limiter, no read-ahead)\n"
+			"   and report per-stage latency percentiles, peak RSS and output database size\n"
+			"   for each configuration of the parameter matrix. Only parameters from the\n"
+			"   first database are used as base configuration.\n"
+			"  Options:\n"
+			"     --output \"path.json\"  Results file (default \"benchmark.json\").\n"
+			"     --matrix \"Key:v1,v2\"  Values to benchmark for a parameter, can be set\n"
+			"                           more than once. All combinations are run.\n"
+			"                           Example: --matrix \"Kp/MaxFeatures:200,500\"\n"
+			"     --repeat #            Number of runs per configuration (default 1).\n"
+			"     --frames #            Maximum frames processed per run (default 0, all).\n"
+			"     --warmup #            First frames of each run not included in the\n"
+			"                           statistics (default 0).\n"
+			"     --odom                Recompute odometry instead of using the poses\n"
+			"                           saved in the database (odometry timings are then\n"
+			"                           included in the statistics).\n"
+			"     --keep_db             Keep the output database of the last run.\n"
+			"     -c \"path.ini\"         Configuration file, overwriting parameters read \n"
+			"                           from the database. If custom parameters are also set as \n"
+			"                           arguments, they overwrite those in config file and the database.\n"
+			"   Unless explicitly set, %s is set to 0 so that memory\n"
+			"   management doesn't depend on processing time and runs are reproducible.\n"
+			"%s\n"
+			"\n", Parameters::kRtabmapTimeThr().c_str(), Parameters::showUsage());
+	exit(1);
+}
+
+// catch ctrl-c
+bool g_loopForever = true;
+void sighandler(int sig)
+{
+	printf("\nSignal %d caught...\n", sig);
+	g_loopForever = false;
+}
+
+// nearest-rank percentile, values should be sorted
+float percentile(const std::vector<float> & values, float p)
+{
+	if(values.empty())
+	{
+		return 0.0f;
+	}
+	int rank = (int)ceil(p/100.0f * float(values.size()));
+	return values[std::max(0, std::min(rank-1, (int)values.size()-1))];
+}
+
+std::string jsonString(const std::string & str)
+{
+	std::string out = "\"";
+	for(unsigned int i=0; i<str.size(); ++i)
+	{
+		if(str[i] == '"' || str[i] == '\\')
+		{
+			out += '\\';
+			out += str[i];
+		}
+		else if((unsigned char)str[i] < 0x20)
+		{
+			out += uFormat("\\u%04x", (int)str[i]);
+		}
+		else
+		{
+			out += str[i];
+		}
+	}
+	return out + "\"";
+}
+
+struct RunResult
+{
+	RunResult() :
+		frames(0),
+		failures(0),
+		wallTime(0.0),
+		peakRSS(0),
+		processPeakRSS(0),
+		dbSize(0)
+	{}
+	int frames;
+	int failures;
+	double wallTime;
+	long peakRSS;
+	long processPeakRSS;
+	long dbSize;
+};
+
+struct ConfigResult
+{
+	ParametersMap parameters;
+	std::vector<RunResult> runs;
+	std::map<std::string, std::vector<float> > samples; // stage name, latencies (ms) of all runs
+};
+
+RunResult run(
+		const std::list<std::string> & databases,
+		const ParametersMap & parameters,
+		const std::string & outputDatabasePath,
+		bool recomputeOdometry,
+		int maxFrames,
+		int warmupFrames,
+		std::map<std::string, std::vector<float> > & samples)
+{
+	RunResult result;
+
+	if(UFile::exists(outputDatabasePath))
+	{
+		UFile::erase(outputDatabasePath);
+	}
+
+	bool incrementalMemory = Parameters::defaultMemIncrementalMemory();
+	Parameters::parse(parameters, Parameters::kMemIncrementalMemory(), incrementalMemory);
+	std::list<std::string> inputs = databases;
+	if(!incrementalMemory && inputs.size() > 1)
+	{
+		// localization: initialize with the first database
+		UFile::copy(inputs.front(), outputDatabasePath);
+		inputs.pop_front();
+	}
+
+	bool rgbdEnabled = Parameters::defaultRGBDEnabled();
+	Parameters::parse(parameters, Parameters::kRGBDEnabled(), rgbdEnabled);
+	bool odometryIgnored = !rgbdEnabled || recomputeOdometry;
+
+	Rtabmap rtabmap;
+	rtabmap.init(parameters, outputDatabasePath);
+
+	Odometry * odom = 0;
+	if(recomputeOdometry && rgbdEnabled)
+	{
+		ParametersMap odomParameters = parameters;
+		odomParameters.erase(Parameters::kRtabmapPublishRAMUsage()); // as odometry is in the same process than rtabmap, don't get RAM usage in odometry.
+		odom = Odometry::create(odomParameters);
+	}
+
+	// frame rate 0: no rate limiter, as fast as possible
+	DBReader dbReader(inputs, 0, odometryIgnored);
+	dbReader.init();
+
+	UTimer wallTimer;
+	CameraInfo info;
+	SensorData data = dbReader.takeImage(&info);
+	while(data.isValid() && g_loopForever && (maxFrames <= 0 || result.frames < maxFrames))
+	{
+		std::map<std::string, float> frameTimings;
+
+		Transform pose = info.odomPose;
+		cv::Mat covariance = info.odomCovariance;
+		std::vector<float> velocity = info.odomVelocity;
+		if(odom)
+		{
+			OdometryInfo odomInfo;
+			UTimer odomTimer;
+			pose = odom->process(data, &odomInfo);
+			frameTimings.insert(std::make_pair(std::string("Odometry/Total/ms"), float(odomTimer.ticks()*1000.0)));
+			frameTimings.insert(std::make_pair(std::string("Odometry/Estimation/ms"), odomInfo.timeEstimation*1000.0f));
+			covariance = odomInfo.reg.covariance;
+			velocity.clear();
+			if(odomInfo.lost && !pose.isNull())
+			{
+				pose.setNull();
+			}
+		}
+
+		if(!pose.isNull() || !rgbdEnabled)
+		{
+			if(!odom && !covariance.empty() && covariance.at<double>(0,0)>=9999 && incrementalMemory)
+			{
+				rtabmap.triggerNewMap();
+			}
+			UTimer processTimer;
+			if(covariance.empty())
+			{
+				covariance = cv::Mat::eye(6,6,CV_64FC1);
+			}
+			if(!rtabmap.process(data, pose, covariance, velocity))
+			{
+				++result.failures;
+			}
+			frameTimings.insert(std::make_pair(std::string("Rtabmap/Process/ms"), float(processTimer.ticks()*1000.0)));
+
+			const std::map<std::string, float> & stats = rtabmap.getStatistics().data();
+			for(std::map<std::string, float>::const_iterator iter=stats.begin(); iter!=stats.end(); ++iter)
+			{
+				if(iter->first.compare(0, 6, "Timing") == 0)
+				{
+					frameTimings.insert(*iter);
+				}
+			}
+		}
+
+		long rss = UProcessInfo::getMemoryUsage();
+		if(rss > result.peakRSS)
+		{
+			result.peakRSS = rss;
+		}
+
+		if(result.frames >= warmupFrames)
+		{
+			for(std::map<std::string, float>::iterator iter=frameTimings.begin(); iter!=frameTimings.end(); ++iter)
+			{
+				samples[iter->first].push_back(iter->second);
+			}
+		}
+		++result.frames;
+
+		data = dbReader.takeImage(&info);
+	}
+	result.wallTime = wallTimer.ticks();
+	delete odom;
+
+	rtabmap.close(true);
+	result.processPeakRSS = UProcessInfo::getPeakMemoryUsage();
+	result.dbSize = UFile::length(outputDatabasePath);
+
+	return result;
+}
+
+int main(int argc, char * argv[])
+{
+	signal(SIGABRT, &sighandler);
+	signal(SIGTERM, &sighandler);
+	signal(SIGINT, &sighandler);
+
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kError);
+
+	ParametersMap customParameters = Parameters::parseArguments(argc, argv);
+
+	if(argc < 2)
+	{
+		showUsage();
+	}
+
+	std::string outputPath = "benchmark.json";
+	std::list<std::pair<std::string, std::vector<std::string> > > matrix;
+	int repeat = 1;
+	int maxFrames = 0;
+	int warmupFrames = 0;
+	bool recomputeOdometry = false;
+	bool keepDatabase = false;
+	ParametersMap configParameters;
+	for(int i=1; i<argc-1; ++i)
+	{
+		if(strcmp(argv[i], "--output") == 0)
+		{
+			++i;
+			if(i < argc - 1)
+			{
+				outputPath = uReplaceChar(argv[i], '~', UDirectory::homeDir());
+			}
+			else
+			{
+				showUsage();
+			}
+		}
+		else if(strcmp(argv[i], "--matrix") == 0)
+		{
+			++i;
+			if(i < argc - 1)
+			{
+				std::string arg = argv[i];
+				size_t sep = arg.find(':');
+				std::string key = arg.substr(0, sep);
+				if(sep == std::string::npos || Parameters::getDefaultParameters().find(key) == Parameters::getDefaultParameters().end())
+				{
+					printf("Parameter \"%s\" of matrix argument \"%s\" doesn't exist!\n", key.c_str(), argv[i]);
+					showUsage();
+				}
+				std::list<std::string> values = uSplit(arg.substr(sep+1), ',');
+				if(values.empty())
+				{
+					printf("No values set for parameter \"%s\"!\n", key.c_str());
+					showUsage();
+				}
+				matrix.push_back(std::make_pair(key, uListToVector(values)));
+				printf("Benchmarking %d values of \"%s\".\n", (int)values.size(), key.c_str());
+			}
+			else
+			{
+				showUsage();
+			}
+		}
+		else if(strcmp(argv[i], "--repeat") == 0)
+		{
+			++i;
+			if(i < argc - 1)
+			{
+				repeat = std::max(1, atoi(argv[i]));
+			}
+			else
+			{
+				showUsage();
+			}
+		}
+		else if(strcmp(argv[i], "--frames") == 0)
+		{
+			++i;
+			if(i < argc - 1)
+			{
+				maxFrames = atoi(argv[i]);
+			}
+			else
+			{
+				showUsage();
+			}
+		}
+		else if(strcmp(argv[i], "--warmup") == 0)
+		{
+			++i;
+			if(i < argc - 1)
+			{
+				warmupFrames = std::max(0, atoi(argv[i]));
+			}
+			else
+			{
+				showUsage();
+			}
+		}
+		else if(strcmp(argv[i], "--odom") == 0)
+		{
+			recomputeOdometry = true;
+		}
+		else if(strcmp(argv[i], "--keep_db") == 0)
+		{
+			keepDatabase = true;
+		}
+		else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--c") == 0)
+		{
+			++i;
+			if (i < argc - 1 && UFile::exists(argv[i]) && UFile::getExtension(argv[i]).compare("ini") == 0)
+			{
+				Parameters::readINI(argv[i], configParameters);
+				printf("Using %d parameters from config file \"%s\"\n", (int)configParameters.size(), argv[i]);
+			}
+			else if(i < argc - 1)
+			{
+				printf("Config file \"%s\" is not valid or doesn't exist!\n", argv[i]);
+			}
+			else
+			{
+				printf("Config file is not set!\n");
+			}
+		}
+	}
+
+	std::string inputDatabasePath = uReplaceChar(argv[argc-1], '~', UDirectory::homeDir());
+	std::list<std::string> databases = uSplit(inputDatabasePath, ';');
+	if (databases.empty())
+	{
+		printf("No input database \"%s\" detected!\n", inputDatabasePath.c_str());
+		return -1;
+	}
+	for (std::list<std::string>::iterator iter = databases.begin(); iter != databases.end(); ++iter)
+	{
+		if (!UFile::exists(*iter))
+		{
+			printf("Input database \"%s\" doesn't exist!\n", iter->c_str());
+			return -1;
+		}
+
+		if (UFile::getExtension(*iter).compare("db") != 0)
+		{
+			printf("File \"%s\" is not a database format (*.db)!\n", iter->c_str());
+			return -1;
+		}
+	}
+
+	// Get parameters of the first database
+	DBDriver * dbDriver = DBDriver::create();
+	if(!dbDriver->openConnection(databases.front(), false))
+	{
+		printf("Failed opening input database!\n");
+		delete dbDriver;
+		return -1;
+	}
+	ParametersMap parameters = dbDriver->getLastParameters();
+	if(parameters.empty())
+	{
+		printf("WARNING: Failed getting parameters from database, benchmark will be done with default parameters! Database version may be too old (%s).\n", dbDriver->getDatabaseVersion().c_str());
+	}
+	dbDriver->closeConnection(false);
+	delete dbDriver;
+	dbDriver = 0;
+
+	if(configParameters.find(Parameters::kRtabmapTimeThr()) == configParameters.end() &&
+	   customParameters.find(Parameters::kRtabmapTimeThr()) == customParameters.end())
+	{
+		uInsert(parameters, ParametersPair(Parameters::kRtabmapTimeThr(), "0"));
+	}
+	uInsert(parameters, configParameters);
+	uInsert(parameters, customParameters);
+
+	std::string outputDatabasePath = UDirectory::getDir(outputPath);
+	if(outputDatabasePath.empty())
+	{
+		outputDatabasePath = UDirectory::currentDir();
+	}
+	outputDatabasePath += UDirectory::separator() + std::string("benchmark_tmp.db");
+	uInsert(parameters, ParametersPair(Parameters::kRtabmapWorkingDirectory(), UDirectory::getDir(outputDatabasePath)));
+	uInsert(parameters, ParametersPair(Parameters::kRtabmapPublishStats(), "true"));
+
+	// Cartesian product of the matrix
+	std::vector<ParametersMap> configurations(1);
+	for(std::list<std::pair<std::string, std::vector<std::string> > >::iterator iter=matrix.begin(); iter!=matrix.end(); ++iter)
+	{
+		std::vector<ParametersMap> expanded;
+		for(unsigned int i=0; i<configurations.size(); ++i)
+		{
+			for(unsigned int j=0; j<iter->second.size(); ++j)
+			{
+				expanded.push_back(configurations[i]);
+				uInsert(expanded.back(), ParametersPair(iter->first, iter->second[j]));
+			}
+		}
+		configurations = expanded;
+	}
+
+	std::vector<ConfigResult> results(configurations.size());
+	for(unsigned int c=0; c<configurations.size() && g_loopForever; ++c)
+	{
+		results[c].parameters = configurations[c];
+		ParametersMap runParameters = parameters;
+		uInsert(runParameters, configurations[c]);
+
+		printf("Configuration %d/%d:", c+1, (int)configurations.size());
+		for(ParametersMap::iterator iter=configurations[c].begin(); iter!=configurations[c].end(); ++iter)
+		{
+			printf(" %s=%s", iter->first.c_str(), iter->second.c_str());
+		}
+		printf("\n");
+
+		for(int r=0; r<repeat && g_loopForever; ++r)
+		{
+			RunResult runResult = run(databases, runParameters, outputDatabasePath, recomputeOdometry, maxFrames, warmupFrames, results[c].samples);
+			results[c].runs.push_back(runResult);
+			printf("  Run %d/%d: %d frames in %.3fs (%d failed), peak RSS=%ld MB, db=%ld MB\n",
+					r+1, repeat,
+					runResult.frames,
+					runResult.wallTime,
+					runResult.failures,
+					runResult.peakRSS/(1024*1024),
+					runResult.dbSize/(1024*1024));
+		}
+		std::map<std::string, std::vector<float> >::iterator total = results[c].samples.find(Statistics::kTimingTotal());
+		if(total != results[c].samples.end())
+		{
+			std::sort(total->second.begin(), total->second.end());
+			printf("  %s: p50=%.2fms p95=%.2fms p99=%.2fms\n",
+					total->first.c_str(),
+					percentile(total->second, 50),
+					percentile(total->second, 95),
+					percentile(total->second, 99));
+		}
+	}
+
+	if(!keepDatabase && UFile::exists(outputDatabasePath))
+	{
+		UFile::erase(outputDatabasePath);
+	}
+
+	FILE * file = 0;
+#ifdef _MSC_VER
+	fopen_s(&file, outputPath.c_str(), "w");
+#else
+	file = fopen(outputPath.c_str(), "w");
+#endif
+	if(!file)
+	{
+		printf("Failed to open \"%s\" for writing!\n", outputPath.c_str());
+		return -1;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"version\": %s,\n", jsonString(RTABMAP_VERSION).c_str());
+	fprintf(file, "  \"inputs\": [");
+	for(std::list<std::string>::iterator iter=databases.begin(); iter!=databases.end(); ++iter)
+	{
+		fprintf(file, "%s%s", iter==databases.begin()?"":", ", jsonString(*iter).c_str());
+	}
+	fprintf(file, "],\n");
+	fprintf(file, "  \"repeat\": %d,\n", repeat);
+	fprintf(file, "  \"max_frames\": %d,\n", maxFrames);
+	fprintf(file, "  \"warmup_frames\": %d,\n", warmupFrames);
+	fprintf(file, "  \"odometry_recomputed\": %s,\n", recomputeOdometry?"true":"false");
+	fprintf(file, "  \"configurations\": [\n");
+	for(unsigned int c=0; c<results.size(); ++c)
+	{
+		fprintf(file, "    {\n");
+		fprintf(file, "      \"parameters\": {");
+		for(ParametersMap::iterator iter=results[c].parameters.begin(); iter!=results[c].parameters.end(); ++iter)
+		{
+			fprintf(file, "%s%s: %s", iter==results[c].parameters.begin()?"":", ", jsonString(iter->first).c_str(), jsonString(iter->second).c_str());
+		}
+		fprintf(file, "},\n");
+		fprintf(file, "      \"runs\": [\n");
+		for(unsigned int r=0; r<results[c].runs.size(); ++r)
+		{
+			const RunResult & runResult = results[c].runs[r];
+			fprintf(file, "        {\"frames\": %d, \"failures\": %d, \"wall_time_s\": %f, \"peak_rss_bytes\": %ld, \"process_peak_rss_bytes\": %ld, \"db_size_bytes\": %ld}%s\n",
+					runResult.frames,
+					runResult.failures,
+					runResult.wallTime,
+					runResult.peakRSS,
+					runResult.processPeakRSS,
+					runResult.dbSize,
+					r+1<results[c].runs.size()?",":"");
+		}
+		fprintf(file, "      ],\n");
+		fprintf(file, "      \"stages\": {\n");
+		unsigned int stage = 0;
+		for(std::map<std::string, std::vector<float> >::iterator iter=results[c].samples.begin(); iter!=results[c].samples.end(); ++iter)
+		{
+			std::vector<float> & values = iter->second;
+			std::sort(values.begin(), values.end());
+			fprintf(file, "        %s: {\"count\": %d, \"mean\": %f, \"min\": %f, \"max\": %f, \"p50\": %f, \"p95\": %f, \"p99\": %f}%s\n",
+					jsonString(iter->first).c_str(),
+					(int)values.size(),
+					values.empty()?0.0f:uMean(values),
+					values.empty()?0.0f:values.front(),
+					values.empty()?0.0f:values.back(),
+					percentile(values, 50),
+					percentile(values, 95),
+					percentile(values, 99),
+					++stage<results[c].samples.size()?",":"");
+		}
+		fprintf(file, "      }\n");
+		fprintf(file, "    }%s\n", c+1<results.size()?",":"");
+	}
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+	fclose(file);
+
+	printf("Results saved to \"%s\".\n", outputPath.c_str());
+
+	return 0;
+}
@@ -29,6 +29,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UTimer.h>
 #include "rtabmap/core/Rtabmap.h"
 #include "rtabmap/core/CameraRGB.h"
+#include "rtabmap/core/Trace.h"
 #include <rtabmap/utilite/UDirectory.h>
 #include <rtabmap/utilite/UFile.h>
 #include <rtabmap/utilite/UConversion.h>
@@ -58,6 +59,8 @@ void showUsage()
 			"  -skip #                         Skip X images while reading directory (default 0).\n"
 			"  -v                              Get version of RTAB-Map\n"
 			"  -input \"path\"                 Load previous database if it exists.\n"
+			"  -trace \"path.json\"            Save a trace of the processing (Chrome trace format,\n"
+			"                                   open it with chrome://tracing or ui.perfetto.dev).\n"
 			"%s\n",
 			rtabmap::Parameters::showUsage());
 	exit(1);
@@ -100,6 +103,7 @@ int main(int argc, char * argv[])
 	int repeat = 0;
 	bool createGT = false;
 	std::string inputDbPath;
+	std::string tracePath;
 	int startAt = 0;
 	int skip = 0;
 
@@ -224,6 +228,19 @@ int main(int argc, char * argv[])
 			}
 			continue;
 		}
+		if(strcmp(argv[i], "-trace") == 0)
+		{
+			++i;
+			if(i < argc)
+			{
+				tracePath = argv[i];
+			}
+			else
+			{
+				showUsage();
+			}
+			continue;
+		}
 		if(strcmp(argv[i], "-help") == 0 || strcmp(argv[i], "--help") == 0)
 		{
 			showUsage();
@@ -287,6 +304,16 @@ int main(int argc, char * argv[])
 	rtabmap.close(false);
 	ULogger::setLevel(level);
 
+	if(!tracePath.empty())
+	{
+#ifdef RTABMAP_TRACING
+		Trace::start();
+#else
+		printf("RTAB-Map is not built with tracing support (WITH_TRACING=OFF), ignoring -trace.\n");
+		tracePath.clear();
+#endif
+	}
+
 	rtabmap.init(pm, inputDbPath);
 
 	printf("rtabmap init time = %fs\n", timer.ticks());
@@ -444,6 +471,15 @@ int main(int argc, char * argv[])
 
 	printf(" Cleanup time = %fs\n", timer.ticks());
 
+	if(!tracePath.empty())
+	{
+		Trace::stop();
+		if(Trace::save(tracePath))
+		{
+			printf("Trace (%d events) saved to \"%s\".\n", Trace::events(), tracePath.c_str());
+		}
+	}
+
 	printf("Database (\"%s\") and log files saved to current directory.\n", inputDbPath.c_str());
 
 	return 0;
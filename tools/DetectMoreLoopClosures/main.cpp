@@ -35,6 +35,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UTimer.h>
 #include <rtabmap/utilite/UFile.h>
 #include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UThreadPool.h>
 #include <pcl/filters/filter.h>
 #include <pcl/io/ply_io.h>
 #include <pcl/io/obj_io.h>
@@ -53,6 +54,7 @@ void showUsage()
 			"    -r #          Cluster radius (default 1 m).\n"
 			"    -a #          Cluster angle (default 30 deg).\n"
 			"    -i #          Iterations (default 1).\n"
+			"    -t #          Registration threads (default 0 = as many as cores).\n"
 			"    --intra       Add only intra-session loop closures.\n"
 			"    --inter       Add only inter-session loop closures.\n"
 			"\n%s", Parameters::showUsage());
@@ -95,6 +97,7 @@ int main(int argc, char * argv[])
 	float clusterRadius = 1.0f;
 	float clusterAngle = CV_PI/6.0f;
 	int iterations = 1;
+	int threads = 0;
 	bool intraSession = false;
 	bool interSession = false;
 	for(int i=1; i<argc-1; ++i)
@@ -155,6 +158,18 @@ int main(int argc, char * argv[])
 				showUsage();
 			}
 		}
+		else if(std::strcmp(argv[i], "-t") == 0)
+		{
+			++i;
+			if(i<argc-1)
+			{
+				threads = uStr2Int(argv[i]);
+			}
+			else
+			{
+				showUsage();
+			}
+		}
 	}
 	ParametersMap inputParams = Parameters::parseArguments(argc,  argv);
 
@@ -167,6 +182,7 @@ int main(int argc, char * argv[])
 	printf("\nDatabase: %s\n", dbPath.c_str());
 	printf("Cluster radius = %f m\n", clusterRadius);
 	printf("Cluster angle = %f deg\n", clusterAngle*180.0f/CV_PI);
+	printf("Threads = %d\n", threads>0?threads:UThreadPool::idealThreadCount());
 	if(intraSession)
 	{
 		printf("Intra-session only\n");
@@ -204,7 +220,8 @@ int main(int argc, char * argv[])
 
 	PrintProgressState progress;
 	printf("Detecting...\n");
-	int detected = rtabmap.detectMoreLoopClosures(clusterRadius, clusterAngle, iterations, intraSession, interSession, &progress);
+	UTimer timer;
+	int detected = rtabmap.detectMoreLoopClosures(clusterRadius, clusterAngle, iterations, intraSession, interSession, &progress, threads);
 	if(detected < 0)
 	{
 		if(!g_loopForever)
@@ -216,6 +233,10 @@ int main(int argc, char * argv[])
 			printf("Loop closure detection failed!\n");
 		}
 	}
+	else
+	{
+		printf("Detected %d loop closures in %.3fs.\n", detected, timer.ticks());
+	}
 
 	rtabmap.close();
 
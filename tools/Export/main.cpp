@@ -31,17 +31,21 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/util3d_filtering.h>
 #include <rtabmap/core/util3d_transforms.h>
 #include <rtabmap/core/util3d_surface.h>
+#include <rtabmap/core/TiledCloudWriter.h>
+#include <rtabmap/core/ProgressState.h>
 #include <rtabmap/core/optimizer/OptimizerG2O.h>
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UTimer.h>
 #include <rtabmap/utilite/UFile.h>
 #include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UThreadPool.h>
 #include <pcl/filters/filter.h>
 #include <pcl/io/ply_io.h>
 #include <pcl/io/obj_io.h>
 #include <pcl/common/common.h>
 #include <pcl/surface/poisson.h>
 #include <stdio.h>
+#include <algorithm>
 
 using namespace rtabmap;
 
@@ -66,11 +70,88 @@ void showUsage()
 			"    --decimation    #     Depth image decimation before creating the clouds (default 4).\n"
 			"    --voxel         #     Voxel size of the created clouds (default 0.01 m).\n"
 			"    --color_radius  #     Radius used to colorize polygons (default 0.05 m, set 0 for nearest color).\n"
+			"    --threads       #     Threads used to create the clouds (default 0: all cores).\n"
+			"    --tile_size     #     Size of the tiles used to write the cloud without\n"
+			"                          keeping it in memory (default 10 m). Points are\n"
+			"                          written tile by tile, so their order in the\n"
+			"                          cloud file is not the global voxel grid order.\n"
+			"    --tiles               Write one cloud file per tile, with an index file.\n"
 			"\n%s", Parameters::showUsage());
 	;
 	exit(1);
 }
 
+// Cloud of a node in the map frame, with normals
+class NodeCloudTask : public UThreadPoolTask
+{
+public:
+	NodeCloudTask(
+			int id,
+			const SensorData & data,
+			const Transform & pose,
+			int decimation,
+			float maxRange,
+			float voxelSize) :
+		id_(id),
+		data_(data),
+		pose_(pose),
+		decimation_(decimation),
+		maxRange_(maxRange),
+		voxelSize_(voxelSize)
+	{}
+
+	virtual void run()
+	{
+		// uncompress data
+		data_.uncompressData();
+
+		pcl::IndicesPtr indices(new std::vector<int>);
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = util3d::cloudRGBFromSensorData(
+				data_,
+				decimation_,      // image decimation before creating the clouds
+				maxRange_,        // maximum depth of the cloud
+				0.0f,
+				indices.get());
+
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr transformedCloud = rtabmap::util3d::voxelize(cloud, indices, voxelSize_);
+		transformedCloud = rtabmap::util3d::transformPointCloud(transformedCloud, pose_);
+
+		// nodes are already processed in parallel, single thread for the normals
+		Eigen::Vector3f viewpoint( pose_.x(),  pose_.y(),  pose_.z());
+		pcl::PointCloud<pcl::Normal>::Ptr normals = rtabmap::util3d::computeNormals(transformedCloud, 10, 0.0f, viewpoint, 1);
+
+		cloud_.reset(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
+		pcl::concatenateFields(*transformedCloud, *normals, *cloud_);
+	}
+
+	int id() const {return id_;}
+	const SensorData & data() const {return data_;}
+	const pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr & cloud() const {return cloud_;}
+
+private:
+	int id_;
+	SensorData data_;
+	Transform pose_;
+	int decimation_;
+	float maxRange_;
+	float voxelSize_;
+	pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloud_;
+};
+
+// Prints the texturing steps with the time elapsed since the previous one
+class TimedProgressState : public ProgressState
+{
+public:
+	virtual bool callback(const std::string & msg) const
+	{
+		if(!msg.empty())
+			printf("   [%.3fs] %s\n", timer_.ticks(), msg.c_str());
+		return true;
+	}
+private:
+	mutable UTimer timer_;
+};
+
 int main(int argc, char * argv[])
 {
 	ULogger::setType(ULogger::kTypeConsole);
@@ -97,6 +178,9 @@ int main(int argc, char * argv[])
 	int textureRange = 0;
 	bool multiband = false;
 	float colorRadius = 0.05;
+	int threads = 0;
+	float tileSize = 10.0f;
+	bool tiles = false;
 	for(int i=1; i<argc-1; ++i)
 	{
 		if(std::strcmp(argv[i], "--help") == 0)
@@ -244,6 +328,34 @@ int main(int argc, char * argv[])
 				showUsage();
 			}
 		}
+		else if(std::strcmp(argv[i], "--threads") == 0)
+		{
+			++i;
+			if(i<argc-1)
+			{
+				threads = uStr2Int(argv[i]);
+			}
+			else
+			{
+				showUsage();
+			}
+		}
+		else if(std::strcmp(argv[i], "--tile_size") == 0)
+		{
+			++i;
+			if(i<argc-1)
+			{
+				tileSize = uStr2Float(argv[i]);
+			}
+			else
+			{
+				showUsage();
+			}
+		}
+		else if(std::strcmp(argv[i], "--tiles") == 0)
+		{
+			tiles = true;
+		}
 	}
 	ParametersMap params = Parameters::parseArguments(argc, argv, false);
 
@@ -313,65 +425,105 @@ int main(int argc, char * argv[])
 	std::map<int, std::vector<rtabmap::CameraModel> > cameraModels;
 	std::map<int, cv::Mat> cameraDepths;
 
-	for(std::map<int, Transform>::iterator iter=optimizedPoses.lower_bound(1); iter!=optimizedPoses.end(); ++iter)
+	// When exporting a cloud, the clouds are voxelized and written by tiles
+	// as they are created, so the assembled cloud is never in memory.
+	// Meshing uses all points.
+	std::string cloudPath = outputDirectory+"/"+baseName+"_cloud.ply";
+	TiledCloudWriter * cloudWriter = 0;
+	if(!(mesh || texture))
 	{
-		Signature node = nodes.find(iter->first)->second;
-
-		// uncompress data
-		node.sensorData().uncompressData();
-		std::vector<CameraModel> models = node.sensorData().cameraModels();
-		cv::Mat depth = node.sensorData().depthRaw();
-
-		pcl::IndicesPtr indices(new std::vector<int>);
-		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = util3d::cloudRGBFromSensorData(
-				node.sensorData(),
-				decimation,      // image decimation before creating the clouds
-				maxRange,        // maximum depth of the cloud
-				0.0f,
-				indices.get());
-
-		pcl::PointCloud<pcl::PointXYZRGB>::Ptr transformedCloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-		transformedCloud = rtabmap::util3d::voxelize(cloud, indices, voxelSize);
-		transformedCloud = rtabmap::util3d::transformPointCloud(transformedCloud, iter->second);
-
-		Eigen::Vector3f viewpoint( iter->second.x(),  iter->second.y(),  iter->second.z());
-		pcl::PointCloud<pcl::Normal>::Ptr normals = rtabmap::util3d::computeNormals(transformedCloud, 10, 0.0f, viewpoint);
-
-		pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloudWithNormals(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
-		pcl::concatenateFields(*transformedCloud, *normals, *cloudWithNormals);
+		cloudWriter = new TiledCloudWriter(cloudPath, voxelSize, tileSize, tiles);
+	}
 
-		if(mergedClouds->size() == 0)
+	// Nodes are processed in parallel by batches, bounding the
+	// number of uncompressed images in memory
+	UThreadPool pool(threads);
+	std::vector<std::pair<int, Transform> > poses(optimizedPoses.lower_bound(1), optimizedPoses.end());
+	unsigned int batchSize = pool.threads()*4;
+	for(unsigned int i=0; i<poses.size(); i+=batchSize)
+	{
+		std::vector<NodeCloudTask> tasks;
+		tasks.reserve(batchSize);
+		for(unsigned int j=i; j<poses.size() && j<i+batchSize; ++j)
 		{
-			*mergedClouds = *cloudWithNormals;
+			tasks.push_back(NodeCloudTask(
+					poses[j].first,
+					nodes.find(poses[j].first)->second.sensorData(),
+					poses[j].second,
+					decimation,
+					maxRange,
+					voxelSize));
 		}
-		else
+		std::vector<UThreadPoolTask*> tasksPtr(tasks.size());
+		for(unsigned int j=0; j<tasks.size(); ++j)
+		{
+			tasksPtr[j] = &tasks[j];
+		}
+		try
 		{
-			*mergedClouds += *cloudWithNormals;
+			pool.run(tasksPtr);
 		}
+		catch(const std::exception & e)
+		{
+			// a node failed, remove the temporary tiles
+			delete cloudWriter;
+			UERROR("Failed to create the clouds: %s", e.what());
+			return -1;
+		}
+
+		for(unsigned int j=0; j<tasks.size(); ++j)
+		{
+			const NodeCloudTask & task = tasks[j];
+			if(cloudWriter)
+			{
+				cloudWriter->add(*task.cloud());
+			}
+			else if(mergedClouds->size() == 0)
+			{
+				*mergedClouds = *task.cloud();
+			}
+			else
+			{
+				*mergedClouds += *task.cloud();
+			}
 
-		cameraPoses.insert(std::make_pair(iter->first, iter->second));
-		if(!models.empty())
+			cameraPoses.insert(std::make_pair(task.id(), poses[i+j].second));
+			if(!task.data().cameraModels().empty())
+			{
+				cameraModels.insert(std::make_pair(task.id(), task.data().cameraModels()));
+			}
+			if(texture && !task.data().depthRaw().empty())
+			{
+				cameraDepths.insert(std::make_pair(task.id(), task.data().depthRaw()));
+			}
+		}
+		if(cloudWriter)
 		{
-			cameraModels.insert(std::make_pair(iter->first, models));
+			printf("Processed %d/%d nodes... (%d tiles)\n",
+					(int)std::min(i+batchSize, (unsigned int)poses.size()), (int)poses.size(), cloudWriter->tiles());
 		}
-		if(!depth.empty())
+		else
 		{
-			cameraDepths.insert(std::make_pair(iter->first, depth));
+			printf("Processed %d/%d nodes... (%d points)\n",
+					(int)std::min(i+batchSize, (unsigned int)poses.size()), (int)poses.size(), (int)mergedClouds->size());
 		}
 	}
-	printf("Create and assemble the clouds... done (%fs, %d points).\n", timer.ticks(), (int)mergedClouds->size());
+	printf("Create and assemble the clouds... done (%fs).\n", timer.ticks());
 
-	if(mergedClouds->size())
+	if(cloudWriter || mergedClouds->size())
 	{
-		if(!(mesh || texture))
+		if(cloudWriter)
 		{
-			printf("Voxel grid filtering of the assembled cloud (voxel=%f, %d points)\n", 0.01f, (int)mergedClouds->size());
-			mergedClouds = util3d::voxelize(mergedClouds, voxelSize);
-
-			std::string outputPath=outputDirectory+"/"+baseName+"_cloud.ply";
-			printf("Saving %s... (%d points)\n", outputPath.c_str(), (int)mergedClouds->size());
-			pcl::io::savePLYFile(outputPath, *mergedClouds);
-			printf("Saving %s... done!\n", outputPath.c_str());
+			printf("Saving %s... (%d tiles)\n", cloudPath.c_str(), cloudWriter->tiles());
+			if(cloudWriter->close())
+			{
+				printf("Saving %s... done (%fs, %lu points)!\n", cloudPath.c_str(), timer.ticks(), cloudWriter->points());
+			}
+			else
+			{
+				printf("Saving %s... failed!\n", cloudPath.c_str());
+			}
+			delete cloudWriter;
 		}
 		else
 		{
@@ -424,6 +576,7 @@ int main(int argc, char * argv[])
 				{
 					printf("Texturing %d polygons... cameraPoses=%d, cameraDepths=%d\n", (int)mesh->polygons.size(), (int)cameraPoses.size(), (int)cameraDepths.size());
 					std::vector<std::map<int, pcl::PointXY> > vertexToPixels;
+					TimedProgressState progress;
 					pcl::TextureMeshPtr textureMesh = rtabmap::util3d::createTextureMesh(
 							mesh,
 							cameraPoses,
@@ -434,7 +587,7 @@ int main(int argc, char * argv[])
 							0.0f,
 							multiband?0:50, // Min polygons in camera view to be textured by this camera
 							std::vector<float>(),
-							0,
+							&progress,
 							&vertexToPixels);
 					printf("Texturing... done (%fs).\n", timer.ticks());
 
@@ -472,7 +625,7 @@ int main(int argc, char * argv[])
 								doBlending, 0,
 								0, 10, // low-high brightness/contrast balance
 								false, // exposure fusion
-								0,     // state
+								&progress,
 								0,     // blank value (0=black)
 								&gains,
 								&blendingGains,
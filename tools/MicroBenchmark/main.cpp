@@ -0,0 +1,1509 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <rtabmap/core/BayesFilter.h>
+#include <rtabmap/core/Graph.h>
+#include <rtabmap/core/PathGraph.h>
+#include <rtabmap/core/DBReader.h>
+#include <rtabmap/core/Compression.h>
+#include <rtabmap/core/Memory.h>
+#include <rtabmap/core/Features2d.h>
+#include <rtabmap/core/VWDictionary.h>
+#include <rtabmap/core/VisualWord.h>
+#include <rtabmap/core/util2d.h>
+#include <rtabmap/core/util3d.h>
+#include <rtabmap/core/util3d_filtering.h>
+#include <rtabmap/core/util3d_transforms.h>
+#include <rtabmap/core/util3d_surface.h>
+#include <rtabmap/core/util3d_registration.h>
+#include <rtabmap/core/util3d_motion_estimation.h>
+#include <rtabmap/utilite/UFile.h>
+#include <rtabmap/utilite/UDirectory.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <rtabmap/utilite/UMath.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <pcl/common/io.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fstream>
+#include <algorithm>
+#include <memory>
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("\nUsage:\n"
+			"   rtabmap-micro_benchmark [options]\n"
+			"   Time util2d/util3d/registration kernels in isolation at several problem sizes.\n"
+			"  Options:\n"
+			"     --db \"path.db\"        Use fixtures derived from the first frames of a database\n"
+			"                           instead of synthetic fixtures.\n"
+			"     --db_frames #         Frames loaded from the database (default 20).\n"
+			"     --filter \"name\"       Run only kernels whose name contains this string.\n"
+			"     --min_time #          Minimum time (s) spent per kernel (default 0.5).\n"
+			"     --min_iterations #    Minimum iterations per kernel (default 5).\n"
+			"     --output \"path.txt\"   Save results (can be used as baseline later).\n"
+			"     --baseline \"path.txt\" Compare with results saved previously with --output.\n"
+			"     --threshold #         Regression threshold in %% of the baseline median\n"
+			"                           (default 10). The program returns 1 if a kernel\n"
+			"                           is slower than this threshold.\n"
+			"  Kernels replacing a reference implementation (e.g. util3d::commonFiltering)\n"
+			"  are first checked against it, the program returns 1 on mismatch.\n"
+			"%s\n"
+			"\n", Parameters::showUsage());
+	exit(1);
+}
+
+/**
+ * A kernel to time. Inputs are prepared in the constructor, run()
+ * should only contain the call to the benchmarked function.
+ */
+class Kernel
+{
+public:
+	Kernel(const std::string & name) : name_(name) {}
+	virtual ~Kernel() {}
+	const std::string & name() const {return name_;}
+	virtual void run() = 0;
+	// Called once before timing. Kernels replacing a reference
+	// implementation return false with the difference in "error".
+	virtual bool check(std::string & error) {return true;}
+private:
+	std::string name_;
+};
+
+class VoxelizeKernel : public Kernel
+{
+public:
+	VoxelizeKernel(const std::string & size, const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud, float voxelSize) :
+		Kernel("util3d::voxelize[" + size + "]"),
+		cloud_(cloud),
+		voxelSize_(voxelSize)
+	{}
+	virtual void run()
+	{
+		util3d::voxelize(cloud_, voxelSize_);
+	}
+private:
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_;
+	float voxelSize_;
+};
+
+class TransformPointCloudKernel : public Kernel
+{
+public:
+	TransformPointCloudKernel(const std::string & size, const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud) :
+		Kernel("util3d::transformPointCloud[" + size + "]"),
+		cloud_(cloud),
+		transform_(0.1f, 0.2f, 0.3f, 0.01f, 0.02f, 0.03f)
+	{}
+	virtual void run()
+	{
+		util3d::transformPointCloud(cloud_, transform_);
+	}
+private:
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_;
+	Transform transform_;
+};
+
+class LaserScanFromPointCloudKernel : public Kernel
+{
+public:
+	LaserScanFromPointCloudKernel(const std::string & size, const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud) :
+		Kernel("util3d::laserScanFromPointCloud[" + size + "]"),
+		cloud_(cloud)
+	{}
+	virtual void run()
+	{
+		util3d::laserScanFromPointCloud(*cloud_);
+	}
+private:
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_;
+};
+
+class FastBilateralFilteringKernel : public Kernel
+{
+public:
+	FastBilateralFilteringKernel(const std::string & size, const cv::Mat & depth) :
+		Kernel("util2d::fastBilateralFiltering[" + size + "]"),
+		depth_(depth)
+	{}
+	virtual void run()
+	{
+		util2d::fastBilateralFiltering(depth_);
+	}
+private:
+	cv::Mat depth_;
+};
+
+class CvtDepthFromFloatKernel : public Kernel
+{
+public:
+	CvtDepthFromFloatKernel(const std::string & size, const cv::Mat & depth32F) :
+		Kernel("util2d::cvtDepthFromFloat[" + size + "]"),
+		depth_(depth32F)
+	{}
+	virtual void run()
+	{
+		util2d::cvtDepthFromFloat(depth_);
+	}
+private:
+	cv::Mat depth_;
+};
+
+class CvtDepthToFloatKernel : public Kernel
+{
+public:
+	CvtDepthToFloatKernel(const std::string & size, const cv::Mat & depth16U) :
+		Kernel("util2d::cvtDepthToFloat[" + size + "]"),
+		depth_(depth16U)
+	{}
+	virtual void run()
+	{
+		util2d::cvtDepthToFloat(depth_);
+	}
+private:
+	cv::Mat depth_;
+};
+
+class DecimateKernel : public Kernel
+{
+public:
+	DecimateKernel(const std::string & size, const cv::Mat & depth, int decimation) :
+		Kernel(uFormat("util2d::decimate[%s,d=%d]", size.c_str(), decimation)),
+		depth_(depth),
+		decimation_(decimation)
+	{}
+	virtual void run()
+	{
+		util2d::decimate(depth_, decimation_);
+	}
+private:
+	cv::Mat depth_;
+	int decimation_;
+};
+
+class InterpolateKernel : public Kernel
+{
+public:
+	// "depth" is the decimated image, "size" is the size of the output
+	InterpolateKernel(const std::string & size, const cv::Mat & depth, int factor) :
+		Kernel(uFormat("util2d::interpolate[%s,f=%d]", size.c_str(), factor)),
+		depth_(depth),
+		factor_(factor)
+	{}
+	virtual void run()
+	{
+		util2d::interpolate(depth_, factor_);
+	}
+private:
+	cv::Mat depth_;
+	int factor_;
+};
+
+class RegisterDepthKernel : public Kernel
+{
+public:
+	RegisterDepthKernel(const std::string & size, const cv::Mat & depth, const cv::Mat & K, const Transform & transform) :
+		Kernel("util2d::registerDepth[" + size + "]"),
+		depth_(depth),
+		K_(K),
+		transform_(transform)
+	{}
+	virtual void run()
+	{
+		util2d::registerDepth(depth_, K_, depth_.size(), K_, transform_);
+	}
+private:
+	cv::Mat depth_;
+	cv::Mat K_;
+	Transform transform_;
+};
+
+class FillDepthHolesKernel : public Kernel
+{
+public:
+	FillDepthHolesKernel(const std::string & size, const cv::Mat & depth) :
+		Kernel("util2d::fillDepthHoles[" + size + "]"),
+		depth_(depth)
+	{}
+	virtual void run()
+	{
+		util2d::fillDepthHoles(depth_, 2);
+	}
+private:
+	cv::Mat depth_;
+};
+
+// The image is filled in place, so the time includes a copy of the input
+class FillRegisteredDepthHolesKernel : public Kernel
+{
+public:
+	FillRegisteredDepthHolesKernel(const std::string & size, const cv::Mat & depth16U, bool horizontal) :
+		Kernel(uFormat("util2d::fillRegisteredDepthHoles[%s,%s]", size.c_str(), horizontal?"v+h":"v")),
+		depth_(depth16U),
+		horizontal_(horizontal)
+	{}
+	virtual void run()
+	{
+		cv::Mat depth = depth_.clone();
+		util2d::fillRegisteredDepthHoles(depth, true, horizontal_);
+	}
+private:
+	cv::Mat depth_;
+	bool horizontal_;
+};
+
+class CloudFromDepthKernel : public Kernel
+{
+public:
+	CloudFromDepthKernel(const std::string & size, const cv::Mat & depth, const CameraModel & model, int decimation) :
+		Kernel(uFormat("util3d::cloudFromDepth[%s,d=%d]", size.c_str(), decimation)),
+		depth_(depth),
+		model_(model),
+		decimation_(decimation)
+	{}
+	virtual void run()
+	{
+		util3d::cloudFromDepth(depth_, model_, decimation_);
+	}
+private:
+	cv::Mat depth_;
+	CameraModel model_;
+	int decimation_;
+};
+
+class CloudFromDepthRGBKernel : public Kernel
+{
+public:
+	CloudFromDepthRGBKernel(const std::string & size, const cv::Mat & rgb, const cv::Mat & depth, const CameraModel & model, int decimation) :
+		Kernel(uFormat("util3d::cloudFromDepthRGB[%s,d=%d]", size.c_str(), decimation)),
+		rgb_(rgb),
+		depth_(depth),
+		model_(model),
+		decimation_(decimation)
+	{}
+	virtual void run()
+	{
+		util3d::cloudFromDepthRGB(rgb_, depth_, model_, decimation_);
+	}
+private:
+	cv::Mat rgb_;
+	cv::Mat depth_;
+	CameraModel model_;
+	int decimation_;
+};
+
+class LaserScanFromDepthKernel : public Kernel
+{
+public:
+	LaserScanFromDepthKernel(const std::string & size, const cv::Mat & rgb, const cv::Mat & depth, const CameraModel & model, int decimation) :
+		Kernel(uFormat("util3d::laserScanFromDepth[%s,d=%d]", size.c_str(), decimation)),
+		rgb_(rgb),
+		depth_(depth),
+		model_(model),
+		decimation_(decimation)
+	{}
+	virtual void run()
+	{
+		util3d::laserScanFromDepth(depth_, model_, decimation_, 0.0f, 0.0f, rgb_);
+	}
+private:
+	cv::Mat rgb_;
+	cv::Mat depth_;
+	CameraModel model_;
+	int decimation_;
+};
+
+// Scan from depth as CameraThread does it when filtering is required (and did it before laserScanFromDepth())
+class LaserScanFromCloudKernel : public Kernel
+{
+public:
+	LaserScanFromCloudKernel(const std::string & size, const cv::Mat & rgb, const cv::Mat & depth, const CameraModel & model, int decimation) :
+		Kernel(uFormat("util3d::laserScanFromPointCloud(cloudRGBFromSensorData)[%s,d=%d]", size.c_str(), decimation)),
+		data_(rgb, depth, model),
+		decimation_(decimation)
+	{}
+	virtual void run()
+	{
+		std::vector<int> validIndices;
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = util3d::cloudRGBFromSensorData(data_, decimation_, 0.0f, 0.0f, &validIndices);
+		pcl::PointCloud<pcl::PointXYZRGB> denseCloud;
+		pcl::copyPointCloud(*cloud, validIndices, denseCloud);
+		util3d::laserScanFromPointCloud(denseCloud, data_.cameraModels()[0].localTransform().inverse());
+	}
+private:
+	SensorData data_;
+	int decimation_;
+};
+
+// commonFiltering() as it was before the fused step/range/voxel pass: step and
+// range filtering copied point by point, then LaserScan -> pcl::PointCloud ->
+// util3d::voxelize() -> LaserScan.
+LaserScan legacyCommonFiltering(const LaserScan & scanIn, int downsamplingStep, float rangeMin, float rangeMax, float voxelSize)
+{
+	LaserScan scan = scanIn;
+	if(scan.isEmpty())
+	{
+		return scan;
+	}
+	if(downsamplingStep<=1 || scan.size() <= downsamplingStep)
+	{
+		downsamplingStep = 1;
+	}
+
+	if(downsamplingStep > 1 || rangeMin > 0.0f || rangeMax > 0.0f)
+	{
+		cv::Mat tmp = cv::Mat(1, scan.size()/downsamplingStep, scan.dataType());
+		bool is2d = scan.is2d();
+		int oi = 0;
+		float rangeMinSqrd = rangeMin * rangeMin;
+		float rangeMaxSqrd = rangeMax * rangeMax;
+		for(int i=0; i<scan.size()-downsamplingStep+1; i+=downsamplingStep)
+		{
+			const float * ptr = scan.data().ptr<float>(0, i);
+			if(rangeMin>0.0f || rangeMax>0.0f)
+			{
+				float r = ptr[0]*ptr[0] + ptr[1]*ptr[1] + (is2d?0.0f:ptr[2]*ptr[2]);
+				if((rangeMin > 0.0f && r < rangeMinSqrd) || (rangeMax > 0.0f && r > rangeMaxSqrd))
+				{
+					continue;
+				}
+			}
+			cv::Mat(scan.data(), cv::Range::all(), cv::Range(i,i+1)).copyTo(cv::Mat(tmp, cv::Range::all(), cv::Range(oi,oi+1)));
+			++oi;
+		}
+		scan = LaserScan(
+				cv::Mat(tmp, cv::Range::all(), cv::Range(0, oi)),
+				scan.maxPoints()/downsamplingStep,
+				rangeMax>0.0f&&rangeMax<scan.rangeMax()?rangeMax:scan.rangeMax(),
+				scan.format(),
+				scan.localTransform());
+	}
+
+	if(scan.size() && voxelSize > 0.0f)
+	{
+		cv::Mat data;
+		LaserScan::Format format;
+		if(scan.hasRGB())
+		{
+			data = util3d::laserScanFromPointCloud(*util3d::voxelize(util3d::laserScanToPointCloudRGB(scan), voxelSize));
+			format = LaserScan::kXYZRGB;
+		}
+		else if(scan.hasIntensity())
+		{
+			pcl::PointCloud<pcl::PointXYZI>::Ptr cloud = util3d::voxelize(util3d::laserScanToPointCloudI(scan), voxelSize);
+			data = scan.is2d()?util3d::laserScan2dFromPointCloud(*cloud):util3d::laserScanFromPointCloud(*cloud);
+			format = scan.is2d()?LaserScan::kXYI:LaserScan::kXYZI;
+		}
+		else
+		{
+			pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = util3d::voxelize(util3d::laserScanToPointCloud(scan), voxelSize);
+			data = scan.is2d()?util3d::laserScan2dFromPointCloud(*cloud):util3d::laserScanFromPointCloud(*cloud);
+			format = scan.is2d()?LaserScan::kXY:LaserScan::kXYZ;
+		}
+		float ratio = float(data.cols) / scan.size();
+		scan = LaserScan(data, int(float(scan.maxPoints()) * ratio), scan.rangeMax(), format, scan.localTransform());
+	}
+	return scan;
+}
+
+class CommonFilteringKernel : public Kernel
+{
+public:
+	CommonFilteringKernel(const std::string & size, const LaserScan & scan, int step, float rangeMin, float rangeMax, float voxelSize, bool legacy = false) :
+		Kernel(uFormat("util3d::commonFiltering%s[%s,%s,step=%d,range=%g-%g,voxel=%g]",
+				legacy?"(legacy)":"", size.c_str(), scan.formatName().c_str(), step, rangeMin, rangeMax, voxelSize)),
+		scan_(scan),
+		step_(step),
+		rangeMin_(rangeMin),
+		rangeMax_(rangeMax),
+		voxelSize_(voxelSize),
+		legacy_(legacy)
+	{}
+	virtual void run()
+	{
+		if(legacy_)
+		{
+			legacyCommonFiltering(scan_, step_, rangeMin_, rangeMax_, voxelSize_);
+		}
+		else
+		{
+			util3d::commonFiltering(scan_, step_, rangeMin_, rangeMax_, voxelSize_);
+		}
+	}
+	// Same points in the same order than the legacy chain. Step and range
+	// filtering only copy points, so they should match exactly. Voxel
+	// centroids can differ in the last bits as pcl::VoxelGrid doesn't sum
+	// the points of a voxel in the same order.
+	virtual bool check(std::string & error)
+	{
+		if(legacy_)
+		{
+			return true;
+		}
+		LaserScan scan = util3d::commonFiltering(scan_, step_, rangeMin_, rangeMax_, voxelSize_);
+		LaserScan reference = legacyCommonFiltering(scan_, step_, rangeMin_, rangeMax_, voxelSize_);
+		if(scan.size() != reference.size())
+		{
+			error = uFormat("%d points instead of %d", scan.size(), reference.size());
+			return false;
+		}
+		if(scan.format() != reference.format())
+		{
+			error = uFormat("format %s instead of %s", scan.formatName().c_str(), reference.formatName().c_str());
+			return false;
+		}
+		float tolerance = voxelSize_ > 0.0f?0.0001f:0.0f;
+		int dims = scan.is2d()?2:3;
+		for(int i=0; i<scan.size(); ++i)
+		{
+			const float * ptr = scan.data().ptr<float>(0, i);
+			const float * ref = reference.data().ptr<float>(0, i);
+			for(int j=0; j<dims; ++j)
+			{
+				if(fabs(ptr[j] - ref[j]) > tolerance)
+				{
+					error = uFormat("point %d: coordinate %d is %f instead of %f", i, j, ptr[j], ref[j]);
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+private:
+	LaserScan scan_;
+	int step_;
+	float rangeMin_;
+	float rangeMax_;
+	float voxelSize_;
+	bool legacy_;
+};
+
+// Checked against the legacy chain with step/range only, voxel only and all
+// filters, the latter also timed with the legacy chain for comparison
+void createCommonFilteringKernels(std::list<Kernel*> & kernels, const std::string & size, const LaserScan & scan)
+{
+	if(scan.isEmpty())
+	{
+		return;
+	}
+	kernels.push_back(new CommonFilteringKernel(size, scan, 2, 0.5f, 4.0f, 0.0f));
+	kernels.push_back(new CommonFilteringKernel(size, scan, 1, 0.0f, 0.0f, 0.05f));
+	kernels.push_back(new CommonFilteringKernel(size, scan, 2, 0.5f, 4.0f, 0.05f));
+	kernels.push_back(new CommonFilteringKernel(size, scan, 2, 0.5f, 4.0f, 0.05f, true));
+}
+
+class CompressImageKernel : public Kernel
+{
+public:
+	CompressImageKernel(const std::string & size, const cv::Mat & image, const std::string & format) :
+		Kernel("compressImage2[" + format + "," + size + "]"),
+		image_(image),
+		format_(format)
+	{}
+	virtual void run()
+	{
+		compressImage2(image_, format_);
+	}
+private:
+	cv::Mat image_;
+	std::string format_;
+};
+
+class UncompressImageKernel : public Kernel
+{
+public:
+	UncompressImageKernel(const std::string & size, const cv::Mat & image, const std::string & format) :
+		Kernel("uncompressImage[" + format + "," + size + "]"),
+		bytes_(compressImage2(image, format))
+	{}
+	virtual void run()
+	{
+		uncompressImage(bytes_);
+	}
+private:
+	cv::Mat bytes_;
+};
+
+class EstimateMotion3DTo2DKernel : public Kernel
+{
+public:
+	EstimateMotion3DTo2DKernel(
+			const std::string & size,
+			const std::map<int, cv::Point3f> & words3A,
+			const std::map<int, cv::KeyPoint> & words2B,
+			const CameraModel & model) :
+		Kernel("util3d::estimateMotion3DTo2D[" + size + "]"),
+		words3A_(words3A),
+		words2B_(words2B),
+		model_(model)
+	{}
+	virtual void run()
+	{
+		util3d::estimateMotion3DTo2D(words3A_, words2B_, model_);
+	}
+private:
+	std::map<int, cv::Point3f> words3A_;
+	std::map<int, cv::KeyPoint> words2B_;
+	CameraModel model_;
+};
+
+class IcpPointToPlaneKernel : public Kernel
+{
+public:
+	IcpPointToPlaneKernel(
+			const std::string & size,
+			const pcl::PointCloud<pcl::PointNormal>::Ptr & source,
+			const pcl::PointCloud<pcl::PointNormal>::Ptr & target) :
+		Kernel("util3d::icpPointToPlane[" + size + "]"),
+		source_(source),
+		target_(target)
+	{}
+	virtual void run()
+	{
+		bool hasConverged = false;
+		pcl::PointCloud<pcl::PointNormal> registered;
+		util3d::icpPointToPlane(source_, target_, 0.1, 30, hasConverged, registered);
+	}
+private:
+	pcl::PointCloud<pcl::PointNormal>::Ptr source_;
+	pcl::PointCloud<pcl::PointNormal>::Ptr target_;
+};
+
+class FindNNKernel : public Kernel
+{
+public:
+	FindNNKernel(
+			const std::string & size,
+			const cv::Mat & dictionaryDescriptors,
+			const cv::Mat & queries,
+			const ParametersMap & parameters) :
+		Kernel("VWDictionary::findNN[" + size + "]"),
+		dictionary_(parameters),
+		queries_(queries)
+	{
+		for(int i=0; i<dictionaryDescriptors.rows; ++i)
+		{
+			dictionary_.addWord(new VisualWord(i+1, dictionaryDescriptors.row(i).clone()));
+		}
+		dictionary_.update();
+	}
+	virtual void run()
+	{
+		dictionary_.findNN(queries_);
+	}
+private:
+	VWDictionary dictionary_;
+	cv::Mat queries_;
+};
+
+class BayesFilterKernel : public Kernel
+{
+public:
+	// full=true: the prediction is rebuilt on each run (like after a reset or
+	// with Bayes/FullPredictionUpdate), otherwise only the posterior is updated.
+	BayesFilterKernel(
+			const std::string & size,
+			const std::shared_ptr<Memory> & memory,
+			const std::map<int, float> & likelihood,
+			bool full,
+			const ParametersMap & parameters) :
+		Kernel(uFormat("BayesFilter::computePosterior[%s,%s]", size.c_str(), full?"full":"update")),
+		memory_(memory),
+		likelihood_(likelihood),
+		full_(full),
+		filter_(parameters)
+	{}
+	virtual void run()
+	{
+		if(full_)
+		{
+			filter_.reset();
+		}
+		filter_.computePosterior(memory_.get(), likelihood_);
+	}
+private:
+	std::shared_ptr<Memory> memory_;
+	std::map<int, float> likelihood_;
+	bool full_;
+	BayesFilter filter_;
+};
+
+// Local path as Rtabmap::process() planned it before PathGraph:
+// the adjacency is rebuilt from the constraints on each request.
+class GraphComputePathKernel : public Kernel
+{
+public:
+	GraphComputePathKernel(
+			const std::string & size,
+			const std::map<int, Transform> & poses,
+			const std::multimap<int, Link> & links,
+			int from,
+			int to) :
+		Kernel("graph::computePath[" + size + "]"),
+		poses_(poses),
+		links_(links),
+		from_(from),
+		to_(to)
+	{}
+	virtual void run()
+	{
+		std::multimap<int, int> links;
+		for(std::multimap<int, Link>::iterator iter=links_.begin(); iter!=links_.end(); ++iter)
+		{
+			if(uContains(poses_, iter->second.from()) && uContains(poses_, iter->second.to()))
+			{
+				links.insert(std::make_pair(iter->second.from(), iter->second.to()));
+				links.insert(std::make_pair(iter->second.to(), iter->second.from())); // <->
+			}
+		}
+		graph::computePath(poses_, links, from_, to_);
+	}
+private:
+	std::map<int, Transform> poses_;
+	std::multimap<int, Link> links_;
+	int from_;
+	int to_;
+};
+
+class PathGraphComputePathKernel : public Kernel
+{
+public:
+	PathGraphComputePathKernel(
+			const std::string & size,
+			const std::map<int, Transform> & poses,
+			const std::multimap<int, Link> & links,
+			int from,
+			int to) :
+		Kernel("PathGraph::computePath[" + size + "]"),
+		from_(from),
+		to_(to)
+	{
+		graph_.update(poses, links);
+		graph_.compact();
+	}
+	virtual void run()
+	{
+		graph_.computePath(from_, to_);
+	}
+private:
+	PathGraph graph_;
+	int from_;
+	int to_;
+};
+
+// full=true: synchronization with all poses and links (after an
+// optimization), otherwise a new node and its neighbor link are added then
+// removed like Rtabmap::process() does on each update.
+class PathGraphUpdateKernel : public Kernel
+{
+public:
+	PathGraphUpdateKernel(
+			const std::string & size,
+			const std::map<int, Transform> & poses,
+			const std::multimap<int, Link> & links,
+			bool full) :
+		Kernel(uFormat("PathGraph::update[%s,%s]", size.c_str(), full?"full":"incremental")),
+		poses_(poses),
+		links_(links),
+		full_(full)
+	{
+		graph_.update(poses_, links_);
+		graph_.compact();
+	}
+	virtual void run()
+	{
+		if(full_)
+		{
+			graph_.update(poses_, links_);
+		}
+		else
+		{
+			int id = poses_.rbegin()->first + 1;
+			graph_.addNode(id, poses_.rbegin()->second);
+			graph_.addLink(id-1, id);
+			graph_.removeNode(id);
+		}
+	}
+private:
+	std::map<int, Transform> poses_;
+	std::multimap<int, Link> links_;
+	bool full_;
+	PathGraph graph_;
+};
+
+struct Result
+{
+	Result() :
+		iterations(0),
+		median(0.0),
+		mean(0.0),
+		min(0.0)
+	{}
+	std::string name;
+	int iterations;
+	double median; // ms
+	double mean; // ms
+	double min; // ms
+};
+
+Result timeKernel(Kernel & kernel, double minTime, int minIterations)
+{
+	// warm-up (caches, lazy allocations, FLANN index...)
+	kernel.run();
+
+	std::vector<double> times;
+	UTimer total;
+	while(times.size() < 10000 && ((int)times.size() < minIterations || total.elapsed() < minTime))
+	{
+		UTimer timer;
+		kernel.run();
+		times.push_back(timer.ticks()*1000.0);
+	}
+
+	Result result;
+	result.name = kernel.name();
+	result.iterations = (int)times.size();
+	std::sort(times.begin(), times.end());
+	result.median = times[times.size()/2];
+	result.mean = uMean(times);
+	result.min = times.front();
+	return result;
+}
+
+// Synthetic fixtures, seeded so that they are the same between runs
+
+pcl::PointCloud<pcl::PointXYZ>::Ptr createRandomCloud(int size, cv::RNG & rng)
+{
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+	cloud->resize(size);
+	for(int i=0; i<size; ++i)
+	{
+		cloud->at(i).x = rng.uniform(-5.0f, 5.0f);
+		cloud->at(i).y = rng.uniform(-5.0f, 5.0f);
+		cloud->at(i).z = rng.uniform(0.0f, 3.0f);
+	}
+	return cloud;
+}
+
+// Same distribution than createRandomCloud(), intensity and colors are random
+LaserScan createRandomScan(int size, LaserScan::Format format, cv::RNG & rng)
+{
+	cv::Mat data(1, size, CV_32FC(LaserScan::channels(format)));
+	bool is2d = LaserScan::isScan2d(format);
+	for(int i=0; i<size; ++i)
+	{
+		float * ptr = data.ptr<float>(0, i);
+		int oi = 0;
+		ptr[oi++] = rng.uniform(-5.0f, 5.0f);
+		ptr[oi++] = rng.uniform(-5.0f, 5.0f);
+		if(!is2d)
+		{
+			ptr[oi++] = rng.uniform(0.0f, 3.0f);
+		}
+		if(format == LaserScan::kXYZRGB)
+		{
+			*(int*)(ptr + oi) = rng.uniform(0, 0x1000000);
+		}
+		else if(format == LaserScan::kXYZI || format == LaserScan::kXYI)
+		{
+			ptr[oi] = rng.uniform(0.0f, 100.0f);
+		}
+	}
+	return LaserScan(data, size, 0, format);
+}
+
+cv::Mat createDepth(int width, int height, cv::RNG & rng)
+{
+	// slanted plane with a box in front and some invalid pixels
+	cv::Mat depth(height, width, CV_32FC1);
+	for(int v=0; v<height; ++v)
+	{
+		for(int u=0; u<width; ++u)
+		{
+			float d = 2.0f + 2.0f*float(u)/float(width);
+			if(u > width/3 && u < width/2 && v > height/3 && v < 2*height/3)
+			{
+				d -= 1.0f;
+			}
+			depth.at<float>(v,u) = rng.uniform(0.0f, 1.0f) < 0.02f?0.0f:d + (float)rng.gaussian(0.01);
+		}
+	}
+	return depth;
+}
+
+// Points on the floor and two walls of a room corner (well constrained for ICP)
+pcl::PointCloud<pcl::PointNormal>::Ptr createCorner(int size, cv::RNG & rng)
+{
+	pcl::PointCloud<pcl::PointNormal>::Ptr cloud(new pcl::PointCloud<pcl::PointNormal>);
+	cloud->resize(size);
+	for(int i=0; i<size; ++i)
+	{
+		pcl::PointNormal & pt = cloud->at(i);
+		float a = rng.uniform(0.0f, 4.0f);
+		float b = rng.uniform(0.0f, 4.0f);
+		float noise = (float)rng.gaussian(0.005);
+		pt.normal_x = pt.normal_y = pt.normal_z = 0.0f;
+		if(i%3 == 0)
+		{
+			pt.x = a; pt.y = b; pt.z = noise; pt.normal_z = 1.0f;
+		}
+		else if(i%3 == 1)
+		{
+			pt.x = noise; pt.y = a; pt.z = b*0.6f; pt.normal_x = 1.0f;
+		}
+		else
+		{
+			pt.x = a; pt.y = noise; pt.z = b*0.6f; pt.normal_y = 1.0f;
+		}
+	}
+	return cloud;
+}
+
+// Project words3A in a camera moved by "motion", with pixel noise and 10% outliers
+std::map<int, cv::KeyPoint> projectWords(
+		const std::map<int, cv::Point3f> & words3A,
+		const CameraModel & model,
+		const Transform & motion,
+		cv::RNG & rng)
+{
+	std::map<int, cv::KeyPoint> words2B;
+	Transform baseToCamera = (motion * model.localTransform()).inverse();
+	for(std::map<int, cv::Point3f>::const_iterator iter=words3A.begin(); iter!=words3A.end(); ++iter)
+	{
+		cv::Point3f pt = util3d::transformPoint(iter->second, baseToCamera);
+		if(pt.z <= 0.0f)
+		{
+			continue;
+		}
+		float u, v;
+		model.reproject(pt.x, pt.y, pt.z, u, v);
+		if(rng.uniform(0.0f, 1.0f) < 0.1f)
+		{
+			u = rng.uniform(0.0f, (float)model.imageWidth());
+			v = rng.uniform(0.0f, (float)model.imageHeight());
+		}
+		else
+		{
+			u += (float)rng.gaussian(0.5);
+			v += (float)rng.gaussian(0.5);
+		}
+		words2B.insert(std::make_pair(iter->first, cv::KeyPoint(u, v, 3.0f)));
+	}
+	return words2B;
+}
+
+// util2d depth kernels on a float depth image, run with --baseline to compare before/after a change
+void createUtil2dDepthKernels(std::list<Kernel*> & kernels, const cv::Mat & depth)
+{
+	cv::Mat depth32F = depth.type() == CV_16UC1?util2d::cvtDepthToFloat(depth):depth;
+	UASSERT(depth32F.type() == CV_32FC1);
+	cv::Mat depth16U = util2d::cvtDepthFromFloat(depth32F);
+	std::string size = uFormat("%dx%d", depth32F.cols, depth32F.rows);
+
+	kernels.push_back(new CvtDepthFromFloatKernel(size, depth32F));
+	kernels.push_back(new CvtDepthToFloatKernel(size, depth16U));
+	if(depth32F.rows % 2 == 0 && depth32F.cols % 2 == 0)
+	{
+		kernels.push_back(new DecimateKernel(size, depth32F, 2));
+		kernels.push_back(new InterpolateKernel(size, util2d::decimate(depth32F, 2), 2));
+	}
+	cv::Mat K = (cv::Mat_<double>(3,3) <<
+			0.82*depth32F.cols, 0, (depth32F.cols-1)/2.0,
+			0, 0.82*depth32F.cols, (depth32F.rows-1)/2.0,
+			0, 0, 1);
+	// depth camera 2.5 cm beside the color camera (optical frame)
+	kernels.push_back(new RegisterDepthKernel(size, depth32F, K, Transform(0.025f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f)));
+	kernels.push_back(new FillDepthHolesKernel(size, depth32F));
+	kernels.push_back(new FillRegisteredDepthHolesKernel(size, depth16U, false));
+	kernels.push_back(new FillRegisteredDepthHolesKernel(size, depth16U, true));
+}
+
+// Depth back-projection at decimation 1, 2 and 4
+void createDepthProjectionKernels(std::list<Kernel*> & kernels, const cv::Mat & rgb, const cv::Mat & depth, const CameraModel & model)
+{
+	std::string size = uFormat("%dx%d", depth.cols, depth.rows);
+	int decimations[] = {1, 2, 4};
+	for(int i=0; i<3; ++i)
+	{
+		if(depth.rows % decimations[i] != 0 || depth.cols % decimations[i] != 0)
+		{
+			continue;
+		}
+		kernels.push_back(new CloudFromDepthKernel(size, depth, model, decimations[i]));
+		if(!rgb.empty())
+		{
+			kernels.push_back(new CloudFromDepthRGBKernel(size, rgb, depth, model, decimations[i]));
+		}
+		kernels.push_back(new LaserScanFromDepthKernel(size, rgb, depth, model, decimations[i]));
+		if(!rgb.empty())
+		{
+			kernels.push_back(new LaserScanFromCloudKernel(size, rgb, depth, model, decimations[i]));
+		}
+	}
+}
+
+// Bayes filter with "wmSize" places in WM (no visual features), linked by
+// odometry with a loop closure every 100 places. The memory used by the
+// sparse prediction is printed with the size a dense matrix would have.
+void createBayesFilterKernels(std::list<Kernel*> & kernels, int wmSize, cv::RNG & rng, const ParametersMap & parameters)
+{
+	ParametersMap memoryParameters = parameters;
+	uInsert(memoryParameters, ParametersPair(Parameters::kKpMaxFeatures(), "-1"));
+	int stmSize = Parameters::defaultMemSTMSize();
+	Parameters::parse(memoryParameters, Parameters::kMemSTMSize(), stmSize);
+	std::shared_ptr<Memory> memory(new Memory(memoryParameters));
+	memory->init("", true, memoryParameters);
+
+	cv::Mat image = cv::Mat::zeros(16, 16, CV_8UC1);
+	cv::Mat covariance = cv::Mat::eye(6, 6, CV_64FC1)*0.0001;
+	Transform pose = Transform::getIdentity();
+	for(int i=0; i<wmSize+stmSize; ++i)
+	{
+		pose *= Transform(0.1f, 0.0f, 0.0f, 0.0f, 0.0f, 0.01f);
+		memory->update(SensorData(image, 0, double(i)), pose, covariance);
+		int id = memory->getLastSignatureId();
+		if(i >= 100 && i % 100 == 0)
+		{
+			memory->addLink(Link(id, id-50, Link::kGlobalClosure, Transform::getIdentity()));
+		}
+	}
+
+	std::map<int, float> likelihood;
+	for(std::map<int, double>::const_iterator iter=memory->getWorkingMem().begin(); iter!=memory->getWorkingMem().end(); ++iter)
+	{
+		likelihood.insert(std::make_pair(iter->first, iter->first==Memory::kIdVirtual?1.0f:rng.uniform(1.0f, 2.0f)));
+	}
+
+	BayesFilter filter(parameters);
+	filter.computePosterior(memory.get(), likelihood);
+	long dense = long(likelihood.size())*long(likelihood.size())*long(sizeof(float));
+	printf("Bayes filter [wm=%d]: sparse prediction=%ld bytes, dense prediction would be %ld bytes\n",
+			(int)likelihood.size(), filter.getMemoryUsed(), dense);
+
+	std::string size = uFormat("wm=%d", (int)likelihood.size());
+	kernels.push_back(new BayesFilterKernel(size, memory, likelihood, false, parameters));
+	kernels.push_back(new BayesFilterKernel(size, memory, likelihood, true, parameters));
+}
+
+// Trajectory with a loop closure every 100 nodes, path is planned from the last node to the first one
+void createPathKernels(std::list<Kernel*> & kernels, int nodes)
+{
+	std::map<int, Transform> poses;
+	std::multimap<int, Link> links;
+	Transform pose = Transform::getIdentity();
+	for(int id=1; id<=nodes; ++id)
+	{
+		pose *= Transform(0.1f, 0.0f, 0.0f, 0.0f, 0.0f, 0.01f);
+		poses.insert(std::make_pair(id, pose));
+		if(id > 1)
+		{
+			links.insert(std::make_pair(id-1, Link(id-1, id, Link::kNeighbor, Transform(0.1f, 0.0f, 0.0f, 0.0f, 0.0f, 0.01f))));
+		}
+		if(id > 100 && id % 100 == 0)
+		{
+			links.insert(std::make_pair(id, Link(id, id-50, Link::kGlobalClosure, Transform::getIdentity())));
+		}
+	}
+
+	std::string size = uFormat("nodes=%d", nodes);
+	kernels.push_back(new GraphComputePathKernel(size, poses, links, nodes, 1));
+	kernels.push_back(new PathGraphComputePathKernel(size, poses, links, nodes, 1));
+	kernels.push_back(new PathGraphUpdateKernel(size, poses, links, true));
+	kernels.push_back(new PathGraphUpdateKernel(size, poses, links, false));
+}
+
+// PNG vs RVL for 16UC1 depth (see Mem/DepthCompressionFormat), compressed sizes are printed
+void createDepthCompressionKernels(std::list<Kernel*> & kernels, const cv::Mat & depth)
+{
+	cv::Mat depth16 = depth;
+	if(depth.type() == CV_32FC1)
+	{
+		depth16 = util2d::cvtDepthFromFloat(depth);
+	}
+	UASSERT(depth16.type() == CV_16UC1);
+	std::string size = uFormat("%dx%d", depth16.cols, depth16.rows);
+	int pngBytes = compressImage2(depth16, ".png").cols;
+	int rvlBytes = compressImage2(depth16, ".rvl").cols;
+	int rawBytes = int(depth16.total()*depth16.elemSize());
+	printf("Depth compression [%s]: raw=%d bytes, .png=%d bytes (%.1f%%), .rvl=%d bytes (%.1f%%)\n",
+			size.c_str(), rawBytes,
+			pngBytes, float(pngBytes)/float(rawBytes)*100.0f,
+			rvlBytes, float(rvlBytes)/float(rawBytes)*100.0f);
+	const char * formats[] = {".png", ".rvl"};
+	for(int i=0; i<2; ++i)
+	{
+		kernels.push_back(new CompressImageKernel(size, depth16, formats[i]));
+		kernels.push_back(new UncompressImageKernel(size, depth16, formats[i]));
+	}
+}
+
+void createSyntheticKernels(std::list<Kernel*> & kernels, const ParametersMap & parameters)
+{
+	cv::RNG rng(42);
+
+	int cloudSizes[] = {10000, 100000, 1000000};
+	for(int i=0; i<3; ++i)
+	{
+		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = createRandomCloud(cloudSizes[i], rng);
+		std::string size = uFormat("n=%d", cloudSizes[i]);
+		kernels.push_back(new VoxelizeKernel(size, cloud, 0.05f));
+		kernels.push_back(new TransformPointCloudKernel(size, cloud));
+		kernels.push_back(new LaserScanFromPointCloudKernel(size, cloud));
+	}
+
+	cv::Size imageSizes[] = {cv::Size(160, 120), cv::Size(320, 240), cv::Size(640, 480)};
+	for(int i=0; i<3; ++i)
+	{
+		kernels.push_back(new FastBilateralFilteringKernel(
+				uFormat("%dx%d", imageSizes[i].width, imageSizes[i].height),
+				createDepth(imageSizes[i].width, imageSizes[i].height, rng)));
+	}
+
+	CameraModel model(525.0, 525.0, 319.5, 239.5, Transform(0,0,1,0, -1,0,0,0, 0,-1,0,0), 0, cv::Size(640, 480));
+	Transform motion(0.1f, 0.02f, 0.01f, 0.0f, 0.0f, 0.05f);
+	int wordSizes[] = {100, 500, 2000};
+	for(int i=0; i<3; ++i)
+	{
+		std::map<int, cv::Point3f> words3A;
+		for(int j=0; j<wordSizes[i]; ++j)
+		{
+			float z = rng.uniform(1.0f, 8.0f);
+			float u = rng.uniform(0.0f, 640.0f);
+			float v = rng.uniform(0.0f, 480.0f);
+			cv::Point3f pt((u-model.cx())*z/model.fx(), (v-model.cy())*z/model.fy(), z);
+			words3A.insert(std::make_pair(j+1, util3d::transformPoint(pt, model.localTransform())));
+		}
+		kernels.push_back(new EstimateMotion3DTo2DKernel(
+				uFormat("n=%d", wordSizes[i]),
+				words3A,
+				projectWords(words3A, model, motion, rng),
+				model));
+	}
+
+	int icpSizes[] = {1000, 10000, 50000};
+	for(int i=0; i<3; ++i)
+	{
+		pcl::PointCloud<pcl::PointNormal>::Ptr target = createCorner(icpSizes[i], rng);
+		pcl::PointCloud<pcl::PointNormal>::Ptr source = util3d::transformPointCloud(createCorner(icpSizes[i], rng), motion.inverse());
+		kernels.push_back(new IcpPointToPlaneKernel(uFormat("n=%d", icpSizes[i]), source, target));
+	}
+
+	// binary descriptors (like ORB)
+	int dictionarySizes[] = {10000, 50000, 200000};
+	cv::Mat queries(500, 32, CV_8UC1);
+	rng.fill(queries, cv::RNG::UNIFORM, 0, 256);
+	for(int i=0; i<3; ++i)
+	{
+		cv::Mat descriptors(dictionarySizes[i], 32, CV_8UC1);
+		rng.fill(descriptors, cv::RNG::UNIFORM, 0, 256);
+		kernels.push_back(new FindNNKernel(uFormat("words=%d,queries=%d", descriptors.rows, queries.rows), descriptors, queries, parameters));
+	}
+
+	// VGA, 720p and 1080p depth, after the other fixtures to keep their random sequence
+	cv::Size depthSizes[] = {cv::Size(640, 480), cv::Size(1280, 720), cv::Size(1920, 1080)};
+	for(int i=0; i<3; ++i)
+	{
+		createUtil2dDepthKernels(kernels, createDepth(depthSizes[i].width, depthSizes[i].height, rng));
+	}
+
+	createDepthCompressionKernels(kernels, createDepth(640, 480, rng));
+	createDepthCompressionKernels(kernels, createDepth(1280, 720, rng));
+
+	cv::Mat rgb(480, 640, CV_8UC3);
+	rng.fill(rgb, cv::RNG::UNIFORM, 0, 256);
+	createDepthProjectionKernels(kernels, rgb, createDepth(640, 480, rng), model);
+
+	int wmSizes[] = {1000, 5000, 10000};
+	for(int i=0; i<3; ++i)
+	{
+		createBayesFilterKernels(kernels, wmSizes[i], rng, parameters);
+	}
+
+	int pathSizes[] = {1000, 10000, 50000};
+	for(int i=0; i<3; ++i)
+	{
+		createPathKernels(kernels, pathSizes[i]);
+	}
+
+	int scanSizes[] = {10000, 100000};
+	LaserScan::Format scanFormats[] = {LaserScan::kXYZ, LaserScan::kXYZI, LaserScan::kXYZRGB, LaserScan::kXY, LaserScan::kXYI};
+	for(int i=0; i<2; ++i)
+	{
+		for(int j=0; j<5; ++j)
+		{
+			createCommonFilteringKernels(kernels, uFormat("n=%d", scanSizes[i]), createRandomScan(scanSizes[i], scanFormats[j], rng));
+		}
+	}
+}
+
+// Fixtures derived from the first frames of a database, sizes are set by decimation
+bool createDatasetKernels(std::list<Kernel*> & kernels, const std::string & path, int maxFrames, const ParametersMap & parameters)
+{
+	DBReader reader(path, 0, true);
+	if(!reader.init())
+	{
+		printf("Failed to initialize the reader with database \"%s\"!\n", path.c_str());
+		return false;
+	}
+
+	Feature2D * detector = Feature2D::create(parameters);
+	std::vector<SensorData> frames;
+	std::vector<cv::Mat> descriptors;
+	std::vector<std::map<int, cv::Point3f> > words3D;
+	SensorData data = reader.takeImage();
+	while(data.isValid() && (int)frames.size() < maxFrames)
+	{
+		if(!data.depthOrRightRaw().empty() && !data.imageRaw().empty())
+		{
+			cv::Mat gray = data.imageRaw();
+			if(gray.channels() == 3)
+			{
+				cv::cvtColor(gray, gray, cv::COLOR_BGR2GRAY);
+			}
+			std::vector<cv::KeyPoint> keypoints = detector->generateKeypoints(gray);
+			descriptors.push_back(detector->generateDescriptors(gray, keypoints));
+			std::vector<cv::Point3f> points3D = detector->generateKeypoints3D(data, keypoints);
+			std::map<int, cv::Point3f> words;
+			for(unsigned int i=0; i<points3D.size(); ++i)
+			{
+				if(util3d::isFinite(points3D[i]))
+				{
+					words.insert(std::make_pair((int)i+1, points3D[i]));
+				}
+			}
+			words3D.push_back(words);
+			frames.push_back(data);
+		}
+		data = reader.takeImage();
+	}
+	delete detector;
+
+	if(frames.size() < 2)
+	{
+		printf("At least 2 frames with images and depth/stereo are required in database \"%s\".\n", path.c_str());
+		return false;
+	}
+	printf("Loaded %d frames from \"%s\".\n", (int)frames.size(), path.c_str());
+
+	const SensorData & frameA = frames[frames.size()/2-1];
+	const SensorData & frameB = frames[frames.size()/2];
+
+	int decimations[] = {4, 2, 1};
+	for(int i=0; i<3; ++i)
+	{
+		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = util3d::cloudFromSensorData(frameA, decimations[i]);
+		std::string size = uFormat("n=%d", (int)cloud->size());
+		kernels.push_back(new VoxelizeKernel(size, cloud, 0.05f));
+		kernels.push_back(new TransformPointCloudKernel(size, cloud));
+		kernels.push_back(new LaserScanFromPointCloudKernel(size, cloud));
+
+		// NaNs of the invalid depth pixels are removed, as in scans created from clouds
+		LaserScan scan(util3d::laserScanFromPointCloud(*cloud), 0, 0, LaserScan::kXYZ);
+		createCommonFilteringKernels(kernels, uFormat("n=%d", scan.size()), scan);
+		LaserScan scanRGB(util3d::laserScanFromPointCloud(*util3d::cloudRGBFromSensorData(frameA, decimations[i])), 0, 0, LaserScan::kXYZRGB);
+		createCommonFilteringKernels(kernels, uFormat("n=%d", scanRGB.size()), scanRGB);
+
+		if(frameA.depthRaw().type() == CV_32FC1 || frameA.depthRaw().type() == CV_16UC1)
+		{
+			cv::Mat depth = util2d::decimate(frameA.depthRaw(), decimations[i]);
+			kernels.push_back(new FastBilateralFilteringKernel(uFormat("%dx%d", depth.cols, depth.rows), depth));
+			createUtil2dDepthKernels(kernels, depth);
+		}
+
+		pcl::PointCloud<pcl::PointNormal>::Ptr icpClouds[2];
+		const SensorData * icpFrames[2] = {&frameA, &frameB};
+		for(int j=0; j<2; ++j)
+		{
+			pcl::PointCloud<pcl::PointXYZ>::Ptr icpCloud = util3d::voxelize(util3d::cloudFromSensorData(*icpFrames[j], decimations[i], 4.0f), 0.01f*float(decimations[i]));
+			icpClouds[j].reset(new pcl::PointCloud<pcl::PointNormal>);
+			if(icpCloud->size())
+			{
+				pcl::PointCloud<pcl::Normal>::Ptr normals = util3d::computeNormals(icpCloud, 10);
+				pcl::concatenateFields(*icpCloud, *normals, *icpClouds[j]);
+			}
+		}
+		if(icpClouds[0]->size() && icpClouds[1]->size())
+		{
+			kernels.push_back(new IcpPointToPlaneKernel(uFormat("n=%d", (int)icpClouds[0]->size()), icpClouds[1], icpClouds[0]));
+		}
+	}
+
+	if(!frameA.laserScanRaw().isEmpty())
+	{
+		createCommonFilteringKernels(kernels, uFormat("n=%d", frameA.laserScanRaw().size()), frameA.laserScanRaw());
+	}
+
+	if(frameA.depthRaw().type() == CV_32FC1 || frameA.depthRaw().type() == CV_16UC1)
+	{
+		createDepthCompressionKernels(kernels, frameA.depthRaw());
+		if(frameA.cameraModels().size() == 1 && frameA.cameraModels()[0].isValidForProjection())
+		{
+			cv::Mat rgb = frameA.imageRaw();
+			if(rgb.rows % frameA.depthRaw().rows != 0 || rgb.cols % frameA.depthRaw().cols != 0)
+			{
+				// RGB size should be a multiple of the depth size
+				rgb = cv::Mat();
+			}
+			createDepthProjectionKernels(kernels, rgb, frameA.depthRaw(), frameA.cameraModels()[0]);
+		}
+	}
+
+	// real keypoints, synthetic projections
+	CameraModel model = frameA.cameraModels().size()?frameA.cameraModels()[0]:frameA.stereoCameraModel().left();
+	if(model.isValidForReprojection())
+	{
+		cv::RNG rng(42);
+		Transform motion(0.1f, 0.02f, 0.01f, 0.0f, 0.0f, 0.05f);
+		const std::map<int, cv::Point3f> & words = words3D[frames.size()/2-1];
+		for(int i=0; i<3; ++i)
+		{
+			std::map<int, cv::Point3f> words3A;
+			for(std::map<int, cv::Point3f>::const_iterator iter=words.begin(); iter!=words.end(); ++iter)
+			{
+				if(iter->first % decimations[i] == 0)
+				{
+					words3A.insert(*iter);
+				}
+			}
+			if(words3A.size() >= 10)
+			{
+				kernels.push_back(new EstimateMotion3DTo2DKernel(
+						uFormat("n=%d", (int)words3A.size()),
+						words3A,
+						projectWords(words3A, model, motion, rng),
+						model));
+			}
+		}
+	}
+
+	// dictionary from the previous frames, queries from the last one
+	for(int i=0; i<3; ++i)
+	{
+		cv::Mat dictionaryDescriptors;
+		for(unsigned int j=0; j<descriptors.size()-1; j+=decimations[i])
+		{
+			if(!descriptors[j].empty())
+			{
+				dictionaryDescriptors.push_back(descriptors[j]);
+			}
+		}
+		if(!dictionaryDescriptors.empty() && !descriptors.back().empty())
+		{
+			kernels.push_back(new FindNNKernel(
+					uFormat("words=%d,queries=%d", dictionaryDescriptors.rows, descriptors.back().rows),
+					dictionaryDescriptors,
+					descriptors.back(),
+					parameters));
+		}
+	}
+	return true;
+}
+
+std::map<std::string, Result> loadResults(const std::string & path)
+{
+	std::map<std::string, Result> results;
+	std::ifstream file(path.c_str());
+	std::string line;
+	while(std::getline(file, line))
+	{
+		if(line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+		std::list<std::string> strs = uSplit(line, ' ');
+		if(strs.size() == 5)
+		{
+			Result result;
+			result.name = uValueAt(strs, 0);
+			result.median = uStr2Double(uValueAt(strs, 1));
+			result.mean = uStr2Double(uValueAt(strs, 2));
+			result.min = uStr2Double(uValueAt(strs, 3));
+			result.iterations = uStr2Int(uValueAt(strs, 4));
+			results.insert(std::make_pair(result.name, result));
+		}
+	}
+	return results;
+}
+
+int main(int argc, char * argv[])
+{
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kError);
+
+	ParametersMap parameters = Parameters::parseArguments(argc, argv);
+
+	std::string databasePath;
+	int databaseFrames = 20;
+	std::string filter;
+	double minTime = 0.5;
+	int minIterations = 5;
+	std::string outputPath;
+	std::string baselinePath;
+	float threshold = 10.0f;
+	for(int i=1; i<argc; ++i)
+	{
+		if(strcmp(argv[i], "--db") == 0 && i+1<argc)
+		{
+			databasePath = uReplaceChar(argv[++i], '~', UDirectory::homeDir());
+		}
+		else if(strcmp(argv[i], "--db_frames") == 0 && i+1<argc)
+		{
+			databaseFrames = std::max(2, atoi(argv[++i]));
+		}
+		else if(strcmp(argv[i], "--filter") == 0 && i+1<argc)
+		{
+			filter = argv[++i];
+		}
+		else if(strcmp(argv[i], "--min_time") == 0 && i+1<argc)
+		{
+			minTime = uStr2Double(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--min_iterations") == 0 && i+1<argc)
+		{
+			minIterations = std::max(1, atoi(argv[++i]));
+		}
+		else if(strcmp(argv[i], "--output") == 0 && i+1<argc)
+		{
+			outputPath = uReplaceChar(argv[++i], '~', UDirectory::homeDir());
+		}
+		else if(strcmp(argv[i], "--baseline") == 0 && i+1<argc)
+		{
+			baselinePath = uReplaceChar(argv[++i], '~', UDirectory::homeDir());
+		}
+		else if(strcmp(argv[i], "--threshold") == 0 && i+1<argc)
+		{
+			threshold = uStr2Float(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--h") == 0)
+		{
+			showUsage();
+		}
+	}
+
+	std::map<std::string, Result> baseline;
+	if(!baselinePath.empty())
+	{
+		if(!UFile::exists(baselinePath))
+		{
+			printf("Baseline \"%s\" doesn't exist!\n", baselinePath.c_str());
+			return -1;
+		}
+		baseline = loadResults(baselinePath);
+		printf("Loaded %d results from baseline \"%s\" (threshold=%.1f%%).\n", (int)baseline.size(), baselinePath.c_str(), threshold);
+	}
+
+	printf("Creating fixtures...\n");
+	std::list<Kernel*> kernels;
+	if(!databasePath.empty())
+	{
+		if(!createDatasetKernels(kernels, databasePath, databaseFrames, parameters))
+		{
+			return -1;
+		}
+	}
+	else
+	{
+		createSyntheticKernels(kernels, parameters);
+	}
+
+	std::vector<Result> results;
+	int regressions = 0;
+	int mismatches = 0;
+	printf("%-60s %10s %10s %10s %6s\n", "kernel", "median(ms)", "mean(ms)", "min(ms)", "iter");
+	for(std::list<Kernel*>::iterator iter=kernels.begin(); iter!=kernels.end(); ++iter)
+	{
+		if(!filter.empty() && (*iter)->name().find(filter) == std::string::npos)
+		{
+			continue;
+		}
+		std::string error;
+		if(!(*iter)->check(error))
+		{
+			printf("%-60s MISMATCH: %s\n", (*iter)->name().c_str(), error.c_str());
+			++mismatches;
+			continue;
+		}
+		Result result = timeKernel(**iter, minTime, minIterations);
+		results.push_back(result);
+		printf("%-60s %10.3f %10.3f %10.3f %6d", result.name.c_str(), result.median, result.mean, result.min, result.iterations);
+		std::map<std::string, Result>::iterator jter = baseline.find(result.name);
+		if(jter != baseline.end() && jter->second.median > 0.0)
+		{
+			float change = float((result.median - jter->second.median) / jter->second.median * 100.0);
+			bool regression = change > threshold;
+			printf("  %+.1f%%%s", change, regression?" REGRESSION":"");
+			regressions += regression?1:0;
+		}
+		else if(!baseline.empty())
+		{
+			printf("  (not in baseline)");
+		}
+		printf("\n");
+	}
+	for(std::list<Kernel*>::iterator iter=kernels.begin(); iter!=kernels.end(); ++iter)
+	{
+		delete *iter;
+	}
+	kernels.clear();
+
+	if(!outputPath.empty())
+	{
+		std::ofstream file(outputPath.c_str());
+		if(!file.is_open())
+		{
+			printf("Failed to open \"%s\" for writing!\n", outputPath.c_str());
+			return -1;
+		}
+		file << "# name median_ms mean_ms min_ms iterations" << std::endl;
+		for(unsigned int i=0; i<results.size(); ++i)
+		{
+			file << results[i].name << " "
+				 << uNumber2Str(results[i].median) << " "
+				 << uNumber2Str(results[i].mean) << " "
+				 << uNumber2Str(results[i].min) << " "
+				 << results[i].iterations << std::endl;
+		}
+		file.close();
+		printf("Results saved to \"%s\".\n", outputPath.c_str());
+	}
+
+	if(mismatches)
+	{
+		printf("%d kernel(s) don't match their reference implementation!\n", mismatches);
+	}
+	if(regressions)
+	{
+		printf("%d kernel(s) slower than the baseline by more than %.1f%%!\n", regressions, threshold);
+	}
+	return mismatches || regressions?1:0;
+}
@@ -0,0 +1,244 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <rtabmap/core/DBDriver.h>
+#include <rtabmap/core/Signature.h>
+#include <rtabmap/core/Compression.h>
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UFile.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <pcl/pcl_config.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("\nUsage:\n"
+			"rtabmap-recompress [options] database.db\n"
+			"  Recompress laser scans, occupancy grids, optimized poses, 2D map\n"
+			"  and optimized mesh of the database with another codec. Images and\n"
+			"  user data are not modified.\n"
+			"Options:\n"
+			"    -c #          Codec: 0=zlib, 1=LZ4, 2=zstd (default: zstd, or LZ4\n"
+			"                  then zlib if RTAB-Map is not built with them). Only\n"
+			"                  zlib is used on databases older than 0.20.0.\n"
+			"    -n #          Nodes loaded at the same time (default 100).\n"
+			"\n");
+	exit(1);
+}
+
+int main(int argc, char * argv[])
+{
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kError);
+
+	if(argc < 2)
+	{
+		showUsage();
+	}
+
+	int codec = isCompressionCodecAvailable(kCompressionZstd)?kCompressionZstd:
+				isCompressionCodecAvailable(kCompressionLZ4)?kCompressionLZ4:
+				kCompressionZlib;
+	int nodesPerBatch = 100;
+	for(int i=1; i<argc-1; ++i)
+	{
+		if(strcmp(argv[i], "--help") == 0)
+		{
+			showUsage();
+		}
+		else if(strcmp(argv[i], "-c") == 0)
+		{
+			++i;
+			if(i<argc-1)
+			{
+				codec = uStr2Int(argv[i]);
+			}
+			else
+			{
+				showUsage();
+			}
+		}
+		else if(strcmp(argv[i], "-n") == 0)
+		{
+			++i;
+			if(i<argc-1)
+			{
+				nodesPerBatch = uStr2Int(argv[i]);
+				if(nodesPerBatch < 1)
+				{
+					showUsage();
+				}
+			}
+			else
+			{
+				showUsage();
+			}
+		}
+	}
+
+	std::string dbPath = argv[argc-1];
+	if(!UFile::exists(dbPath))
+	{
+		printf("Database %s doesn't exist!\n", dbPath.c_str());
+		return -1;
+	}
+	if(codec < kCompressionZlib || codec > kCompressionZstd || !isCompressionCodecAvailable((CompressionCodec)codec))
+	{
+		printf("Codec %d is not available (RTAB-Map should be built with LZ4 or Zstandard).\n", codec);
+		return -1;
+	}
+	long sizeBefore = UFile::length(dbPath);
+
+	printf("\nDatabase: %s\n", dbPath.c_str());
+	printf("Codec: %s\n", codec==kCompressionZlib?"zlib":codec==kCompressionLZ4?"LZ4":"zstd");
+
+	ParametersMap parameters;
+	parameters.insert(ParametersPair(Parameters::kDbCompressionCodec(), uNumber2Str(codec)));
+	DBDriver * driver = DBDriver::create(parameters);
+	if(!driver->openConnection(dbPath, false))
+	{
+		printf("Failed to open database %s!\n", dbPath.c_str());
+		delete driver;
+		return -1;
+	}
+	if(driver->getCompressionCodec() != codec)
+	{
+		printf("Database version %s is older than 0.20.0, zlib is used so that it can still be read by older versions.\n",
+				driver->getDatabaseVersion().c_str());
+	}
+
+	UTimer timer;
+	std::set<int> ids;
+	driver->getAllNodeIds(ids);
+	int scans = 0;
+	int grids = 0;
+	int processed = 0;
+	std::list<int> batch;
+	for(std::set<int>::iterator iter=ids.begin(); iter!=ids.end(); ++iter)
+	{
+		batch.push_back(*iter);
+		if((int)batch.size() < nodesPerBatch && *iter != *ids.rbegin())
+		{
+			continue;
+		}
+
+		std::list<Signature*> signatures;
+		driver->loadSignatures(batch, signatures);
+		driver->loadNodeData(signatures, false, true, false, true);
+		std::vector<SensorData*> data;
+		for(std::list<Signature*>::iterator jter=signatures.begin(); jter!=signatures.end(); ++jter)
+		{
+			data.push_back(&(*jter)->sensorData());
+		}
+		SensorData::uncompressData(data);
+
+		driver->beginTransaction();
+		for(std::list<Signature*>::iterator jter=signatures.begin(); jter!=signatures.end(); ++jter)
+		{
+			const SensorData & d = (*jter)->sensorData();
+			if(!d.laserScanRaw().isEmpty())
+			{
+				driver->updateLaserScan((*jter)->id(), d.laserScanRaw());
+				++scans;
+			}
+			if(d.gridCellSize() > 0.0f &&
+			   (!d.gridGroundCellsRaw().empty() || !d.gridObstacleCellsRaw().empty() || !d.gridEmptyCellsRaw().empty()))
+			{
+				driver->updateOccupancyGrid(
+						(*jter)->id(),
+						d.gridGroundCellsRaw(),
+						d.gridObstacleCellsRaw(),
+						d.gridEmptyCellsRaw(),
+						d.gridCellSize(),
+						d.gridViewPoint());
+				++grids;
+			}
+			delete *jter;
+		}
+		driver->commit();
+
+		processed += (int)batch.size();
+		batch.clear();
+		printf("Processed %d/%d nodes...\n", processed, (int)ids.size());
+	}
+	printf("Recompressed %d laser scans and %d occupancy grids.\n", scans, grids);
+
+	Transform lastLocalizationPose;
+	std::map<int, Transform> optimizedPoses = driver->loadOptimizedPoses(&lastLocalizationPose);
+	if(!optimizedPoses.empty())
+	{
+		driver->saveOptimizedPoses(optimizedPoses, lastLocalizationPose);
+		printf("Recompressed optimized poses.\n");
+	}
+
+	float xMin, yMin, cellSize;
+	cv::Mat map = driver->load2DMap(xMin, yMin, cellSize);
+	if(!map.empty())
+	{
+		driver->save2DMap(map, xMin, yMin, cellSize);
+		printf("Recompressed 2D map.\n");
+	}
+
+	std::vector<std::vector<std::vector<unsigned int> > > polygons;
+#if PCL_VERSION_COMPARE(>=, 1, 8, 0)
+	std::vector<std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > > texCoords;
+#else
+	std::vector<std::vector<Eigen::Vector2f> > texCoords;
+#endif
+	cv::Mat textures;
+	cv::Mat cloud = driver->loadOptimizedMesh(&polygons, &texCoords, &textures);
+	if(!cloud.empty())
+	{
+		if(textures.empty())
+		{
+			driver->saveOptimizedMesh(cloud, polygons, texCoords);
+			printf("Recompressed optimized mesh.\n");
+		}
+		else
+		{
+			// textures would be re-encoded in JPEG
+			printf("Optimized mesh is textured, it is kept as is.\n");
+		}
+	}
+
+	driver->closeConnection(true);
+	delete driver;
+
+	long sizeAfter = UFile::length(dbPath);
+	printf("Done in %.3fs. Database size: %.1f MB -> %.1f MB\n",
+			timer.ticks(),
+			double(sizeBefore)/(1024.0*1024.0),
+			double(sizeAfter)/(1024.0*1024.0));
+	printf("Note that sqlite doesn't shrink the file, use \"sqlite3 database.db 'VACUUM;'\" to reclaim free pages.\n");
+
+	return 0;
+}
@@ -55,6 +55,8 @@ void showUsage()
 			"   To see warnings when loop closures are rejected, add \"--uwarn\" argument.\n"
 			"  Options:\n"
 			"     -r                Use database stamps as input rate.\n"
+			"     -ra #             Read-ahead: load and decompress the next # nodes\n"
+			"                       in background (default 0, disabled).\n"
 			"     -c \"path.ini\"   Configuration file, overwriting parameters read \n"
 			"                       from the database. If custom parameters are also set as \n"
 			"                       arguments, they overwrite those in config file and the database.\n"
@@ -152,6 +154,7 @@ int main(int argc, char * argv[])
 	bool assemble2dOctoMap = false;
 	bool assemble3dOctoMap = false;
 	bool useDatabaseRate = false;
+	int readAhead = 0;
 	ParametersMap configParameters;
 	for(int i=1; i<argc-2; ++i)
 	{
@@ -160,6 +163,19 @@ int main(int argc, char * argv[])
 			useDatabaseRate = true;
 			printf("Using database stamps as input rate.\n");
 		}
+		else if(strcmp(argv[i], "-ra") == 0 || strcmp(argv[i], "--ra") == 0)
+		{
+			++i;
+			if(i < argc - 2)
+			{
+				readAhead = atoi(argv[i]);
+				printf("Reading ahead %d nodes (-ra option).\n", readAhead);
+			}
+			else
+			{
+				showUsage();
+			}
+		}
 		else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--c") == 0)
 		{
 			++i;
@@ -323,6 +339,7 @@ int main(int argc, char * argv[])
 	Parameters::parse(parameters, Parameters::kRGBDEnabled(), rgbdEnabled);
 	bool odometryIgnored = !rgbdEnabled;
 	DBReader dbReader(inputDatabasePath, useDatabaseRate?-1:0, odometryIgnored);
+	dbReader.setReadAhead(readAhead);
 	dbReader.init();
 
 	OccupancyGrid grid(parameters);
@@ -334,6 +351,7 @@ int main(int argc, char * argv[])
 	printf("Reprocessing data of \"%s\"...\n", inputDatabasePath.c_str());
 	std::map<std::string, float> globalMapStats;
 	int processed = 0;
+	float readAheadOccupancy = 0.0f;
 	CameraInfo info;
 	SensorData data = dbReader.takeImage(&info);
 	Transform lastLocalizationPose = info.odomPose;
@@ -489,6 +507,7 @@ int main(int argc, char * argv[])
 		}
 
 		Transform odomPose = info.odomPose;
+		readAheadOccupancy += dbReader.getReadAheadQueueSize();
 		data = dbReader.takeImage(&info);
 
 		if(!incrementalMemory &&
@@ -507,6 +526,13 @@ int main(int argc, char * argv[])
 	{
 		printf("Total loop closures = %d\n", loopCount);
 	}
+	if(readAhead > 0)
+	{
+		printf("Read-ahead: %.1f nodes/s loaded, average queue occupancy %.1f/%d\n",
+				dbReader.getReadAheadFrameRate(),
+				processed?readAheadOccupancy/float(processed):0.0f,
+				readAhead);
+	}
 
 	printf("Closing database \"%s\"...\n", outputDatabasePath.c_str());
 	rtabmap.close(true);
@@ -151,6 +151,7 @@ protected:
      * @return "true" to notify UEventsManager that this handler took ownership of the
      *         event (meaning it must delete it). The event will
      *         not be dispatched to next handlers.
+     *         Not allowed for events received from a UEventsManager::kDeliveryQueued subscription.
      * @return "false" to let event be dispatched to next handlers (default behavior). UEventsManager
      *         will take care of deleting the event.
      *
@@ -29,6 +29,9 @@
 
 #include <list>
 #include <map>
+#include <memory>
+#include <set>
+#include <vector>
 
 // TODO Not implemented... for multithreading event handling
 class UEventDispatcher : public UThread
@@ -64,6 +67,15 @@ private:
  * UEventsManager::addHandler(). To remove, use
  * UEventsManager::removeHandler().
  *
+ * By default, a handler receives all events from the UEventsManager's thread. A
+ * handler can instead subscribe to the events it handles with
+ * UEventsManager::subscribe(), it will then receive only those events. Each
+ * subscription selects how events are delivered (see DeliveryMode): from the
+ * UEventsManager's thread, directly in the thread posting the event or through
+ * a queue with its own thread, so that a slow handler doesn't delay the others.
+ * Latency and queue depth of each event name can be monitored with
+ * UEventsManager::getTopicStatistics().
+ *
  * @code
  *  // Anywhere in the code:
  *  UEventsManager::post(new MyEvent()); // where MyEvent is an implemented UEvent
@@ -74,10 +86,43 @@ private:
  * @see post()
  * @see addHandler()
  * @see removeHandler()
+ * @see subscribe()
  */
 class UTILITE_EXP UEventsManager : public UThread{
 
 public:
+    /**
+     * How events of a subscription are delivered to the handler.
+     */
+    enum DeliveryMode {
+    	kDeliveryDispatcher, /**< From the UEventsManager's thread, like handlers without subscriptions. */
+    	kDeliveryDirect,     /**< Immediately in the thread posting the event, handleEvent() must be fast and thread-safe. */
+    	kDeliveryQueued      /**< In a thread owned by the subscription, handleEvent() must not take ownership of the event (it is shared). */
+    };
+
+    /**
+     * Delivery statistics of an event name.
+     * @see getTopicStatistics()
+     */
+    struct TopicStatistics
+    {
+    	TopicStatistics() :
+    		posted(0),
+    		deliveries(0),
+    		totalLatency(0.0),
+    		maxLatency(0.0),
+    		queueDepth(0),
+    		maxQueueDepth(0)
+    	{}
+    	double meanLatency() const {return deliveries?totalLatency/double(deliveries):0.0;}
+
+    	unsigned long posted;     /**< Events posted. */
+    	unsigned long deliveries; /**< Calls to UEventsHandler::handleEvent(). */
+    	double totalLatency;      /**< Sum of the delays (sec) between post and delivery. */
+    	double maxLatency;        /**< Maximum delay (sec) between post and delivery. */
+    	int queueDepth;           /**< Events waiting in the dispatcher and subscriber queues. */
+    	int maxQueueDepth;        /**< Maximum of queueDepth. */
+    };
 
     /**
      * This method is used to add an events 
@@ -95,6 +140,37 @@ public:
      */
     static void removeHandler(UEventsHandler* handler);
 
+    /**
+     * Subscribe an handler to an event name (the event's UEvent::getClassName()).
+     * Once subscribed to at least one event name, the handler receives only the
+     * events it is subscribed to. The handler must be already added with addHandler().
+     * Subscribing again to the same event name changes the delivery mode.
+     * Events with the same delivery mode are received in the order they are posted.
+     *
+     * @code
+     * UEventsManager::addHandler(&odomThread);
+     * UEventsManager::subscribe(&odomThread, "CameraEvent", UEventsManager::kDeliveryQueued);
+     * UEventsManager::subscribe(&odomThread, "OdometryResetEvent");
+     * @endcode
+     *
+     * @param handler the handler, already added to UEventsManager.
+     * @param eventName the class name of the events.
+     * @param mode how the events are delivered to the handler.
+     */
+    static void subscribe(UEventsHandler * handler, const std::string & eventName, DeliveryMode mode = kDeliveryDispatcher);
+
+    /**
+     * Remove a subscription. When the handler doesn't have subscriptions anymore,
+     * it receives all events again.
+     */
+    static void unsubscribe(UEventsHandler * handler, const std::string & eventName);
+
+    /**
+     * @param reset reset the counters (except queue depths) after they are returned.
+     * @return the statistics of each event name posted.
+     */
+    static std::map<std::string, TopicStatistics> getTopicStatistics(bool reset = false);
+
     /**
      * This method is used to post an event to
      * handlers.
@@ -173,9 +249,55 @@ private:
     virtual void dispatchEvents();
 
     /*
-	 * This method dispatches an event to all handlers.
+	 * This method dispatches an event to handlers called from the UEventsManager's
+	 * thread (or the caller thread for synchronous posts), then to queued
+	 * subscribers if not taken.
 	 */
-    virtual bool dispatchEvent(UEvent * event, const UEventsSender * sender);
+    bool dispatchEvent(UEvent * event, const std::string & eventName, const UEventsSender * sender, double stamp);
+
+    class SubscriberQueue;
+    friend class SubscriberQueue;
+    struct Envelope;
+    struct Route
+    {
+    	std::vector<UEventsHandler*> direct;
+    	std::vector<UEventsHandler*> dispatched;
+    	std::vector<UEventsHandler*> queued;
+    };
+
+    /*
+     * Handlers receiving the event. handlersMutex_ must be locked. Cached routes
+     * are shared, not copied: they are replaced (not modified) when handlers
+     * or subscriptions change, so the returned route can be used after unlocking.
+     */
+    std::shared_ptr<const Route> getRoute(const std::string & eventName, const std::list<UEventsHandler*> & pipes);
+
+    /*
+     * Call handleEvent() of the handlers still added, stopping when one takes the event.
+     */
+    bool deliver(const std::vector<UEventsHandler*> & handlers, UEvent * event, const std::string & eventName, const UEventsSender * sender, double stamp);
+
+    /*
+     * Push the event to queued subscribers.
+     * @return false if there are no queued subscribers, the event is not taken.
+     */
+    bool enqueue(UEvent * event, const std::string & eventName, const UEventsSender * sender, double stamp, const std::list<UEventsHandler*> & pipes);
+    void deliverQueued(UEventsHandler * handler, Envelope * envelope);
+
+    /*
+     * Move the queue of the handler in queues if it doesn't have queued subscriptions. handlersMutex_ must be locked.
+     */
+    void takeUnusedQueue(UEventsHandler * handler, std::list<SubscriberQueue*> & queues);
+
+    /*
+     * Stop and delete the queues, handlersMutex_ must not be locked.
+     */
+    void deleteQueues(const std::list<SubscriberQueue*> & queues);
+
+    void _subscribe(UEventsHandler * handler, const std::string & eventName, DeliveryMode mode);
+    void _unsubscribe(UEventsHandler * handler, const std::string & eventName);
+    std::map<std::string, TopicStatistics> _getTopicStatistics(bool reset);
+    void updateStatistics(const std::string & eventName, int posted, int queueDelta, double latency);
 
     /*
      * This method is used to add an events 
@@ -241,8 +363,30 @@ private:
 
     static UEventsManager* instance_;            /* The EventsManager instance pointer. */
     static UDestroyer<UEventsManager> destroyer_; /* The EventsManager's destroyer. */
-    std::list<std::pair<UEvent*, const UEventsSender * > > events_; /* The events list. */
+
+    class PostedEvent
+    {
+    public:
+    	PostedEvent(UEvent * event, const UEventsSender * sender, const std::string & eventName, double stamp) :
+    		event_(event),
+    		sender_(sender),
+    		eventName_(eventName),
+    		stamp_(stamp)
+    	{}
+    	UEvent * event_;
+    	const UEventsSender * sender_;
+    	std::string eventName_;
+    	double stamp_;
+    };
+    std::list<PostedEvent> events_;              /* The events list. */
     std::list<UEventsHandler*> handlers_;      /* The handlers list. */
+    std::set<UEventsHandler*> handlersSet_;    /* The handlers, for fast lookup. */
+    std::map<UEventsHandler*, std::map<std::string, DeliveryMode> > subscriptions_; /* Protected by handlersMutex_. */
+    std::map<UEventsHandler*, SubscriberQueue*> queues_; /* Protected by handlersMutex_. */
+    std::map<std::string, std::shared_ptr<const Route> > routes_;       /* Cached routes without pipes, protected by handlersMutex_. */
+    std::list<SubscriberQueue*> retiredQueues_; /* Queues killed from their own thread, protected by handlersMutex_. */
+    std::map<std::string, TopicStatistics> statistics_;
+    UMutex statisticsMutex_;
     UMutex eventsMutex_;                         /* The mutex of the events list, */
     UMutex handlersMutex_;                       /* The mutex of the handlers list. */
     USemaphore postEventSem_;                    /* Semaphore used to signal when an events is posted. */
@@ -170,6 +170,12 @@ private:
  * If you want the application to exit on a lower severity level than kFatal,
  * you can set ULogger::setExitLevel() to any ULogger::Type you want.
  *
+ * To avoid slowing down the logging threads, ULogger::setAsynchronous() can be
+ * set to true: the format string and the arguments are only copied in a ring buffer of the
+ * calling thread, they are formatted and written by a background thread. With the kTypeBinaryFile
+ * type, messages are not formatted at all but saved in a compact binary file, which
+ * can be converted to text afterwards with ULogger::decodeBinaryLog() (or the rtabmap-log_decoder tool).
+ *
  * Example:
  * @code
  * #include <utilite/ULogger.h>
@@ -238,10 +244,12 @@ public:
     /**
      * Loggers available:
      * @code
-     * kTypeNoLog, kTypeConsole, kTypeFile
+     * kTypeNoLog, kTypeConsole, kTypeFile, kTypeBinaryFile
      * @endcode
+     * With kTypeBinaryFile, the format strings and their arguments are saved
+     * without being formatted, see decodeBinaryLog().
      */
-    enum Type{kTypeNoLog, kTypeConsole, kTypeFile};
+    enum Type{kTypeNoLog, kTypeConsole, kTypeFile, kTypeBinaryFile};
 
     /**
      * Logger levels, from lowest severity to highest:
@@ -325,6 +333,24 @@ public:
     static void setBuffered(bool buffered);
     static bool isBuffered() {return buffered_;}
 
+    /**
+     * Set if the messages are written by a background thread, default false. When true, the
+     * logging threads only copy the format string and its arguments in their own ring buffer
+     * (of "bufferSize" bytes), formatting and writing are done later by the background thread.
+     * When a ring buffer is full, messages are dropped and the number of
+     * dropped messages is logged. Fatal messages and messages sent as events (see setEventLevel())
+     * are still written synchronously, after the pending messages.
+     * Messages of a same thread are always written in the order they were logged. Messages
+     * of different threads are sorted only among those written by the same flush: a message
+     * logged while the background thread is flushing can be written after more recent messages
+     * of other threads (see setPrintTime() to compare them).
+     * @see ULogger::flush()
+     * @param asynchronous true to write messages in a background thread, otherwise set to false.
+     * @param bufferSize size in bytes of the ring buffer of each thread (threads already logging keep their buffer).
+     */
+    static void setAsynchronous(bool asynchronous, int bufferSize = 1024*1024);
+    static bool isAsynchronous() {return asynchronous_;}
+
     /**
      * Set logger level: default kInfo. All messages over the severity set
      * are printed, other are ignored. The severity is from the lowest to
@@ -369,11 +395,21 @@ public:
     static void reset();
 
     /**
-	 * Flush buffered messages.
+	 * Flush buffered messages and messages not yet written by the asynchronous logger.
 	 * @see setBuffered()
+	 * @see setAsynchronous()
 	 */
 	static void flush();
 
+	/**
+	 * Convert a log saved with kTypeBinaryFile type to text. Messages are formatted
+	 * with the current printing options (see setPrintTime(), setPrintWhere()...), without colors.
+	 * @param binaryLogPath the binary log file
+	 * @param output where the text is written (e.g., stdout or a file opened with fopen())
+	 * @return false if the file cannot be read or is not a binary log.
+	 */
+	static bool decodeBinaryLog(const std::string & binaryLogPath, FILE * output);
+
     /**
      * Write a message directly to logger without level handling.
      * @param msg the message to write.
@@ -475,6 +511,58 @@ private:
     virtual void _write(const char*, va_list) {} // Do nothing by default
     virtual void _writeStr(const char*) {} // Do nothing by default
 
+protected:
+    /*
+     * A message with its format string and arguments not yet formatted.
+     */
+    struct Record;
+
+    /*
+     * Write a message not yet formatted. By default, the message is
+     * formatted like in write() and written with _writeStr().
+     */
+    virtual void _writeRecord(const Record & record);
+
+private:
+    /*
+     * Time in microseconds since epoch.
+     */
+    static long long currentTime();
+    static int formatTime(long long time, std::string & timeStr);
+
+    /*
+     * Level, thread ID, time and where the message is written, depending
+     * on the printing options.
+     */
+    static std::string formatPrefix(Level level,
+    		const char * file,
+    		int line,
+    		const char * function,
+    		unsigned long threadId,
+    		long long time);
+
+    /*
+     * Copy the message in the ring buffer of the current thread.
+     * Return false if the message cannot be queued (e.g., the thread is exiting).
+     */
+    static bool writeAsync(Level level,
+    		const char * file,
+    		int line,
+    		const char * function,
+    		const char* msg,
+    		va_list args);
+
+    /*
+     * Write the messages in the ring buffers of all threads.
+     */
+    static void writePendingAsync();
+
+    /*
+     * Background thread calling writePendingAsync().
+     */
+    class Flusher;
+    friend class Flusher;
+
 private:
     /*
      * The Logger instance pointer.
@@ -568,6 +656,15 @@ private:
 
 	static std::string bufferedMsgs_;
 
+	/*
+	 * If the messages are written by the Flusher thread.
+	 * Default is false.
+	 */
+	static bool asynchronous_;
+	static int asyncBufferSize_;
+	static Flusher * flusher_;
+	static UDestroyer<Flusher> flusherDestroyer_;
+
 	static std::set<unsigned long> threadIdFilter_;
 	static std::map<std::string, unsigned long> registeredThreads_;
 };
@@ -36,6 +36,12 @@ public:
 	 * @return the number of bytes used by the current process.
 	 */
 	static long int getMemoryUsage();
+
+	/**
+	 * Get the peak memory used by the current process (high water mark).
+	 * @return the maximum number of bytes used by the current process since it started.
+	 */
+	static long int getPeakMemoryUsage();
 };
 
 #endif /* UPROCESSINFO_H */
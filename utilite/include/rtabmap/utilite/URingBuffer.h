@@ -0,0 +1,279 @@
+/*
+*  utilite is a cross-platform library with
+*  useful utilities for fast and small developing.
+*  Copyright (C) 2010  Mathieu Labbe
+*
+*  utilite is free library: you can redistribute it and/or modify
+*  it under the terms of the GNU Lesser General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  utilite is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef URINGBUFFER_H
+#define URINGBUFFER_H
+
+#include "rtabmap/utilite/UMutex.h"
+#include "rtabmap/utilite/UTimer.h"
+#include <vector>
+
+/**
+ * A bounded FIFO of items passed between threads, for example between
+ * a producer thread and the main loop of a consumer thread. Items
+ * are passed by pointer: the buffer takes ownership of the pushed items and
+ * the consumer takes ownership of the popped items, so they are never copied.
+ * Slots are allocated once (except for unlimited buffers), and the mutex
+ * is only held to move a pointer in or out.
+ *
+ * When the buffer is full, an item is dropped (deleted) depending on the
+ * drop policy. The time spent by each item in the buffer is returned by pop().
+ *
+ * Example:
+ * @code
+ * URingBuffer<SensorData> buffer(2, URingBuffer<SensorData>::kKeepKeyFrames);
+ * // producer thread
+ * if(buffer.push(new SensorData(data), isKeyFrame) == 0) dataAdded.release();
+ * // consumer thread
+ * dataAdded.acquire();
+ * double queued;
+ * SensorData * data = buffer.pop(&queued);
+ * if(data) { ...; delete data; }
+ * @endcode
+ */
+template<class T>
+class URingBuffer
+{
+public:
+	enum DropPolicy {
+		kFifo,          /**< Drop the oldest item when full. */
+		kLatestOnly,    /**< Keep only the latest item (the capacity is ignored). */
+		kKeepKeyFrames  /**< Drop the oldest item not pushed as key frame when full, or the oldest key frame if there are only key frames. */
+	};
+
+public:
+	/**
+	 * @param capacity maximum number of items (0 means unlimited)
+	 * @param policy which item to drop when full
+	 */
+	URingBuffer(unsigned int capacity = 0, DropPolicy policy = kFifo) :
+		policy_(policy),
+		capacity_(capacity),
+		head_(0),
+		size_(0),
+		dropped_(0)
+	{
+		slots_.resize(policy_==kLatestOnly?1:capacity_>0?capacity_:16);
+	}
+	~URingBuffer()
+	{
+		clear();
+	}
+
+	void setCapacity(unsigned int capacity)
+	{
+		UScopeMutex lock(mutex_);
+		capacity_ = capacity;
+		resize();
+	}
+	void setDropPolicy(DropPolicy policy)
+	{
+		UScopeMutex lock(mutex_);
+		policy_ = policy;
+		resize();
+	}
+
+	/**
+	 * Push an item, the buffer takes ownership of it.
+	 * @param item the item
+	 * @param keyFrame used with kKeepKeyFrames policy, key frames are dropped last
+	 * @return the number of items dropped to add this one
+	 */
+	int push(T * item, bool keyFrame = false)
+	{
+		std::vector<T*> dropped;
+		mutex_.lock();
+		if(size_ == slots_.size())
+		{
+			if(policy_ != kLatestOnly && capacity_ == 0)
+			{
+				grow();
+			}
+			else
+			{
+				dropped.push_back(remove(dropIndex()));
+			}
+		}
+		Slot & slot = slots_[(head_+size_) % slots_.size()];
+		slot.item = item;
+		slot.keyFrame = keyFrame;
+		slot.stamp = UTimer::now();
+		++size_;
+		dropped_ += dropped.size();
+		mutex_.unlock();
+
+		// delete outside the lock
+		for(unsigned int i=0; i<dropped.size(); ++i)
+		{
+			delete dropped[i];
+		}
+		return (int)dropped.size();
+	}
+
+	/**
+	 * Pop the oldest item, the caller takes ownership of it.
+	 * @param queuedTime if not null, set to the time (sec) the item spent in the buffer
+	 * @return the item, or null if the buffer is empty
+	 */
+	T * pop(double * queuedTime = 0)
+	{
+		UScopeMutex lock(mutex_);
+		if(size_ == 0)
+		{
+			return 0;
+		}
+		if(queuedTime)
+		{
+			*queuedTime = UTimer::now() - slots_[head_].stamp;
+		}
+		return remove(0);
+	}
+
+	/**
+	 * The oldest item, still owned by the buffer. It is valid until it is popped,
+	 * so it should be used only by the consumer thread, and only if the producer
+	 * doesn't drop items (unlimited kFifo buffer).
+	 * @return the oldest item, or null if the buffer is empty
+	 */
+	const T * front() const
+	{
+		UScopeMutex lock(mutex_);
+		return size_?slots_[head_].item:0;
+	}
+
+	unsigned int size() const
+	{
+		UScopeMutex lock(mutex_);
+		return size_;
+	}
+	bool empty() const {return size() == 0;}
+
+	/**
+	 * @return the total number of items dropped since the buffer is created.
+	 */
+	unsigned long dropped() const
+	{
+		UScopeMutex lock(mutex_);
+		return dropped_;
+	}
+
+	/**
+	 * Delete all items.
+	 */
+	void clear()
+	{
+		std::vector<T*> items;
+		mutex_.lock();
+		while(size_)
+		{
+			items.push_back(remove(0));
+		}
+		mutex_.unlock();
+		for(unsigned int i=0; i<items.size(); ++i)
+		{
+			delete items[i];
+		}
+	}
+
+private:
+	struct Slot
+	{
+		Slot() : item(0), keyFrame(false), stamp(0.0) {}
+		T * item;
+		bool keyFrame;
+		double stamp;
+	};
+
+	// Index (from head) of the item to drop when full
+	unsigned int dropIndex() const
+	{
+		if(policy_ == kKeepKeyFrames)
+		{
+			for(unsigned int i=0; i<size_; ++i)
+			{
+				if(!slots_[(head_+i) % slots_.size()].keyFrame)
+				{
+					return i;
+				}
+			}
+		}
+		return 0;
+	}
+
+	// Remove the item at index (from head), mutex_ must be locked
+	T * remove(unsigned int index)
+	{
+		unsigned int n = slots_.size();
+		T * item = slots_[(head_+index) % n].item;
+		// shift the older items by one to fill the hole
+		for(unsigned int i=index; i>0; --i)
+		{
+			slots_[(head_+i) % n] = slots_[(head_+i-1) % n];
+		}
+		slots_[head_] = Slot();
+		head_ = (head_+1) % n;
+		--size_;
+		return item;
+	}
+
+	void grow()
+	{
+		std::vector<Slot> slots(slots_.size()*2);
+		for(unsigned int i=0; i<size_; ++i)
+		{
+			slots[i] = slots_[(head_+i) % slots_.size()];
+		}
+		slots_.swap(slots);
+		head_ = 0;
+	}
+
+	// Resize the slots for the current capacity and policy, mutex_ must be locked
+	void resize()
+	{
+		unsigned int n = policy_==kLatestOnly?1:capacity_;
+		std::vector<T*> dropped;
+		while(n > 0 && size_ > n)
+		{
+			dropped.push_back(remove(dropIndex()));
+		}
+		dropped_ += dropped.size();
+		std::vector<Slot> slots(n>0?n:(size_>16?size_*2:16));
+		for(unsigned int i=0; i<size_; ++i)
+		{
+			slots[i] = slots_[(head_+i) % slots_.size()];
+		}
+		slots_.swap(slots);
+		head_ = 0;
+		for(unsigned int i=0; i<dropped.size(); ++i)
+		{
+			delete dropped[i];
+		}
+	}
+
+private:
+	std::vector<Slot> slots_;
+	DropPolicy policy_;
+	unsigned int capacity_;
+	unsigned int head_;
+	unsigned int size_;
+	unsigned long dropped_;
+	UMutex mutex_;
+};
+
+#endif // URINGBUFFER_H
@@ -0,0 +1,115 @@
+/*
+*  utilite is a cross-platform library with
+*  useful utilities for fast and small developing.
+*  Copyright (C) 2010  Mathieu Labbe
+*
+*  utilite is free library: you can redistribute it and/or modify
+*  it under the terms of the GNU Lesser General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  utilite is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UTHREADPOOL_H
+#define UTHREADPOOL_H
+
+#include "rtabmap/utilite/UtiLiteExp.h" // DLL export/import defines
+
+#include "rtabmap/utilite/UMutex.h"
+#include "rtabmap/utilite/USemaphore.h"
+#include <deque>
+#include <vector>
+
+/**
+ * A task executed by UThreadPool, in a worker thread or in the thread
+ * waiting for its batch. If it throws, see UThreadPool::run().
+ * @see UThreadPool
+ */
+class UTILITE_EXP UThreadPoolTask
+{
+public:
+	virtual ~UThreadPoolTask() {}
+	virtual void run() = 0;
+};
+
+/**
+ * A pool of worker threads executing batches of tasks. Each
+ * worker has its own queue: it takes tasks at the front of its queue and,
+ * when empty, steals tasks at the back of the other queues. Tasks with
+ * unbalanced costs are then spread automatically between the workers. The
+ * calling thread participates to the work while waiting for its batch to finish.
+ * Batches can be submitted concurrently from different threads, or from a task
+ * (nested batches), so a single process-wide pool can be shared.
+ *
+ * Example:
+ * @code
+ * class SquareTask : public UThreadPoolTask
+ * {
+ * public:
+ *    SquareTask(int value) : value(value), result(0) {}
+ *    virtual void run() {result = value*value;}
+ *    int value;
+ *    int result;
+ * };
+ *
+ * UThreadPool pool; // as many threads as cores
+ * std::vector<SquareTask> tasks;
+ * for(int i=0; i<100; ++i) tasks.push_back(SquareTask(i));
+ * std::vector<UThreadPoolTask*> ptrs(tasks.size());
+ * for(unsigned int i=0; i<tasks.size(); ++i) ptrs[i] = &tasks[i];
+ * pool.run(ptrs); // blocking, all tasks are done after this call
+ * @endcode
+ */
+class UTILITE_EXP UThreadPool
+{
+public:
+	/**
+	 * @return the number of cores available.
+	 */
+	static int idealThreadCount();
+
+public:
+	/**
+	 * @param threads number of threads executing the tasks, including the calling
+	 *        thread (0 means idealThreadCount()). With 1, tasks are executed
+	 *        sequentially in the calling thread.
+	 */
+	UThreadPool(int threads = 0);
+	~UThreadPool();
+
+	/**
+	 * @return the number of threads executing the tasks, including the calling thread.
+	 */
+	int threads() const {return (int)queues_.size();}
+
+	/**
+	 * Execute the tasks and wait until they are all done. Tasks are
+	 * not deleted. This can be called concurrently from different threads.
+	 * If a task throws an exception, the tasks of the batch not started yet
+	 * are skipped and the first exception is rethrown here, once no
+	 * other task of the batch is running.
+	 */
+	void run(const std::vector<UThreadPoolTask*> & tasks);
+
+private:
+	class Worker;
+	friend class Worker;
+	struct Batch;
+	bool runOne(int queueIndex);
+	bool isDone(const Batch & batch) const;
+
+private:
+	std::vector<Worker*> workers_;
+	std::vector<std::deque<std::pair<UThreadPoolTask*, Batch*> > > queues_; // last one is for the calling threads
+	std::vector<UMutex*> queuesMutexes_;
+	UMutex pendingMutex_;
+};
+
+#endif // UTHREADPOOL_H
@@ -0,0 +1,123 @@
+/*
+*  utilite is a cross-platform library with
+*  useful utilities for fast and small developing.
+*  Copyright (C) 2010  Mathieu Labbe
+*
+*  utilite is free library: you can redistribute it and/or modify
+*  it under the terms of the GNU Lesser General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  utilite is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rtabmap/utilite/ULogger.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+void showUsage()
+{
+	printf("Usage:\n"
+			"log_decoder [options] \"log.bin\" [\"output.txt\"]\n"
+			"  Convert a log saved with ULogger::kTypeBinaryFile to text.\n"
+			"  The text is written to standard output if no output file is set.\n"
+			"  Options:\n"
+			"     -nt       Don't print time.\n"
+			"     -nw       Don't print where (file, line and function).\n"
+			"     -nl       Don't print level.\n"
+			"     -tid      Print thread ID.\n"
+			"     -fp       Print full path of the source files.\n");
+	exit(1);
+}
+
+int main(int argc, char * argv[])
+{
+	if(argc < 2)
+	{
+		showUsage();
+	}
+
+	ULogger::setPrintTime(true);
+	ULogger::setPrintWhere(true);
+	ULogger::setPrintLevel(true);
+
+	std::string input;
+	std::string output;
+	for(int i=1; i<argc; ++i)
+	{
+		if(strcmp(argv[i], "-nt") == 0)
+		{
+			ULogger::setPrintTime(false);
+		}
+		else if(strcmp(argv[i], "-nw") == 0)
+		{
+			ULogger::setPrintWhere(false);
+		}
+		else if(strcmp(argv[i], "-nl") == 0)
+		{
+			ULogger::setPrintLevel(false);
+		}
+		else if(strcmp(argv[i], "-tid") == 0)
+		{
+			ULogger::setPrintThreadId(true);
+		}
+		else if(strcmp(argv[i], "-fp") == 0)
+		{
+			ULogger::setPrintWhereFullPath(true);
+		}
+		else if(argv[i][0] == '-')
+		{
+			printf("Unrecognized option \"%s\"\n", argv[i]);
+			showUsage();
+		}
+		else if(input.empty())
+		{
+			input = argv[i];
+		}
+		else if(output.empty())
+		{
+			output = argv[i];
+		}
+		else
+		{
+			showUsage();
+		}
+	}
+	if(input.empty())
+	{
+		showUsage();
+	}
+
+	FILE * out = stdout;
+	if(!output.empty())
+	{
+		out = fopen(output.c_str(), "w");
+		if(out == 0)
+		{
+			printf("Cannot open \"%s\" for writing.\n", output.c_str());
+			return 1;
+		}
+	}
+
+	bool success = ULogger::decodeBinaryLog(input, out);
+
+	if(out != stdout)
+	{
+		fclose(out);
+	}
+
+	if(!success)
+	{
+		printf("Cannot decode \"%s\", is it a binary log?\n", input.c_str());
+		return 1;
+	}
+	return 0;
+}
@@ -19,12 +19,110 @@
 
 #include "rtabmap/utilite/UEventsManager.h"
 #include "rtabmap/utilite/UEvent.h"
+#include "rtabmap/utilite/UTimer.h"
 #include <list>
+#include <deque>
 #include "rtabmap/utilite/UStl.h"
 
 UEventsManager* UEventsManager::instance_ = 0;
 UDestroyer<UEventsManager> UEventsManager::destroyer_;
 
+// An event shared between queued subscribers
+struct UEventsManager::Envelope
+{
+	Envelope(UEvent * event, const std::string & eventName, double stamp, int refs) :
+		event(event),
+		eventName(eventName),
+		stamp(stamp),
+		refs(refs)
+	{}
+	// The last subscriber releasing the envelope deletes the event
+	void release()
+	{
+		mutex.lock();
+		bool last = --refs == 0;
+		mutex.unlock();
+		if(last)
+		{
+			delete event;
+			delete this;
+		}
+	}
+	UEvent * event;
+	std::string eventName;
+	double stamp;
+	int refs;
+	UMutex mutex;
+};
+
+// Events of kDeliveryQueued subscriptions of an handler, delivered in their own thread
+class UEventsManager::SubscriberQueue : public UThread
+{
+public:
+	SubscriberQueue(UEventsManager * manager, UEventsHandler * handler) :
+		manager_(manager),
+		handler_(handler),
+		loopThreadId_(0)
+	{}
+	virtual ~SubscriberQueue()
+	{
+		join(true);
+		for(std::deque<Envelope*>::iterator iter=queue_.begin(); iter!=queue_.end(); ++iter)
+		{
+			manager_->updateStatistics((*iter)->eventName, 0, -1, -1.0);
+			(*iter)->release();
+		}
+	}
+	void push(Envelope * envelope)
+	{
+		queueMutex_.lock();
+		queue_.push_back(envelope);
+		queueMutex_.unlock();
+		queueSem_.release();
+	}
+	bool isCurrentThread() const
+	{
+		return loopThreadId_ == UThread::currentThreadId();
+	}
+
+private:
+	virtual void mainLoopBegin()
+	{
+		loopThreadId_ = UThread::currentThreadId();
+	}
+	virtual void mainLoop()
+	{
+		queueSem_.acquire();
+		if(!this->isKilled())
+		{
+			Envelope * envelope = 0;
+			queueMutex_.lock();
+			if(!queue_.empty())
+			{
+				envelope = queue_.front();
+				queue_.pop_front();
+			}
+			queueMutex_.unlock();
+			if(envelope)
+			{
+				manager_->deliverQueued(handler_, envelope);
+			}
+		}
+	}
+	virtual void mainLoopKill()
+	{
+		queueSem_.release();
+	}
+
+private:
+	UEventsManager * manager_;
+	UEventsHandler * handler_;
+	unsigned long loopThreadId_;
+	std::deque<Envelope*> queue_;
+	UMutex queueMutex_;
+	USemaphore queueSem_;
+};
+
 void UEventsManager::addHandler(UEventsHandler* handler)
 {
 	if(!handler)
@@ -122,6 +220,37 @@ void UEventsManager::removeNullPipes(const UEventsSender * sender)
 	}
 }
 
+void UEventsManager::subscribe(UEventsHandler * handler, const std::string & eventName, DeliveryMode mode)
+{
+	if(!handler)
+	{
+		UERROR("Handler is null!");
+		return;
+	}
+	else
+	{
+		UEventsManager::getInstance()->_subscribe(handler, eventName, mode);
+	}
+}
+
+void UEventsManager::unsubscribe(UEventsHandler * handler, const std::string & eventName)
+{
+	if(!handler)
+	{
+		UERROR("Handler is null!");
+		return;
+	}
+	else
+	{
+		UEventsManager::getInstance()->_unsubscribe(handler, eventName);
+	}
+}
+
+std::map<std::string, UEventsManager::TopicStatistics> UEventsManager::getTopicStatistics(bool reset)
+{
+	return UEventsManager::getInstance()->_getTopicStatistics(reset);
+}
+
 UEventsManager* UEventsManager::getInstance()
 {
     if(!instance_)
@@ -142,13 +271,28 @@ UEventsManager::~UEventsManager()
    	join(true);
 
     // Free memory
-    for(std::list<std::pair<UEvent*, const UEventsSender*> >::iterator it=events_.begin(); it!=events_.end(); ++it)
+    for(std::list<PostedEvent>::iterator it=events_.begin(); it!=events_.end(); ++it)
     {
-        delete it->first;
+        delete it->event_;
     }
     events_.clear();
 
+    std::list<SubscriberQueue*> queues = retiredQueues_;
+    for(std::map<UEventsHandler*, SubscriberQueue*>::iterator it=queues_.begin(); it!=queues_.end(); ++it)
+    {
+    	queues.push_back(it->second);
+    }
+    queues_.clear();
+    retiredQueues_.clear();
+    for(std::list<SubscriberQueue*>::iterator it=queues.begin(); it!=queues.end(); ++it)
+    {
+    	delete *it;
+    }
+
     handlers_.clear();
+    handlersSet_.clear();
+    subscriptions_.clear();
+    routes_.clear();
 
     instance_ = 0;
 }
@@ -174,62 +318,133 @@ void UEventsManager::dispatchEvents()
         return;
     }
 
-    std::list<std::pair<UEvent*, const UEventsSender*> >::iterator it;
-    std::list<std::pair<UEvent*, const UEventsSender*> > eventsBuf;
+    std::list<PostedEvent>::iterator it;
+    std::list<PostedEvent> eventsBuf;
 
-    // Copy events in a buffer :
+    // Move events in a buffer :
     // Other threads can post events 
     // while events are handled.
     eventsMutex_.lock();
     {
-        eventsBuf = events_;
-        events_.clear();
+        eventsBuf.swap(events_);
     }
     eventsMutex_.unlock();
 
 	// Past events to handlers
 	for(it=eventsBuf.begin(); it!=eventsBuf.end(); ++it)
 	{
-		if(!dispatchEvent(it->first, it->second))
+		updateStatistics(it->eventName_, 0, -1, -1.0);
+		if(!dispatchEvent(it->event_, it->eventName_, it->sender_, it->stamp_))
 		{
-			delete it->first;
+			delete it->event_;
 		}
 	}
     eventsBuf.clear();
 }
 
-bool UEventsManager::dispatchEvent(UEvent * event, const UEventsSender * sender)
+bool UEventsManager::dispatchEvent(UEvent * event, const std::string & eventName, const UEventsSender * sender, double stamp)
 {
-	std::list<UEventsHandler*> handlers;
+	std::list<UEventsHandler*> pipes;
 
 	// Verify if there are pipes with the sender for his type of event
 	if(sender)
 	{
-		handlers = getPipes(sender, event->getClassName());
+		pipes = getPipes(sender, eventName);
 	}
 
 	handlersMutex_.lock();
-	if(handlers.size() == 0)
+	std::shared_ptr<const Route> route = getRoute(eventName, pipes);
+	handlersMutex_.unlock();
+
+	return deliver(route->dispatched, event, eventName, sender, stamp) ||
+		   enqueue(event, eventName, sender, stamp, pipes);
+}
+
+std::shared_ptr<const UEventsManager::Route> UEventsManager::getRoute(
+		const std::string & eventName,
+		const std::list<UEventsHandler*> & pipes)
+{
+	if(pipes.empty())
+	{
+		std::map<std::string, std::shared_ptr<const Route> >::iterator iter = routes_.find(eventName);
+		if(iter != routes_.end())
+		{
+			return iter->second;
+		}
+	}
+
+	// No pipes, send to all handlers not subscribed or subscribed to this event.
+	// With pipes, send only to pipe receivers (null ones are removed handlers).
+	std::shared_ptr<Route> route(new Route());
+	const std::list<UEventsHandler*> & handlers = pipes.empty()?handlers_:pipes;
+	for(std::list<UEventsHandler*>::const_iterator iter=handlers.begin(); iter!=handlers.end(); ++iter)
+	{
+		if(*iter == 0)
+		{
+			continue;
+		}
+		DeliveryMode mode = kDeliveryDispatcher;
+		std::map<UEventsHandler*, std::map<std::string, DeliveryMode> >::iterator jter = subscriptions_.find(*iter);
+		if(jter != subscriptions_.end())
+		{
+			std::map<std::string, DeliveryMode>::iterator kter = jter->second.find(eventName);
+			if(kter != jter->second.end())
+			{
+				mode = kter->second;
+			}
+			else if(pipes.empty())
+			{
+				// not subscribed to this event
+				continue;
+			}
+		}
+
+		if(mode == kDeliveryDirect)
+		{
+			route->direct.push_back(*iter);
+		}
+		else if(mode == kDeliveryQueued)
+		{
+			route->queued.push_back(*iter);
+		}
+		else
+		{
+			route->dispatched.push_back(*iter);
+		}
+	}
+
+	if(pipes.empty())
 	{
-		//No pipes, send to all handlers
-		handlers = handlers_;
+		routes_.insert(std::make_pair(eventName, route));
 	}
+	return route;
+}
 
+bool UEventsManager::deliver(
+		const std::vector<UEventsHandler*> & handlers,
+		UEvent * event,
+		const std::string & eventName,
+		const UEventsSender * sender,
+		double stamp)
+{
 	bool handled = false;
 
-	for(std::list<UEventsHandler*>::iterator it=handlers.begin(); it!=handlers.end() && !handled; ++it)
+	handlersMutex_.lock();
+	for(unsigned int i=0; i<handlers.size() && !handled; ++i)
 	{
 		// Check if the handler is still in the
 		// handlers_ list (may be changed if addHandler() or
 		// removeHandler() is called in EventsHandler::handleEvent())
-		if(std::find(handlers_.begin(), handlers_.end(), *it) != handlers_.end())
+		UEventsHandler * handler = handlers[i];
+		if(handlersSet_.find(handler) != handlersSet_.end())
 		{
-			UEventsHandler * handler = *it;
 			handlersMutex_.unlock();
 
 			// Don't process event if the handler is the same as the sender
 			if(handler != sender)
 			{
+				updateStatistics(eventName, 0, 0, UTimer::now() - stamp);
+
 				// To be able to add/remove an handler in a handleEvent call (without a deadlock)
 				// @see _addHandler(), _removeHandler()
 				handled = handler->handleEvent(event);
@@ -242,6 +457,113 @@ bool UEventsManager::dispatchEvent(UEvent * event, const UEventsSender * sender)
 	return handled;
 }
 
+bool UEventsManager::enqueue(
+		UEvent * event,
+		const std::string & eventName,
+		const UEventsSender * sender,
+		double stamp,
+		const std::list<UEventsHandler*> & pipes)
+{
+	UScopeMutex lock(handlersMutex_);
+	std::shared_ptr<const Route> route = getRoute(eventName, pipes);
+	const std::vector<UEventsHandler*> & handlers = route->queued;
+	std::vector<SubscriberQueue*> queues;
+	for(unsigned int i=0; i<handlers.size(); ++i)
+	{
+		if(handlers[i] != sender)
+		{
+			std::map<UEventsHandler*, SubscriberQueue*>::iterator iter = queues_.find(handlers[i]);
+			if(iter != queues_.end())
+			{
+				queues.push_back(iter->second);
+			}
+		}
+	}
+	if(queues.empty())
+	{
+		return false;
+	}
+
+	// The event is shared, the last queue releasing it deletes it
+	Envelope * envelope = new Envelope(event, eventName, stamp, (int)queues.size());
+	for(unsigned int i=0; i<queues.size(); ++i)
+	{
+		updateStatistics(eventName, 0, 1, -1.0);
+		queues[i]->push(envelope);
+	}
+	return true;
+}
+
+void UEventsManager::deliverQueued(UEventsHandler * handler, Envelope * envelope)
+{
+	updateStatistics(envelope->eventName, 0, -1, UTimer::now() - envelope->stamp);
+	if(handler->handleEvent(envelope->event))
+	{
+		UERROR("Handler %p took ownership of event \"%s\" received from its queue, this is "
+				"not allowed as the event is shared with other queued subscribers.",
+				handler, envelope->eventName.c_str());
+	}
+	envelope->release();
+}
+
+void UEventsManager::takeUnusedQueue(UEventsHandler * handler, std::list<SubscriberQueue*> & queues)
+{
+	std::map<UEventsHandler*, SubscriberQueue*>::iterator iter = queues_.find(handler);
+	if(iter != queues_.end())
+	{
+		std::map<UEventsHandler*, std::map<std::string, DeliveryMode> >::iterator jter = subscriptions_.find(handler);
+		if(jter != subscriptions_.end())
+		{
+			for(std::map<std::string, DeliveryMode>::iterator kter=jter->second.begin(); kter!=jter->second.end(); ++kter)
+			{
+				if(kter->second == kDeliveryQueued)
+				{
+					return;
+				}
+			}
+		}
+		queues.push_back(iter->second);
+		queues_.erase(iter);
+	}
+}
+
+void UEventsManager::deleteQueues(const std::list<SubscriberQueue*> & queues)
+{
+	std::list<SubscriberQueue*> toDelete;
+	handlersMutex_.lock();
+	for(std::list<SubscriberQueue*>::const_iterator iter=queues.begin(); iter!=queues.end(); ++iter)
+	{
+		if((*iter)->isCurrentThread())
+		{
+			// Called from handleEvent() of the queue, it cannot join itself
+			(*iter)->kill();
+			retiredQueues_.push_back(*iter);
+		}
+		else
+		{
+			toDelete.push_back(*iter);
+		}
+	}
+	for(std::list<SubscriberQueue*>::iterator iter=retiredQueues_.begin(); iter!=retiredQueues_.end();)
+	{
+		if(!(*iter)->isCurrentThread())
+		{
+			toDelete.push_back(*iter);
+			iter = retiredQueues_.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+	handlersMutex_.unlock();
+
+	for(std::list<SubscriberQueue*>::iterator iter=toDelete.begin(); iter!=toDelete.end(); ++iter)
+	{
+		delete *iter; // wait for the current event, remaining events are dropped
+	}
+}
+
 void UEventsManager::_addHandler(UEventsHandler* handler)
 {
     if(!this->isKilled())
@@ -249,17 +571,10 @@ void UEventsManager::_addHandler(UEventsHandler* handler)
         handlersMutex_.lock();
         {
         	//make sure it is not already in the list
-        	bool handlerFound = false;
-        	for(std::list<UEventsHandler*>::iterator it=handlers_.begin(); it!=handlers_.end(); ++it)
-        	{
-        		if(*it == handler)
-        		{
-        			handlerFound = true;
-        		}
-        	}
-        	if(!handlerFound)
+        	if(handlersSet_.insert(handler).second)
         	{
         		handlers_.push_back(handler);
+        		routes_.clear();
         	}
         }
         handlersMutex_.unlock();
@@ -270,18 +585,19 @@ void UEventsManager::_removeHandler(UEventsHandler* handler)
 {
     if(!this->isKilled())
     {
+    	std::list<SubscriberQueue*> queues;
         handlersMutex_.lock();
         {
-            for (std::list<UEventsHandler*>::iterator it = handlers_.begin(); it!=handlers_.end(); ++it)
+            if(handlersSet_.erase(handler))
             {
-                if(*it == handler)
-                {
-                    handlers_.erase(it);
-                    break;
-                }
+            	handlers_.remove(handler);
+            	subscriptions_.erase(handler);
+            	takeUnusedQueue(handler, queues);
+            	routes_.clear();
             }
         }
         handlersMutex_.unlock();
+        deleteQueues(queues);
 
         pipesMutex_.lock();
         {
@@ -297,24 +613,148 @@ void UEventsManager::_removeHandler(UEventsHandler* handler)
     }
 }
 
+void UEventsManager::_subscribe(UEventsHandler * handler, const std::string & eventName, DeliveryMode mode)
+{
+	if(!this->isKilled())
+	{
+		std::list<SubscriberQueue*> queues;
+		handlersMutex_.lock();
+		if(handlersSet_.find(handler) != handlersSet_.end())
+		{
+			subscriptions_[handler][eventName] = mode;
+			if(mode == kDeliveryQueued)
+			{
+				if(queues_.find(handler) == queues_.end())
+				{
+					SubscriberQueue * queue = new SubscriberQueue(this, handler);
+					queues_.insert(std::make_pair(handler, queue));
+					queue->start();
+				}
+			}
+			else
+			{
+				takeUnusedQueue(handler, queues);
+			}
+			routes_.clear();
+		}
+		else
+		{
+			UERROR("Cannot subscribe to \"%s\" because the handler is not yet "
+				   "added to UEventsManager's handlers list.", eventName.c_str());
+		}
+		handlersMutex_.unlock();
+		deleteQueues(queues);
+	}
+}
+
+void UEventsManager::_unsubscribe(UEventsHandler * handler, const std::string & eventName)
+{
+	if(!this->isKilled())
+	{
+		std::list<SubscriberQueue*> queues;
+		handlersMutex_.lock();
+		std::map<UEventsHandler*, std::map<std::string, DeliveryMode> >::iterator iter = subscriptions_.find(handler);
+		if(iter != subscriptions_.end() && iter->second.erase(eventName))
+		{
+			if(iter->second.empty())
+			{
+				subscriptions_.erase(iter);
+			}
+			takeUnusedQueue(handler, queues);
+			routes_.clear();
+		}
+		else
+		{
+			UWARN("Handler %p was not subscribed to \"%s\".", handler, eventName.c_str());
+		}
+		handlersMutex_.unlock();
+		deleteQueues(queues);
+	}
+}
+
+std::map<std::string, UEventsManager::TopicStatistics> UEventsManager::_getTopicStatistics(bool reset)
+{
+	UScopeMutex lock(statisticsMutex_);
+	std::map<std::string, TopicStatistics> statistics = statistics_;
+	if(reset)
+	{
+		for(std::map<std::string, TopicStatistics>::iterator iter=statistics_.begin(); iter!=statistics_.end(); ++iter)
+		{
+			TopicStatistics stats;
+			stats.queueDepth = stats.maxQueueDepth = iter->second.queueDepth;
+			iter->second = stats;
+		}
+	}
+	return statistics;
+}
+
+void UEventsManager::updateStatistics(const std::string & eventName, int posted, int queueDelta, double latency)
+{
+	UScopeMutex lock(statisticsMutex_);
+	TopicStatistics & stats = statistics_[eventName];
+	stats.posted += posted;
+	stats.queueDepth += queueDelta;
+	if(stats.queueDepth > stats.maxQueueDepth)
+	{
+		stats.maxQueueDepth = stats.queueDepth;
+	}
+	if(latency >= 0.0)
+	{
+		++stats.deliveries;
+		stats.totalLatency += latency;
+		if(latency > stats.maxLatency)
+		{
+			stats.maxLatency = latency;
+		}
+	}
+}
+
 void UEventsManager::_postEvent(UEvent * event, bool async, const UEventsSender * sender)
 {
     if(!this->isKilled())
     {
-    	if(async)
+    	std::string eventName = event->getClassName();
+    	double stamp = UTimer::now();
+    	updateStatistics(eventName, 1, 0, -1.0);
+
+    	std::list<UEventsHandler*> pipes;
+    	if(sender)
+    	{
+    		pipes = getPipes(sender, eventName);
+    	}
+    	handlersMutex_.lock();
+    	std::shared_ptr<const Route> route = getRoute(eventName, pipes);
+    	handlersMutex_.unlock();
+
+    	// Direct subscribers are called in the caller thread
+    	if(deliver(route->direct, event, eventName, sender, stamp))
+    	{
+    		return;
+    	}
+
+    	if(async && !route->dispatched.empty())
     	{
 			eventsMutex_.lock();
 			{
-				events_.push_back(std::make_pair(event, sender));
+				events_.push_back(PostedEvent(event, sender, eventName, stamp));
 			}
 			eventsMutex_.unlock();
+			updateStatistics(eventName, 0, 1, -1.0);
 
 			// Signal the EventsManager that an Event is added
 			postEventSem_.release();
     	}
+    	else if(async)
+    	{
+    		// Only queued subscribers, skip the UEventsManager's thread
+    		if(!enqueue(event, eventName, sender, stamp, pipes))
+    		{
+    			delete event;
+    		}
+    	}
     	else
     	{
-    		if(!dispatchEvent(event, sender))
+    		if(!dispatchEvent(event, eventName, sender, stamp))
     		{
     			delete event;
     		}
@@ -458,7 +898,7 @@ void UEventsManager::_removeAllPipes(const UEventsSender * sender)
 	pipesMutex_.unlock();
 }
 
-void UEventsManager::_removeNullPipes(const UEventsSender * sender)
+void UEventsManager::_removeNullPipes(const UEventsSender *)
 {
 	pipesMutex_.lock();
 	for(std::list<Pipe>::iterator iter=pipes_.begin(); iter!=pipes_.end();)
@@ -22,9 +22,17 @@
 #include "rtabmap/utilite/UFile.h"
 #include "rtabmap/utilite/UStl.h"
 #include "rtabmap/utilite/UEventsManager.h"
+#include "rtabmap/utilite/UThread.h"
 #include <fstream>
 #include <string>
 #include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <list>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
 
 #ifndef _WIN32
 #include <sys/time.h>
@@ -53,6 +61,9 @@ bool ULogger::printWhereFullPath_ = false;
 bool ULogger::printThreadID_ = false;
 bool ULogger::limitWhereLength_ = false;
 bool ULogger::buffered_ = false;
+bool ULogger::asynchronous_ = false;
+int ULogger::asyncBufferSize_ = 1024*1024;
+ULogger::Flusher * ULogger::flusher_ = 0;
 ULogger::Level ULogger::level_ = kInfo; // By default, we show all info msgs + upper level (Warning, Error)
 ULogger::Level ULogger::eventLevel_ = kFatal;
 const char * ULogger::levelName_[5] = {"DEBUG", " INFO", " WARN", "ERROR", "FATAL"};
@@ -173,6 +184,614 @@ private:
     std::string bufferedMsgs_;
 };
 
+#ifdef _WIN32
+static int levelColor(ULogger::Level level)
+#else
+static const char * levelColor(ULogger::Level level)
+#endif
+{
+	switch(level)
+	{
+	case ULogger::kDebug:
+		return COLOR_GREEN;
+	case ULogger::kWarning:
+		return COLOR_YELLOW;
+	case ULogger::kError:
+	case ULogger::kFatal:
+		return COLOR_RED;
+	default:
+		return COLOR_NORMAL;
+	}
+}
+
+/*
+ * Conversion specification of a printf format, parsed the same way when the
+ * arguments are captured (writeAsync()) and when they are formatted later.
+ */
+struct ULogFormatSpec
+{
+	ULogFormatSpec() :
+		widthArg(false),
+		hasPrecision(false),
+		precisionArg(false),
+		conversion(0)
+	{}
+	std::string flags;
+	bool widthArg; // '*'
+	std::string width;
+	bool hasPrecision;
+	bool precisionArg; // ".*"
+	std::string precision;
+	std::string length;
+	char conversion; // 0 if not supported
+};
+
+// "format" points just after the '%', return the position after the conversion
+static const char * parseFormatSpec(const char * format, ULogFormatSpec & spec)
+{
+	const char * p = format;
+	while(*p && strchr("-+ #0'", *p))
+	{
+		spec.flags += *p++;
+	}
+	if(*p == '*')
+	{
+		spec.widthArg = true;
+		++p;
+	}
+	while(*p >= '0' && *p <= '9')
+	{
+		spec.width += *p++;
+	}
+	if(*p == '.')
+	{
+		spec.hasPrecision = true;
+		++p;
+		if(*p == '*')
+		{
+			spec.precisionArg = true;
+			++p;
+		}
+		while(*p >= '0' && *p <= '9')
+		{
+			spec.precision += *p++;
+		}
+	}
+	const char * lengths[] = {"hh", "h", "ll", "l", "L", "q", "j", "z", "t", "I64", "I32", "I"};
+	for(unsigned int i=0; i<sizeof(lengths)/sizeof(const char *); ++i)
+	{
+		size_t n = strlen(lengths[i]);
+		if(strncmp(p, lengths[i], n) == 0)
+		{
+			spec.length = lengths[i];
+			p += n;
+			break;
+		}
+	}
+	if(*p && strchr("diuoxXfFeEgGaAcspn", *p))
+	{
+		spec.conversion = *p++;
+	}
+	return p;
+}
+
+template<typename T>
+static void appendValue(std::string & out, const T & value)
+{
+	out.append((const char *)&value, sizeof(T));
+}
+
+template<typename T>
+static bool readValue(const char * & data, const char * end, T & value)
+{
+	if(data + sizeof(T) > end)
+	{
+		return false;
+	}
+	memcpy(&value, data, sizeof(T));
+	data += sizeof(T);
+	return true;
+}
+
+/*
+ * Copy the arguments used by the format string. Integers are saved on 64 bits,
+ * floating points as double and strings by value, so the arguments can be
+ * formatted later (even in another process) with formatArguments().
+ */
+static void captureArguments(const char * format, va_list args, std::string & out)
+{
+	for(const char * p = format; *p; )
+	{
+		if(*p++ != '%')
+		{
+			continue;
+		}
+		if(*p == '%')
+		{
+			++p;
+			continue;
+		}
+		ULogFormatSpec spec;
+		p = parseFormatSpec(p, spec);
+		if(spec.conversion == 0)
+		{
+			// not supported, the rest of the format is written as is
+			return;
+		}
+		if(spec.widthArg)
+		{
+			appendValue(out, va_arg(args, int));
+		}
+		if(spec.precisionArg)
+		{
+			appendValue(out, va_arg(args, int));
+		}
+		const std::string & l = spec.length;
+		switch(spec.conversion)
+		{
+		case 'd':
+		case 'i':
+		{
+			long long value;
+			if(l == "l") value = va_arg(args, long);
+			else if(l == "ll" || l == "q" || l == "I64") value = va_arg(args, long long);
+			else if(l == "j") value = va_arg(args, intmax_t);
+			else if(l == "z" || l == "I") value = (long long)va_arg(args, size_t);
+			else if(l == "t") value = va_arg(args, ptrdiff_t);
+			else if(l == "hh") value = (signed char)va_arg(args, int);
+			else if(l == "h") value = (short)va_arg(args, int);
+			else value = va_arg(args, int);
+			appendValue(out, value);
+			break;
+		}
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+		{
+			unsigned long long value;
+			if(l == "l") value = va_arg(args, unsigned long);
+			else if(l == "ll" || l == "q" || l == "I64") value = va_arg(args, unsigned long long);
+			else if(l == "j") value = va_arg(args, uintmax_t);
+			else if(l == "z" || l == "I") value = va_arg(args, size_t);
+			else if(l == "t") value = (unsigned long long)va_arg(args, ptrdiff_t);
+			else if(l == "hh") value = (unsigned char)va_arg(args, unsigned int);
+			else if(l == "h") value = (unsigned short)va_arg(args, unsigned int);
+			else value = va_arg(args, unsigned int);
+			appendValue(out, value);
+			break;
+		}
+		case 'c':
+			appendValue(out, (long long)va_arg(args, int));
+			break;
+		case 's':
+		{
+			// wide strings are not supported, only their address is kept
+			const char * str = l == "l"?0:va_arg(args, const char *);
+			if(l == "l")
+			{
+				va_arg(args, void *);
+			}
+			unsigned int size = str?(unsigned int)strlen(str):0xFFFFFFFF;
+			appendValue(out, size);
+			if(str)
+			{
+				out.append(str, size);
+			}
+			break;
+		}
+		case 'p':
+			appendValue(out, (unsigned long long)(size_t)va_arg(args, void *));
+			break;
+		case 'n':
+			va_arg(args, void *); // ignored
+			break;
+		default: // floating points
+			appendValue(out, l == "L"?(double)va_arg(args, long double):va_arg(args, double));
+			break;
+		}
+	}
+}
+
+/*
+ * Format the arguments captured with captureArguments().
+ */
+static std::string formatArguments(const char * format, const char * args, unsigned int argsSize)
+{
+	std::string out;
+	const char * end = args + argsSize;
+	const char * p = format;
+	while(*p)
+	{
+		const char * percent = strchr(p, '%');
+		if(percent == 0)
+		{
+			out.append(p);
+			break;
+		}
+		out.append(p, percent - p);
+		p = percent + 1;
+		if(*p == '%')
+		{
+			out += '%';
+			++p;
+			continue;
+		}
+		ULogFormatSpec spec;
+		const char * next = parseFormatSpec(p, spec);
+		int width = 0;
+		int precision = 0;
+		if(spec.conversion == 0 ||
+		   (spec.widthArg && !readValue(args, end, width)) ||
+		   (spec.precisionArg && !readValue(args, end, precision)))
+		{
+			out.append(percent);
+			break;
+		}
+		std::string specStr = "%" + spec.flags;
+		specStr += spec.widthArg?uNumber2Str(width):spec.width;
+		if(spec.hasPrecision)
+		{
+			specStr += "." + (spec.precisionArg?uNumber2Str(precision):spec.precision);
+		}
+		bool valid = true;
+		switch(spec.conversion)
+		{
+		case 'd':
+		case 'i':
+		{
+			long long value;
+			valid = readValue(args, end, value);
+			if(valid) out += uFormat((specStr + "ll" + spec.conversion).c_str(), value);
+			break;
+		}
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+		{
+			unsigned long long value;
+			valid = readValue(args, end, value);
+			if(valid) out += uFormat((specStr + "ll" + spec.conversion).c_str(), value);
+			break;
+		}
+		case 'c':
+		{
+			long long value;
+			valid = readValue(args, end, value);
+			if(valid) out += uFormat((specStr + "c").c_str(), (int)value);
+			break;
+		}
+		case 's':
+		{
+			unsigned int size;
+			valid = readValue(args, end, size);
+			if(valid && size == 0xFFFFFFFF)
+			{
+				out += uFormat((specStr + "s").c_str(), spec.length=="l"?"(wide string)":"(null)");
+			}
+			else if(valid && args + size <= end)
+			{
+				out += uFormat((specStr + "s").c_str(), std::string(args, size).c_str());
+				args += size;
+			}
+			else
+			{
+				valid = false;
+			}
+			break;
+		}
+		case 'p':
+		{
+			unsigned long long value;
+			valid = readValue(args, end, value);
+			if(valid) out += uFormat("0x%llx", value);
+			break;
+		}
+		case 'n':
+			break;
+		default:
+		{
+			double value;
+			valid = readValue(args, end, value);
+			if(valid) out += uFormat((specStr + spec.conversion).c_str(), value);
+			break;
+		}
+		}
+		if(!valid)
+		{
+			// corrupted or truncated arguments
+			out.append(percent);
+			break;
+		}
+		p = next;
+	}
+	return out;
+}
+
+struct ULogger::Record
+{
+	long long time; // microseconds since epoch
+	unsigned long long threadId;
+	int level;
+	int line;
+	const char * file;
+	const char * function;
+	const char * format;
+	const char * args; // see captureArguments()
+	unsigned int argsSize;
+};
+
+/*
+ * Fixed part of a message in ULogRingBuffer, followed by the format
+ * string (with '\0') and the captured arguments.
+ */
+struct ULogRingHeader
+{
+	unsigned int size; // total size of the entry, 0 means the next entry is at the beginning of the buffer
+	unsigned int formatSize;
+	unsigned int argsSize;
+	int level;
+	int line;
+	unsigned long long sequence;
+	long long time;
+	unsigned long long threadId;
+	const char * file; // __FILE__ and __FUNCTION__ are static
+	const char * function;
+};
+
+/*
+ * Messages of one thread waiting to be written, single producer (the
+ * logging thread) and single consumer (ULogger::writePendingAsync()).
+ */
+class ULogRingBuffer
+{
+public:
+	ULogRingBuffer(int size) :
+		data_(((size_t)std::max(size, 1024)+7) & ~(size_t)7),
+		head_(0),
+		tail_(0),
+		dropped(0),
+		finished(false)
+	{}
+
+	// Producer
+	void push(ULogRingHeader & header, const char * format, const std::string & args)
+	{
+		size_t capacity = data_.size();
+		size_t need = (sizeof(ULogRingHeader) + header.formatSize + header.argsSize + 7) & ~(size_t)7;
+		size_t head = head_.load(std::memory_order_relaxed);
+		size_t tail = tail_.load(std::memory_order_acquire);
+		size_t pos = head % capacity;
+		size_t contiguous = capacity - pos;
+		size_t required = need > contiguous?need + contiguous:need;
+		if(capacity - (head - tail) < required)
+		{
+			++dropped;
+			return;
+		}
+		if(need > contiguous)
+		{
+			unsigned int wrap = 0;
+			memcpy(&data_[pos], &wrap, sizeof(unsigned int));
+			head += contiguous;
+			pos = 0;
+		}
+		header.size = (unsigned int)need;
+		memcpy(&data_[pos], &header, sizeof(ULogRingHeader));
+		memcpy(&data_[pos+sizeof(ULogRingHeader)], format, header.formatSize);
+		if(header.argsSize)
+		{
+			memcpy(&data_[pos+sizeof(ULogRingHeader)+header.formatSize], args.data(), header.argsSize);
+		}
+		head_.store(head + need, std::memory_order_release);
+	}
+
+	// Consumer: append the entries to "entries", with their sequence number and offset in "order"
+	void pop(std::vector<char> & entries, std::vector<std::pair<unsigned long long, size_t> > & order)
+	{
+		size_t capacity = data_.size();
+		size_t tail = tail_.load(std::memory_order_relaxed);
+		size_t head = head_.load(std::memory_order_acquire);
+		while(tail != head)
+		{
+			size_t pos = tail % capacity;
+			unsigned int size;
+			memcpy(&size, &data_[pos], sizeof(unsigned int));
+			if(size == 0)
+			{
+				tail += capacity - pos;
+				continue;
+			}
+			ULogRingHeader header;
+			memcpy(&header, &data_[pos], sizeof(ULogRingHeader));
+			order.push_back(std::make_pair(header.sequence, entries.size()));
+			entries.insert(entries.end(), data_.begin()+pos, data_.begin()+pos+size);
+			tail += size;
+		}
+		tail_.store(tail, std::memory_order_release);
+	}
+
+	bool empty() const
+	{
+		return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::vector<char> data_;
+	std::atomic<size_t> head_; // written bytes, only modified by the producer
+	std::atomic<size_t> tail_; // read bytes, only modified by the consumer
+
+public:
+	std::atomic<int> dropped;
+	std::atomic<bool> finished; // set when the thread is exited
+};
+
+// Never deleted, as threads may log while static objects are destroyed
+static UMutex & asyncRingsMutex()
+{
+	static UMutex * mutex = new UMutex();
+	return *mutex;
+}
+static std::list<ULogRingBuffer*> & asyncRings()
+{
+	static std::list<ULogRingBuffer*> * rings = new std::list<ULogRingBuffer*>();
+	return *rings;
+}
+static std::atomic<unsigned long long> asyncSequence(0);
+
+/*
+ * Ring buffer of the current thread, created on its first message.
+ */
+static thread_local bool threadRingExited = false;
+class ULogThreadRing
+{
+public:
+	ULogThreadRing() : ring(0) {}
+	~ULogThreadRing()
+	{
+		if(ring)
+		{
+			ring->finished = true; // the ring is deleted by the consumer when empty
+		}
+		threadRingExited = true;
+	}
+	ULogRingBuffer * ring;
+};
+static thread_local ULogThreadRing threadRing;
+
+/*
+ * This class is used to write logs in a binary file. Strings (source files,
+ * functions and formats) are saved once and referred by their id.
+ * Format of the file (native endianness):
+ *   "ULOGBIN1" followed by 0x01020304 (unsigned int), repeated when a file is appended
+ *   'S' id size string         : string definition
+ *   'R' time threadId level line fileId functionId formatId argsSize args : message
+ *   'T' size text              : text already formatted (ULogger::write(msg, ...))
+ * @see ULogger::decodeBinaryLog()
+ */
+class UBinaryFileLogger : public ULogger
+{
+public:
+	virtual ~UBinaryFileLogger()
+	{
+		this->_flush();
+		if(fout_)
+		{
+			fclose(fout_);
+		}
+	}
+
+protected:
+	friend class ULogger;
+
+	UBinaryFileLogger(const std::string &fileName, bool append)
+	{
+#ifdef _MSC_VER
+		fopen_s(&fout_, fileName.c_str(), append?"ab":"wb");
+#else
+		fout_ = fopen(fileName.c_str(), append?"ab":"wb");
+#endif
+		if(!fout_) {
+			printf("BinaryFileLogger : Cannot open file : %s\n", fileName.c_str());
+			return;
+		}
+		unsigned int endianness = 0x01020304;
+		fwrite("ULOGBIN1", 1, 8, fout_);
+		fwrite(&endianness, sizeof(unsigned int), 1, fout_);
+	}
+
+private:
+	virtual void _write(const char* msg, va_list arg)
+	{
+		_writeStr(uFormatv(msg, arg).c_str());
+	}
+	virtual void _writeStr(const char* msg)
+	{
+		if(fout_)
+		{
+			unsigned int size = (unsigned int)strlen(msg);
+			fputc('T', fout_);
+			fwrite(&size, sizeof(unsigned int), 1, fout_);
+			fwrite(msg, 1, size, fout_);
+		}
+	}
+	virtual void _writeRecord(const Record & record)
+	{
+		if(fout_)
+		{
+			std::string entry;
+			entry += 'R';
+			appendValue(entry, record.time);
+			appendValue(entry, record.threadId);
+			appendValue(entry, record.level);
+			appendValue(entry, record.line);
+			appendValue(entry, stringId(record.file));
+			appendValue(entry, stringId(record.function));
+			appendValue(entry, stringId(record.format));
+			appendValue(entry, record.argsSize);
+			entry.append(record.args, record.argsSize);
+			fwrite(entry.data(), 1, entry.size(), fout_);
+		}
+	}
+
+	unsigned int stringId(const char * str)
+	{
+		std::string key = str;
+		std::map<std::string, unsigned int>::iterator iter = strings_.find(key);
+		if(iter != strings_.end())
+		{
+			return iter->second;
+		}
+		unsigned int id = (unsigned int)strings_.size();
+		unsigned int size = (unsigned int)key.size();
+		strings_.insert(std::make_pair(key, id));
+		fputc('S', fout_);
+		fwrite(&id, sizeof(unsigned int), 1, fout_);
+		fwrite(&size, sizeof(unsigned int), 1, fout_);
+		fwrite(key.data(), 1, size, fout_);
+		return id;
+	}
+
+private:
+	FILE* fout_;
+	std::map<std::string, unsigned int> strings_;
+};
+
+class ULogger::Flusher : public UThread
+{
+public:
+	virtual ~Flusher()
+	{
+		// Called by setAsynchronous(false) or on application exit
+		ULogger::asynchronous_ = false;
+		ULogger::flusher_ = 0;
+		join(true);
+		ULogger::writePendingAsync();
+	}
+
+private:
+	virtual void mainLoop()
+	{
+		wake_.acquire(1, 10);
+		if(!this->isKilled())
+		{
+			ULogger::writePendingAsync();
+		}
+	}
+	virtual void mainLoopKill()
+	{
+		wake_.release();
+	}
+
+private:
+	USemaphore wake_;
+};
+
+// After ULogger::destroyer_, so that it is deleted before the logger on application exit
+UDestroyer<ULogger::Flusher> ULogger::flusherDestroyer_;
+
+
 void ULogger::setType(Type type, const std::string &fileName, bool append)
 {
 	ULogger::flush();
@@ -187,7 +806,7 @@ void ULogger::setType(Type type, const std::string &fileName, bool append)
 			instance_ = createInstance();
 		}
 		// type changed
-		else if(type_ != type || (type_ == kTypeFile && logFileName_.compare(fileName)!=0))
+		else if(type_ != type || ((type_ == kTypeFile || type_ == kTypeBinaryFile) && logFileName_.compare(fileName)!=0))
 		{
 			destroyer_.setDoomed(0);
 			delete instance_;
@@ -280,6 +899,8 @@ void ULogger::setBuffered(bool buffered)
 
 void ULogger::flush()
 {
+	writePendingAsync();
+
 	loggerMutex_.lock();
 	if(!instance_ || bufferedMsgs_.size()==0)
 	{
@@ -297,8 +918,300 @@ void ULogger::_flush()
 	bufferedMsgs_.clear();
 }
 
+void ULogger::setAsynchronous(bool asynchronous, int bufferSize)
+{
+	static UMutex asyncMutex;
+	UScopeMutex lock(asyncMutex);
+	if(asynchronous)
+	{
+		asyncBufferSize_ = bufferSize;
+		if(!flusher_)
+		{
+			flusher_ = new Flusher();
+			flusherDestroyer_.setDoomed(flusher_);
+			flusher_->start();
+		}
+		asynchronous_ = true;
+	}
+	else if(flusher_)
+	{
+		flusherDestroyer_.setDoomed(0);
+		delete flusher_; // pending messages are written
+	}
+}
+
+bool ULogger::writeAsync(ULogger::Level level,
+		const char * file,
+		int line,
+		const char * function,
+		const char* msg,
+		va_list args)
+{
+	if(threadRingExited)
+	{
+		return false;
+	}
+	if(threadRing.ring == 0)
+	{
+		threadRing.ring = new ULogRingBuffer(asyncBufferSize_);
+		UScopeMutex lock(asyncRingsMutex());
+		asyncRings().push_back(threadRing.ring);
+	}
+
+	static thread_local std::string capturedArgs;
+	capturedArgs.clear();
+	captureArguments(msg, args, capturedArgs);
+
+	ULogRingHeader header;
+	header.size = 0;
+	header.formatSize = (unsigned int)strlen(msg) + 1;
+	header.argsSize = (unsigned int)capturedArgs.size();
+	header.level = level;
+	header.line = line;
+	header.sequence = asyncSequence++;
+	header.time = currentTime();
+	header.threadId = UThread::currentThreadId();
+	header.file = file;
+	header.function = function;
+	threadRing.ring->push(header, msg, capturedArgs);
+	return true;
+}
+
+void ULogger::writePendingAsync()
+{
+	// serialize the Flusher thread and flush() calls
+	static UMutex * pendingMutex = new UMutex();
+	UScopeMutex pendingLock(*pendingMutex);
+
+	std::list<ULogRingBuffer*> rings;
+	{
+		UScopeMutex lock(asyncRingsMutex());
+		rings = asyncRings();
+	}
+
+	std::vector<char> entries;
+	std::vector<std::pair<unsigned long long, size_t> > order;
+	int dropped = 0;
+	for(std::list<ULogRingBuffer*>::iterator iter=rings.begin(); iter!=rings.end(); ++iter)
+	{
+		(*iter)->pop(entries, order);
+		dropped += (*iter)->dropped.exchange(0);
+	}
+
+	if(order.size() || dropped)
+	{
+		// messages of different threads in the order they were logged (only
+		// in this batch, a message still being pushed will come in the next one)
+		std::sort(order.begin(), order.end());
+
+		loggerMutex_.lock();
+		if(instance_ && type_ != kTypeNoLog)
+		{
+			for(unsigned int i=0; i<order.size(); ++i)
+			{
+				ULogRingHeader header;
+				memcpy(&header, &entries[order[i].second], sizeof(ULogRingHeader));
+				if(threadIdFilter_.size() &&
+				   threadIdFilter_.find((unsigned long)header.threadId) == threadIdFilter_.end())
+				{
+					continue;
+				}
+				Record record;
+				record.time = header.time;
+				record.threadId = header.threadId;
+				record.level = header.level;
+				record.line = header.line;
+				record.file = header.file;
+				record.function = header.function;
+				record.format = &entries[order[i].second + sizeof(ULogRingHeader)];
+				record.args = record.format + header.formatSize;
+				record.argsSize = header.argsSize;
+				instance_->_writeRecord(record);
+			}
+			if(dropped)
+			{
+				std::string msg = uFormat("%d messages dropped, the asynchronous buffer of a thread was full "
+						"(current size is %d bytes, see ULogger::setAsynchronous()).", dropped, asyncBufferSize_);
+				Record record;
+				record.time = currentTime();
+				record.threadId = UThread::currentThreadId();
+				record.level = kWarning;
+				record.line = __LINE__;
+				record.file = __FILE__;
+				record.function = __FUNCTION__;
+				record.format = "%s";
+				std::string args;
+				appendValue(args, (unsigned int)msg.size());
+				args.append(msg);
+				record.args = args.data();
+				record.argsSize = (unsigned int)args.size();
+				instance_->_writeRecord(record);
+			}
+		}
+		loggerMutex_.unlock();
+	}
+
+	// remove the buffers of the exited threads
+	UScopeMutex lock(asyncRingsMutex());
+	for(std::list<ULogRingBuffer*>::iterator iter=asyncRings().begin(); iter!=asyncRings().end();)
+	{
+		if((*iter)->finished && (*iter)->empty())
+		{
+			delete *iter;
+			iter = asyncRings().erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+void ULogger::_writeRecord(const Record & record)
+{
+	Level level = (Level)record.level;
+	std::string msg = formatPrefix(level, record.file, record.line, record.function, (unsigned long)record.threadId, record.time);
+	msg.append(formatArguments(record.format, record.args, record.argsSize));
+
+#ifdef _WIN32
+	HANDLE H = GetStdHandle(STD_OUTPUT_HANDLE);
+#endif
+	bool colored = type_ == ULogger::kTypeConsole && printColored_;
+	if(colored)
+	{
+#ifdef _WIN32
+		SetConsoleTextAttribute(H, levelColor(level));
+#else
+		msg.insert(0, levelColor(level));
+		msg.append(COLOR_NORMAL);
+#endif
+	}
+	if(printEndline_)
+	{
+		msg.append("\r\n");
+	}
+	if(buffered_)
+	{
+		bufferedMsgs_.append(msg);
+	}
+	else
+	{
+		_writeStr(msg.c_str());
+	}
+#ifdef _WIN32
+	if(colored)
+	{
+		SetConsoleTextAttribute(H, COLOR_NORMAL);
+	}
+#endif
+}
+
+bool ULogger::decodeBinaryLog(const std::string & binaryLogPath, FILE * output)
+{
+	std::ifstream file(binaryLogPath.c_str(), std::ios::in | std::ios::binary);
+	if(!file.is_open())
+	{
+		return false;
+	}
+	std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	const char * p = data.empty()?0:&data[0];
+	const char * end = p + data.size();
+
+	std::map<unsigned int, std::string> strings;
+	bool headerFound = false;
+	while(p < end)
+	{
+		char tag = *p++;
+		if(tag == 'U')
+		{
+			// header of a new logging session, string ids are reset
+			unsigned int endianness = 0;
+			if(p + 7 > end || strncmp(p, "LOGBIN1", 7) != 0)
+			{
+				break;
+			}
+			p += 7;
+			if(!readValue(p, end, endianness) || endianness != 0x01020304)
+			{
+				fprintf(stderr, "Binary log \"%s\" has been saved on a computer with different endianness.\n", binaryLogPath.c_str());
+				return false;
+			}
+			strings.clear();
+			headerFound = true;
+		}
+		else if(!headerFound)
+		{
+			break;
+		}
+		else if(tag == 'S' || tag == 'T')
+		{
+			unsigned int id = 0;
+			unsigned int size = 0;
+			if((tag == 'S' && !readValue(p, end, id)) || !readValue(p, end, size) || p + size > end)
+			{
+				break;
+			}
+			if(tag == 'S')
+			{
+				strings[id] = std::string(p, size);
+			}
+			else
+			{
+				fwrite(p, 1, size, output);
+			}
+			p += size;
+		}
+		else if(tag == 'R')
+		{
+			Record record;
+			unsigned int fileId, functionId, formatId;
+			if(!readValue(p, end, record.time) ||
+			   !readValue(p, end, record.threadId) ||
+			   !readValue(p, end, record.level) ||
+			   !readValue(p, end, record.line) ||
+			   !readValue(p, end, fileId) ||
+			   !readValue(p, end, functionId) ||
+			   !readValue(p, end, formatId) ||
+			   !readValue(p, end, record.argsSize) ||
+			   p + record.argsSize > end ||
+			   record.level < kDebug || record.level > kFatal)
+			{
+				break;
+			}
+			record.file = strings[fileId].c_str();
+			record.function = strings[functionId].c_str();
+			record.format = strings[formatId].c_str();
+			record.args = p;
+			p += record.argsSize;
+
+			std::string msg = formatPrefix((Level)record.level, record.file, record.line, record.function, (unsigned long)record.threadId, record.time);
+			msg.append(formatArguments(record.format, record.args, record.argsSize));
+			if(printEndline_)
+			{
+				msg.append("\n");
+			}
+			fwrite(msg.data(), 1, msg.size(), output);
+		}
+		else
+		{
+			break;
+		}
+	}
+	if(p < end)
+	{
+		fprintf(stderr, "Binary log \"%s\" is corrupted or truncated (offset %d/%d).\n", binaryLogPath.c_str(), int(p-1-&data[0]), (int)data.size());
+	}
+	return headerFound;
+}
+
 void ULogger::write(const char* msg, ...)
 {
+	if(asynchronous_)
+	{
+		// keep the order with the messages not yet written
+		writePendingAsync();
+	}
+
 	loggerMutex_.lock();
 	if(!instance_)
 	{
@@ -364,6 +1277,27 @@ void ULogger::write(ULogger::Level level,
 		const char* msg,
 		...)
 {
+	if(asynchronous_ && level < kFatal && level < eventLevel_)
+	{
+		if(type_ == kTypeNoLog || level < level_ || (strlen(msg) == 0 && !printWhere_))
+		{
+			return;
+		}
+		va_list args;
+		va_start(args, msg);
+		bool queued = writeAsync(level, file, line, function, msg, args);
+		va_end(args);
+		if(queued)
+		{
+			return;
+		}
+	}
+	else if(asynchronous_)
+	{
+		// keep the order with the messages not yet written
+		writePendingAsync();
+	}
+
 	loggerMutex_.lock();
 	if(type_ == kTypeNoLog && level < kFatal && level < eventLevel_)
 	{
@@ -386,106 +1320,35 @@ void ULogger::write(ULogger::Level level,
 
     if(level >= level_ || level >= eventLevel_)
     {
-#ifdef _WIN32
-    	int color = 0;
-#else
-    	const char* color = NULL;
-#endif
-    	switch(level)
-    	{
-    	case kDebug:
-    		color = COLOR_GREEN;
-    		break;
-    	case kInfo:
-    		color = COLOR_NORMAL;
-    		break;
-    	case kWarning:
-    		color = COLOR_YELLOW;
-    		break;
-    	case kError:
-    	case kFatal:
-    		color = COLOR_RED;
-    		break;
-    	default:
-    		break;
-    	}
-
 		std::string endline = "";
 		if(printEndline_) {
 			endline = "\r\n";
 		}
 
-		std::string time = "";
-		if(printTime_ || level == kFatal)
-		{
-			time.append("(");
-			getTime(time);
-			time.append(") ");
-		}
-
-		std::string levelStr = "";
-		if(printLevel_ || level == kFatal)
-		{
-			const int bufSize = 30;
-			char buf[bufSize] = {0};
-
-#ifdef _MSC_VER
-			sprintf_s(buf, bufSize, "[%s]", levelName_[level]);
-#else
-			snprintf(buf, bufSize, "[%s]", levelName_[level]);
-#endif
-			levelStr = buf;
-			levelStr.append(" ");
-		}
+		long long time = currentTime();
+		std::string prefix = formatPrefix(level, file, line, function, UThread::currentThreadId(), time);
 
-		std::string pidStr;
-		if(printThreadID_)
-		{
-			pidStr = uFormat("{%lu} ", UThread::currentThreadId());
-		}
+		va_list args;
 
-		std::string whereStr = "";
-		if(printWhere_ || level == kFatal)
+		if(type_ == kTypeBinaryFile)
 		{
-			whereStr.append("");
-			//File
-			if(printWhereFullPath_)
-			{
-				whereStr.append(file);
-			}
-			else
-			{
-				std::string fileName = UFile::getName(file);
-				if(limitWhereLength_ && fileName.size() > 8)
-				{
-					fileName.erase(8);
-					fileName.append("~");
-				}
-				whereStr.append(fileName);
-			}
-
-			//Line
-			whereStr.append(":");
-			std::string lineStr = uNumber2Str(line);
-			whereStr.append(lineStr);
-
-			//Function
-			whereStr.append("::");
-			std::string funcStr = function;
-			if(!printWhereFullPath_ && limitWhereLength_ && funcStr.size() > 8)
-			{
-				funcStr.erase(8);
-				funcStr.append("~");
-			}
-			funcStr.append("()");
-			whereStr.append(funcStr);
-
-			whereStr.append(" ");
+			va_start(args, msg);
+			std::string capturedArgs;
+			captureArguments(msg, args, capturedArgs);
+			va_end(args);
+			Record record;
+			record.time = time;
+			record.threadId = UThread::currentThreadId();
+			record.level = level;
+			record.line = line;
+			record.file = file;
+			record.function = function;
+			record.format = msg;
+			record.args = capturedArgs.data();
+			record.argsSize = (unsigned int)capturedArgs.size();
+			ULogger::getInstance()->_writeRecord(record);
 		}
-
-		va_list args;
-
-		if(type_ != kTypeNoLog)
+		else if(type_ != kTypeNoLog)
 		{
 			va_start(args, msg);
 #ifdef _WIN32
@@ -494,33 +1357,27 @@ void ULogger::write(ULogger::Level level,
 			if(type_ == ULogger::kTypeConsole && printColored_)
 			{
 #ifdef _WIN32
-				SetConsoleTextAttribute(H,color);
+				SetConsoleTextAttribute(H,levelColor(level));
 #else
 				if(buffered_)
 				{
-					bufferedMsgs_.append(color);
+					bufferedMsgs_.append(levelColor(level));
 				}
 				else
 				{
-					ULogger::getInstance()->_writeStr(color);
+					ULogger::getInstance()->_writeStr(levelColor(level));
 				}
 #endif
 			}
 
 			if(buffered_)
 			{
-				bufferedMsgs_.append(levelStr.c_str());
-				bufferedMsgs_.append(pidStr.c_str());
-				bufferedMsgs_.append(time.c_str());
-				bufferedMsgs_.append(whereStr.c_str());
+				bufferedMsgs_.append(prefix.c_str());
 				bufferedMsgs_.append(uFormatv(msg, args));
 			}
 			else
 			{
-				ULogger::getInstance()->_writeStr(levelStr.c_str());
-				ULogger::getInstance()->_writeStr(pidStr.c_str());
-				ULogger::getInstance()->_writeStr(time.c_str());
-				ULogger::getInstance()->_writeStr(whereStr.c_str());
+				ULogger::getInstance()->_writeStr(prefix.c_str());
 				ULogger::getInstance()->_write(msg, args);
 			}
 			if(type_ == ULogger::kTypeConsole && printColored_)
@@ -551,7 +1408,7 @@ void ULogger::write(ULogger::Level level,
 
 		if(level >= eventLevel_)
 		{
-			std::string fullMsg = uFormat("%s%s%s%s", levelStr.c_str(), pidStr.c_str(), time.c_str(), whereStr.c_str());
+			std::string fullMsg = prefix;
 			va_start(args, msg);
 			fullMsg.append(uFormatv(msg, args));
 			va_end(args);
@@ -569,7 +1426,7 @@ void ULogger::write(ULogger::Level level,
 
 		if(level >= kFatal)
 		{
-			std::string fullMsg = uFormat("%s%s%s%s", levelStr.c_str(), pidStr.c_str(), time.c_str(), whereStr.c_str());
+			std::string fullMsg = prefix;
 			va_start(args, msg);
 			fullMsg.append(uFormatv(msg, args));
 			va_end(args);
@@ -590,15 +1447,103 @@ void ULogger::write(ULogger::Level level,
     loggerMutex_.unlock();
 }
 
+std::string ULogger::formatPrefix(ULogger::Level level,
+		const char * file,
+		int line,
+		const char * function,
+		unsigned long threadId,
+		long long time)
+{
+	std::string levelStr = "";
+	if(printLevel_ || level == kFatal)
+	{
+		const int bufSize = 30;
+		char buf[bufSize] = {0};
+
+#ifdef _MSC_VER
+		sprintf_s(buf, bufSize, "[%s]", levelName_[level]);
+#else
+		snprintf(buf, bufSize, "[%s]", levelName_[level]);
+#endif
+		levelStr = buf;
+		levelStr.append(" ");
+	}
+
+	std::string pidStr;
+	if(printThreadID_)
+	{
+		pidStr = uFormat("{%lu} ", threadId);
+	}
+
+	std::string timeStr = "";
+	if(printTime_ || level == kFatal)
+	{
+		timeStr.append("(");
+		formatTime(time, timeStr);
+		timeStr.append(") ");
+	}
+
+	std::string whereStr = "";
+	if(printWhere_ || level == kFatal)
+	{
+		whereStr.append("");
+		//File
+		if(printWhereFullPath_)
+		{
+			whereStr.append(file);
+		}
+		else
+		{
+			std::string fileName = UFile::getName(file);
+			if(limitWhereLength_ && fileName.size() > 8)
+			{
+				fileName.erase(8);
+				fileName.append("~");
+			}
+			whereStr.append(fileName);
+		}
+
+		//Line
+		whereStr.append(":");
+		std::string lineStr = uNumber2Str(line);
+		whereStr.append(lineStr);
+
+		//Function
+		whereStr.append("::");
+		std::string funcStr = function;
+		if(!printWhereFullPath_ && limitWhereLength_ && funcStr.size() > 8)
+		{
+			funcStr.erase(8);
+			funcStr.append("~");
+		}
+		funcStr.append("()");
+		whereStr.append(funcStr);
+
+		whereStr.append(" ");
+	}
+
+	return levelStr + pidStr + timeStr + whereStr;
+}
+
+long long ULogger::currentTime()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
 int ULogger::getTime(std::string &timeStr)
+{
+	return formatTime(currentTime(), timeStr);
+}
+
+int ULogger::formatTime(long long time, std::string &timeStr)
 {
     struct tm timeinfo;
     const int bufSize = 30;
     char buf[bufSize] = {0};
+    time_t rawtime = (time_t)(time / 1000000);
 
 #if _MSC_VER
-    time_t rawtime;
-    time(&rawtime);
     localtime_s (&timeinfo, &rawtime );
     int result = sprintf_s(buf, bufSize, "%d-%s%d-%s%d %s%d:%s%d:%s%d",
         timeinfo.tm_year+1900,
@@ -608,8 +1553,6 @@ int ULogger::getTime(std::string &timeStr)
         (timeinfo.tm_min) < 10 ? "0":"", timeinfo.tm_min,
         (timeinfo.tm_sec) < 10 ? "0":"", timeinfo.tm_sec);
 #elif WIN32
-    time_t rawtime;
-    time(&rawtime);
     timeinfo = *localtime (&rawtime);
     int result = snprintf(buf, bufSize, "%d-%s%d-%s%d %s%d:%s%d:%s%d",
 		timeinfo.tm_year+1900,
@@ -619,9 +1562,8 @@ int ULogger::getTime(std::string &timeStr)
 		(timeinfo.tm_min) < 10 ? "0":"", timeinfo.tm_min,
 		(timeinfo.tm_sec) < 10 ? "0":"", timeinfo.tm_sec);
  #else
-    struct timeval rawtime;
-    gettimeofday(&rawtime, NULL);
-    localtime_r (&rawtime.tv_sec, &timeinfo);
+    int ms = int((time / 1000) % 1000);
+    localtime_r (&rawtime, &timeinfo);
 	int result = snprintf(buf, bufSize, "%d-%s%d-%s%d %s%d:%s%d:%s%d.%s%d",
 		timeinfo.tm_year+1900,
 		(timeinfo.tm_mon+1) < 10 ? "0":"", timeinfo.tm_mon+1,
@@ -629,7 +1571,7 @@ int ULogger::getTime(std::string &timeStr)
 		(timeinfo.tm_hour) < 10 ? "0":"", timeinfo.tm_hour,
 		(timeinfo.tm_min) < 10 ? "0":"", timeinfo.tm_min,
 		(timeinfo.tm_sec) < 10 ? "0":"", timeinfo.tm_sec,
-	    (rawtime.tv_usec/1000) < 10 ? "00":(rawtime.tv_usec/1000) < 100?"0":"", int(rawtime.tv_usec/1000));
+	    ms < 10 ? "00":ms < 100?"0":"", ms);
 #endif
     if(result)
     {
@@ -658,6 +1600,10 @@ ULogger* ULogger::createInstance()
     {
         instance = new UFileLogger(logFileName_, append_);
     }
+    else if(type_ == ULogger::kTypeBinaryFile)
+    {
+        instance = new UBinaryFileLogger(logFileName_, append_);
+    }
     destroyer_.setDoomed(instance);
     return instance;
 }
@@ -0,0 +1,232 @@
+/*
+*  utilite is a cross-platform library with
+*  useful utilities for fast and small developing.
+*  Copyright (C) 2010  Mathieu Labbe
+*
+*  utilite is free library: you can redistribute it and/or modify
+*  it under the terms of the GNU Lesser General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  utilite is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rtabmap/utilite/UThreadPool.h"
+#include "rtabmap/utilite/UThread.h"
+#include "rtabmap/utilite/ULogger.h"
+#include <exception>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+struct UThreadPool::Batch
+{
+	Batch(int size) : pending(size) {}
+	int pending; // protected by UThreadPool::pendingMutex_
+	std::exception_ptr exception; // first exception thrown by a task, protected by UThreadPool::pendingMutex_
+	USemaphore done;
+};
+
+class UThreadPool::Worker : public UThread
+{
+public:
+	Worker(UThreadPool * pool, int queueIndex) :
+		pool_(pool),
+		queueIndex_(queueIndex)
+	{}
+	virtual ~Worker()
+	{
+		join(true);
+	}
+	void wakeUp()
+	{
+		wake_.release();
+	}
+
+private:
+	virtual void mainLoop()
+	{
+		wake_.acquire();
+		if(!this->isKilled())
+		{
+			while(pool_->runOne(queueIndex_))
+			{
+			}
+		}
+	}
+	virtual void mainLoopKill()
+	{
+		wake_.release();
+	}
+
+private:
+	UThreadPool * pool_;
+	int queueIndex_;
+	USemaphore wake_;
+};
+
+int UThreadPool::idealThreadCount()
+{
+	int count = 0;
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	count = (int)info.dwNumberOfProcessors;
+#else
+	count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return count>0?count:1;
+}
+
+UThreadPool::UThreadPool(int threads)
+{
+	if(threads <= 0)
+	{
+		threads = idealThreadCount();
+	}
+	queues_.resize(threads);
+	queuesMutexes_.resize(threads);
+	for(int i=0; i<threads; ++i)
+	{
+		queuesMutexes_[i] = new UMutex();
+	}
+	// the last queue is for the calling thread
+	for(int i=0; i<threads-1; ++i)
+	{
+		workers_.push_back(new Worker(this, i));
+		workers_.back()->start();
+	}
+	UDEBUG("threads=%d", threads);
+}
+
+UThreadPool::~UThreadPool()
+{
+	for(unsigned int i=0; i<workers_.size(); ++i)
+	{
+		delete workers_[i];
+	}
+	workers_.clear();
+	for(unsigned int i=0; i<queuesMutexes_.size(); ++i)
+	{
+		delete queuesMutexes_[i];
+	}
+	queuesMutexes_.clear();
+}
+
+void UThreadPool::run(const std::vector<UThreadPoolTask*> & tasks)
+{
+	if(tasks.empty())
+	{
+		return;
+	}
+
+	Batch batch((int)tasks.size());
+
+	// contiguous blocks of tasks per queue, stealing will balance the rest
+	int queues = (int)queues_.size();
+	for(int q=0; q<queues; ++q)
+	{
+		unsigned int begin = (unsigned int)((long long)tasks.size()*q/queues);
+		unsigned int end = (unsigned int)((long long)tasks.size()*(q+1)/queues);
+		UScopeMutex queueLock(queuesMutexes_[q]);
+		for(unsigned int i=begin; i<end; ++i)
+		{
+			queues_[q].push_back(std::make_pair(tasks[i], &batch));
+		}
+	}
+	for(unsigned int i=0; i<workers_.size(); ++i)
+	{
+		workers_[i]->wakeUp();
+	}
+
+	// help until all our tasks are taken (we may execute tasks of other batches)
+	while(!isDone(batch) && runOne(queues-1))
+	{
+	}
+
+	// wait for our tasks still running in other threads
+	batch.done.acquire();
+
+	// no task references the batch anymore
+	if(batch.exception)
+	{
+		std::rethrow_exception(batch.exception);
+	}
+}
+
+bool UThreadPool::isDone(const Batch & batch) const
+{
+	UScopeMutex lock(pendingMutex_);
+	return batch.pending == 0;
+}
+
+bool UThreadPool::runOne(int queueIndex)
+{
+	std::pair<UThreadPoolTask*, Batch*> task(0, 0);
+	// front of our own queue, then steal at the back of the others
+	for(unsigned int i=0; task.first==0 && i<queues_.size(); ++i)
+	{
+		int index = (queueIndex + i) % queues_.size();
+		UScopeMutex lock(queuesMutexes_[index]);
+		std::deque<std::pair<UThreadPoolTask*, Batch*> > & queue = queues_[index];
+		if(!queue.empty())
+		{
+			if(i == 0)
+			{
+				task = queue.front();
+				queue.pop_front();
+			}
+			else
+			{
+				task = queue.back();
+				queue.pop_back();
+			}
+		}
+	}
+
+	if(task.first == 0)
+	{
+		return false;
+	}
+
+	// the remaining tasks of a batch are skipped after an exception
+	pendingMutex_.lock();
+	bool cancelled = (bool)task.second->exception;
+	pendingMutex_.unlock();
+	if(!cancelled)
+	{
+		try
+		{
+			task.first->run();
+		}
+		catch(...)
+		{
+			// rethrown by run() in the thread waiting for the batch
+			pendingMutex_.lock();
+			if(!task.second->exception)
+			{
+				task.second->exception = std::current_exception();
+			}
+			pendingMutex_.unlock();
+		}
+	}
+
+	pendingMutex_.lock();
+	bool done = --task.second->pending == 0;
+	pendingMutex_.unlock();
+	if(done)
+	{
+		// the batch may be destroyed as soon as this is released
+		task.second->done.release();
+	}
+	return true;
+}